@@ -0,0 +1,219 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file AsyncLogger.hpp
+ * @brief Header file for the AsyncLogger class.
+ */
+
+#ifndef INCLUDE_OKVIS_ASYNCLOGGER_HPP_
+#define INCLUDE_OKVIS_ASYNCLOGGER_HPP_
+
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <okvis/Time.hpp>
+#include <okvis/threadsafe/LockFreeQueue.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Writes tables (states, landmarks, tracks) to a file on a background thread.
+ *
+ * The producer appends rows and hands them over with commit(), which only copies them into a lock-free queue.
+ * Formatting and disk I/O happen on the writer thread, which writes in large blocks. Rows are written either as CSV
+ * or in a compact binary columnar format that convertToCsv() turns into the very same CSV.
+ *
+ * Binary format (little endian): the magic "OKVISLOG", uint32 version, uint32 number of columns, and for every column
+ * its uint8 type, uint8 name length and name. Then blocks of uint32 number of rows followed by the 8 byte cells of
+ * every column, one column after the other.
+ *
+ * There must only be one producer per logger.
+ */
+class AsyncLogger {
+ public:
+  /// \brief Output format.
+  enum class Format { Csv, Binary };
+
+  /// \brief Type of a column. Decides how the cells are formatted in CSV.
+  enum class ColumnType : uint8_t {
+    Timestamp = 0,  ///< Nanoseconds, written as seconds followed by nine digits of nanoseconds.
+    Integer = 1,    ///< Signed 64 bit integer.
+    Double = 2      ///< Written in scientific notation with 18 digits.
+  };
+
+  /// \brief A column of the table.
+  struct Column {
+    std::string name;  ///< Name in the CSV header.
+    ColumnType type;   ///< Type of the cells.
+  };
+
+  /// \brief A cell of the table.
+  union Cell {
+    int64_t integer;  ///< Timestamp and Integer columns.
+    double real;      ///< Double columns.
+  };
+
+  /// \brief Default constructor.
+  AsyncLogger();
+  /// \brief Destructor. Calls close().
+  ~AsyncLogger();
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  /**
+   * @brief Create a file and start the writer thread. Closes a previously opened file.
+   * @param filename The file name.
+   * @param format The output format.
+   * @return True if the file could be created.
+   */
+  bool open(const std::string& filename, Format format);
+
+  /**
+   * @brief Write to a stream and start the writer thread. Closes a previously opened file.
+   * @param stream The stream. Not owned, has to outlive the logger or the next call to close().
+   * @param format The output format.
+   * @return True if the stream is good.
+   */
+  bool open(std::ostream& stream, Format format);
+
+  /// \brief Write all committed rows and stop the writer thread. Rows appended but not committed are discarded.
+  void close();
+
+  /// \brief Whether a file is open.
+  bool isOpen() const { return stream_ != nullptr; }
+
+  /// \brief Whether the columns have been set.
+  bool hasColumns() const { return !columns_.empty(); }
+
+  /// \brief Set the columns. Has to happen once per file, before the first commit().
+  void setColumns(const std::vector<Column>& columns);
+
+  /// \brief The columns.
+  const std::vector<Column>& columns() const { return columns_; }
+
+  /// \name Producer side
+  /// \{
+
+  /// \brief Append a timestamp cell to the current row.
+  AsyncLogger& timestamp(const okvis::Time& t) { return integer(static_cast<int64_t>(t.toNSec())); }
+  /// \brief Append an integer cell to the current row.
+  AsyncLogger& integer(int64_t value) {
+    pending_.emplace_back();
+    pending_.back().integer = value;
+    return *this;
+  }
+  /// \brief Append a double cell to the current row.
+  AsyncLogger& real(double value) {
+    pending_.emplace_back();
+    pending_.back().real = value;
+    return *this;
+  }
+  /// \brief Append the coefficients of a vector as double cells to the current row.
+  template <typename Derived>
+  AsyncLogger& reals(const Eigen::MatrixBase<Derived>& values) {
+    for (int i = 0; i < values.size(); ++i) real(values[i]);
+    return *this;
+  }
+
+  /// \brief Hand all complete rows appended since the last commit over to the writer thread. Never blocks: if the
+  ///        writer falls far behind, the oldest uncommitted batch is dropped.
+  void commit();
+
+  /// \brief Number of batches dropped because the writer fell behind.
+  size_t numDropped() const { return numDropped_; }
+
+  /// \}
+
+  /**
+   * @brief Convert a binary log to CSV. The output is the same as if the logger had written CSV directly.
+   * @param in The binary log.
+   * @param out The CSV output.
+   * @return False if the input is no binary log or is truncated.
+   */
+  static bool convertToCsv(std::istream& in, std::ostream& out);  // NOLINT
+
+ private:
+  /// \brief Rows handed over in one commit().
+  typedef std::vector<Cell> Batch;
+
+  /// \brief Start the writer thread.
+  bool start(Format format);
+  /// \brief The writer thread.
+  void writerLoop();
+  /// \brief Format a batch into the output buffer, or gather it for the next binary block.
+  void append(const Batch& batch);
+  /// \brief Write the output buffer to the stream.
+  void write();
+
+  /// \brief Append the CSV header.
+  static void appendCsvHeader(const std::vector<Column>& columns, std::string& buffer);  // NOLINT
+  /// \brief Append a row as a CSV line.
+  static void appendCsvRow(const std::vector<Column>& columns,
+                           const Cell* row,
+                           size_t stride,
+                           std::string& buffer);  // NOLINT
+
+  /// \brief Bytes of formatted output the writer collects before writing them.
+  static const size_t kWriteSize = 1 << 20;
+  /// \brief Rows per block of the binary format.
+  static const size_t kRowsPerBlock = 4096;
+  /// \brief The writer also writes if output is older than this.
+  static constexpr std::chrono::milliseconds kWritePeriod{500};
+
+  std::vector<Column> columns_;  ///< The columns.
+  Format format_;                ///< The output format.
+  std::ostream* stream_;         ///< The output, nullptr if closed.
+  std::unique_ptr<std::ofstream> file_;  ///< The file, if opened by name.
+
+  Batch pending_;                                  ///< Rows appended but not committed.
+  okvis::threadsafe::LockFreeQueue<Batch> queue_;  ///< Committed batches.
+  size_t numDropped_;                              ///< Number of dropped batches.
+
+  std::thread writer_;          ///< The writer thread.
+  std::atomic_bool closing_;    ///< Tells the writer to write everything left and stop.
+  bool headerWritten_;          ///< Writer thread: the header is in the output.
+  std::string buffer_;          ///< Writer thread: formatted output not yet written.
+  std::vector<Cell> blockRows_; ///< Writer thread: rows of the binary block being gathered.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_ASYNCLOGGER_HPP_ */
@@ -0,0 +1,174 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file ImagePreprocessor.hpp
+ * @brief Header file for the ImagePreprocessor class.
+ */
+
+#ifndef INCLUDE_OKVIS_IMAGEPREPROCESSOR_HPP_
+#define INCLUDE_OKVIS_IMAGEPREPROCESSOR_HPP_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverloaded-virtual"
+#include <opencv2/opencv.hpp>
+#pragma GCC diagnostic pop
+
+#include <okvis/Parameters.hpp>
+#include <okvis/Time.hpp>
+#include <okvis/threadsafe/LockFreeQueue.hpp>
+#include <okvis/timing/Timer.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Converts, resizes, median filters and equalises the camera images before they are handed to the estimator.
+ *
+ * Every camera has its own worker thread, so the images of a stereo pair are processed in parallel and the ROS
+ * callback thread only enqueues them. The intermediate images are written into buffers that are kept per camera. Only
+ * the output of the last stage is allocated per frame, since the estimator keeps it.
+ * If the workers fall behind, whole multiframes are dropped: the first image of a timestamp decides for all cameras,
+ * so the estimator never waits for the missing image of a multiframe.
+ */
+class ImagePreprocessor {
+ public:
+#ifdef DEACTIVATE_TIMERS
+  typedef okvis::timing::DummyTimer TimerSwitchable;
+#else
+  typedef okvis::timing::Timer TimerSwitchable;
+#endif
+
+  /// \brief Receives the preprocessed images. Called from the worker threads. Returns false if the image was dropped.
+  typedef std::function<bool(const okvis::Time& stamp, size_t cameraIndex, const cv::Mat& image)> ImageCallback;
+
+  /// \brief Counters of one camera.
+  struct Statistics {
+    size_t numReceived;   ///< Images handed to addImage().
+    size_t numProcessed;  ///< Images passed on to the callback.
+    size_t numDropped;    ///< Images dropped because a worker fell behind.
+  };
+
+  /**
+   * @brief Constructor. Starts one worker thread per camera.
+   * @param parameters The parameters, for the resize factor, median filter and histogram equalisation.
+   * @param numCameras Number of cameras.
+   * @param callback Receives the preprocessed images.
+   * @param maxQueueSize Images waiting in any camera before new multiframes are dropped.
+   */
+  ImagePreprocessor(const okvis::VioParameters& parameters,
+                    size_t numCameras,
+                    const ImageCallback& callback,
+                    size_t maxQueueSize = 2);
+  /// \brief Destructor. Stops the workers, images still queued are dropped.
+  ~ImagePreprocessor();
+  ImagePreprocessor(const ImagePreprocessor&) = delete;
+  ImagePreprocessor& operator=(const ImagePreprocessor&) = delete;
+
+  /**
+   * @brief Queue an image, or drop it with the other images of its multiframe. Never blocks.
+   * @param stamp Timestamp of the image.
+   * @param cameraIndex Index of the camera.
+   * @param image The image, 8 bit grey or colour. Only read, it may point into a ROS message.
+   * @param colorConversion cv::ColorConversionCodes to grey, or -1 if the image is grey already.
+   * @param owner Keeps the memory of image alive until it is processed, may be NULL if image owns its data.
+   */
+  void addImage(const okvis::Time& stamp,
+                size_t cameraIndex,
+                const cv::Mat& image,
+                int colorConversion,
+                const std::shared_ptr<const void>& owner);
+
+  /// \brief Counters of one camera.
+  Statistics statistics(size_t cameraIndex) const;
+
+ private:
+  /// \brief A queued image.
+  struct Job {
+    okvis::Time stamp;                   ///< Timestamp.
+    cv::Mat image;                       ///< Input image.
+    int colorConversion;                 ///< Conversion to grey, -1 if none.
+    std::shared_ptr<const void> owner;   ///< Keeps the input alive.
+  };
+
+  /// \brief Whether the images of a timestamp are queued, decided by the first of them.
+  struct Admission {
+    okvis::Time stamp;  ///< Timestamp of the first image.
+    bool admitted;      ///< Queue the images?
+    size_t numImages;   ///< Images of this timestamp seen so far.
+  };
+
+  /// \brief State of one camera.
+  struct Lane {
+    Lane(size_t cameraIndex, size_t maxQueueSize);
+
+    okvis::threadsafe::LockFreeQueue<Job> queue;  ///< Images waiting.
+    std::thread worker;                           ///< The worker thread.
+    cv::Mat grey;                                 ///< Buffer for the conversion to grey.
+    cv::Mat resized;                              ///< Buffer for the resized image.
+    cv::Mat filtered;                             ///< Buffer for the median filtered image.
+    cv::Ptr<cv::CLAHE> clahe;                     ///< Not thread safe, hence one per camera.
+    TimerSwitchable convertTimer;                 ///< Time spent converting to grey.
+    TimerSwitchable resizeTimer;                  ///< Time spent resizing.
+    TimerSwitchable medianTimer;                  ///< Time spent median filtering.
+    TimerSwitchable histogramTimer;               ///< Time spent equalising the histogram.
+    std::atomic<size_t> numReceived;              ///< Images queued.
+    std::atomic<size_t> numProcessed;             ///< Images passed on.
+    std::atomic<size_t> numDropped;               ///< Images dropped.
+  };
+
+  /// \brief Decide whether to queue an image, the same way for every camera of its multiframe.
+  bool admit(const okvis::Time& stamp);
+  /// \brief The worker thread of a camera.
+  void workerLoop(size_t cameraIndex);
+  /// \brief Run all stages on one image.
+  cv::Mat preprocess(Lane& lane, const Job& job);  // NOLINT
+
+  okvis::MiscParams miscParams_;            ///< The resize factor.
+  okvis::HistogramParams histogramParams_;  ///< The histogram equalisation.
+  bool useMedianFilter_;                    ///< Median filter the images?
+  ImageCallback callback_;                  ///< Receives the preprocessed images.
+  double frameTimestampTolerance_;          ///< Images closer in time than this are of the same multiframe. [s]
+  size_t maxQueueSize_;                     ///< Images waiting in any camera before new multiframes are dropped.
+  std::vector<std::unique_ptr<Lane>> lanes_;  ///< One per camera.
+  std::mutex admissionMutex_;                 ///< Guards admissions_.
+  std::deque<Admission> admissions_;          ///< Multiframes with images still to come, oldest first.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_IMAGEPREPROCESSOR_HPP_ */
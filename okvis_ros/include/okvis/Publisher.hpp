@@ -67,7 +67,9 @@
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
 
+#include <okvis/AsyncLogger.hpp>
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/KeyframePacket.hpp>
 #include <okvis/Parameters.hpp>
 #include <okvis/Time.hpp>
 #include <okvis/kinematics/Transformation.hpp>
@@ -102,7 +104,7 @@ class Publisher {
   void setNodeHandle(ros::NodeHandle& nh);  // NOLINT
 
   /// \brief Set an odometry output CSV file.
-  /// \param csvFile The file
+  /// \param csvFile The file. Not owned, has to outlive the publisher.
   bool setCsvFile(std::fstream& csvFile);
   /// \brief Set an odometry output CSV file.
   /// \param csvFileName The filename of a new file
@@ -112,7 +114,7 @@ class Publisher {
   bool setCsvFile(std::string csvFileName);
 
   /// \brief              Set a CVS file where the landmarks will be saved to.
-  /// \param csvFile      The file
+  /// \param csvFile      The file. Not owned, has to outlive the publisher.
   bool setLandmarksCsvFile(std::fstream& csvFile);  // NOLINT
   /// \brief              Set a CVS file where the landmarks will be saved to.
   /// \param csvFileName  The filename of a new file
@@ -121,6 +123,19 @@ class Publisher {
   /// \param csvFileName  The filename of a new file
   bool setLandmarksCsvFile(std::string csvFileName);  // NOLINT
 
+  /// \brief Set an odometry output file, written on a background thread.
+  /// \param fileName The filename of a new file.
+  /// \param format CSV or binary, see okvis_log_to_csv to convert the latter.
+  bool setStateLogFile(const std::string& fileName, AsyncLogger::Format format);
+  /// \brief Set a file where the landmarks will be saved to, written on a background thread.
+  /// \param fileName The filename of a new file.
+  /// \param format CSV or binary, see okvis_log_to_csv to convert the latter.
+  bool setLandmarksLogFile(const std::string& fileName, AsyncLogger::Format format);
+  /// \brief Set a file where the keyframe tracks will be saved to, written on a background thread.
+  /// \param fileName The filename of a new file.
+  /// \param format CSV or binary, see okvis_log_to_csv to convert the latter.
+  bool setTracksLogFile(const std::string& fileName, AsyncLogger::Format format);
+
   /**
    * @brief Set the pose message that is published next.
    * @param T_WS The pose.
@@ -236,7 +251,7 @@ class Publisher {
   void publishKeyframeAsCallback(const okvis::Time& t,
                                  const cv::Mat& imageL,
                                  const okvis::kinematics::Transformation& T_WCa,
-                                 std::vector<std::list<std::vector<double> > >& keyframePoints);  // NOLINT
+                                 const okvis::KeyframePacket& keyframePoints);
   void publishRelocRelativePoseAsCallback(const okvis::Time& t,
                                           const Eigen::Vector3d& relative_t,
                                           const Eigen::Quaterniond& relative_q,
@@ -302,10 +317,12 @@ class Publisher {
   /// @}
 
  private:
-  /// @brief Write CSV header.
-  bool writeCsvDescription();
-  /// @brief Write CSV header for landmarks file.
-  bool writeLandmarksCsvDescription();
+  /// @brief Hand a state row over to the state log.
+  void logState(const okvis::Time& t,
+                const okvis::kinematics::Transformation& T_WS,
+                const Eigen::Matrix<double, 9, 1>& speedAndBiases,
+                const std::vector<okvis::kinematics::Transformation,
+                                  Eigen::aligned_allocator<okvis::kinematics::Transformation> >& extrinsics);
 
   /// @name Node and subscriber related
   /// @{
@@ -368,8 +385,9 @@ class Publisher {
 
   uint32_t ctr2_;  ///< The counter for the amount of transferred points. Used for the seq parameter in the header.
 
-  std::shared_ptr<std::fstream> csvFile_;           ///< CSV file to save state in.
-  std::shared_ptr<std::fstream> csvLandmarksFile_;  ///< CSV file to save landmarks in.
+  okvis::AsyncLogger stateLogger_;      ///< Log to save the states in.
+  okvis::AsyncLogger landmarksLogger_;  ///< Log to save the landmarks in.
+  okvis::AsyncLogger tracksLogger_;     ///< Log to save the keyframe tracks in.
 
   // FIXME Sharmin: This is an easy hack to use this publisher as an extern
   ros::Publisher pubSvinHealth;  // Sharmin: To publish SVIn2 health
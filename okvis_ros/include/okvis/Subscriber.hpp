@@ -86,6 +86,7 @@
 #include <visensor/visensor_api.hpp>
 #endif
 
+#include <okvis/ImagePreprocessor.hpp>
 #include <okvis/Publisher.hpp>
 #include <okvis/ThreadedKFVio.hpp>
 #include <okvis/Time.hpp>
@@ -125,13 +126,19 @@ class Subscriber {
   /// @brief Set custom world transformation for reloc callback @Hunter
   void setT_Wc_W(okvis::kinematics::Transformation T_Wc_W);
 
+  /// @brief Received, processed and dropped images of a camera.
+  ImagePreprocessor::Statistics imageStatistics(size_t cameraIndex) const {
+    return imagePreprocessor_->statistics(cameraIndex);
+  }
+
  protected:
-  const cv::Mat readRosImage(const sensor_msgs::ImageConstPtr& img_msg) const;
+  /// @brief Hand a preprocessed image to the estimator. Called by the preprocessing workers.
+  bool addPreprocessedImage(const okvis::Time& t, size_t cameraIndex, const cv::Mat& image);
 
   /// @name ROS callbacks
   /// @{
 
-  /// @brief The image callback.
+  /// @brief The image callback. Only queues the image for preprocessing.
   void imageCallback(const sensor_msgs::ImageConstPtr& msg, unsigned int cameraIndex);
   /// @brief The depth image callback.
   /// @warning Not implemented.
@@ -188,7 +195,6 @@ class Subscriber {
   ros::Subscriber subSonarRange_;                              ///< The Sonar Range Subscriber @Sharmin
   ros::Subscriber subDepth_;                                   ///< The Depth Subscriber @Sharmin
   ros::Subscriber subReloPoints_;  ///< The Relocalization Points Subscriber from pose_graph @Sharmin
-  cv::Ptr<cv::CLAHE> clahe;        /// Sharmin
   /// @}
 
 #ifdef HAVE_LIBVISENSOR
@@ -200,6 +206,9 @@ class Subscriber {
   okvis::VioInterface* vioInterface_;   ///< The VioInterface. (E.g. ThreadedKFVio)
   okvis::VioParameters vioParameters_;  ///< The parameters and settings.
 
+  std::unique_ptr<okvis::ImagePreprocessor> imagePreprocessor_;  ///< Resizing, filtering, histogram equalisation.
+  std::mutex addImageMutex_;  ///< The preprocessing workers of the cameras take turns in adding images.
+
   /// @Sharmin
   // std::mutex lastState_mutex_;            ///< Lock when accessing any of the 'lastOptimized*' variables.
   /// TODO: @Sharmin: Parameter
@@ -45,12 +45,16 @@
 
 #include <array>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/LandmarkSpatialIndex.hpp>
+#include <okvis/MeasurementBuffer.hpp>
 #include <okvis/Measurements.hpp>
 #include <okvis/MultiFrame.hpp>
+#include <okvis/SolverSelector.hpp>
 #include <okvis/Variables.hpp>
 #include <okvis/VioBackendInterface.hpp>
 #include <okvis/assert_macros.hpp>
@@ -69,6 +73,8 @@
 /// \brief okvis Main namespace of this package.
 namespace okvis {
 
+class ThreadPool;
+
 //! The estimator class
 /*!
  The estimator class. This does all the backend work.
@@ -211,14 +217,26 @@ class Estimator : public VioBackendInterface {
   static bool initPoseFromImu(const okvis::ImuMeasurementDeque& imuMeasurements,
                               okvis::kinematics::Transformation& T_WS);  // NOLINT
 
+  /// \brief Same as above, on IMU measurements viewed in a measurement buffer.
+  static bool initPoseFromImu(const okvis::ImuMeasurementSpan& imuMeasurements,
+                              okvis::kinematics::Transformation& T_WS);  // NOLINT
+
   /**
    * @brief Start ceres optimization.
+   * @warning The landmarks are not synchronised with the optimised map, call updateLandmarks() afterwards.
    * @param[in] numIter Maximum number of iterations.
    * @param[in] numThreads Number of threads.
    * @param[in] verbose Print out optimization progress and result, if true.
    */
   void optimize(size_t numIter, size_t numThreads = 1, bool verbose = false);
 
+  /**
+   * @brief Copy the optimised landmark estimates into the landmarks and recompute their quality from the Hessian
+   *        blocks of the map.
+   * @param[in] numThreads Number of threads the landmarks are split on.
+   */
+  void updateLandmarks(size_t numThreads = 1);
+
   /**
    * @brief Set a time limit for the optimization process.
    * @param[in] timeLimit Time limit in seconds. If timeLimit < 0 the time limit is removed.
@@ -228,6 +246,15 @@ class Estimator : public VioBackendInterface {
    */
   bool setOptimizationTimeLimit(double timeLimit, int minIterations);
 
+  /**
+   * @brief Configure the solver used by optimize().
+   * @param[in] optimization The linear solver, preconditioner and trust region strategy to use. With the linear
+   *            solver AUTO, optimize() times DENSE_SCHUR, SPARSE_SCHUR and ITERATIVE_SCHUR on the windows of every
+   *            size and then uses the fastest.
+   * @return True if Ceres supports the configuration, otherwise the previous one is kept.
+   */
+  bool setSolverOptions(const okvis::Optimization& optimization);
+
   /**
    * @brief Checks whether the landmark is added to the estimator.
    * @param landmarkId The ID.
@@ -604,8 +631,15 @@ class Estimator : public VioBackendInterface {
   uint64_t referencePoseId_;  ///< The pose ID of the reference (currently not changing)
 
   // the following are updated after the optimization
-  okvis::PointMap landmarksMap_;    ///< Contains all the current landmarks (synched after optimisation).
-  mutable std::mutex statesMutex_;  ///< Regulate access of landmarksMap_.
+  okvis::PointMap landmarksMap_;               ///< Contains all the current landmarks (synched after optimisation).
+  mutable std::mutex statesMutex_;             ///< Regulate access of landmarksMap_.
+  okvis::LandmarkSpatialIndex landmarkIndex_;  ///< Positions of landmarksMap_, for the sonar association.
+
+  // landmark update, the buffers are kept to not allocate after every optimisation
+  std::unique_ptr<okvis::ThreadPool> landmarkThreadPool_;     ///< Workers of updateLandmarks().
+  std::vector<okvis::PointMap::iterator> landmarksToUpdate_;  ///< The landmarks in a random access order.
+  std::vector<okvis::ceres::Map::LhsScratch> lhsScratch_;     ///< Scratch memory per worker.
+  std::vector<std::future<void>> landmarkUpdates_;            ///< Pending slices of updateLandmarks().
 
   // parameters
   std::vector<okvis::ExtrinsicsEstimationParameters,
@@ -622,6 +656,12 @@ class Estimator : public VioBackendInterface {
   std::shared_ptr<ceres::MarginalizationError> marginalizationErrorPtr_;  ///< The marginalisation class
   ::ceres::ResidualBlockId marginalizationResidualId_;                    ///< Remembers the marginalisation object's Id
 
+  // solver configuration, several candidates if the fastest one is picked automatically
+  std::vector<std::pair<::ceres::LinearSolverType, ::ceres::PreconditionerType>>
+      solverCandidates_;                                   ///< Linear solver and preconditioner candidates.
+  ::ceres::TrustRegionStrategyType trustRegionStrategy_;   ///< The trust region strategy.
+  std::unique_ptr<okvis::SolverSelector> solverSelector_;  ///< Picks one of several candidates, NULL otherwise.
+
   // ceres iteration callback object
   std::unique_ptr<okvis::ceres::CeresIterationCallback>
       ceresCallback_;  ///< Maybe there was a callback registered, store it here.
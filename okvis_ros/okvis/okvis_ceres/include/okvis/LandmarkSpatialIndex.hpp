@@ -0,0 +1,139 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file LandmarkSpatialIndex.hpp
+ * @brief Header file for the LandmarkSpatialIndex class.
+ */
+
+#ifndef INCLUDE_OKVIS_LANDMARKSPATIALINDEX_HPP_
+#define INCLUDE_OKVIS_LANDMARKSPATIALINDEX_HPP_
+
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <unordered_map>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Voxel hash over the Euclidean positions of the landmarks.
+ *
+ * Used to associate sonar returns with the visual landmarks around them. Box and radius queries only visit the
+ * voxels overlapping the query, so their cost does not depend on the number of landmarks. Landmarks at infinity
+ * (homogeneous coordinate close to zero) are not indexed.
+ */
+class LandmarkSpatialIndex {
+ public:
+  /// \brief Constructor.
+  /// \param[in] voxelSize Edge length of the voxels [m]. Best about twice the usual query half size.
+  explicit LandmarkSpatialIndex(double voxelSize = 0.2);
+
+  /// \brief Insert a landmark or move it to its new position.
+  /// \param[in] landmarkId ID of the landmark.
+  /// \param[in] landmark Homogeneous position of the landmark. Removes the landmark if it is at infinity.
+  void update(uint64_t landmarkId, const Eigen::Vector4d& landmark);
+
+  /// \brief Remove a landmark.
+  /// \param[in] landmarkId ID of the landmark.
+  /// \return True if the landmark was indexed.
+  bool remove(uint64_t landmarkId);
+
+  /// \brief Remove all landmarks.
+  void clear();
+
+  /// \brief Number of indexed landmarks.
+  size_t size() const { return locations_.size(); }
+
+  /**
+   * @brief Find the landmarks inside an axis aligned box, i.e. closer than halfSize to center in every coordinate.
+   * @param[in] center Center of the box.
+   * @param[in] halfSize Half edge length of the box.
+   * @param[out] points Euclidean positions of the landmarks found, appended.
+   * @param[out] landmarkIds IDs of the landmarks found, appended if not NULL.
+   * @return The number of landmarks found.
+   */
+  size_t queryBox(const Eigen::Vector3d& center,
+                  double halfSize,
+                  std::vector<Eigen::Vector3d>& points,  // NOLINT
+                  std::vector<uint64_t>* landmarkIds = NULL) const;
+
+  /**
+   * @brief Find the landmarks closer than radius to center.
+   * @param[in] center Center of the sphere.
+   * @param[in] radius Radius of the sphere.
+   * @param[out] points Euclidean positions of the landmarks found, appended.
+   * @param[out] landmarkIds IDs of the landmarks found, appended if not NULL.
+   * @return The number of landmarks found.
+   */
+  size_t queryRadius(const Eigen::Vector3d& center,
+                     double radius,
+                     std::vector<Eigen::Vector3d>& points,  // NOLINT
+                     std::vector<uint64_t>* landmarkIds = NULL) const;
+
+  /**
+   * @brief queryBox for several centers at once, e.g. for all the sonar returns of a frame.
+   * @param[in] centers Centers of the boxes.
+   * @param[in] halfSize Half edge length of the boxes.
+   * @param[out] points The landmarks found for every center. Resized to the number of centers, the inner vectors are
+   *                    cleared but keep their memory.
+   */
+  void queryBoxes(const std::vector<Eigen::Vector3d>& centers,
+                  double halfSize,
+                  std::vector<std::vector<Eigen::Vector3d>>& points) const;  // NOLINT
+
+ private:
+  /// \brief Where a landmark is indexed.
+  struct Location {
+    uint64_t voxel;         ///< Voxel key.
+    Eigen::Vector3d point;  ///< Euclidean position.
+  };
+
+  /// \brief Voxel coordinates packed into one key, 21 bits per axis.
+  uint64_t key(int64_t x, int64_t y, int64_t z) const;
+  /// \brief Voxel coordinate of a position along one axis, clamped to the 21 bit range.
+  int64_t voxelCoordinate(double position) const;
+  /// \brief Remove a landmark from the list of its voxel, and the voxel if it becomes empty.
+  void removeFromVoxel(uint64_t landmarkId, uint64_t voxel);
+
+  /// \brief Visit the landmarks of all voxels overlapping the box [min, max].
+  template <class Visitor>
+  void forEachInBox(const Eigen::Vector3d& min, const Eigen::Vector3d& max, Visitor visitor) const;
+
+  double voxelSize_;                                            ///< Edge length of the voxels.
+  std::unordered_map<uint64_t, std::vector<uint64_t>> voxels_;  ///< Landmark IDs by voxel key.
+  std::unordered_map<uint64_t, Location> locations_;            ///< Location by landmark ID.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_LANDMARKSPATIALINDEX_HPP_ */
@@ -0,0 +1,116 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file SolverSelector.hpp
+ * @brief Header file for the SolverSelector class.
+ */
+
+#ifndef INCLUDE_OKVIS_SOLVERSELECTOR_HPP_
+#define INCLUDE_OKVIS_SOLVERSELECTOR_HPP_
+
+#include <stdint.h>
+
+#include <okvis/assert_macros.hpp>
+#include <unordered_map>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Picks the fastest of several solver configurations for the current size of the optimisation window.
+ *
+ * The windows are classified by their number of frames and the octave of their number of landmarks. For each class,
+ * every candidate is tried a few times first, afterwards the one with the lowest mean time per iteration is used.
+ * The trials are repeated every now and then, as the structure of the problem changes along a trajectory.
+ */
+class SolverSelector {
+ public:
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+  /**
+   * @brief Constructor.
+   * @param[in] numCandidates Number of solver configurations to choose from.
+   * @param[in] numTrials Solves timed per candidate and window class before choosing.
+   * @param[in] reevaluationPeriod Repeat the trials of a window class after this many solves.
+   */
+  explicit SolverSelector(size_t numCandidates, size_t numTrials = 3, size_t reevaluationPeriod = 1000);
+
+  /// \brief Number of solver configurations to choose from.
+  size_t numCandidates() const { return numCandidates_; }
+
+  /**
+   * @brief The candidate to use for the next solve.
+   * @param[in] numFrames Number of frames in the window.
+   * @param[in] numLandmarks Number of landmarks in the window.
+   * @return Index of the candidate.
+   */
+  size_t select(size_t numFrames, size_t numLandmarks);
+
+  /**
+   * @brief Record the time a solve took.
+   * @param[in] numFrames Number of frames in the window.
+   * @param[in] numLandmarks Number of landmarks in the window.
+   * @param[in] candidate Index of the candidate used.
+   * @param[in] secondsPerIteration Solver time divided by the number of iterations. [s]
+   * @return True if this completed the trials of the window class, i.e. the choice is (re)made.
+   */
+  bool report(size_t numFrames, size_t numLandmarks, size_t candidate, double secondsPerIteration);
+
+  /**
+   * @brief Mean time per iteration of a candidate in the current trials of a window class.
+   * @return The mean time [s], or a negative value if the candidate was not timed yet.
+   */
+  double meanSecondsPerIteration(size_t numFrames, size_t numLandmarks, size_t candidate) const;
+
+ private:
+  /// \brief Timings of one window class.
+  struct WindowClass {
+    std::vector<size_t> numSamples;    ///< Solves timed per candidate.
+    std::vector<double> totalSeconds;  ///< Sum of the times per iteration per candidate.
+    size_t numSolves = 0;              ///< Solves since the last trials started.
+    size_t best = 0;                   ///< The fastest candidate, once all are timed.
+  };
+
+  /// \brief Key of the window class: the number of frames and the octave of the number of landmarks.
+  uint64_t key(size_t numFrames, size_t numLandmarks) const;
+  /// \brief Window class of a key, created if new.
+  WindowClass& windowClass(size_t numFrames, size_t numLandmarks);
+
+  size_t numCandidates_;                                     ///< Number of solver configurations.
+  size_t numTrials_;                                         ///< Solves timed per candidate before choosing.
+  size_t reevaluationPeriod_;                                ///< Solves until the trials are repeated.
+  std::unordered_map<uint64_t, WindowClass> windowClasses_;  ///< Timings by window class.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_SOLVERSELECTOR_HPP_ */
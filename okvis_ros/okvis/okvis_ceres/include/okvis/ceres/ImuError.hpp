@@ -41,6 +41,7 @@
 
 #include <mutex>
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/MeasurementBuffer.hpp>
 #include <okvis/Measurements.hpp>
 #include <okvis/Parameters.hpp>
 #include <okvis/Time.hpp>
@@ -128,6 +129,19 @@ class ImuError : public ::ceres::SizedCostFunction<15 /* number of residuals */,
                          covariance_t* covariance = 0,
                          jacobian_t* jacobian = 0);
 
+  /**
+   * @brief Propagates pose, speeds and biases with IMU measurements viewed in a measurement buffer.
+   * @remark Same as above, but avoids copying the measurements out of the buffer.
+   */
+  static int propagation(const okvis::ImuMeasurementSpan& imuMeasurements,
+                         const okvis::ImuParameters& imuParams,
+                         okvis::kinematics::Transformation& T_WS,  // NOLINT
+                         okvis::SpeedAndBias& speedAndBiases,      // NOLINT
+                         const okvis::Time& t_start,
+                         const okvis::Time& t_end,
+                         covariance_t* covariance = 0,
+                         jacobian_t* jacobian = 0);
+
   // Added by Sharmin to add scale
   static int propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
                          const okvis::ImuParameters& imuParams,
@@ -226,6 +240,17 @@ class ImuError : public ::ceres::SizedCostFunction<15 /* number of residuals */,
   virtual std::string typeInfo() const { return "ImuError"; }
 
  protected:
+  /// \brief Implementation of propagation() for any container of IMU measurements with random access iterators.
+  template <class IMU_MEASUREMENT_CONTAINER_T>
+  static int propagationImpl(const IMU_MEASUREMENT_CONTAINER_T& imuMeasurements,
+                             const okvis::ImuParameters& imuParams,
+                             okvis::kinematics::Transformation& T_WS,  // NOLINT
+                             okvis::SpeedAndBias& speedAndBiases,      // NOLINT
+                             const okvis::Time& t_start,
+                             const okvis::Time& t_end,
+                             covariance_t* covariance,
+                             jacobian_t* jacobian);
+
   // parameters
   okvis::ImuParameters imuParameters_;  ///< The IMU parameters.
 
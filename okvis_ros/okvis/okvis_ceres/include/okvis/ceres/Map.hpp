@@ -94,6 +94,14 @@ class Map {
   typedef std::vector<ResidualBlockSpec> ResidualBlockCollection;
   typedef std::vector<ParameterBlockSpec> ParameterBlockCollection;
 
+  /// @brief Scratch memory of getLandmarkLhs. Keep one per thread, the buffers only grow.
+  struct LhsScratch {
+    std::vector<double*> parameters;        ///< Parameter pointers of a residual block.
+    std::vector<double*> jacobians;         ///< Jacobian pointers, NULL for all but the landmark.
+    std::vector<double*> jacobiansMinimal;  ///< Minimal Jacobian pointers, NULL for all but the landmark.
+    std::vector<double> buffer;             ///< Residuals and Jacobians of residual blocks other than 2D.
+  };
+
   /// @brief The Parameterisation enum
   enum Parameterization {
     HomogeneousPoint,  ///< Use okvis::ceres::HomogeneousPointLocalParameterization.
@@ -131,6 +139,17 @@ class Map {
    */
   void getLhs(uint64_t parameterBlockId, Eigen::MatrixXd& H);  // NOLINT
 
+  /**
+   * @brief Obtain the Hessian block of a landmark (homogeneous point), as getLhs.
+   *        Only the Jacobians w.r.t. the landmark are evaluated, and nothing is allocated once the scratch buffers
+   *        are large enough. Can be called concurrently with different scratch memory, as long as the map is not
+   *        modified.
+   * @param[in] parameterBlockId Parameter block ID of the landmark.
+   * @param[out] H the output Hessian block.
+   * @param[in,out] scratch Scratch memory of the calling thread.
+   */
+  void getLandmarkLhs(uint64_t parameterBlockId, Eigen::Matrix3d& H, LhsScratch& scratch) const;  // NOLINT
+
   /// @name add/remove
   /// @{
 
@@ -40,12 +40,14 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <memory>
 #include <okvis/Estimator.hpp>
 #include <okvis/IdProvider.hpp>
 #include <okvis/MultiFrame.hpp>
+#include <okvis/ThreadPool.hpp>
 #include <okvis/assert_macros.hpp>
 #include <okvis/ceres/DepthError.hpp>                      // @Sharmin
 #include <okvis/ceres/HomogeneousPointError.hpp>           // @Sharmin
@@ -56,6 +58,8 @@
 #include <okvis/ceres/RelativePoseError.hpp>
 #include <okvis/ceres/SonarError.hpp>  // @Sharmin
 #include <okvis/ceres/SpeedAndBiasError.hpp>
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -68,7 +72,9 @@ Estimator::Estimator(std::shared_ptr<okvis::ceres::Map> mapPtr)
       referencePoseId_(0),
       cauchyLossFunctionPtr_(new ::ceres::CauchyLoss(1)),
       huberLossFunctionPtr_(new ::ceres::HuberLoss(1)),
-      marginalizationResidualId_(0) {}
+      marginalizationResidualId_(0),
+      solverCandidates_(1, std::make_pair(::ceres::SPARSE_SCHUR, ::ceres::SCHUR_JACOBI)),
+      trustRegionStrategy_(::ceres::DOGLEG) {}
 
 // The default constructor.
 Estimator::Estimator()
@@ -76,7 +82,9 @@ Estimator::Estimator()
       referencePoseId_(0),
       cauchyLossFunctionPtr_(new ::ceres::CauchyLoss(1)),
       huberLossFunctionPtr_(new ::ceres::HuberLoss(1)),
-      marginalizationResidualId_(0) {}
+      marginalizationResidualId_(0),
+      solverCandidates_(1, std::make_pair(::ceres::SPARSE_SCHUR, ::ceres::SCHUR_JACOBI)),
+      trustRegionStrategy_(::ceres::DOGLEG) {}
 
 Estimator::~Estimator() {}
 
@@ -299,22 +307,9 @@ bool Estimator::addStates(okvis::MultiFramePtr multiFrame,
     // std::cout << "T_WSo: " << T_WSo.r() << std::endl;
     // std::cout << "T_WSo_point: " << sonar_landmark << std::endl;
 
-    // may be the reverse searching is faster
-    for (PointMap::const_reverse_iterator rit = landmarksMap_.rbegin(); rit != landmarksMap_.rend(); ++rit) {
-      Eigen::Vector3d visual_landmark;
-      if (fabs(rit->second.point[3]) > 1.0e-8) {
-        visual_landmark = (rit->second.point / rit->second.point[3]).head<3>();
-        // LOG (INFO) << "Visual Landmark: " << visual_landmark;
-      }
-      // double distance_from_sonar = (sonar_landmark - visual_landmark).norm();  //Euclidean distance
-      if (fabs(sonar_landmark[0] - visual_landmark[0]) < 0.1 && fabs(sonar_landmark[1] - visual_landmark[1]) < 0.1 &&
-          fabs(sonar_landmark[2] - visual_landmark[2]) < 0.1) {
-        // TODO(sharmin) parameter!!
-        // searching around 10 cm of sonar landmark
-
-        landmarkSubset.push_back(visual_landmark);
-      }
-    }
+    // TODO(sharmin) parameter!!
+    // searching around 10 cm of sonar landmark
+    landmarkIndex_.queryBox(sonar_landmark, 0.1, landmarkSubset);
 
     // std::cout << "Size of visual patch: "<<landmarkSubset.size() << std::endl;
 
@@ -468,6 +463,7 @@ bool Estimator::addSonarLandmark(uint64_t landmarkId, const Eigen::Vector4d& lan
   }
   //  (sharmin) check landmarksMap
   landmarksMap_.insert(std::pair<uint64_t, MapPoint>(landmarkId, MapPoint(landmarkId, landmark, 0.0, dist)));
+  landmarkIndex_.update(landmarkId, landmark);
   OKVIS_ASSERT_TRUE_DBG(
       Exception, isLandmarkAdded(landmarkId), "bug adding sonar landmark: inconsistend landmarkdMap_ with mapPtr_.");
   return true;
@@ -495,6 +491,7 @@ bool Estimator::addLandmark(uint64_t landmarkId, const Eigen::Vector4d& landmark
     dist = (landmark / landmark[3]).head<3>().norm();  // euclidean distance
   }
   landmarksMap_.insert(std::pair<uint64_t, MapPoint>(landmarkId, MapPoint(landmarkId, landmark, 0.0, dist)));
+  landmarkIndex_.update(landmarkId, landmark);
   OKVIS_ASSERT_TRUE_DBG(Exception, isLandmarkAdded(landmarkId), "bug: inconsistend landmarkdMap_ with mapPtr_.");
   return true;
 }
@@ -777,6 +774,7 @@ bool Estimator::applyMarginalizationStrategy(size_t numKeyframes,
         if (residuals.size() == 0) {
           mapPtr_->removeParameterBlock(pit->first);
           removedLandmarks.push_back(pit->second);
+          landmarkIndex_.remove(pit->first);
           pit = landmarksMap_.erase(pit);
           continue;
         }
@@ -821,6 +819,7 @@ bool Estimator::applyMarginalizationStrategy(size_t numKeyframes,
         if (justDelete) {
           mapPtr_->removeParameterBlock(pit->first);
           removedLandmarks.push_back(pit->second);
+          landmarkIndex_.remove(pit->first);
           pit = landmarksMap_.erase(pit);
           continue;
         }
@@ -828,6 +827,7 @@ bool Estimator::applyMarginalizationStrategy(size_t numKeyframes,
           paremeterBlocksToBeMarginalized.push_back(pit->first);
           keepParameterBlocks.push_back(false);
           removedLandmarks.push_back(pit->second);
+          landmarkIndex_.remove(pit->first);
           pit = landmarksMap_.erase(pit);
           continue;
         }
@@ -915,9 +915,12 @@ void Estimator::printStates(uint64_t poseId, std::ostream& buffer) const {
   buffer << std::endl;
 }
 
-// Initialise pose from IMU measurements. For convenience as static.
-bool Estimator::initPoseFromImu(const okvis::ImuMeasurementDeque& imuMeasurements,
-                                okvis::kinematics::Transformation& T_WS) {
+namespace {
+
+// Initialise pose from the mean accelerometer reading of any IMU measurement container.
+template <class IMU_MEASUREMENT_CONTAINER_T>
+bool initPoseFromImuMeasurements(const IMU_MEASUREMENT_CONTAINER_T& imuMeasurements,
+                                 okvis::kinematics::Transformation& T_WS) {  // NOLINT
   // set translation to zero, unit rotation
   T_WS.setIdentity();
 
@@ -925,7 +928,8 @@ bool Estimator::initPoseFromImu(const okvis::ImuMeasurementDeque& imuMeasurement
 
   // acceleration vector
   Eigen::Vector3d acc_B = Eigen::Vector3d::Zero();
-  for (okvis::ImuMeasurementDeque::const_iterator it = imuMeasurements.begin(); it < imuMeasurements.end(); ++it) {
+  for (typename IMU_MEASUREMENT_CONTAINER_T::const_iterator it = imuMeasurements.begin(); it < imuMeasurements.end();
+       ++it) {
     acc_B += it->measurement.accelerometers;
   }
   acc_B /= static_cast<double>(imuMeasurements.size());
@@ -943,14 +947,31 @@ bool Estimator::initPoseFromImu(const okvis::ImuMeasurementDeque& imuMeasurement
   return true;
 }
 
+}  // namespace
+
+// Initialise pose from IMU measurements. For convenience as static.
+bool Estimator::initPoseFromImu(const okvis::ImuMeasurementDeque& imuMeasurements,
+                                okvis::kinematics::Transformation& T_WS) {
+  return initPoseFromImuMeasurements(imuMeasurements, T_WS);
+}
+
+// Initialise pose from IMU measurements viewed in a measurement buffer.
+bool Estimator::initPoseFromImu(const okvis::ImuMeasurementSpan& imuMeasurements,
+                                okvis::kinematics::Transformation& T_WS) {
+  return initPoseFromImuMeasurements(imuMeasurements, T_WS);
+}
+
 // Start ceres optimization.
 void Estimator::optimize(size_t numIter, size_t numThreads, bool verbose) {
   // assemble options
-  mapPtr_->options.linear_solver_type = ::ceres::SPARSE_SCHUR;
+  const size_t numFrames = statesMap_.size();
+  const size_t numLandmarks = landmarksMap_.size();
+  const size_t candidate = solverSelector_ ? solverSelector_->select(numFrames, numLandmarks) : 0;
+  mapPtr_->options.linear_solver_type = solverCandidates_[candidate].first;
   // mapPtr_->options.initial_trust_region_radius = 1.0e4;
   // mapPtr_->options.initial_trust_region_radius = 2.0e6;
-  // mapPtr_->options.preconditioner_type = ::ceres::IDENTITY;
-  mapPtr_->options.trust_region_strategy_type = ::ceres::DOGLEG;
+  mapPtr_->options.preconditioner_type = solverCandidates_[candidate].second;
+  mapPtr_->options.trust_region_strategy_type = trustRegionStrategy_;
   // mapPtr_->options.trust_region_strategy_type = ::ceres::LEVENBERG_MARQUARDT;
   // mapPtr_->options.use_nonmonotonic_steps = true;
   // mapPtr_->options.max_consecutive_nonmonotonic_steps = 10;
@@ -969,27 +990,18 @@ void Estimator::optimize(size_t numIter, size_t numThreads, bool verbose) {
   // call solver
   mapPtr_->solve();
 
-  // update landmarks
-  {
-    for (auto it = landmarksMap_.begin(); it != landmarksMap_.end(); ++it) {
-      Eigen::MatrixXd H(3, 3);
-      mapPtr_->getLhs(it->first, H);
-      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(H);
-      Eigen::Vector3d eigenvalues = saes.eigenvalues();
-      const double smallest = (eigenvalues[0]);
-      const double largest = (eigenvalues[2]);
-      if (smallest < 1.0e-12) {
-        // this means, it has a non-observable depth
-        it->second.quality = 0.0;
-      } else {
-        // OK, well constrained
-        it->second.quality = sqrt(smallest) / sqrt(largest);
+  // time per iteration, including the setup of the linear solver
+  const ::ceres::Solver::Summary& summary = mapPtr_->summary;
+  if (solverSelector_ && summary.iterations.size() > 1) {
+    const double secondsPerIteration = summary.total_time_in_seconds / (summary.iterations.size() - 1);
+    if (solverSelector_->report(numFrames, numLandmarks, candidate, secondsPerIteration)) {
+      std::stringstream timings;
+      for (size_t i = 0; i < solverCandidates_.size(); ++i) {
+        timings << " " << ::ceres::LinearSolverTypeToString(solverCandidates_[i].first) << " "
+                << 1.0e3 * solverSelector_->meanSecondsPerIteration(numFrames, numLandmarks, i) << " ms";
       }
-
-      // update coordinates
-      it->second.point =
-          std::static_pointer_cast<okvis::ceres::HomogeneousPointParameterBlock>(mapPtr_->parameterBlockPtr(it->first))
-              ->estimate();
+      LOG(INFO) << "Solver time per iteration with " << numFrames << " frames and " << numLandmarks
+                << " landmarks:" << timings.str();
     }
   }
 
@@ -1020,6 +1032,105 @@ void Estimator::optimize(size_t numIter, size_t numThreads, bool verbose) {
   }
 }
 
+// Configure the solver used by optimize().
+bool Estimator::setSolverOptions(const okvis::Optimization& optimization) {
+  ::ceres::PreconditionerType preconditioner;
+  if (!::ceres::StringToPreconditionerType(optimization.preconditioner, &preconditioner)) {
+    LOG(ERROR) << "Unknown preconditioner " << optimization.preconditioner;
+    return false;
+  }
+  ::ceres::TrustRegionStrategyType trustRegionStrategy;
+  if (!::ceres::StringToTrustRegionStrategyType(optimization.trustRegionStrategy, &trustRegionStrategy)) {
+    LOG(ERROR) << "Unknown trust region strategy " << optimization.trustRegionStrategy;
+    return false;
+  }
+  std::vector<std::pair<::ceres::LinearSolverType, ::ceres::PreconditionerType>> candidates;
+  const bool automatic = optimization.linearSolver == "AUTO" || optimization.linearSolver == "auto";
+  if (automatic) {
+    candidates.push_back(std::make_pair(::ceres::SPARSE_SCHUR, preconditioner));
+    candidates.push_back(std::make_pair(::ceres::DENSE_SCHUR, preconditioner));
+    candidates.push_back(std::make_pair(::ceres::ITERATIVE_SCHUR, preconditioner));
+  } else {
+    ::ceres::LinearSolverType linearSolver;
+    if (!::ceres::StringToLinearSolverType(optimization.linearSolver, &linearSolver)) {
+      LOG(ERROR) << "Unknown linear solver " << optimization.linearSolver;
+      return false;
+    }
+    candidates.push_back(std::make_pair(linearSolver, preconditioner));
+  }
+
+  // drop what this build of Ceres cannot do, e.g. SPARSE_SCHUR without a sparse linear algebra library
+  ::ceres::Solver::Options options = mapPtr_->options;
+  options.trust_region_strategy_type = trustRegionStrategy;
+  for (auto it = candidates.begin(); it != candidates.end();) {
+    options.linear_solver_type = it->first;
+    options.preconditioner_type = it->second;
+    std::string error;
+    if (options.IsValid(&error)) {
+      ++it;
+    } else {
+      LOG(WARNING) << "Solver " << ::ceres::LinearSolverTypeToString(it->first) << " not available: " << error;
+      it = candidates.erase(it);
+    }
+  }
+  if (candidates.empty()) return false;
+
+  solverCandidates_ = candidates;
+  trustRegionStrategy_ = trustRegionStrategy;
+  solverSelector_.reset(candidates.size() > 1 ? new okvis::SolverSelector(candidates.size()) : nullptr);
+  return true;
+}
+
+// Synchronise the landmarks with the optimised map.
+void Estimator::updateLandmarks(size_t numThreads) {
+  landmarksToUpdate_.clear();
+  for (auto it = landmarksMap_.begin(); it != landmarksMap_.end(); ++it) {
+    landmarksToUpdate_.push_back(it);
+  }
+  numThreads = std::max<size_t>(numThreads, 1);
+  if (lhsScratch_.size() != numThreads) {
+    lhsScratch_.resize(numThreads);
+    landmarkThreadPool_.reset(numThreads > 1 ? new okvis::ThreadPool(numThreads - 1) : nullptr);
+  }
+
+  // every worker takes a contiguous slice, the last one is done by the calling thread
+  auto updateSlice = [this, numThreads](size_t slice) {
+    okvis::ceres::Map::LhsScratch& scratch = lhsScratch_[slice];
+    const size_t begin = landmarksToUpdate_.size() * slice / numThreads;
+    const size_t end = landmarksToUpdate_.size() * (slice + 1) / numThreads;
+    Eigen::Matrix3d H;
+    for (size_t i = begin; i < end; ++i) {
+      okvis::MapPoint& landmark = landmarksToUpdate_[i]->second;
+      mapPtr_->getLandmarkLhs(landmarksToUpdate_[i]->first, H, scratch);
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(H, Eigen::EigenvaluesOnly);
+      Eigen::Vector3d eigenvalues = saes.eigenvalues();
+      const double smallest = (eigenvalues[0]);
+      const double largest = (eigenvalues[2]);
+      if (smallest < 1.0e-12) {
+        // this means, it has a non-observable depth
+        landmark.quality = 0.0;
+      } else {
+        // OK, well constrained
+        landmark.quality = sqrt(smallest) / sqrt(largest);
+      }
+
+      // update coordinates
+      landmark.point = std::static_pointer_cast<const okvis::ceres::HomogeneousPointParameterBlock>(
+                           mapPtr_->parameterBlockPtr(landmarksToUpdate_[i]->first))
+                           ->estimate();
+    }
+  };
+  landmarkUpdates_.clear();
+  for (size_t slice = 0; slice + 1 < numThreads; ++slice) {
+    landmarkUpdates_.push_back(landmarkThreadPool_->enqueue(updateSlice, slice));
+  }
+  updateSlice(numThreads - 1);
+  for (std::future<void>& update : landmarkUpdates_) update.wait();
+
+  // the spatial index is not thread safe
+  for (const auto& landmark : landmarksMap_) landmarkIndex_.update(landmark.first, landmark.second.point);
+}
+
 // Set a time limit for the optimization process.
 bool Estimator::setOptimizationTimeLimit(double timeLimit, int minIterations) {
   if (ceresCallback_ != nullptr) {
@@ -1211,6 +1322,7 @@ bool Estimator::setLandmark(uint64_t landmarkId, const Eigen::Vector4d& landmark
 
   // also update in map
   landmarksMap_.at(landmarkId).point = landmark;
+  landmarkIndex_.update(landmarkId, landmark);
   return true;
 }
 
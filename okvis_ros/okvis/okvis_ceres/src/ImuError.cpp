@@ -262,15 +262,16 @@ int ImuError::redoPreintegration(const okvis::kinematics::Transformation& /*T_WS
   return i;
 }
 
-// Propagates pose, speeds and biases with given IMU measurements.
-int ImuError::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
-                          const okvis::ImuParameters& imuParams,
-                          okvis::kinematics::Transformation& T_WS,
-                          okvis::SpeedAndBias& speedAndBiases,
-                          const okvis::Time& t_start,
-                          const okvis::Time& t_end,
-                          covariance_t* covariance,
-                          jacobian_t* jacobian) {
+// Actual propagation, shared by all IMU measurement containers.
+template <class IMU_MEASUREMENT_CONTAINER_T>
+int ImuError::propagationImpl(const IMU_MEASUREMENT_CONTAINER_T& imuMeasurements,
+                              const okvis::ImuParameters& imuParams,
+                              okvis::kinematics::Transformation& T_WS,
+                              okvis::SpeedAndBias& speedAndBiases,
+                              const okvis::Time& t_start,
+                              const okvis::Time& t_end,
+                              covariance_t* covariance,
+                              jacobian_t* jacobian) {
   // now the propagation
   okvis::Time time = t_start;
   okvis::Time end = t_end;
@@ -306,7 +307,8 @@ int ImuError::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
   bool hasStarted = false;
   int i = 0;
 
-  for (okvis::ImuMeasurementDeque::const_iterator it = imuMeasurements.begin(); it != imuMeasurements.end(); ++it) {
+  for (typename IMU_MEASUREMENT_CONTAINER_T::const_iterator it = imuMeasurements.begin(); it != imuMeasurements.end();
+       ++it) {
     Eigen::Vector3d omega_S_0 = it->measurement.gyroscopes;
     Eigen::Vector3d acc_S_0 = it->measurement.accelerometers;
     Eigen::Vector3d omega_S_1 = (it + 1)->measurement.gyroscopes;
@@ -475,6 +477,30 @@ int ImuError::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
   return i;
 }
 
+// Propagates pose, speeds and biases with given IMU measurements.
+int ImuError::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
+                          const okvis::ImuParameters& imuParams,
+                          okvis::kinematics::Transformation& T_WS,
+                          okvis::SpeedAndBias& speedAndBiases,
+                          const okvis::Time& t_start,
+                          const okvis::Time& t_end,
+                          covariance_t* covariance,
+                          jacobian_t* jacobian) {
+  return propagationImpl(imuMeasurements, imuParams, T_WS, speedAndBiases, t_start, t_end, covariance, jacobian);
+}
+
+// Propagates pose, speeds and biases with IMU measurements viewed in a measurement buffer.
+int ImuError::propagation(const okvis::ImuMeasurementSpan& imuMeasurements,
+                          const okvis::ImuParameters& imuParams,
+                          okvis::kinematics::Transformation& T_WS,
+                          okvis::SpeedAndBias& speedAndBiases,
+                          const okvis::Time& t_start,
+                          const okvis::Time& t_end,
+                          covariance_t* covariance,
+                          jacobian_t* jacobian) {
+  return propagationImpl(imuMeasurements, imuParams, T_WS, speedAndBiases, t_start, t_end, covariance, jacobian);
+}
+
 // Added by Sharmin
 int ImuError::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
                           const okvis::ImuParameters& imuParams,
@@ -0,0 +1,184 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file LandmarkSpatialIndex.cpp
+ * @brief Source file for the LandmarkSpatialIndex class.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <okvis/LandmarkSpatialIndex.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+namespace {
+const int kBitsPerAxis = 21;
+const int64_t kMaxVoxelCoordinate = (int64_t(1) << (kBitsPerAxis - 1)) - 1;
+const uint64_t kAxisMask = (uint64_t(1) << kBitsPerAxis) - 1;
+}  // namespace
+
+// Constructor.
+LandmarkSpatialIndex::LandmarkSpatialIndex(double voxelSize) : voxelSize_(voxelSize) {}
+
+// Voxel coordinates packed into one key.
+uint64_t LandmarkSpatialIndex::key(int64_t x, int64_t y, int64_t z) const {
+  return (uint64_t(x) & kAxisMask) | ((uint64_t(y) & kAxisMask) << kBitsPerAxis) |
+         ((uint64_t(z) & kAxisMask) << (2 * kBitsPerAxis));
+}
+
+// Voxel coordinate of a position along one axis. Landmarks far away share the outermost voxels, the queries test the
+// exact positions anyway.
+int64_t LandmarkSpatialIndex::voxelCoordinate(double position) const {
+  const double coordinate = std::floor(position / voxelSize_);
+  return static_cast<int64_t>(
+      std::max(std::min(coordinate, double(kMaxVoxelCoordinate)), double(-kMaxVoxelCoordinate - 1)));
+}
+
+// Insert a landmark or move it to its new position.
+void LandmarkSpatialIndex::update(uint64_t landmarkId, const Eigen::Vector4d& landmark) {
+  if (std::fabs(landmark[3]) <= 1.0e-8) {
+    remove(landmarkId);
+    return;
+  }
+  const Eigen::Vector3d point = landmark.head<3>() / landmark[3];
+  const uint64_t voxel = key(voxelCoordinate(point[0]), voxelCoordinate(point[1]), voxelCoordinate(point[2]));
+
+  // after an optimisation most landmarks stay in their voxel: one lookup only
+  auto inserted = locations_.emplace(landmarkId, Location{voxel, point});
+  Location& location = inserted.first->second;
+  if (!inserted.second) {
+    location.point = point;
+    if (location.voxel == voxel) return;
+    removeFromVoxel(landmarkId, location.voxel);
+    location.voxel = voxel;
+  }
+  voxels_[voxel].push_back(landmarkId);
+}
+
+// Remove a landmark.
+bool LandmarkSpatialIndex::remove(uint64_t landmarkId) {
+  auto it = locations_.find(landmarkId);
+  if (it == locations_.end()) return false;
+  removeFromVoxel(landmarkId, it->second.voxel);
+  locations_.erase(it);
+  return true;
+}
+
+// Remove all landmarks.
+void LandmarkSpatialIndex::clear() {
+  voxels_.clear();
+  locations_.clear();
+}
+
+// Remove a landmark from the list of its voxel.
+void LandmarkSpatialIndex::removeFromVoxel(uint64_t landmarkId, uint64_t voxel) {
+  auto it = voxels_.find(voxel);
+  std::vector<uint64_t>& landmarkIds = it->second;
+  for (size_t i = 0; i < landmarkIds.size(); ++i) {
+    if (landmarkIds[i] == landmarkId) {
+      landmarkIds[i] = landmarkIds.back();
+      landmarkIds.pop_back();
+      break;
+    }
+  }
+  if (landmarkIds.empty()) voxels_.erase(it);
+}
+
+// Visit the landmarks of all voxels overlapping the box [min, max].
+template <class Visitor>
+void LandmarkSpatialIndex::forEachInBox(const Eigen::Vector3d& min, const Eigen::Vector3d& max, Visitor visitor) const {
+  const int64_t x0 = voxelCoordinate(min[0]), x1 = voxelCoordinate(max[0]);
+  const int64_t y0 = voxelCoordinate(min[1]), y1 = voxelCoordinate(max[1]);
+  const int64_t z0 = voxelCoordinate(min[2]), z1 = voxelCoordinate(max[2]);
+  if (double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1) > double(voxels_.size())) {
+    // huge box, cheaper to go through all landmarks
+    for (const auto& location : locations_) visitor(location.first, location.second.point);
+    return;
+  }
+  for (int64_t x = x0; x <= x1; ++x) {
+    for (int64_t y = y0; y <= y1; ++y) {
+      for (int64_t z = z0; z <= z1; ++z) {
+        auto voxel = voxels_.find(key(x, y, z));
+        if (voxel == voxels_.end()) continue;
+        for (uint64_t landmarkId : voxel->second) visitor(landmarkId, locations_.find(landmarkId)->second.point);
+      }
+    }
+  }
+}
+
+// Find the landmarks inside an axis aligned box.
+size_t LandmarkSpatialIndex::queryBox(const Eigen::Vector3d& center,
+                                      double halfSize,
+                                      std::vector<Eigen::Vector3d>& points,
+                                      std::vector<uint64_t>* landmarkIds) const {
+  const Eigen::Vector3d half = Eigen::Vector3d::Constant(halfSize);
+  size_t found = 0;
+  forEachInBox(center - half, center + half, [&](uint64_t landmarkId, const Eigen::Vector3d& point) {
+    if (((point - center).array().abs() < halfSize).all()) {
+      points.push_back(point);
+      if (landmarkIds) landmarkIds->push_back(landmarkId);
+      ++found;
+    }
+  });
+  return found;
+}
+
+// Find the landmarks closer than radius to center.
+size_t LandmarkSpatialIndex::queryRadius(const Eigen::Vector3d& center,
+                                         double radius,
+                                         std::vector<Eigen::Vector3d>& points,
+                                         std::vector<uint64_t>* landmarkIds) const {
+  const Eigen::Vector3d half = Eigen::Vector3d::Constant(radius);
+  const double radiusSquared = radius * radius;
+  size_t found = 0;
+  forEachInBox(center - half, center + half, [&](uint64_t landmarkId, const Eigen::Vector3d& point) {
+    if ((point - center).squaredNorm() < radiusSquared) {
+      points.push_back(point);
+      if (landmarkIds) landmarkIds->push_back(landmarkId);
+      ++found;
+    }
+  });
+  return found;
+}
+
+// queryBox for several centers at once.
+void LandmarkSpatialIndex::queryBoxes(const std::vector<Eigen::Vector3d>& centers,
+                                      double halfSize,
+                                      std::vector<std::vector<Eigen::Vector3d>>& points) const {
+  points.resize(centers.size());
+  for (size_t i = 0; i < centers.size(); ++i) {
+    points[i].clear();
+    queryBox(centers[i], halfSize, points[i]);
+  }
+}
+
+}  // namespace okvis
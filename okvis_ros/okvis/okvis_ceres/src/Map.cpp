@@ -149,6 +149,52 @@ void Map::getLhs(uint64_t parameterBlockId, Eigen::MatrixXd& H) {
   }
 }
 
+// Obtain the Hessian block of a landmark.
+void Map::getLandmarkLhs(uint64_t parameterBlockId, Eigen::Matrix3d& H, LhsScratch& scratch) const {
+  OKVIS_ASSERT_TRUE_DBG(Exception, parameterBlockExists(parameterBlockId), "parameter block not in map.");
+  H.setZero();
+  auto range = id2ResidualBlock_Multimap_.equal_range(parameterBlockId);
+  for (auto it = range.first; it != range.second; ++it) {
+    const ErrorInterface& error = *it->second.errorInterfacePtr;
+    const ParameterBlockCollection& pars =
+        residualBlockId2ParameterBlockCollection_Map_.find(it->second.residualBlockId)->second;
+
+    scratch.parameters.resize(pars.size());
+    scratch.jacobians.assign(pars.size(), NULL);
+    scratch.jacobiansMinimal.assign(pars.size(), NULL);
+    size_t J = 0;
+    for (size_t j = 0; j < pars.size(); ++j) {
+      if (pars[j].first == parameterBlockId) J = j;
+      scratch.parameters[j] = pars[j].second->parameters();
+    }
+    OKVIS_ASSERT_TRUE_DBG(Exception,
+                          pars[J].second->dimension() == 4 && pars[J].second->minimalDimension() == 3,
+                          "parameter block is no homogeneous point.");
+
+    if (error.residualDim() == 2) {
+      // reprojection error, by far the most frequent
+      Eigen::Vector2d residuals;
+      Eigen::Matrix<double, 2, 4, Eigen::RowMajor> jacobian;
+      Eigen::Matrix<double, 2, 3, Eigen::RowMajor> jacobianMinimal;
+      scratch.jacobians[J] = jacobian.data();
+      scratch.jacobiansMinimal[J] = jacobianMinimal.data();
+      error.EvaluateWithMinimalJacobians(
+          scratch.parameters.data(), residuals.data(), scratch.jacobians.data(), scratch.jacobiansMinimal.data());
+      H += jacobianMinimal.transpose() * jacobianMinimal;
+    } else {
+      const size_t residualDim = error.residualDim();
+      scratch.buffer.resize(residualDim * 8);
+      scratch.jacobians[J] = scratch.buffer.data() + residualDim;
+      scratch.jacobiansMinimal[J] = scratch.buffer.data() + residualDim * 5;
+      error.EvaluateWithMinimalJacobians(
+          scratch.parameters.data(), scratch.buffer.data(), scratch.jacobians.data(), scratch.jacobiansMinimal.data());
+      Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> > jacobianMinimal(
+          scratch.jacobiansMinimal[J], residualDim, 3);
+      H += jacobianMinimal.transpose() * jacobianMinimal;
+    }
+  }
+}
+
 // Check a Jacobian with numeric differences.
 bool Map::isJacobianCorrect(::ceres::ResidualBlockId residualBlockId, double relTol) const {
   std::shared_ptr<const okvis::ceres::ErrorInterface> errorInterface_ptr = errorInterfacePtr(residualBlockId);
@@ -0,0 +1,110 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file SolverSelector.cpp
+ * @brief Source file for the SolverSelector class.
+ */
+
+#include <okvis/SolverSelector.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Constructor.
+SolverSelector::SolverSelector(size_t numCandidates, size_t numTrials, size_t reevaluationPeriod)
+    : numCandidates_(numCandidates), numTrials_(numTrials), reevaluationPeriod_(reevaluationPeriod) {
+  OKVIS_ASSERT_TRUE(Exception, numCandidates_ > 0 && numTrials_ > 0, "nothing to select from");
+}
+
+// Key of the window class.
+uint64_t SolverSelector::key(size_t numFrames, size_t numLandmarks) const {
+  uint64_t octave = 0;
+  while (numLandmarks > 1) {
+    numLandmarks >>= 1;
+    ++octave;
+  }
+  return (uint64_t(numFrames) << 8) | octave;
+}
+
+// Window class of a key, created if new.
+SolverSelector::WindowClass& SolverSelector::windowClass(size_t numFrames, size_t numLandmarks) {
+  WindowClass& windowClass = windowClasses_[key(numFrames, numLandmarks)];
+  if (windowClass.numSamples.empty()) {
+    windowClass.numSamples.assign(numCandidates_, 0);
+    windowClass.totalSeconds.assign(numCandidates_, 0.0);
+  }
+  return windowClass;
+}
+
+// The candidate to use for the next solve.
+size_t SolverSelector::select(size_t numFrames, size_t numLandmarks) {
+  WindowClass& windowClass = this->windowClass(numFrames, numLandmarks);
+  if (++windowClass.numSolves > reevaluationPeriod_) {
+    windowClass.numSamples.assign(numCandidates_, 0);
+    windowClass.totalSeconds.assign(numCandidates_, 0.0);
+    windowClass.numSolves = 1;
+  }
+  // time the candidates in turns, so they all see similar windows
+  size_t leastTimed = 0;
+  for (size_t candidate = 1; candidate < numCandidates_; ++candidate) {
+    if (windowClass.numSamples[candidate] < windowClass.numSamples[leastTimed]) leastTimed = candidate;
+  }
+  return windowClass.numSamples[leastTimed] < numTrials_ ? leastTimed : windowClass.best;
+}
+
+// Record the time a solve took.
+bool SolverSelector::report(size_t numFrames, size_t numLandmarks, size_t candidate, double secondsPerIteration) {
+  OKVIS_ASSERT_TRUE(Exception, candidate < numCandidates_, "candidate " << candidate << " does not exist");
+  WindowClass& windowClass = this->windowClass(numFrames, numLandmarks);
+  if (windowClass.numSamples[candidate] >= numTrials_) return false;
+  ++windowClass.numSamples[candidate];
+  windowClass.totalSeconds[candidate] += secondsPerIteration;
+
+  for (size_t i = 0; i < numCandidates_; ++i) {
+    if (windowClass.numSamples[i] < numTrials_) return false;
+  }
+  windowClass.best = 0;
+  for (size_t i = 1; i < numCandidates_; ++i) {
+    if (windowClass.totalSeconds[i] < windowClass.totalSeconds[windowClass.best]) windowClass.best = i;
+  }
+  return true;
+}
+
+// Mean time per iteration of a candidate in the current trials of a window class.
+double SolverSelector::meanSecondsPerIteration(size_t numFrames, size_t numLandmarks, size_t candidate) const {
+  auto it = windowClasses_.find(key(numFrames, numLandmarks));
+  if (it == windowClasses_.end() || candidate >= numCandidates_ || it->second.numSamples[candidate] == 0) {
+    return -1.0;
+  }
+  return it->second.totalSeconds[candidate] / it->second.numSamples[candidate];
+}
+
+}  // namespace okvis
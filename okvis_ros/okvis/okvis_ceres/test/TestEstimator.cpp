@@ -183,6 +183,7 @@ TEST(okvisTestSuite, Estimator) {
       }
       // run the optimization
       estimator.optimize(10, 4, false);
+      estimator.updateLandmarks(4);
     }
     std::cout << "== TRY MARGINALIZATION ==" << std::endl;
     // try out the marginalization strategy
@@ -191,6 +192,7 @@ TEST(okvisTestSuite, Estimator) {
     // run the optimization
     std::cout << "== LAST OPTIMIZATION ==" << std::endl;
     estimator.optimize(10, 4, false);
+    estimator.updateLandmarks(4);
 
     // get the estimates
     estimator.get_T_WS(id, T_WS_est);
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <okvis/LandmarkSpatialIndex.hpp>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef std::map<uint64_t, Eigen::Vector4d, std::less<uint64_t>,
+                 Eigen::aligned_allocator<std::pair<const uint64_t, Eigen::Vector4d>>>
+    LandmarkMap;
+
+// the sonar association Estimator::addStates used to do, as reference
+std::vector<uint64_t> boxScan(const LandmarkMap& landmarks, const Eigen::Vector3d& center, double halfSize) {
+  std::vector<uint64_t> ids;
+  for (auto rit = landmarks.rbegin(); rit != landmarks.rend(); ++rit) {
+    if (std::fabs(rit->second[3]) <= 1.0e-8) continue;
+    const Eigen::Vector3d point = rit->second.head<3>() / rit->second[3];
+    if (((point - center).array().abs() < halfSize).all()) ids.push_back(rit->first);
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// landmarks scattered around a trajectory, as seen by a downward looking stereo rig
+Eigen::Vector4d randomLandmark(std::mt19937& rng, double extent) {
+  std::uniform_real_distribution<double> horizontal(-extent, extent);
+  std::uniform_real_distribution<double> depth(-2.0, 0.0);
+  std::uniform_real_distribution<double> scale(0.5, 2.0);
+  const double w = scale(rng);
+  return Eigen::Vector4d(horizontal(rng) * w, horizontal(rng) * w, depth(rng) * w, w);
+}
+
+}  // namespace
+
+TEST(LandmarkSpatialIndex, queriesMatchScan) {
+  std::mt19937 rng(42);
+  okvis::LandmarkSpatialIndex index;
+  LandmarkMap landmarks;
+  const double extent = 2.0;
+  for (uint64_t id = 1; id <= 3000; ++id) {
+    landmarks[id] = randomLandmark(rng, extent);
+    index.update(id, landmarks[id]);
+  }
+  // a landmark at infinity is never associated
+  landmarks[5000] = Eigen::Vector4d(1.0, 0.0, 0.0, 0.0);
+  index.update(5000, landmarks[5000]);
+
+  // move some, as the optimisation does, and marginalise some
+  std::uniform_int_distribution<uint64_t> anyId(1, 3000);
+  for (int i = 0; i < 500; ++i) {
+    const uint64_t id = anyId(rng);
+    landmarks[id] += Eigen::Vector4d::Random() * 0.05;
+    index.update(id, landmarks[id]);
+  }
+  for (int i = 0; i < 500; ++i) {
+    const uint64_t id = anyId(rng);
+    EXPECT_EQ(index.remove(id), landmarks.erase(id) == 1);
+  }
+  EXPECT_EQ(index.size(), landmarks.size() - 1);
+
+  std::uniform_real_distribution<double> coordinate(-extent, extent);
+  std::vector<Eigen::Vector3d> centers;
+  for (int i = 0; i < 200; ++i) centers.push_back(Eigen::Vector3d(coordinate(rng), coordinate(rng), -1.0));
+  for (double halfSize : {0.1, 0.35}) {
+    std::vector<std::vector<Eigen::Vector3d>> batch;
+    index.queryBoxes(centers, halfSize, batch);
+    for (size_t i = 0; i < centers.size(); ++i) {
+      std::vector<Eigen::Vector3d> points;
+      std::vector<uint64_t> ids;
+      const size_t found = index.queryBox(centers[i], halfSize, points, &ids);
+      EXPECT_EQ(found, ids.size());
+      std::sort(ids.begin(), ids.end());
+      EXPECT_EQ(ids, boxScan(landmarks, centers[i], halfSize));
+      EXPECT_EQ(batch[i].size(), ids.size());
+
+      points.clear();
+      ids.clear();
+      index.queryRadius(centers[i], halfSize, points, &ids);
+      for (size_t j = 0; j < ids.size(); ++j) {
+        EXPECT_LT((points[j] - centers[i]).norm(), halfSize);
+        EXPECT_TRUE(((landmarks[ids[j]].head<3>() / landmarks[ids[j]][3]) - points[j]).norm() < 1e-12);
+      }
+      size_t inside = 0;
+      for (const auto& landmark : landmarks) {
+        if (std::fabs(landmark.second[3]) > 1.0e-8 &&
+            (landmark.second.head<3>() / landmark.second[3] - centers[i]).norm() < halfSize)
+          ++inside;
+      }
+      EXPECT_EQ(ids.size(), inside);
+    }
+  }
+
+  // a box larger than the whole map
+  std::vector<Eigen::Vector3d> points;
+  EXPECT_EQ(index.queryBox(Eigen::Vector3d::Zero(), 1.0e6, points), index.size());
+}
+
+// Cost of associating the sonar returns of one frame with the landmarks, for a growing map.
+TEST(LandmarkSpatialIndex, benchmarkAssociation) {
+  const int returnsPerFrame = 10;
+  std::cout << "Sonar association per frame (" << returnsPerFrame << " returns, 10 cm box):" << std::endl;
+  for (size_t numLandmarks : {100, 1000, 10000, 100000}) {
+    std::mt19937 rng(1);
+    const double extent = 0.5 * std::sqrt(static_cast<double>(numLandmarks));  // constant density
+    okvis::LandmarkSpatialIndex index;
+    LandmarkMap landmarks;
+    for (uint64_t id = 1; id <= numLandmarks; ++id) {
+      landmarks[id] = randomLandmark(rng, extent);
+      index.update(id, landmarks[id]);
+    }
+    std::uniform_real_distribution<double> coordinate(-extent, extent);
+    std::vector<Eigen::Vector3d> centers;
+    for (int i = 0; i < returnsPerFrame; ++i) centers.push_back(Eigen::Vector3d(coordinate(rng), coordinate(rng), -1));
+
+    typedef std::chrono::steady_clock clock;
+    const int repetitions = numLandmarks > 10000 ? 5 : 50;
+    size_t scanFound = 0, indexFound = 0;
+    clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+      for (const Eigen::Vector3d& center : centers) scanFound += boxScan(landmarks, center, 0.1).size();
+    }
+    const double scanUs = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+
+    std::vector<std::vector<Eigen::Vector3d>> subsets;
+    start = clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+      index.queryBoxes(centers, 0.1, subsets);
+      for (const auto& subset : subsets) indexFound += subset.size();
+    }
+    const double indexUs = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+    EXPECT_EQ(scanFound, indexFound);
+
+    // the re-indexing updateLandmarks does after every optimisation
+    start = clock::now();
+    for (const auto& landmark : landmarks) index.update(landmark.first, landmark.second);
+    const double reindexUs = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+
+    std::cout << "  " << numLandmarks << " landmarks: scan " << scanUs << " us, index " << indexUs << " us ("
+              << scanUs / indexUs << "x), re-indexing " << reindexUs << " us" << std::endl;
+  }
+}
@@ -90,6 +90,7 @@ TEST(okvisTestSuite, Map) {
 
   std::cout << "create N=" << N << " visible points and add respective reprojection error terms... " << std::flush;
   ::ceres::CauchyLoss loss(1);
+  std::vector<uint64_t> landmarkIds;
   for (size_t i = 0; i < N; ++i) {
     Eigen::Vector4d point = cameraGeometry->createRandomVisibleHomogeneousPoint(static_cast<double>(i % 10) * 3 + 2.0);
     std::shared_ptr<okvis::ceres::HomogeneousPointParameterBlock> homogeneousPointParameterBlock_ptr(
@@ -116,6 +117,8 @@ TEST(okvisTestSuite, Map) {
         map.removeParameterBlock(homogeneousPointParameterBlock_ptr);  // randomly delete some just for fun to test
       else
         map.removeResidualBlock(id);  // randomly delete some just for fun to test
+    } else {
+      landmarkIds.push_back(i + 3);
     }
   }
   std::cout << " [ OK ] " << std::endl;
@@ -143,6 +146,16 @@ TEST(okvisTestSuite, Map) {
   OKVIS_ASSERT_TRUE(
       Exception, (T_WS.r() - poseParameterBlock_ptr->estimate().r()).norm() < 1e-1, "translation not close enough");
 
+  // the allocation free landmark Hessian has to match the generic one
+  okvis::ceres::Map::LhsScratch scratch;
+  for (uint64_t landmarkId : landmarkIds) {
+    Eigen::MatrixXd H(3, 3);
+    map.getLhs(landmarkId, H);
+    Eigen::Matrix3d H_landmark;
+    map.getLandmarkLhs(landmarkId, H_landmark, scratch);
+    OKVIS_ASSERT_TRUE(Exception, (H - H_landmark).norm() <= 1e-9 * H.norm(), "landmark Hessian mismatch");
+  }
+
   // also try out the resetting of parameterization:
   map.resetParameterization(poseParameterBlock_ptr->id(), okvis::ceres::Map::Pose2d);
   okvis::kinematics::Transformation T_start = poseParameterBlock_ptr->estimate();
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <okvis/SolverSelector.hpp>
+#include <vector>
+
+namespace {
+
+// time per iteration of three solver configurations: the first scales badly with the landmarks, the second with
+// the frames, the third has a large constant cost
+double fakeSecondsPerIteration(size_t candidate, size_t numFrames, size_t numLandmarks) {
+  switch (candidate) {
+    case 0:
+      return 1e-6 * numLandmarks;
+    case 1:
+      return 1e-5 * numFrames * numFrames;
+    default:
+      return 1e-3;
+  }
+}
+
+size_t solve(okvis::SolverSelector& selector, size_t numFrames, size_t numLandmarks) {
+  const size_t candidate = selector.select(numFrames, numLandmarks);
+  selector.report(numFrames, numLandmarks, candidate, fakeSecondsPerIteration(candidate, numFrames, numLandmarks));
+  return candidate;
+}
+
+}  // namespace
+
+TEST(SolverSelector, picksFastestPerWindowClass) {
+  okvis::SolverSelector selector(3, 2, 100);
+
+  // every candidate is timed twice first
+  std::vector<size_t> used(3, 0);
+  for (int i = 0; i < 6; ++i) ++used[solve(selector, 8, 200)];
+  EXPECT_EQ(used, std::vector<size_t>(3, 2));
+  for (size_t candidate = 0; candidate < 3; ++candidate) {
+    EXPECT_DOUBLE_EQ(selector.meanSecondsPerIteration(8, 200, candidate), fakeSecondsPerIteration(candidate, 8, 200));
+  }
+  for (int i = 0; i < 10; ++i) EXPECT_EQ(solve(selector, 8, 200), 0u);
+
+  // same octave of landmarks: same choice without new trials
+  EXPECT_EQ(solve(selector, 8, 250), 0u);
+
+  // more landmarks: the second candidate wins
+  for (int i = 0; i < 6; ++i) solve(selector, 8, 4000);
+  EXPECT_EQ(solve(selector, 8, 4000), 1u);
+
+  // more frames and landmarks: the constant one wins
+  for (int i = 0; i < 6; ++i) solve(selector, 20, 4000);
+  EXPECT_EQ(solve(selector, 20, 4000), 2u);
+  EXPECT_LT(selector.meanSecondsPerIteration(30, 4000, 0), 0.0);
+}
+
+TEST(SolverSelector, reevaluates) {
+  okvis::SolverSelector selector(2, 1, 10);
+  EXPECT_EQ(selector.select(5, 100), 0u);
+  EXPECT_FALSE(selector.report(5, 100, 0, 2.0));
+  EXPECT_EQ(selector.select(5, 100), 1u);
+  EXPECT_TRUE(selector.report(5, 100, 1, 1.0));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(selector.select(5, 100), 1u);
+    EXPECT_FALSE(selector.report(5, 100, 1, 3.0));  // not part of the trials
+  }
+  // the period is over, the first one gets timed again and wins this time
+  EXPECT_EQ(selector.select(5, 100), 0u);
+  EXPECT_FALSE(selector.report(5, 100, 0, 0.5));
+  EXPECT_EQ(selector.select(5, 100), 1u);
+  EXPECT_TRUE(selector.report(5, 100, 1, 1.0));
+  EXPECT_EQ(selector.select(5, 100), 0u);
+}
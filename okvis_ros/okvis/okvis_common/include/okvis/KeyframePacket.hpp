@@ -0,0 +1,114 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file KeyframePacket.hpp
+ * @brief Header file for the KeyframePacket struct.
+ */
+
+#ifndef INCLUDE_OKVIS_KEYFRAMEPACKET_HPP_
+#define INCLUDE_OKVIS_KEYFRAMEPACKET_HPP_
+
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief The landmarks a keyframe observes in its first camera, as handed to the keyframe callback for the pose graph.
+ *
+ * Structure of arrays: entry i of points, landmarkIds, keypointIndices, qualities and keypoints belongs to the same
+ * landmark. The indices of the other keyframes observing landmark i are
+ * covisibilities[covisibilityOffsets[i]] to covisibilities[covisibilityOffsets[i + 1] - 1].
+ */
+struct KeyframePacket {
+  uint64_t frameId = 0;    ///< Multiframe ID of the keyframe.
+  int keyframeIndex = -1;  ///< Running index of the keyframe.
+
+  std::vector<Eigen::Vector3d> points;           ///< Landmark positions in the world frame.
+  std::vector<uint64_t> landmarkIds;             ///< Landmark IDs.
+  std::vector<uint32_t> keypointIndices;         ///< Index of the observing keypoint in the first camera.
+  std::vector<double> qualities;                 ///< Landmark qualities.
+  std::vector<cv::KeyPoint> keypoints;           ///< The observing keypoints.
+  std::vector<uint32_t> covisibilityOffsets{0};  ///< Begin of the covisibilities of every landmark, plus the end.
+  std::vector<int> covisibilities;               ///< Indices of other keyframes observing the landmarks.
+
+  /// \brief Number of landmarks.
+  size_t size() const { return landmarkIds.size(); }
+
+  /// \brief Number of other keyframes observing landmark i.
+  size_t numCovisibilities(size_t i) const { return covisibilityOffsets[i + 1] - covisibilityOffsets[i]; }
+
+  /// \brief The j-th other keyframe observing landmark i.
+  int covisibility(size_t i, size_t j) const { return covisibilities[covisibilityOffsets[i] + j]; }
+
+  /// \brief Remove all landmarks, keeping the memory.
+  void clear() {
+    points.clear();
+    landmarkIds.clear();
+    keypointIndices.clear();
+    qualities.clear();
+    keypoints.clear();
+    covisibilityOffsets.assign(1, 0);
+    covisibilities.clear();
+  }
+
+  /// \brief Reserve memory for n landmarks.
+  void reserve(size_t n) {
+    points.reserve(n);
+    landmarkIds.reserve(n);
+    keypointIndices.reserve(n);
+    qualities.reserve(n);
+    keypoints.reserve(n);
+    covisibilityOffsets.reserve(n + 1);
+  }
+
+  /// \brief Add a landmark. Its covisibilities are the ones pushed to covisibilities since the previous landmark.
+  void add(const Eigen::Vector3d& point,
+           uint64_t landmarkId,
+           uint32_t keypointIndex,
+           double quality,
+           const cv::KeyPoint& keypoint) {
+    points.push_back(point);
+    landmarkIds.push_back(landmarkId);
+    keypointIndices.push_back(keypointIndex);
+    qualities.push_back(quality);
+    keypoints.push_back(keypoint);
+    covisibilityOffsets.push_back(static_cast<uint32_t>(covisibilities.size()));
+  }
+};
+
+}  // namespace okvis
+
+#endif  // INCLUDE_OKVIS_KEYFRAMEPACKET_HPP_
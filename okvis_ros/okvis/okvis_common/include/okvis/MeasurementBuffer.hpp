@@ -0,0 +1,299 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file MeasurementBuffer.hpp
+ * @brief Header file for the MeasurementBuffer and MeasurementSpan classes.
+ */
+
+#ifndef INCLUDE_OKVIS_MEASUREMENTBUFFER_HPP_
+#define INCLUDE_OKVIS_MEASUREMENTBUFFER_HPP_
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <okvis/Measurements.hpp>
+#include <okvis/Time.hpp>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+template <class MEASUREMENT_T>
+class MeasurementBuffer;
+
+/**
+ * @brief Non-owning, read-only view on a range of measurements stored in a MeasurementBuffer.
+ *
+ * A span only stores the buffer and the sequence numbers of its first and one-past-last
+ * element, so creating and passing it around never copies measurements. The buffer never
+ * overwrites measurements it holds, so the referenced measurements stay valid until they are
+ * removed with MeasurementBuffer::eraseUntil() or MeasurementBuffer::popFront().
+ * @tparam MEASUREMENT_T Measurement type, e.g. okvis::ImuMeasurement.
+ */
+template <class MEASUREMENT_T>
+class MeasurementSpan {
+ public:
+  typedef MEASUREMENT_T value_type;
+  typedef std::deque<MEASUREMENT_T, Eigen::aligned_allocator<MEASUREMENT_T> > deque_t;
+
+  /// \brief Random access iterator over the elements of the span.
+  class const_iterator {
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef MEASUREMENT_T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const MEASUREMENT_T* pointer;
+    typedef const MEASUREMENT_T& reference;
+
+    const_iterator() : buffer_(nullptr), seq_(0) {}
+    const_iterator(const MeasurementBuffer<MEASUREMENT_T>* buffer, uint64_t seq) : buffer_(buffer), seq_(seq) {}
+
+    reference operator*() const { return buffer_->at(seq_); }
+    pointer operator->() const { return &buffer_->at(seq_); }
+    reference operator[](difference_type n) const { return buffer_->at(seq_ + n); }
+
+    const_iterator& operator++() {
+      ++seq_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      ++seq_;
+      return tmp;
+    }
+    const_iterator& operator--() {
+      --seq_;
+      return *this;
+    }
+    const_iterator operator--(int) {
+      const_iterator tmp = *this;
+      --seq_;
+      return tmp;
+    }
+    const_iterator& operator+=(difference_type n) {
+      seq_ += n;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type n) {
+      seq_ -= n;
+      return *this;
+    }
+    const_iterator operator+(difference_type n) const { return const_iterator(buffer_, seq_ + n); }
+    const_iterator operator-(difference_type n) const { return const_iterator(buffer_, seq_ - n); }
+    difference_type operator-(const const_iterator& other) const {
+      return static_cast<difference_type>(seq_) - static_cast<difference_type>(other.seq_);
+    }
+
+    bool operator==(const const_iterator& other) const { return seq_ == other.seq_; }
+    bool operator!=(const const_iterator& other) const { return seq_ != other.seq_; }
+    bool operator<(const const_iterator& other) const { return seq_ < other.seq_; }
+    bool operator>(const const_iterator& other) const { return seq_ > other.seq_; }
+    bool operator<=(const const_iterator& other) const { return seq_ <= other.seq_; }
+    bool operator>=(const const_iterator& other) const { return seq_ >= other.seq_; }
+
+   private:
+    const MeasurementBuffer<MEASUREMENT_T>* buffer_;  ///< The buffer the iterator points into.
+    uint64_t seq_;                                    ///< Sequence number of the element.
+  };
+  typedef const_iterator iterator;
+
+  /// \brief Construct an empty span.
+  MeasurementSpan() : buffer_(nullptr), begin_(0), end_(0) {}
+
+  /// \brief Number of measurements in the span.
+  size_t size() const { return static_cast<size_t>(end_ - begin_); }
+  /// \brief Is the span empty?
+  bool empty() const { return end_ == begin_; }
+
+  /// \brief Oldest measurement of the span. Span must not be empty.
+  const MEASUREMENT_T& front() const { return buffer_->at(begin_); }
+  /// \brief Newest measurement of the span. Span must not be empty.
+  const MEASUREMENT_T& back() const { return buffer_->at(end_ - 1); }
+  /// \brief Access the i-th measurement of the span (0 is the oldest).
+  const MEASUREMENT_T& operator[](size_t i) const { return buffer_->at(begin_ + i); }
+
+  const_iterator begin() const { return const_iterator(buffer_, begin_); }
+  const_iterator end() const { return const_iterator(buffer_, end_); }
+
+  /// \brief Check whether the referenced measurements are still held by the buffer, i.e. were not removed.
+  bool valid() const { return buffer_ == nullptr || empty() || buffer_->holds(begin_); }
+
+  /// \brief Copy the measurements into an owning deque, e.g. to hand them to an error term.
+  deque_t toDeque() const { return deque_t(begin(), end()); }
+
+ private:
+  friend class MeasurementBuffer<MEASUREMENT_T>;
+
+  /// \brief Only the buffer creates spans on itself.
+  MeasurementSpan(const MeasurementBuffer<MEASUREMENT_T>* buffer, uint64_t begin, uint64_t end)
+      : buffer_(buffer), begin_(begin), end_(end) {}
+
+  const MeasurementBuffer<MEASUREMENT_T>* buffer_;  ///< The buffer holding the measurements.
+  uint64_t begin_;                                  ///< Sequence number of the first element.
+  uint64_t end_;                                    ///< Sequence number one past the last element.
+};
+
+/**
+ * @brief Fixed-capacity, timestamp-sorted ring buffer of measurements.
+ *
+ * Measurements are appended by a single producer thread in strictly increasing timestamp
+ * order. Any thread may extract a time window with getRange(), which does a binary search
+ * and returns a MeasurementSpan without copying, or drop old measurements with eraseUntil().
+ * No mutex is taken: the producer publishes new elements with a release store on the head
+ * index and the oldest index is only ever moved forward. The producer only writes to slots
+ * that were removed, never to a held measurement: if the buffer is full, the new measurement
+ * is dropped, so the capacity should cover several optimization windows.
+ * @warning Only remove measurements that no other thread reads any more, the producer may reuse
+ *          their slots right away.
+ * @tparam MEASUREMENT_T Measurement type, e.g. okvis::ImuMeasurement.
+ */
+template <class MEASUREMENT_T>
+class MeasurementBuffer {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef MeasurementSpan<MEASUREMENT_T> span_t;
+
+  /**
+   * @brief Constructor.
+   * @param capacity Minimum number of measurements to hold. Rounded up to a power of two.
+   */
+  explicit MeasurementBuffer(size_t capacity = 1024);
+
+  MeasurementBuffer(const MeasurementBuffer&) = delete;
+  MeasurementBuffer& operator=(const MeasurementBuffer&) = delete;
+
+  /// \brief Result of push().
+  enum PushResult {
+    Pushed,      ///< The measurement was appended.
+    OutOfOrder,  ///< The measurement is not newer than the last one pushed and was dropped.
+    Full         ///< The buffer is full, the measurement was dropped and counted in numDropped().
+  };
+
+  /**
+   * @brief Append a measurement. Must only be called from one (producer) thread.
+   * @param measurement The measurement. Its timestamp must be newer than the newest one in the buffer.
+   * @return Whether the measurement was appended or why it was dropped.
+   */
+  PushResult push(const MEASUREMENT_T& measurement);
+
+  /**
+   * @brief Get the measurements spanning a time window.
+   * @param begin The first measurement in the span will be older or equal to this timestamp if available.
+   * @param end The last measurement in the span will be newer or equal to this timestamp if available.
+   * @return The span. Empty if end < begin, if begin is newer than the newest measurement or if the
+   *         buffer is empty.
+   */
+  span_t getRange(const okvis::Time& begin, const okvis::Time& end) const;
+
+  /// \brief Get a span over all measurements currently in the buffer.
+  span_t getAll() const;
+
+  /**
+   * @brief Remove measurements that are strictly older than a timestamp.
+   * @remark The newest measurement is always kept.
+   * @param eraseUntil Remove all measurements that are strictly older than this time.
+   * @return The number of measurements removed.
+   */
+  size_t eraseUntil(const okvis::Time& eraseUntil);
+
+  /**
+   * @brief Remove the measurements older than the last one not newer than a timestamp, so that a getRange() beginning
+   *        at or after it still starts with the same measurement. For sensors slower than the frames, where
+   *        eraseUntil() would remove the first measurement of a window still being read.
+   * @param stamp Keep the last measurement not newer than this time and all newer ones.
+   * @return The number of measurements removed.
+   */
+  size_t eraseBefore(const okvis::Time& stamp);
+
+  /**
+   * @brief Remove the oldest measurements.
+   * @param n Number of measurements to remove.
+   * @return The number of measurements removed.
+   */
+  size_t popFront(size_t n = 1);
+
+  /// \brief Number of measurements in the buffer.
+  size_t size() const;
+  /// \brief Is the buffer empty?
+  bool empty() const { return size() == 0; }
+  /// \brief Maximum number of measurements the buffer holds before dropping new ones.
+  size_t capacity() const { return storage_.size(); }
+  /// \brief Number of measurements that were dropped because the buffer was full.
+  size_t numDropped() const { return numDropped_.load(std::memory_order_relaxed); }
+
+  /// \brief Timestamp of the newest measurement. Returns okvis::Time(0, 0) if the buffer is empty.
+  okvis::Time newestTimeStamp() const;
+  /// \brief Timestamp of the oldest measurement. Returns okvis::Time(0, 0) if the buffer is empty.
+  okvis::Time oldestTimeStamp() const;
+
+ private:
+  friend class MeasurementSpan<MEASUREMENT_T>;
+  friend class MeasurementSpan<MEASUREMENT_T>::const_iterator;
+
+  /// \brief Access an element by sequence number.
+  const MEASUREMENT_T& at(uint64_t seq) const { return storage_[seq & mask_]; }
+  /// \brief Is the element with this sequence number still in the buffer?
+  bool holds(uint64_t seq) const { return tail_.load(std::memory_order_acquire) <= seq; }
+  /// \brief Move the oldest index forward to at least newTail.
+  void advanceTail(uint64_t newTail);
+  /// \brief First sequence number in [first, last) whose timestamp is not older than stamp.
+  uint64_t lowerBound(const okvis::Time& stamp, uint64_t first, uint64_t last) const;
+  /// \brief First sequence number in [first, last) whose timestamp is newer than stamp.
+  uint64_t upperBound(const okvis::Time& stamp, uint64_t first, uint64_t last) const;
+
+  std::vector<MEASUREMENT_T, Eigen::aligned_allocator<MEASUREMENT_T> > storage_;  ///< The ring storage.
+  uint64_t mask_;                        ///< capacity - 1, used to map sequence numbers to slots.
+  std::atomic<uint64_t> head_;           ///< Sequence number one past the newest measurement.
+  std::atomic<uint64_t> tail_;           ///< Sequence number of the oldest measurement.
+  std::atomic<size_t> numDropped_;       ///< Measurements dropped because the buffer was full.
+};
+
+typedef MeasurementBuffer<ImuMeasurement> ImuMeasurementBuffer;
+typedef MeasurementSpan<ImuMeasurement> ImuMeasurementSpan;
+
+typedef MeasurementBuffer<SonarMeasurement> SonarMeasurementBuffer;  /// @Sharmin
+typedef MeasurementSpan<SonarMeasurement> SonarMeasurementSpan;      /// @Sharmin
+
+typedef MeasurementBuffer<DepthMeasurement> DepthMeasurementBuffer;  /// @Sharmin
+typedef MeasurementSpan<DepthMeasurement> DepthMeasurementSpan;      /// @Sharmin
+
+typedef MeasurementBuffer<RelocMeasurement> RelocMeasurementBuffer;  /// @Sharmin
+typedef MeasurementSpan<RelocMeasurement> RelocMeasurementSpan;      /// @Sharmin
+
+}  // namespace okvis
+
+#include "implementation/MeasurementBuffer.hpp"
+
+#endif  // INCLUDE_OKVIS_MEASUREMENTBUFFER_HPP_
@@ -40,6 +40,7 @@
 #ifndef INCLUDE_OKVIS_MEASUREMENTS_HPP_
 #define INCLUDE_OKVIS_MEASUREMENTS_HPP_
 
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <vector>
@@ -174,9 +175,10 @@ typedef Measurement<ImuSensorReadings> ImuMeasurement;
 typedef std::deque<ImuMeasurement, Eigen::aligned_allocator<ImuMeasurement> > ImuMeasurementDeque;
 /// \brief Camera measurement.
 struct CameraData {
-  cv::Mat image;                        ///< Image.
-  std::vector<cv::KeyPoint> keypoints;  ///< Keypoints if available.
-  bool deliversKeypoints;               ///< Are the keypoints delivered too?
+  cv::Mat image;                                      ///< Image.
+  std::vector<cv::KeyPoint> keypoints;                ///< Keypoints if available.
+  bool deliversKeypoints;                             ///< Are the keypoints delivered too?
+  std::chrono::steady_clock::time_point arrivalTime;  ///< When the estimator got the image, for frame tracing.
 };
 /// \brief Keypoint measurement.
 struct KeypointData {
@@ -42,6 +42,7 @@
 #define INCLUDE_OKVIS_PARAMETERS_HPP_
 
 #include <deque>
+#include <string>
 #include <vector>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Woverloaded-virtual"
@@ -271,11 +272,20 @@ struct Optimization {
   int max_iterations;                          ///< Maximum iterations the optimization should perform.
   int min_iterations;                          ///< Minimum iterations the optimization should perform.
   double timeLimitForMatchingAndOptimization;  ///< The time limit for both matching and optimization. [s]
+  int solverThreads = 2;                        ///< Threads of the Ceres solver and of the landmark update.
+  std::string linearSolver = "SPARSE_SCHUR";    ///< Ceres linear solver type. AUTO picks the fastest per window size.
+  std::string preconditioner = "SCHUR_JACOBI";  ///< Ceres preconditioner of the iterative linear solvers.
+  std::string trustRegionStrategy = "DOGLEG";   ///< Ceres trust region strategy.
   okvis::Duration timeReserve;                 ///< Store a little more on the beginning and end of the IMU buffer. [s]
   double detectionThreshold;                   ///< Keypoint detection threshold.
   bool useMedianFilter;                        ///< Use a Median filter over captured image?
   int detectionOctaves;                        ///< Number of keypoint detection octaves.
   int maxNoKeypoints;  ///< Restrict to a maximum of this many keypoints per image (strongest ones).
+  int detectionTilesX = 1;        ///< Detect in this many tile columns in parallel. 1x1 detects on the whole image.
+  int detectionTilesY = 1;        ///< Detect in this many tile rows in parallel.
+  int detectionTileOverlap = 32;  ///< Overlap of neighbouring detection tiles. [pixels]
+  int detectionThreads = 0;       ///< Threads detecting the tiles of all cameras. 0 means one per tile.
+  double stereoMatchingBand = 0.0;  ///< Half width of the stereo epipolar band, 0 matches all pairs. [pixels]
   int numKeyframes;    ///< Number of keyframes.
   int numImuFrames;    ///< Number of IMU frames.
   int numSonarFrames;  ///< Number of Sonar frames @Sharmin
@@ -147,6 +147,12 @@ class VioBackendInterface {
    */
   virtual void optimize(size_t numIter, size_t numThreads = 1, bool verbose = false) = 0;
 
+  /**
+   * @brief Synchronise the landmarks and their quality with the optimised states.
+   * @param[in] numThreads Number of threads.
+   */
+  virtual void updateLandmarks(size_t numThreads = 1) = 0;
+
   /**
    * @brief Set a time limit for the optimization process.
    * @param[in] timeLimit Time limit in seconds. If timeLimit < 0 the time limit is removed.
@@ -156,6 +162,13 @@ class VioBackendInterface {
    */
   virtual bool setOptimizationTimeLimit(double timeLimit, int minIterations) = 0;
 
+  /**
+   * @brief Configure the solver used by optimize().
+   * @param[in] optimization The linear solver, preconditioner and trust region strategy to use.
+   * @return True if the configuration is supported, otherwise the previous one is kept.
+   */
+  virtual bool setSolverOptions(const okvis::Optimization& optimization) = 0;
+
   /**
    * @brief Checks whether the landmark is added to the estimator.
    * @param landmarkId The ID.
@@ -44,6 +44,7 @@
 #include <Eigen/Core>
 #include <memory>
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/MeasurementBuffer.hpp>
 #include <okvis/Measurements.hpp>
 #include <okvis/MultiFrame.hpp>
 #include <okvis/Parameters.hpp>
@@ -104,7 +105,7 @@ class VioFrontendInterface {
   /**
    * @brief Propagates pose, speeds and biases with given IMU measurements.
    * @see okvis::ceres::ImuError::propagation()
-   * @param[in] imuMeasurements All the IMU measurements.
+   * @param[in] imuMeasurements The IMU measurements, viewed in the measurement buffer.
    * @param[in] imuParams The parameters to be used.
    * @param[inout] T_WS_propagated Start pose.
    * @param[inout] speedAndBiases Start speed and biases.
@@ -114,7 +115,7 @@ class VioFrontendInterface {
    * @param[out] jacobian Jacobian w.r.t. start states.
    * @return True on success.
    */
-  virtual bool propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
+  virtual bool propagation(const okvis::ImuMeasurementSpan& imuMeasurements,
                            const okvis::ImuParameters& imuParams,
                            okvis::kinematics::Transformation& T_WS_propagated,  // NOLINT
                            okvis::SpeedAndBias& speedAndBiases,                 // NOLINT
@@ -57,6 +57,7 @@
 #include <opencv2/features2d/features2d.hpp>
 #pragma GCC diagnostic pop
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/KeyframePacket.hpp>
 #include <okvis/Time.hpp>
 #include <okvis/assert_macros.hpp>
 #include <okvis/kinematics/Transformation.hpp>
@@ -94,11 +95,8 @@ class VioInterface {
   // Sharmin
   // typedef std::function<
   //      void(const okvis::Time &, const std::vector<Eigen::Vector3d> &)> StereoMatchCallback;
-  // TODO(Sharmin): Fix the size of the matrix
-  typedef std::function<void(const okvis::Time&,
-                             const cv::Mat&,
-                             const okvis::kinematics::Transformation&,
-                             std::vector<std::list<std::vector<double>>>&)>
+  typedef std::function<void(
+      const okvis::Time&, const cv::Mat&, const okvis::kinematics::Transformation&, const okvis::KeyframePacket&)>
       KeyframeCallback;
 
   typedef std::function<
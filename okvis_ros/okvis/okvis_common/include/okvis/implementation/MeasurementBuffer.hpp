@@ -0,0 +1,201 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file implementation/MeasurementBuffer.hpp
+ * @brief Header implementation file for the MeasurementBuffer class.
+ */
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Constructor.
+template <class MEASUREMENT_T>
+MeasurementBuffer<MEASUREMENT_T>::MeasurementBuffer(size_t capacity) : head_(0), tail_(0), numDropped_(0) {
+  size_t roundedCapacity = 2;
+  while (roundedCapacity < capacity) roundedCapacity <<= 1;
+  storage_.resize(roundedCapacity);
+  mask_ = roundedCapacity - 1;
+}
+
+// Append a measurement.
+template <class MEASUREMENT_T>
+typename MeasurementBuffer<MEASUREMENT_T>::PushResult MeasurementBuffer<MEASUREMENT_T>::push(
+    const MEASUREMENT_T& measurement) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  // the slot of the last pushed element is only ever written by the producer, so this is safe
+  if (head > 0 && !(at(head - 1).timeStamp < measurement.timeStamp)) return OutOfOrder;
+
+  // the slot to write still holds the oldest measurement, which readers may be using: drop the new one
+  if (head - tail_.load(std::memory_order_acquire) >= storage_.size()) {
+    numDropped_.fetch_add(1, std::memory_order_relaxed);
+    return Full;
+  }
+
+  storage_[head & mask_] = measurement;
+  head_.store(head + 1, std::memory_order_release);
+  return Pushed;
+}
+
+// Get the measurements spanning a time window.
+template <class MEASUREMENT_T>
+typename MeasurementBuffer<MEASUREMENT_T>::span_t MeasurementBuffer<MEASUREMENT_T>::getRange(
+    const okvis::Time& begin, const okvis::Time& end) const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+
+  // sanity checks:
+  // if end time is smaller than begin time, return empty span.
+  // if begin time is larger than newest measurement time, return empty span.
+  if (head == tail || end < begin || begin > at(head - 1).timeStamp) return span_t();
+
+  // the last measurement not newer than begin, or the oldest one if there is none
+  uint64_t first = upperBound(begin, tail, head);
+  if (first > tail) --first;
+
+  // the first measurement not older than end is included, or all up to the newest one if there is none
+  uint64_t last = lowerBound(end, first, head);
+  if (last < head) ++last;
+
+  return span_t(this, first, last);
+}
+
+// Get a span over all measurements currently in the buffer.
+template <class MEASUREMENT_T>
+typename MeasurementBuffer<MEASUREMENT_T>::span_t MeasurementBuffer<MEASUREMENT_T>::getAll() const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  return span_t(this, tail, head);
+}
+
+// Remove measurements that are strictly older than a timestamp.
+template <class MEASUREMENT_T>
+size_t MeasurementBuffer<MEASUREMENT_T>::eraseUntil(const okvis::Time& eraseUntil) {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  if (head == tail) return 0;
+
+  uint64_t newTail = lowerBound(eraseUntil, tail, head);
+  if (newTail == head) --newTail;  // always keep the newest measurement
+  advanceTail(newTail);
+  return static_cast<size_t>(newTail - tail);
+}
+
+// Remove the measurements older than the last one not newer than a timestamp.
+template <class MEASUREMENT_T>
+size_t MeasurementBuffer<MEASUREMENT_T>::eraseBefore(const okvis::Time& stamp) {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  if (head == tail) return 0;
+
+  // the last measurement not newer than stamp, the newest one at most
+  uint64_t newTail = upperBound(stamp, tail, head);
+  if (newTail > tail) --newTail;
+  advanceTail(newTail);
+  return static_cast<size_t>(newTail - tail);
+}
+
+// Remove the oldest measurements.
+template <class MEASUREMENT_T>
+size_t MeasurementBuffer<MEASUREMENT_T>::popFront(size_t n) {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  const uint64_t newTail = std::min<uint64_t>(head, tail + n);
+  advanceTail(newTail);
+  return static_cast<size_t>(newTail - tail);
+}
+
+// Number of measurements in the buffer.
+template <class MEASUREMENT_T>
+size_t MeasurementBuffer<MEASUREMENT_T>::size() const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  return head > tail ? static_cast<size_t>(head - tail) : 0;
+}
+
+// Timestamp of the newest measurement.
+template <class MEASUREMENT_T>
+okvis::Time MeasurementBuffer<MEASUREMENT_T>::newestTimeStamp() const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  if (head == tail_.load(std::memory_order_acquire)) return okvis::Time(0, 0);
+  return at(head - 1).timeStamp;
+}
+
+// Timestamp of the oldest measurement.
+template <class MEASUREMENT_T>
+okvis::Time MeasurementBuffer<MEASUREMENT_T>::oldestTimeStamp() const {
+  const uint64_t tail = tail_.load(std::memory_order_acquire);
+  if (head_.load(std::memory_order_acquire) == tail) return okvis::Time(0, 0);
+  return at(tail).timeStamp;
+}
+
+// Move the oldest index forward to at least newTail.
+template <class MEASUREMENT_T>
+void MeasurementBuffer<MEASUREMENT_T>::advanceTail(uint64_t newTail) {
+  uint64_t tail = tail_.load(std::memory_order_acquire);
+  while (tail < newTail && !tail_.compare_exchange_weak(tail, newTail, std::memory_order_acq_rel)) {
+  }
+}
+
+// First sequence number in [first, last) whose timestamp is not older than stamp.
+template <class MEASUREMENT_T>
+uint64_t MeasurementBuffer<MEASUREMENT_T>::lowerBound(const okvis::Time& stamp, uint64_t first, uint64_t last) const {
+  uint64_t count = last - first;
+  while (count > 0) {
+    const uint64_t step = count / 2;
+    const uint64_t mid = first + step;
+    if (at(mid).timeStamp < stamp) {
+      first = mid + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+// First sequence number in [first, last) whose timestamp is newer than stamp.
+template <class MEASUREMENT_T>
+uint64_t MeasurementBuffer<MEASUREMENT_T>::upperBound(const okvis::Time& stamp, uint64_t first, uint64_t last) const {
+  uint64_t count = last - first;
+  while (count > 0) {
+    const uint64_t step = count / 2;
+    const uint64_t mid = first + step;
+    if (!(stamp < at(mid).timeStamp)) {
+      first = mid + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+}  // namespace okvis
@@ -116,6 +116,21 @@ void VioParametersReader::readConfigFile(const std::string& filename) {
     LOG(WARNING) << "ceres_options: timeLimit parameter not provided. Setting no time limit.";
     vioParameters_.optimization.timeLimitForMatchingAndOptimization = -1.0;
   }
+  // ceres solver threads and types, validated by the estimator
+  if (file["ceres_options"]["threads"].isInt()) {
+    file["ceres_options"]["threads"] >> vioParameters_.optimization.solverThreads;
+  }
+  OKVIS_ASSERT_TRUE(Exception, vioParameters_.optimization.solverThreads >= 1, "Invalid parameter value.");
+  if (file["ceres_options"]["linearSolver"].isString()) {
+    vioParameters_.optimization.linearSolver = static_cast<std::string>(file["ceres_options"]["linearSolver"]);
+  }
+  if (file["ceres_options"]["preconditioner"].isString()) {
+    vioParameters_.optimization.preconditioner = static_cast<std::string>(file["ceres_options"]["preconditioner"]);
+  }
+  if (file["ceres_options"]["trustRegionStrategy"].isString()) {
+    vioParameters_.optimization.trustRegionStrategy =
+        static_cast<std::string>(file["ceres_options"]["trustRegionStrategy"]);
+  }
 
   // do we use the direct driver?
   bool success = parseBoolean(file["useDriver"], useDriver);
@@ -147,6 +162,33 @@ void VioParametersReader::readConfigFile(const std::string& filename) {
   file["detection_options"]["maxNoKeypoints"] >> vioParameters_.optimization.maxNoKeypoints;
   OKVIS_ASSERT_TRUE(Exception, vioParameters_.optimization.maxNoKeypoints >= 0, "Invalid parameter value.");
 
+  // tiled detection, optional: detects on the whole image by default
+  if (file["detection_options"]["tilesX"].isInt()) {
+    file["detection_options"]["tilesX"] >> vioParameters_.optimization.detectionTilesX;
+  }
+  if (file["detection_options"]["tilesY"].isInt()) {
+    file["detection_options"]["tilesY"] >> vioParameters_.optimization.detectionTilesY;
+  }
+  if (file["detection_options"]["tileOverlap"].isInt()) {
+    file["detection_options"]["tileOverlap"] >> vioParameters_.optimization.detectionTileOverlap;
+  }
+  if (file["detection_options"]["threads"].isInt()) {
+    file["detection_options"]["threads"] >> vioParameters_.optimization.detectionThreads;
+  }
+  OKVIS_ASSERT_TRUE(Exception,
+                    vioParameters_.optimization.detectionTilesX >= 1 &&
+                        vioParameters_.optimization.detectionTilesY >= 1 &&
+                        vioParameters_.optimization.detectionTileOverlap >= 0 &&
+                        vioParameters_.optimization.detectionThreads >= 0,
+                    "Invalid parameter value.");
+
+  // stereo matching in an epipolar band, optional: matches all pairs by default
+  if (file["detection_options"]["stereoMatchingBand"].isReal() ||
+      file["detection_options"]["stereoMatchingBand"].isInt()) {
+    file["detection_options"]["stereoMatchingBand"] >> vioParameters_.optimization.stereoMatchingBand;
+  }
+  OKVIS_ASSERT_TRUE(Exception, vioParameters_.optimization.stereoMatchingBand >= 0.0, "Invalid parameter value.");
+
   // image delay
   success = file["imageDelay"].isReal();
   OKVIS_ASSERT_TRUE(Exception, success, "'imageDelay' parameter missing in configuration file.");
@@ -45,6 +45,7 @@
 #include <mutex>
 #include <okvis/DenseMatcher.hpp>
 #include <okvis/Estimator.hpp>
+#include <okvis/ThreadPool.hpp>
 #include <okvis/VioFrontendInterface.hpp>
 #include <okvis/assert_macros.hpp>
 #include <okvis/timing/Timer.hpp>
@@ -73,6 +74,13 @@ class Frontend : public VioFrontendInterface {
   explicit Frontend(size_t numCameras);
   virtual ~Frontend() {}
 
+  /// \brief Counters of the 2D-2D stereo matching, to compare the epipolar band with matching all pairs.
+  struct StereoMatchingStatistics {
+    size_t numCameraPairs = 0;  ///< Camera pairs matched.
+    size_t numCandidates = 0;   ///< Keypoint pairs compared.
+    size_t numMatches = 0;      ///< Matches handed to the estimator.
+  };
+
   ///@{
   /**
    * @brief Detection and descriptor extraction on a per image basis.
@@ -114,7 +122,7 @@ class Frontend : public VioFrontendInterface {
    * @brief Propagates pose, speeds and biases with given IMU measurements.
    * @see okvis::ceres::ImuError::propagation()
    * @remark This method is threadsafe.
-   * @param[in] imuMeasurements All the IMU measurements.
+   * @param[in] imuMeasurements The IMU measurements, viewed in the measurement buffer.
    * @param[in] imuParams The parameters to be used.
    * @param[inout] T_WS_propagated Start pose.
    * @param[inout] speedAndBiases Start speed and biases.
@@ -124,7 +132,7 @@ class Frontend : public VioFrontendInterface {
    * @param[out] jacobian Jacobian w.r.t. start states.
    * @return True on success.
    */
-  virtual bool propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
+  virtual bool propagation(const okvis::ImuMeasurementSpan& imuMeasurements,
                            const okvis::ImuParameters& imuParams,
                            okvis::kinematics::Transformation& T_WS_propagated,  // NOLINT
                            okvis::SpeedAndBias& speedAndBiases,                 // NOLINT
@@ -166,6 +174,13 @@ class Frontend : public VioFrontendInterface {
   /// @brief Get the matching threshold.
   double getBriskMatchingThreshold() const { return briskMatchingThreshold_; }
 
+  /// @brief Get the half width of the stereo epipolar band, 0 if stereo matching compares all pairs. [pixels]
+  double getStereoMatchingBand() const { return stereoMatchingBand_; }
+
+  /// @brief Get the counters of the 2D-2D stereo matching.
+  /// @warning Not threadsafe, read them when dataAssociationAndInitialization() is not running.
+  const StereoMatchingStatistics& getStereoMatchingStatistics() const { return stereoMatchingStatistics_; }
+
   /// @brief Get the area overlap threshold under which a new keyframe is inserted.
   float getKeyframeInsertionOverlapThershold() const { return keyframeInsertionOverlapThreshold_; }
 
@@ -203,6 +218,17 @@ class Frontend : public VioFrontendInterface {
     initialiseBriskFeatureDetectors();
   }
 
+  /**
+   * @brief Detect and describe in overlapping tiles, in parallel on a thread pool shared by the cameras.
+   *        Each tile is guaranteed its share of the maximum number of keypoints, the rest go to the strongest
+   *        keypoints of the image. A single tile detects on the whole image in the calling thread.
+   * @param tilesX     Number of tile columns.
+   * @param tilesY     Number of tile rows.
+   * @param overlap    Overlap of neighbouring tiles. It needs to hold the BRISK descriptor pattern. [pixels]
+   * @param numThreads Number of threads of the pool. 0 means one per tile.
+   */
+  void setDetectionTiles(size_t tilesX, size_t tilesY, size_t overlap, size_t numThreads);
+
   /// @}
   /// @name Setters related to the BRISK descriptor
   /// @{
@@ -226,6 +252,13 @@ class Frontend : public VioFrontendInterface {
   /// @brief Set the matching threshold.
   void setBriskMatchingThreshold(double threshold) { briskMatchingThreshold_ = threshold; }
 
+  /**
+   * @brief Match the keypoints of the stereo cameras only within a band around the epipolar curves, instead of all
+   *        pairs. The band is computed from the camera extrinsics, so it needs a calibrated rig.
+   * @param band Half width of the band, on top of the keypoint uncertainties. 0 matches all pairs. [pixels]
+   */
+  void setStereoMatchingBand(double band) { stereoMatchingBand_ = band; }
+
   /// @brief Set the area overlap threshold under which a new keyframe is inserted.
   void setKeyframeInsertionOverlapThreshold(float threshold) { keyframeInsertionOverlapThreshold_ = threshold; }
 
@@ -251,6 +284,18 @@ class Frontend : public VioFrontendInterface {
   std::vector<std::shared_ptr<cv::DescriptorExtractor> > descriptorExtractors_;
   /// Mutexes for feature detectors and descriptors.
   std::vector<std::unique_ptr<std::mutex> > featureDetectorMutexes_;
+  /**
+   * @brief   Feature detectors for tiled detection, one for each tile of each camera.
+   * @warning Lock with featureDetectorMutexes_[cameraIndex] when using the detector.
+   */
+  std::vector<std::vector<std::shared_ptr<cv::FeatureDetector> > > tileFeatureDetectors_;
+  /**
+   * @brief   Descriptor extractors for tiled detection, one for each tile of each camera.
+   * @warning Lock with featureDetectorMutexes_[cameraIndex] when using the descriptor.
+   */
+  std::vector<std::vector<std::shared_ptr<cv::DescriptorExtractor> > > tileDescriptorExtractors_;
+  /// Thread pool detecting the tiles of all cameras. Only there if tiled detection is on.
+  std::unique_ptr<okvis::ThreadPool> detectionThreadPool_;
 
   bool isInitialized_;              ///< Is the pose initialised?
   const size_t numCameras_;         ///< Number of cameras in the configuration.
@@ -272,6 +317,10 @@ class Frontend : public VioFrontendInterface {
   double briskDetectionThreshold_;          ///< The set BRISK detection threshold.
   double briskDetectionAbsoluteThreshold_;  ///< The set BRISK absolute detection threshold.
   size_t briskDetectionMaximumKeypoints_;   ///< The set maximum number of keypoints.
+  size_t detectionTilesX_;                  ///< The set number of detection tile columns.
+  size_t detectionTilesY_;                  ///< The set number of detection tile rows.
+  size_t detectionTileOverlap_;             ///< The set overlap of neighbouring detection tiles. [pixels]
+  size_t detectionThreads_;                 ///< The set number of tiled detection threads. 0 means one per tile.
 
   /// @}
   /// @name BRISK descriptor extractor parameters
@@ -285,6 +334,9 @@ class Frontend : public VioFrontendInterface {
   ///@{
 
   double briskMatchingThreshold_;  ///< The set BRISK matching threshold.
+  double stereoMatchingBand_;      ///< The set half width of the stereo epipolar band, 0 if off. [pixels]
+
+  StereoMatchingStatistics stereoMatchingStatistics_;  ///< Counters of the 2D-2D stereo matching.
 
   ///@}
 
@@ -411,6 +463,20 @@ class Frontend : public VioFrontendInterface {
 
   /// (re)instantiates feature detectors and descriptor extractors. Used after settings changed or at startup.
   void initialiseBriskFeatureDetectors();
+
+  /// Creates a feature detector with the current settings.
+  std::shared_ptr<cv::FeatureDetector> createBriskFeatureDetector() const;
+
+  /**
+   * @brief Tiled detection and descriptor extraction, see setDetectionTiles().
+   * @warning Lock with featureDetectorMutexes_[cameraIndex] when calling this.
+   * @param cameraIndex         Index of camera to do detection and description.
+   * @param frameOut            Multiframe containing the frames. Resulting keypoints and descriptors are saved in here.
+   * @param extractionDirection Direction the keypoints are oriented along, in camera frame.
+   */
+  void detectAndDescribeTiled(size_t cameraIndex,
+                              std::shared_ptr<okvis::MultiFrame> frameOut,
+                              const Eigen::Vector3d& extractionDirection);
 };
 
 }  // namespace okvis
@@ -46,8 +46,10 @@
 #include <limits>
 #include <memory>
 #include <okvis/DenseMatcher.hpp>
+#include <okvis/EpipolarBandIndex.hpp>
 #include <okvis/Estimator.hpp>
 #include <okvis/FrameTypedefs.hpp>
+#include <okvis/KeypointGrid.hpp>
 #include <okvis/MatchingAlgorithm.hpp>
 #include <okvis/MultiFrame.hpp>
 #include <okvis/triangulation/ProbabilisticStereoTriangulator.hpp>
@@ -102,6 +104,13 @@ class VioKeyframeWindowMatchingAlgorithm : public okvis::MatchingAlgorithm {
    */
   void setMatchingType(int matchingType);
 
+  /**
+   * @brief Restrict Match2D2D between two cameras of the same multiframe to the keypoints of B near the epipolar
+   *        curve of each keypoint of A, for DenseMatcher::matchInImageSpace().
+   * @param band Half width of the band, on top of the keypoint uncertainties. 0 turns it off. [pixels in A]
+   */
+  void setEpipolarBand(double band) { epipolarBand_ = band; }
+
   /// \brief This will be called exactly once for each call to DenseMatcher::match().
   virtual void doSetup();
 
@@ -118,6 +127,16 @@ class VioKeyframeWindowMatchingAlgorithm : public okvis::MatchingAlgorithm {
   /// \brief Set the distance threshold for which matches exceeding it will not be returned as matches.
   void setDistanceThreshold(float distanceThreshold);
 
+  /// \brief Begin of the keypoints of B that landmark indexA of A can match, i.e. those inside the bounding box of
+  ///        its projection uncertainty (Match3D2D) or inside its epipolar band (Match2D2D). For
+  ///        DenseMatcher::matchInImageSpace(), Match2D2D only with an epipolar band.
+  virtual listB_candidates_t::const_iterator getListBStartIterator(size_t indexA);
+  /// \brief End of the keypoints of B that landmark indexA of A can match.
+  virtual listB_candidates_t::const_iterator getListBEndIterator(size_t indexA);
+
+  /// \brief Number of pairs DenseMatcher::matchInImageSpace() compares, valid after doSetup().
+  size_t numCandidates() const { return candidatesB_.size(); }
+
   /// \brief Should we skip the item in list A? This will be called once for each item in the list
   virtual bool skipA(size_t indexA) const { return skipA_[indexA]; }
 
@@ -225,6 +244,15 @@ class VioKeyframeWindowMatchingAlgorithm : public okvis::MatchingAlgorithm {
   /// Should keypoint[index] in frame B be skipped
   std::vector<bool> skipB_;
 
+  /// Keypoints of frame B bucketed into image cells (Match3D2D only).
+  okvis::KeypointGrid keypointGridB_;
+  /// For each landmark of frame A, the keypoints of frame B it can match (Match3D2D, Match2D2D with epipolar band).
+  listB_candidates_t candidatesB_;
+  /// Half width of the stereo epipolar band, 0 if off. [pixels in A]
+  double epipolarBand_ = 0.0;
+  /// Keypoints of frame B sorted by epipolar plane (Match2D2D with epipolar band only).
+  okvis::EpipolarBandIndex epipolarBandIndexB_;
+
   // ***** Added by Sharmin for Stereo Contour Matching ******//
   /*size_t scm_numMatches_ = 0;
   size_t scm_numUncertainMatches_ = 0;
@@ -253,6 +281,9 @@ class VioKeyframeWindowMatchingAlgorithm : public okvis::MatchingAlgorithm {
   bool usePoseUncertainty_ = false;
   bool useSCM_ = false;
 
+  /// \brief List for each keypoint of A the keypoints of B inside its epipolar band.
+  void setupEpipolarCandidates();
+
   /// \brief Calculates the distance between two descriptors.
   // copy from BriskDescriptor.hpp
   uint32_t specificDescriptorDistance(const unsigned char* descriptorA, const unsigned char* descriptorB) const {
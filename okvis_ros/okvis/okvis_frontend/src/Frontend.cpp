@@ -66,6 +66,25 @@
 /// \brief okvis Main namespace of this package.
 namespace okvis {
 
+namespace {
+
+// Orients the keypoints along the projection of a direction in camera frame, as Frame::describe() does.
+void orientKeypoints(const cameras::CameraBase& geometry,
+                     const Eigen::Vector3d& direction,
+                     std::vector<cv::KeyPoint>& keypoints) {  // NOLINT
+  Eigen::Vector3d ep;
+  Eigen::Vector2d reprojection;
+  Eigen::Matrix<double, 2, 3> Jacobian;
+  for (cv::KeyPoint& keypoint : keypoints) {
+    geometry.backProject(Eigen::Vector2d(keypoint.pt.x, keypoint.pt.y), &ep);
+    geometry.project(ep, &reprojection, &Jacobian);
+    const Eigen::Vector2d projected = Jacobian * direction;
+    keypoint.angle = atan2(projected[1], projected[0]) / M_PI * 180.0;
+  }
+}
+
+}  // namespace
+
 // Constructor.
 Frontend::Frontend(size_t numCameras)
     : isInitialized_(false),
@@ -74,9 +93,14 @@ Frontend::Frontend(size_t numCameras)
       briskDetectionThreshold_(50.0),
       briskDetectionAbsoluteThreshold_(800.0),
       briskDetectionMaximumKeypoints_(450),
+      detectionTilesX_(1),
+      detectionTilesY_(1),
+      detectionTileOverlap_(32),
+      detectionThreads_(0),
       briskDescriptionRotationInvariance_(true),
       briskDescriptionScaleInvariance_(false),
       briskMatchingThreshold_(60.0),
+      stereoMatchingBand_(0.0),
       matcher_(std::unique_ptr<okvis::DenseMatcher>(new okvis::DenseMatcher(4))),
       keyframeInsertionOverlapThreshold_(0.6),
       keyframeInsertionMatchingRatioThreshold_(0.2) {
@@ -101,17 +125,120 @@ bool Frontend::detectAndDescribe(size_t cameraIndex,
   frameOut->setDetector(cameraIndex, featureDetectors_[cameraIndex]);
   frameOut->setExtractor(cameraIndex, descriptorExtractors_[cameraIndex]);
 
-  frameOut->detect(cameraIndex);
-
   // ExtractionDirection == gravity direction in camera frame
   Eigen::Vector3d g_in_W(0, 0, -1);
   Eigen::Vector3d extractionDirection = T_WC.inverse().C() * g_in_W;
+
+  if (detectionThreadPool_) {
+    detectAndDescribeTiled(cameraIndex, frameOut, extractionDirection);
+    return true;
+  }
+
+  frameOut->detect(cameraIndex);
   frameOut->describe(cameraIndex, extractionDirection);
 
   // set detector/extractor to nullpointer? TODO(later) or not?
   return true;
 }
 
+// Tiled detection and descriptor extraction.
+void Frontend::detectAndDescribeTiled(size_t cameraIndex,
+                                      std::shared_ptr<okvis::MultiFrame> frameOut,
+                                      const Eigen::Vector3d& extractionDirection) {
+  const cv::Mat& image = frameOut->image(cameraIndex);
+  const std::shared_ptr<const cameras::CameraBase> geometry = frameOut->geometry(cameraIndex);
+  const size_t numTiles = detectionTilesX_ * detectionTilesY_;
+  const int overlap = static_cast<int>(detectionTileOverlap_);
+
+  // Every pixel belongs to the core of one tile. A tile is detected and described on its core grown by the overlap,
+  // so that the keypoints of its core see the same neighbourhood as in the whole image.
+  std::vector<cv::Rect> cores, regions;
+  for (size_t y = 0; y < detectionTilesY_; ++y) {
+    for (size_t x = 0; x < detectionTilesX_; ++x) {
+      const int x0 = image.cols * x / detectionTilesX_, x1 = image.cols * (x + 1) / detectionTilesX_;
+      const int y0 = image.rows * y / detectionTilesY_, y1 = image.rows * (y + 1) / detectionTilesY_;
+      cores.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+      regions.push_back(cv::Rect(cv::Point(std::max(x0 - overlap, 0), std::max(y0 - overlap, 0)),
+                                 cv::Point(std::min(x1 + overlap, image.cols), std::min(y1 + overlap, image.rows))));
+    }
+  }
+
+  // detect, keeping the keypoints of the core sorted by strength
+  std::vector<std::vector<cv::KeyPoint> > keypoints(numTiles);
+  std::vector<std::future<void> > tilesDone;
+  for (size_t t = 0; t < numTiles; ++t) {
+    tilesDone.push_back(detectionThreadPool_->enqueue([&, t]() {
+      std::vector<cv::KeyPoint> detected;
+      tileFeatureDetectors_[cameraIndex][t]->detect(image(regions[t]), detected);
+      const cv::Rect& core = cores[t];
+      for (cv::KeyPoint& keypoint : detected) {
+        keypoint.pt.x += regions[t].x;
+        keypoint.pt.y += regions[t].y;
+        if (keypoint.pt.x >= core.x && keypoint.pt.x < core.x + core.width && keypoint.pt.y >= core.y &&
+            keypoint.pt.y < core.y + core.height) {
+          keypoints[t].push_back(keypoint);
+        }
+      }
+      std::sort(keypoints[t].begin(), keypoints[t].end(), [](const cv::KeyPoint& a, const cv::KeyPoint& b) {
+        return a.response > b.response;
+      });
+    }));
+  }
+  for (std::future<void>& tileDone : tilesDone) tileDone.get();
+
+  // Each tile keeps its share of the budget. What the weakly textured tiles leave over goes to the strongest
+  // keypoints of the others.
+  if (briskDetectionMaximumKeypoints_ > 0) {
+    std::vector<size_t> kept(numTiles);
+    std::vector<std::pair<float, size_t> > remaining;  // response and tile of the keypoints over the share
+    size_t numKept = 0;
+    for (size_t t = 0; t < numTiles; ++t) {
+      kept[t] = std::min(briskDetectionMaximumKeypoints_ / numTiles, keypoints[t].size());
+      numKept += kept[t];
+      for (size_t k = kept[t]; k < keypoints[t].size(); ++k) {
+        remaining.push_back(std::make_pair(keypoints[t][k].response, t));
+      }
+    }
+    const size_t numExtra = std::min(briskDetectionMaximumKeypoints_ - numKept, remaining.size());
+    if (numExtra < remaining.size()) {
+      std::nth_element(remaining.begin(),
+                       remaining.begin() + numExtra,
+                       remaining.end(),
+                       std::greater<std::pair<float, size_t> >());
+    }
+    for (size_t i = 0; i < numExtra; ++i) ++kept[remaining[i].second];
+    for (size_t t = 0; t < numTiles; ++t) keypoints[t].resize(kept[t]);
+  }
+
+  // orient and describe, the extractor drops keypoints whose pattern leaves the tile region
+  std::vector<cv::Mat> descriptors(numTiles);
+  tilesDone.clear();
+  for (size_t t = 0; t < numTiles; ++t) {
+    tilesDone.push_back(detectionThreadPool_->enqueue([&, t]() {
+      orientKeypoints(*geometry, extractionDirection, keypoints[t]);
+      for (cv::KeyPoint& keypoint : keypoints[t]) {
+        keypoint.pt.x -= regions[t].x;
+        keypoint.pt.y -= regions[t].y;
+      }
+      tileDescriptorExtractors_[cameraIndex][t]->compute(image(regions[t]), keypoints[t], descriptors[t]);
+      for (cv::KeyPoint& keypoint : keypoints[t]) {
+        keypoint.pt.x += regions[t].x;
+        keypoint.pt.y += regions[t].y;
+      }
+    }));
+  }
+  for (std::future<void>& tileDone : tilesDone) tileDone.get();
+
+  std::vector<cv::KeyPoint> allKeypoints;
+  cv::Mat allDescriptors;
+  for (size_t t = 0; t < numTiles; ++t) {
+    allKeypoints.insert(allKeypoints.end(), keypoints[t].begin(), keypoints[t].end());
+    if (!keypoints[t].empty()) allDescriptors.push_back(descriptors[t]);
+  }
+  frameOut->resetKeypoints(cameraIndex, allKeypoints);
+  frameOut->resetDescriptors(cameraIndex, allDescriptors);
+}
+
 // Matching as well as initialization of landmarks and state.
 bool Frontend::dataAssociationAndInitialization(
     okvis::Estimator& estimator,
@@ -242,7 +369,7 @@ bool Frontend::dataAssociationAndInitialization(
 }
 
 // Propagates pose, speeds and biases with given IMU measurements.
-bool Frontend::propagation(const okvis::ImuMeasurementDeque& imuMeasurements,
+bool Frontend::propagation(const okvis::ImuMeasurementSpan& imuMeasurements,
                            const okvis::ImuParameters& imuParams,
                            okvis::kinematics::Transformation& T_WS_propagated,
                            okvis::SpeedAndBias& speedAndBiases,
@@ -359,8 +486,8 @@ int Frontend::matchToKeyframes(okvis::Estimator& estimator,
           estimator, MATCHING_ALGORITHM::Match3D2D, briskMatchingThreshold_, usePoseUncertainty);
       matchingAlgorithm.setFrames(olderFrameId, currentFrameId, im, im);
 
-      // match 3D-2D
-      matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      // match 3D-2D, each landmark against the keypoints around its projection only
+      matcher_->matchInImageSpace<MATCHING_ALGORITHM>(matchingAlgorithm);
       retCtr += matchingAlgorithm.numMatches();
       numUncertainMatches += matchingAlgorithm.numUncertainMatches();
     }
@@ -439,8 +566,8 @@ int Frontend::matchToLastFrame(okvis::Estimator& estimator,
         estimator, MATCHING_ALGORITHM::Match3D2D, briskMatchingThreshold_, usePoseUncertainty);
     matchingAlgorithm.setFrames(lastFrameId, currentFrameId, im, im);
 
-    // match 3D-2D
-    matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+    // match 3D-2D, each landmark against the keypoints around its projection only
+    matcher_->matchInImageSpace<MATCHING_ALGORITHM>(matchingAlgorithm);
     retCtr += matchingAlgorithm.numMatches();
   }
 
@@ -490,17 +617,30 @@ void Frontend::matchStereo(okvis::Estimator& estimator,
           briskMatchingThreshold_,
           false);  // TODO(test): make sure this is changed when switching back to uncertainty based matching
       matchingAlgorithm.setFrames(mfId, mfId, im0, im1);  // newest frame
-
-      // match 2D-2D
-      matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      matchingAlgorithm.setEpipolarBand(stereoMatchingBand_);
+
+      // match 2D-2D, within the epipolar band if there is one
+      if (stereoMatchingBand_ > 0.0) {
+        TimerSwitchable match2D2DTimer("2.4.3.1 matchStereo 2D2D epipolar band");
+        matcher_->matchInImageSpace<MATCHING_ALGORITHM>(matchingAlgorithm);
+        match2D2DTimer.stop();
+        stereoMatchingStatistics_.numCandidates += matchingAlgorithm.numCandidates();
+      } else {
+        TimerSwitchable match2D2DTimer("2.4.3.1 matchStereo 2D2D all pairs");
+        matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+        match2D2DTimer.stop();
+        stereoMatchingStatistics_.numCandidates += matchingAlgorithm.sizeA() * matchingAlgorithm.sizeB();
+      }
+      stereoMatchingStatistics_.numCameraPairs++;
+      stereoMatchingStatistics_.numMatches += matchingAlgorithm.numMatches();
 
       // match 3D-2D
       matchingAlgorithm.setMatchingType(MATCHING_ALGORITHM::Match3D2D);
-      matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      matcher_->matchInImageSpace<MATCHING_ALGORITHM>(matchingAlgorithm);
 
       // match 2D-3D
       matchingAlgorithm.setFrames(mfId, mfId, im1, im0);  // newest frame
-      matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      matcher_->matchInImageSpace<MATCHING_ALGORITHM>(matchingAlgorithm);
     }
   }
 
@@ -986,18 +1126,17 @@ void Frontend::initialiseBriskFeatureDetectors() {
   }
   featureDetectors_.clear();
   descriptorExtractors_.clear();
+  tileFeatureDetectors_.assign(numCameras_, std::vector<std::shared_ptr<cv::FeatureDetector> >());
+  tileDescriptorExtractors_.assign(numCameras_, std::vector<std::shared_ptr<cv::DescriptorExtractor> >());
+  const size_t numTiles = detectionTilesX_ * detectionTilesY_ > 1 ? detectionTilesX_ * detectionTilesY_ : 0;
+  if (numTiles > 0 && !detectionThreadPool_) {
+    detectionThreadPool_.reset(new okvis::ThreadPool(detectionThreads_ > 0 ? detectionThreads_ : numTiles));
+  } else if (numTiles == 0) {
+    detectionThreadPool_.reset();
+  }
   for (size_t i = 0; i < numCameras_; ++i) {
-    featureDetectors_.push_back(std::shared_ptr<cv::FeatureDetector>(
-#ifdef __ARM_NEON__
-        new cv::GridAdaptedFeatureDetector(new cv::FastFeatureDetector(briskDetectionThreshold_),
-                                           briskDetectionMaximumKeypoints_,
-                                           7,
-                                           4)));  // from config file, except the 7x4...
-#else
-        new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(briskDetectionThreshold_,
-                                                                           briskDetectionOctaves_,
-                                                                           briskDetectionAbsoluteThreshold_,
-                                                                           briskDetectionMaximumKeypoints_)));
+    featureDetectors_.push_back(createBriskFeatureDetector());
+#ifndef __ARM_NEON__
     std::cout << "briskDetectionThreshold_: " << briskDetectionThreshold_ << std::endl;
     std::cout << "briskDetectionOctaves_: " << briskDetectionOctaves_ << std::endl;
     std::cout << "briskDetectionAbsoluteThreshold_: " << briskDetectionAbsoluteThreshold_ << std::endl;
@@ -1005,10 +1144,49 @@ void Frontend::initialiseBriskFeatureDetectors() {
 #endif
     descriptorExtractors_.push_back(std::shared_ptr<cv::DescriptorExtractor>(
         new brisk::BriskDescriptorExtractor(briskDescriptionRotationInvariance_, briskDescriptionScaleInvariance_)));
+    // the tiles detect up to the whole budget each, detectAndDescribeTiled() shares it out
+    for (size_t t = 0; t < numTiles; ++t) {
+      tileFeatureDetectors_[i].push_back(createBriskFeatureDetector());
+      tileDescriptorExtractors_[i].push_back(std::shared_ptr<cv::DescriptorExtractor>(
+          new brisk::BriskDescriptorExtractor(briskDescriptionRotationInvariance_, briskDescriptionScaleInvariance_)));
+    }
   }
   for (auto it = featureDetectorMutexes_.begin(); it != featureDetectorMutexes_.end(); ++it) {
     (*it)->unlock();
   }
 }
 
+// Creates a feature detector with the current settings.
+std::shared_ptr<cv::FeatureDetector> Frontend::createBriskFeatureDetector() const {
+  return std::shared_ptr<cv::FeatureDetector>(
+#ifdef __ARM_NEON__
+      new cv::GridAdaptedFeatureDetector(new cv::FastFeatureDetector(briskDetectionThreshold_),
+                                         briskDetectionMaximumKeypoints_,
+                                         7,
+                                         4));  // from config file, except the 7x4...
+#else
+      new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(briskDetectionThreshold_,
+                                                                         briskDetectionOctaves_,
+                                                                         briskDetectionAbsoluteThreshold_,
+                                                                         briskDetectionMaximumKeypoints_));
+#endif
+}
+
+// Sets up tiled detection, or turns it off with a single tile.
+void Frontend::setDetectionTiles(size_t tilesX, size_t tilesY, size_t overlap, size_t numThreads) {
+  OKVIS_ASSERT_TRUE(Exception, tilesX > 0 && tilesY > 0, "At least one detection tile needed.");
+  for (auto it = featureDetectorMutexes_.begin(); it != featureDetectorMutexes_.end(); ++it) {
+    (*it)->lock();
+  }
+  detectionTilesX_ = tilesX;
+  detectionTilesY_ = tilesY;
+  detectionTileOverlap_ = overlap;
+  detectionThreads_ = numThreads;
+  detectionThreadPool_.reset();  // re-created with the new size by initialiseBriskFeatureDetectors()
+  for (auto it = featureDetectorMutexes_.begin(); it != featureDetectorMutexes_.end(); ++it) {
+    (*it)->unlock();
+  }
+  initialiseBriskFeatureDetectors();
+}
+
 }  // namespace okvis
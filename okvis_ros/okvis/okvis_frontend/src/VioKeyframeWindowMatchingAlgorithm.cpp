@@ -263,6 +263,42 @@ void VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::doSetup() {
     }
   }
 
+  // Bucket the keypoints of B. Then list for each landmark the keypoints inside the bounding box of the largest
+  // uncertainty ellipse verifyMatch() can accept, so that matchInImageSpace() compares against those only.
+  if (matchingType_ == Match3D2D) {
+    keypointGridB_.reset(frameB_->geometryAs<CAMERA_GEOMETRY_T>(camIdB_)->imageWidth(),
+                         frameB_->geometryAs<CAMERA_GEOMETRY_T>(camIdB_)->imageHeight());
+    double maxKeypointBStdDev = 0.0;
+    Eigen::Vector2d keypointB;
+    for (size_t k = 0; k < numB; ++k) {
+      if (skipB_[k]) continue;
+      frameB_->getKeypoint(camIdB_, k, keypointB);
+      keypointGridB_.add(k, keypointB[0], keypointB[1]);
+      double keypointBStdDev;
+      frameB_->getKeypointSize(camIdB_, k, keypointBStdDev);
+      maxKeypointBStdDev = std::max(maxKeypointBStdDev, 0.8 * keypointBStdDev / 12.0);
+    }
+    keypointGridB_.finalize();
+
+    const double maxChi2 = 5.0;  // verifyMatch() truncates chi2 to int before comparing it with 4
+    candidatesB_.clear();
+    std::vector<size_t> indicesB;
+    for (size_t k = 0; k < numA; ++k) {
+      if (skipA_[k]) continue;
+      const Eigen::Matrix2d U = Eigen::Matrix2d::Identity() * maxKeypointBStdDev * maxKeypointBStdDev +
+                                projectionsIntoBUncertainties_.block<2, 2>(2 * k, 0);
+      indicesB.clear();
+      keypointGridB_.queryBox(projectionsIntoB_(k, 0),
+                              projectionsIntoB_(k, 1),
+                              sqrt(maxChi2 * U(0, 0)),
+                              sqrt(maxChi2 * U(1, 1)),
+                              indicesB);
+      for (size_t indexB : indicesB) candidatesB_.add(k, indexB);
+    }
+  } else if (epipolarBand_ > 0.0) {
+    setupEpipolarCandidates();
+  }
+
   //*********** Added by Sharmin for Stereo Contour Matching *****************//
   // FIXME Sharmin
   /*if (useSCM_){
@@ -323,6 +359,38 @@ size_t VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::scm_sizeB() const
   return frameB_->contour_numKeypoints(camIdB_);
 }*/
 
+// List for each keypoint of A the keypoints of B inside its epipolar band: the epipolar curve of the keypoint, widened
+// by the band and the uncertainties of both keypoints.
+template <class CAMERA_GEOMETRY_T>
+void VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::setupEpipolarCandidates() {
+  OKVIS_ASSERT_TRUE(Exception, mfIdA_ == mfIdB_, "the epipolar band is for the cameras of one multiframe");
+  const size_t numA = frameA_->numKeypoints(camIdA_);
+  const size_t numB = frameB_->numKeypoints(camIdB_);
+  candidatesB_.clear();
+
+  Eigen::Vector2d keypoint;
+  Eigen::Vector3d ray;
+  epipolarBandIndexB_.reset(T_CaCb_.C(), T_CaCb_.r());
+  for (size_t k = 0; k < numB; ++k) {
+    if (skipB_[k]) continue;
+    frameB_->getKeypoint(camIdB_, k, keypoint);
+    if (!frameB_->geometryAs<CAMERA_GEOMETRY_T>(camIdB_)->backProject(keypoint, &ray)) continue;
+    epipolarBandIndexB_.add(k, ray, raySigmasB_[k]);
+  }
+  epipolarBandIndexB_.finalize();
+
+  std::vector<size_t> indicesB;
+  for (size_t k = 0; k < numA; ++k) {
+    if (skipA_[k]) continue;
+    frameA_->getKeypoint(camIdA_, k, keypoint);
+    if (!frameA_->geometryAs<CAMERA_GEOMETRY_T>(camIdA_)->backProject(keypoint, &ray)) continue;
+    indicesB.clear();
+    epipolarBandIndexB_.queryBand(ray, epipolarBand_ / fA_ + 3.0 * raySigmasA_[k], indicesB);
+    std::sort(indicesB.begin(), indicesB.end());
+    for (size_t indexB : indicesB) candidatesB_.add(k, indexB);
+  }
+}
+
 // What is the size of list A?
 template <class CAMERA_GEOMETRY_T>
 size_t VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::sizeA() const {
@@ -334,6 +402,26 @@ size_t VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::sizeB() const {
   return frameB_->numKeypoints(camIdB_);
 }
 
+// Begin of the keypoints of B that landmark indexA of A can match.
+template <class CAMERA_GEOMETRY_T>
+MatchingAlgorithm::listB_candidates_t::const_iterator
+VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::getListBStartIterator(size_t indexA) {
+  OKVIS_ASSERT_TRUE(Exception,
+                    matchingType_ == Match3D2D || epipolarBand_ > 0.0,
+                    "image space matching needs 3D-2D or an epipolar band");
+  return candidatesB_.begin(indexA);
+}
+
+// End of the keypoints of B that landmark indexA of A can match.
+template <class CAMERA_GEOMETRY_T>
+MatchingAlgorithm::listB_candidates_t::const_iterator
+VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::getListBEndIterator(size_t indexA) {
+  OKVIS_ASSERT_TRUE(Exception,
+                    matchingType_ == Match3D2D || epipolarBand_ > 0.0,
+                    "image space matching needs 3D-2D or an epipolar band");
+  return candidatesB_.end(indexA);
+}
+
 // Set the distance threshold for which matches exceeding it will not be returned as matches.
 template <class CAMERA_GEOMETRY_T>
 void VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::setDistanceThreshold(float distanceThreshold) {
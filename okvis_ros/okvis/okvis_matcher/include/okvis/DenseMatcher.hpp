@@ -44,7 +44,6 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
-#include <mutex>
 #include <okvis/MatchingAlgorithm.hpp>
 #include <okvis/assert_macros.hpp>
 #include <vector>
@@ -120,21 +119,16 @@ class DenseMatcher {
     typedef DenseMatcher::pairing_t pairing_t;
     typedef std::vector<pairing_t> pairing_list_t;
 
-    /// The list of best matches so far.
-    std::vector<std::vector<pairing_t> >* vMyBest;
+    /// The numBest_ best matches of each keypoint in A, one after the other. Their indexA is the index in B.
+    pairing_list_t* vMyBest;
 
     /// The thread ID of this job.
     int iThreadID;
-
-    /// The list of pairs for this thread.
-    DenseMatcher::pairing_list_t* vpairs;
-
-    /// Mutexes for read/write synchronization in assignment of best match.
-    std::mutex* mutexes;
   };
 
   /**
    * @brief This function creates all the matching threads and assigns the best matches afterwards.
+   * @warning Reuses buffers of the matcher: do not run two matchings with the same matcher at the same time.
    * @tparam MATCHING_ALGORITHM_T The algorithm to use. E.g. a class derived from MatchingAlgorithm
    * @param doWorkPtr The function that the threads are going to run.
    * @param matchingAlgorithm The matching algorithm.
@@ -171,18 +165,30 @@ class DenseMatcher {
   void doWorkImageSpaceMatching(MatchJob& my_job, MATCHING_ALGORITHM_T* matchingAlgorithm);  // NOLINT
 
   /**
-   * @brief A recursive function that reassigns weak matches, if a stronger match is found for a particular point
-   * @param[in] myIndexScored The keypoint index that was scored with other keypoints.
-   * @param[inout] vPairsWithScore The distances to other keypoints that a single thread calculated.
-   * @param[inout] aiBestList The best matches so far.
-   * @param locks The mutexes.
-   * @param startidx Start the assigning at some index. Used for the recursion. Set to 0.
+   * @brief Assigns each keypoint in B to at most one in A, from the best matches of each keypoint in A.
+   *
+   * Each keypoint in A proposes to its best match first. Each keypoint in B keeps the best proposal it got. The
+   * rejected ones propose to their next best match in the next round. The proposals of a round are collected per
+   * thread and resolved per keypoint in B by the thread owning it, so no locks are needed. Ties go to the lower
+   * index in A, which makes the result independent of the threads.
+   * @param sizeA Number of keypoints in A.
+   * @param sizeB Number of keypoints in B.
+   */
+  void assignBest(size_t sizeA, size_t sizeB);
+
+  /**
+   * @brief One thread's share of the proposals of a round.
+   * @param threadIndex Index of this thread.
+   * @param numThreads  Number of threads running the round.
    */
-  void assignbest(int myIndexScored,
-                  pairing_list_t& vPairsWithScore,                   // NOLINT
-                  std::vector<std::vector<pairing_t> >& aiBestList,  // NOLINT
-                  std::mutex* locks,
-                  int startidx);
+  void propose(size_t threadIndex, size_t numThreads);
+
+  /**
+   * @brief Resolves the proposals of a round for the keypoints in B owned by one thread.
+   * @param threadIndex Index of this thread.
+   * @param numThreads  Number of threads running the round.
+   */
+  void resolve(size_t threadIndex, size_t numThreads);
 
   /**
    * @brief This calculates the distance between to keypoint descriptors. If it is better than the /e numBest_
@@ -195,7 +201,7 @@ class DenseMatcher {
    */
   template <typename MATCHING_ALGORITHM_T>
   inline void listBIteration(MATCHING_ALGORITHM_T* matchingAlgorithm,
-                             std::vector<pairing_t>& aiBest,  // NOLINT
+                             pairing_t* aiBest,
                              size_t shortindexA,
                              size_t i);
 
@@ -204,6 +210,18 @@ class DenseMatcher {
   bool useDistanceRatioThreshold_;   ///< Use ratio of best and second best match instead of absolute threshold.
 
   std::unique_ptr<okvis::ThreadPool> matcherThreadPool_;  ///< The threads
+
+  /// \name Buffers of matchBody(), reused across calls
+  /// \{
+  pairing_list_t bestLists_;                        ///< The numBest_ best matches of each keypoint in A.
+  pairing_list_t pairs_;                            ///< The keypoint in A each keypoint in B is assigned to.
+  std::vector<unsigned char> nextCandidates_;       ///< Position in bestLists_ each keypoint in A proposes to next.
+  std::vector<int> proposingA_;                     ///< The keypoints in A proposing in the current round.
+  std::vector<int> nextProposingA_;                 ///< The keypoints in A proposing in the next round.
+  std::vector<pairing_list_t> threadProposals_;     ///< The best proposal to each keypoint in B, per thread.
+  std::vector<std::vector<int> > threadProposedB_;  ///< The keypoints in B with a proposal, per thread.
+  std::vector<std::vector<int> > threadRejectedA_;  ///< The keypoints in A that lost their match, per thread.
+  /// \}
 };
 
 }  // namespace okvis
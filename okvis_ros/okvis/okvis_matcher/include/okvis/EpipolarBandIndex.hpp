@@ -0,0 +1,129 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file EpipolarBandIndex.hpp
+ * @brief Header file for the EpipolarBandIndex class.
+ */
+
+#ifndef INCLUDE_OKVIS_EPIPOLARBANDINDEX_HPP_
+#define INCLUDE_OKVIS_EPIPOLARBANDINDEX_HPP_
+
+#include <Eigen/Core>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Sorts the keypoint rays of camera B of a stereo pair by their epipolar plane, to find the keypoints of B
+ *        near the epipolar curve of a keypoint of camera A without going through all of them.
+ *
+ * The ray of a keypoint of A and the baseline span a plane that also holds the ray of its match in B. These planes
+ * are told apart by their angle about the baseline, the same in both cameras whatever the camera model: this is the
+ * row of rectified stereo, without resampling the images.
+ * Usage: reset(), add() every keypoint of B, finalize(), then queryBand() as often as needed. queryBand() is const
+ * and can be called from several threads.
+ */
+class EpipolarBandIndex {
+ public:
+  /// \brief Rays closer to the baseline than this sine (~6 degrees) have no meaningful epipolar angle.
+  static constexpr double kMinSinBaseline = 0.1;
+
+  /// \brief Start a new camera pair, forgetting all keypoints. Keeps the memory.
+  /// @param C_AB Rotation from camera B to camera A.
+  /// @param t_AB Position of camera B in camera A, i.e. the baseline. Must not be zero.
+  void reset(const Eigen::Matrix3d& C_AB, const Eigen::Vector3d& t_AB);
+
+  /// \brief Add a keypoint of B. Keypoints next to the epipole are returned by every query.
+  /// @param index Index of the keypoint, returned by queryBand().
+  /// @param ray_B Back-projected keypoint in camera B, need not be normalised.
+  /// @param sigma Standard deviation of the ray direction. [rad]
+  void add(size_t index, const Eigen::Vector3d& ray_B, double sigma);
+
+  /// \brief Sort the keypoints added since reset() by epipolar angle, in classes of similar band width.
+  void finalize();
+
+  /**
+   * @brief Find the keypoints of B whose epipolar plane is within halfWidth, plus three standard deviations of their
+   *        own ray, of the epipolar plane of a ray of A.
+   * @param ray_A     Back-projected keypoint in camera A, need not be normalised.
+   * @param halfWidth Distance of the ray of B from the epipolar plane, e.g. the band in pixels over the focal length
+   *                  plus the uncertainty of the ray of A. [rad]
+   * @param[out] indices The indices of the keypoints found are appended here, in no particular order.
+   * @return The number of keypoints found.
+   */
+  size_t queryBand(const Eigen::Vector3d& ray_A, double halfWidth, std::vector<size_t>& indices) const;  // NOLINT
+
+  /// \brief Number of keypoints added since reset().
+  size_t size() const { return keypoints_.size() + anyAngle_.size(); }
+
+  /// \brief Angle of the epipolar plane of a ray about the baseline, and the sine of the ray to the baseline.
+  /// @param ray_A Ray in camera A, need not be normalised.
+  /// @param[out] sinBaseline Sine of the angle between the ray and the baseline.
+  /// @return The epipolar angle in [-pi, pi]. [rad]
+  double epipolarAngle(const Eigen::Vector3d& ray_A, double* sinBaseline) const;
+
+ private:
+  /// \brief A keypoint of B with a meaningful epipolar angle.
+  struct Keypoint {
+    double angle;      ///< Epipolar angle. [rad]
+    size_t index;      ///< Index of the keypoint.
+    double halfWidth;  ///< Three sigma of the ray about the baseline. [rad]
+  };
+
+  /// \brief Keypoints of B whose own half widths are within a factor of two.
+  struct Band {
+    std::vector<std::pair<double, size_t>> angles;  ///< Epipolar angles and indices, sorted.
+    double halfWidth = 0.0;                         ///< Largest half width of the keypoints. [rad]
+  };
+
+  /// \brief Angle of the epipolar plane of a ray rotated into the rectified frame.
+  static double rectifiedAngle(const Eigen::Vector3d& ray_R, double* sinBaseline);
+
+  /// \brief Append the keypoints of a band with an epipolar angle in [minAngle, maxAngle].
+  static size_t addRange(const Band& band,
+                         double minAngle,
+                         double maxAngle,
+                         std::vector<size_t>& indices);  // NOLINT
+
+  Eigen::Matrix3d C_RA_;             ///< Rotation from camera A to the rectified frame.
+  Eigen::Matrix3d C_RB_;             ///< Rotation from camera B to the rectified frame.
+  std::vector<Keypoint> keypoints_;  ///< Added since reset(), spread into bands_ by finalize().
+  std::vector<size_t> anyAngle_;     ///< Keypoints next to the epipole.
+  std::vector<Band> bands_;          ///< By increasing half width, some may be empty.
+  size_t numBands_ = 0;              ///< Bands in use, the others only keep their memory.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_EPIPOLARBANDINDEX_HPP_ */
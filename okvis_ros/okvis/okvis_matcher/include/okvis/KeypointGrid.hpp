@@ -0,0 +1,114 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file KeypointGrid.hpp
+ * @brief Header file for the KeypointGrid class.
+ */
+
+#ifndef INCLUDE_OKVIS_KEYPOINTGRID_HPP_
+#define INCLUDE_OKVIS_KEYPOINTGRID_HPP_
+
+#include <cstddef>
+#include <vector>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Buckets the keypoints of an image into square cells, to find the keypoints inside a box without going
+ *        through all of them.
+ *
+ * Usage: reset(), add() every keypoint, finalize(), then queryBox() as often as needed. queryBox() is const and can
+ * be called from several threads.
+ */
+class KeypointGrid {
+ public:
+  /**
+   * @brief Constructor.
+   * @param cellSize Side length of the cells. [pixels]
+   */
+  explicit KeypointGrid(double cellSize = 16.0);
+
+  /// \brief Start a new image, forgetting all keypoints. Keeps the memory.
+  /// @param imageWidth  Image width. [pixels]
+  /// @param imageHeight Image height. [pixels]
+  void reset(double imageWidth, double imageHeight);
+
+  /// \brief Add a keypoint. Keypoints outside the image go to the border cells.
+  /// @param index Index of the keypoint, returned by queryBox().
+  /// @param u     Horizontal keypoint coordinate. [pixels]
+  /// @param v     Vertical keypoint coordinate. [pixels]
+  void add(size_t index, double u, double v);
+
+  /// \brief Sort the keypoints added since reset() into their cells.
+  void finalize();
+
+  /**
+   * @brief Find the keypoints inside the box [u - halfWidth, u + halfWidth] x [v - halfHeight, v + halfHeight].
+   * @param u          Horizontal box center. [pixels]
+   * @param v          Vertical box center. [pixels]
+   * @param halfWidth  Half the box width. [pixels]
+   * @param halfHeight Half the box height. [pixels]
+   * @param[out] indices The indices of the keypoints found are appended here, sorted by cell.
+   * @return The number of keypoints found.
+   */
+  size_t queryBox(double u,
+                  double v,
+                  double halfWidth,
+                  double halfHeight,
+                  std::vector<size_t>& indices) const;  // NOLINT
+
+  /// \brief Number of keypoints sorted by finalize().
+  size_t size() const { return keypoints_.size(); }
+
+ private:
+  /// \brief A keypoint with its cell.
+  struct Keypoint {
+    size_t index;  ///< The index given to add().
+    double u;      ///< Horizontal keypoint coordinate. [pixels]
+    double v;      ///< Vertical keypoint coordinate. [pixels]
+    size_t cell;   ///< Row major cell index.
+  };
+
+  /// \brief Cell column or row of a coordinate, clamped to the grid.
+  int cellCoordinate(double coordinate, int numCells) const;
+
+  double cellSize_;                  ///< Side length of the cells. [pixels]
+  int numColumns_ = 0;               ///< Number of cell columns.
+  int numRows_ = 0;                  ///< Number of cell rows.
+  std::vector<Keypoint> added_;      ///< Keypoints added since reset(), in order.
+  std::vector<Keypoint> keypoints_;  ///< Keypoints sorted by cell.
+  std::vector<size_t> cellStarts_;   ///< Start of each cell in keypoints_, and the end of the last one.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_KEYPOINTGRID_HPP_ */
@@ -43,7 +43,6 @@
 
 #include <cstddef>
 #include <limits>
-#include <map>
 #include <memory>
 #include <okvis/assert_macros.hpp>
 #include <vector>
@@ -79,19 +78,51 @@ class MatchingAlgorithm {
   /// \brief What is the size of list B?
   virtual size_t sizeB() const = 0;
 
-  /// \brief Tree data structure for image space restricted matching
-  /// mapping from image row to list of features (indices!)
-  typedef std::multimap<size_t, size_t> listB_tree_structure_t;
+  /**
+   * @brief For image space restricted matching: the elements of list B (indices!) to match against each element of
+   *        list A, in one flat array. The candidates of indexA are indices_[offsets_[indexA], offsets_[indexA + 1]),
+   *        so there is no allocation per pair, and clear() keeps the memory for the next frame.
+   */
+  class ListBCandidates {
+   public:
+    typedef std::vector<size_t>::const_iterator const_iterator;
+
+    /// \brief Forget all candidates, keeps the memory.
+    void clear() {
+      offsets_.clear();
+      indices_.clear();
+    }
+    /// \brief Append a candidate of list B for indexA. Must be called with increasing indexA.
+    void add(size_t indexA, size_t indexB) {
+      while (offsets_.size() <= indexA) offsets_.push_back(indices_.size());
+      indices_.push_back(indexB);
+    }
+    /// \brief Number of candidate pairs.
+    size_t size() const { return indices_.size(); }
+    /// \brief Start of the candidates of indexA.
+    const_iterator begin(size_t indexA) const {
+      return indexA < offsets_.size() ? indices_.begin() + offsets_[indexA] : indices_.end();
+    }
+    /// \brief End of the candidates of indexA.
+    const_iterator end(size_t indexA) const {
+      return indexA + 1 < offsets_.size() ? indices_.begin() + offsets_[indexA + 1] : indices_.end();
+    }
+
+   private:
+    std::vector<size_t> offsets_;  ///< Start of the candidates of each indexA added so far.
+    std::vector<size_t> indices_;  ///< Candidates of list B, by indexA.
+  };
+  typedef ListBCandidates listB_candidates_t;
 
   /// \brief Get begin iterator for elements of listB to be matched against the given element from list A (indexA)
-  /// for a given index of listA, get an iterator into the listB multimap to the start of all elements in listB
-  /// that should be matched against indexA
+  /// for a given index of listA, get an iterator to the start of all elements in listB that should be matched against
+  /// indexA
   /// note: implement this in your matching algorithm subclass
-  virtual listB_tree_structure_t::iterator getListBStartIterator(size_t indexA);
+  virtual listB_candidates_t::const_iterator getListBStartIterator(size_t indexA);
   /// \brief Get end  iterator for elements of listB to be matched against the given element from list A (indexA)
-  /// for a given index of listA, get an iterator into the listB multimap to the end of all elements in listB
-  /// that should be matched against indexA
-  virtual listB_tree_structure_t::iterator getListBEndIterator(size_t indexA);
+  /// for a given index of listA, get an iterator to the end of all elements in listB that should be matched against
+  /// indexA
+  virtual listB_candidates_t::const_iterator getListBEndIterator(size_t indexA);
 
   /// \brief Distances above this threshold will not be returned as matches.
   virtual float distanceThreshold() const { return std::numeric_limits<float>::max(); }
@@ -120,7 +151,7 @@ class MatchingAlgorithm {
   float matchFailed() const { return std::numeric_limits<float>::max(); }
 
  private:
-  listB_tree_structure_t dummy_;
+  listB_candidates_t dummy_;
 };
 
 }  // namespace okvis
@@ -38,6 +38,7 @@
  * @author Stefan Leutenegger
  */
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <vector>
@@ -51,58 +52,32 @@ template <typename MATCHING_ALGORITHM_T>
 void DenseMatcher::matchBody(void (DenseMatcher::*doWorkPtr)(MatchJob&, MATCHING_ALGORITHM_T*),
                              MATCHING_ALGORITHM_T& matchingAlgorithm,
                              bool useSCM) {
-  // std::cout<< "In matchBody(...)"<<std::endl;
-  // create lock list
-  std::mutex* locks = new std::mutex[matchingAlgorithm.sizeB()];
-
-  // the pairing list
-  pairing_list_t vpairs;
-  // a list with best matches for each "A" point
-  std::vector<std::vector<pairing_t> > vMyBest;
-
-  vMyBest.resize(matchingAlgorithm.sizeA());
-
-  // this point is not paired so far, score max
-  vpairs.resize(matchingAlgorithm.sizeB(), pairing_t(-1, std::numeric_limits<distance_t>::max()));
-
-  // prepare the jobs for the threads
-  std::vector<MatchJob> jobs(numMatcherThreads_);
+  // the best matches of each "A" point, every thread only writes the lists of its own points
+  bestLists_.resize(matchingAlgorithm.sizeA() * numBest_);
   for (int i = 0; i < numMatcherThreads_; ++i) {
-    jobs[i].iThreadID = i;
-    jobs[i].vpairs = &vpairs;
-    jobs[i].vMyBest = &vMyBest;
-    jobs[i].mutexes = locks;
+    MatchJob job;
+    job.iThreadID = i;
+    job.vMyBest = &bestLists_;
+    matcherThreadPool_->enqueue(doWorkPtr, this, job, &matchingAlgorithm);
   }
-
-  // create all threads
-  //  boost::thread_group matchers;
-  for (int i = 0; i < numMatcherThreads_; ++i) {
-    matcherThreadPool_->enqueue(doWorkPtr, this, jobs[i], &matchingAlgorithm);
-    //    matchers.create_thread(boost::bind(doWorkPtr, this, jobs[i], &matchingAlgorithm));
-  }
-
-  //  matchers.join_all();
   matcherThreadPool_->waitForEmptyQueue();
 
-  // Looks like running this in one thread is faster than creating 30+ new threads for every image.
-  // TODO(gohlp): distribute this to n threads.
-
-  //  for (int i = 0; i < _numMatcherThreads; ++i)
-  //  {
-  //  (this->*doWorkPtr)(jobs[i], &matchingAlgorithm);
-  //  }
+  // pair each "B" point with at most one "A" point
+  assignBest(matchingAlgorithm.sizeA(), matchingAlgorithm.sizeB());
 
-  matchingAlgorithm.reserveMatches(vpairs.size());
+  // setBestMatch() modifies the matching algorithm, so the matches are handed over from this thread only
+  matchingAlgorithm.reserveMatches(pairs_.size());
 
   // assemble the pairs and return
+  const pairing_list_t& vpairs = pairs_;
   const distance_t& const_distratiothres = matchingAlgorithm.distanceRatioThreshold();
   const distance_t& const_distthres = matchingAlgorithm.distanceThreshold();
   for (size_t i = 0; i < vpairs.size(); ++i) {
     if (useDistanceRatioThreshold_ && vpairs[i].distance < const_distthres) {
-      const std::vector<pairing_t>& best_matches_list = vMyBest[vpairs[i].indexA];
+      const pairing_t* best_matches_list = &bestLists_[vpairs[i].indexA * numBest_];
       OKVIS_ASSERT_TRUE_DBG(Exception, best_matches_list[0].indexA != -1, "assertion failed");
 
-      if (best_matches_list[1].indexA != -1) {
+      if (numBest_ > 1 && best_matches_list[1].indexA != -1) {
         const distance_t& best_match_distance = best_matches_list[0].distance;
         const distance_t& second_best_match_distance = best_matches_list[1].distance;
         // Only assign if the distance ratio better than the threshold.
@@ -186,8 +161,6 @@ void DenseMatcher::matchBody(void (DenseMatcher::*doWorkPtr)(MatchJob&, MATCHING
  delete[] scm_locks;
  */
   // ********* End Adedd by Sharmin for scm ***//
-
-  delete[] locks;
 }
 
 // Execute a matching algorithm. This is the fast, templated version. Use this.
@@ -214,7 +187,7 @@ void DenseMatcher::matchInImageSpace(MATCHING_ALGORITHM_T& matchingAlgorithm) {
 // found so far, it is included in the aiBest list.
 template <typename MATCHING_ALGORITHM_T>
 inline void DenseMatcher::listBIteration(MATCHING_ALGORITHM_T* matchingAlgorithm,
-                                         std::vector<pairing_t>& aiBest,
+                                         pairing_t* aiBest,
                                          size_t shortindexA,
                                          size_t i) {
   OKVIS_ASSERT_TRUE(std::runtime_error, matchingAlgorithm != NULL, "matching algorithm is NULL");
@@ -224,10 +197,9 @@ inline void DenseMatcher::listBIteration(MATCHING_ALGORITHM_T* matchingAlgorithm
   tmpdist = matchingAlgorithm->distance(shortindexA, i);
   if (tmpdist < aiBest[numBest_ - 1].distance) {
     pairing_t tmp(static_cast<int>(i), tmpdist);
-    typename std::vector<pairing_t>::iterator lb =
-        std::lower_bound(aiBest.begin(), aiBest.end(), tmp);  // get position for insertion
-    typename std::vector<pairing_t>::iterator it, it_next;
-    it = it_next = aiBest.end();
+    pairing_t* lb = std::lower_bound(aiBest, aiBest + numBest_, tmp);  // get position for insertion
+    pairing_t *it, *it_next;
+    it = it_next = aiBest + numBest_;
 
     --it;
     --it_next;
@@ -309,15 +281,13 @@ void DenseMatcher::doWorkLinearMatching(MatchJob& my_job, MATCHING_ALGORITHM_T*
 
     size_t sizeA = matchingAlgorithm->sizeA();
     for (size_t shortindexA = start; shortindexA < sizeA; shortindexA += numMatcherThreads_) {
-      if (matchingAlgorithm->skipA(shortindexA)) continue;
-
-      // typename DenseMatcher::distance_t tmpdist;
-      std::vector<pairing_t>& aiBest = (*my_job.vMyBest)[shortindexA];
+      pairing_t* aiBest = &(*my_job.vMyBest)[shortindexA * numBest_];
 
       // initialize the best match to be -1 (no match) and set the score to be the distance threshold
       // No matches worse than the distance threshold will get through.
-      aiBest.resize(numBest_, pairing_t(-1, const_distthres));  // the best x matches for this feature from the long
-                                                                // list
+      std::fill(aiBest, aiBest + numBest_, pairing_t(-1, const_distthres));  // the best x matches for this feature
+                                                                             // from the long list
+      if (matchingAlgorithm->skipA(shortindexA)) continue;
 
       size_t numElementsInListB = matchingAlgorithm->sizeB();
       for (size_t i = 0; i < numElementsInListB; ++i) {
@@ -327,11 +297,6 @@ void DenseMatcher::doWorkLinearMatching(MatchJob& my_job, MATCHING_ALGORITHM_T*
 
         listBIteration(matchingAlgorithm, aiBest, shortindexA, i);
       }
-      assignbest(static_cast<int>(shortindexA),
-                 *(my_job.vpairs),
-                 *(my_job.vMyBest),
-                 my_job.mutexes,
-                 0);  // this call assigns the match and reassigns losing matches recursively
     }
   } catch (const std::exception& e) {
     // \todo Install an error handler in the matching algorithm?
@@ -346,12 +311,8 @@ template <typename MATCHING_ALGORITHM_T>
 void DenseMatcher::doWorkImageSpaceMatching(MatchJob& my_job, MATCHING_ALGORITHM_T* matchingAlgorithm) {
   OKVIS_ASSERT_TRUE(std::runtime_error, matchingAlgorithm != NULL, "matching algorithm is NULL");
   try {
-    std::cout << "Matching in doWorkImageSpaceMatching" << std::endl;
     int start = my_job.iThreadID;
 
-    size_t numElementsInListB = matchingAlgorithm->sizeB();
-    size_t numElementsInListA = matchingAlgorithm->sizeA();
-
     distance_t const_distthres = matchingAlgorithm->distanceThreshold();
     if (useDistanceRatioThreshold_) {
       // When using the distance ratio threshold, we want to build a list of good matches
@@ -360,23 +321,21 @@ void DenseMatcher::doWorkImageSpaceMatching(MatchJob& my_job, MATCHING_ALGORITHM
     }
 
     for (size_t shortindexA = start; shortindexA < matchingAlgorithm->sizeA(); shortindexA += numMatcherThreads_) {
-      if (matchingAlgorithm->skipA(shortindexA)) continue;
-
-      typename DenseMatcher::distance_t tmpdist;
-      std::vector<pairing_t>& aiBest = (*my_job.vMyBest)[shortindexA];
+      pairing_t* aiBest = &(*my_job.vMyBest)[shortindexA * numBest_];
 
       // initialize the best match to be -1 (no match) and set the score to be the distance threshold
       // No matches worse than the distance threshold will get through.
-      aiBest.resize(numBest_, pairing_t(-1, const_distthres));  // the best x matches for this feature from the long
-                                                                // list
+      std::fill(aiBest, aiBest + numBest_, pairing_t(-1, const_distthres));  // the best x matches for this feature
+                                                                             // from the long list
+      if (matchingAlgorithm->skipA(shortindexA)) continue;
 
-      typename MATCHING_ALGORITHM_T::listB_tree_structure_t::iterator itBegin =
+      typename MATCHING_ALGORITHM_T::listB_candidates_t::const_iterator itBegin =
           matchingAlgorithm->getListBStartIterator(shortindexA);
-      typename MATCHING_ALGORITHM_T::listB_tree_structure_t::iterator itEnd =
+      typename MATCHING_ALGORITHM_T::listB_candidates_t::const_iterator itEnd =
           matchingAlgorithm->getListBEndIterator(shortindexA);
       // check all features from the long list
-      for (typename MATCHING_ALGORITHM_T::listB_tree_structure_t::iterator it = itBegin; it != itEnd; ++it) {
-        size_t i = it->second;
+      for (typename MATCHING_ALGORITHM_T::listB_candidates_t::const_iterator it = itBegin; it != itEnd; ++it) {
+        size_t i = *it;
 
         if (matchingAlgorithm->skipB(i)) {
           continue;
@@ -384,12 +343,6 @@ void DenseMatcher::doWorkImageSpaceMatching(MatchJob& my_job, MATCHING_ALGORITHM
 
         listBIteration(matchingAlgorithm, aiBest, shortindexA, i);
       }
-
-      assignbest(static_cast<int>(shortindexA),
-                 *(my_job.vpairs),
-                 *(my_job.vMyBest),
-                 my_job.mutexes,
-                 0);  // this call assigns the match and reassigns losing matches recursively
     }
   } catch (const std::exception& e) {
     // \todo Install an error handler in the matching algorithm?
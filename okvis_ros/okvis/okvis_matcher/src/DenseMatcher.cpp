@@ -38,12 +38,26 @@
  * @author Stefan Leutenegger
  */
 
+#include <algorithm>
 #include <okvis/DenseMatcher.hpp>
 #include <vector>
 
 /// \brief okvis Main namespace of this package.
 namespace okvis {
 
+namespace {
+// Rounds with fewer proposals are assigned on the calling thread.
+const size_t kMinParallelProposals = 1024;
+
+// Strict order of the proposals to a keypoint: unset ones lose, then the lower distance wins, then the lower index.
+bool isBetter(const DenseMatcher::pairing_t& lhs, const DenseMatcher::pairing_t& rhs) {
+  if (lhs.indexA == -1) return false;
+  if (rhs.indexA == -1) return true;
+  if (lhs.distance != rhs.distance) return lhs.distance < rhs.distance;
+  return lhs.indexA < rhs.indexA;
+}
+}  // namespace
+
 // Initialize the dense matcher.
 DenseMatcher::DenseMatcher(unsigned char numMatcherThreads, unsigned char numBest, bool useDistanceRatioThreshold)
     : numMatcherThreads_(numMatcherThreads), numBest_(numBest), useDistanceRatioThreshold_(useDistanceRatioThreshold) {
@@ -55,43 +69,98 @@ DenseMatcher::~DenseMatcher() { matcherThreadPool_->stop(); }
 // Execute a matching algorithm. This is the slow, runtime polymorphic version. Don't use this.
 void DenseMatcher::matchSlow(MatchingAlgorithm& matchingAlgorithm) { match(matchingAlgorithm); }
 
-// A recursive function that reassigns weak matches, if a stronger match is found for a particular point
-void DenseMatcher::assignbest(int indexToAssignFromListA,
-                              pairing_list_t& vPairsWithScore,
-                              std::vector<std::vector<pairing_t> >& aiBestList,
-                              std::mutex* mutexes,
-                              int startidx) {
-  // the top matches for the current index
-  const std::vector<pairing_t>& aiBest = aiBestList[indexToAssignFromListA];
-  for (int index = startidx; index < numBest_ && aiBest[index].indexA != -1; ++index) {
-    // fetch index to pair with myidx
-    const int pairIndexFromListB = aiBest[index].indexA;
-    // synchronize this
-    mutexes[pairIndexFromListB].lock();
-    if (vPairsWithScore[pairIndexFromListB].indexA == -1) {
-      // if we are not paired yet
-      // pair with me
-      vPairsWithScore[pairIndexFromListB].indexA = indexToAssignFromListA;
-      // set my distance
-      vPairsWithScore[pairIndexFromListB].distance = aiBest[index].distance;
-      mutexes[pairIndexFromListB].unlock();
-      return;
+// One "B" point for each "A" point, by rounds of proposals.
+void DenseMatcher::assignBest(size_t sizeA, size_t sizeB) {
+  pairs_.assign(sizeB, pairing_t());
+  nextCandidates_.assign(sizeA, 0);
+  const size_t maxThreads = std::max<size_t>(numMatcherThreads_, 1);
+  threadProposals_.resize(maxThreads);
+  threadProposedB_.resize(maxThreads);
+  threadRejectedA_.resize(maxThreads);
+  for (size_t t = 0; t < maxThreads; ++t) {
+    threadProposals_[t].resize(sizeB);  // all entries are unset between calls
+  }
+
+  // everybody with a match proposes to the best one first
+  proposingA_.clear();
+  for (size_t a = 0; a < sizeA; ++a) {
+    if (bestLists_[a * numBest_].indexA != -1) proposingA_.push_back(static_cast<int>(a));
+  }
+
+  size_t numThreads = 1;
+  while (!proposingA_.empty()) {
+    // only worth waking up the pool for large rounds, the later ones are usually tiny
+    numThreads = proposingA_.size() >= kMinParallelProposals ? maxThreads : 1;
+    if (numThreads > 1) {
+      for (size_t t = 0; t < numThreads; ++t) matcherThreadPool_->enqueue(&DenseMatcher::propose, this, t, numThreads);
+      matcherThreadPool_->waitForEmptyQueue();
+      for (size_t t = 0; t < numThreads; ++t) matcherThreadPool_->enqueue(&DenseMatcher::resolve, this, t, numThreads);
+      matcherThreadPool_->waitForEmptyQueue();
     } else {
-      // already paired, so check the score of that pairing
-      if (aiBest[index].distance < vPairsWithScore[pairIndexFromListB].distance) {
-        // My distance is better!
-        // save vals of old pairing
-        const int oldPairIndexFromListA = vPairsWithScore[pairIndexFromListB].indexA;
-        // pair with me
-        vPairsWithScore[pairIndexFromListB] = pairing_t(indexToAssignFromListA, aiBest[index].distance);
-        mutexes[pairIndexFromListB].unlock();
-        // now reassign the old paring recursivly
-        // note: skip element at position zero since we just assigned a match with better score,
-        // so we start the reassignment at position 1
-        assignbest(oldPairIndexFromListA, vPairsWithScore, aiBestList, mutexes, 1);
-        return;
-      }  // else test next alternative
-      mutexes[pairIndexFromListB].unlock();
+      propose(0, 1);
+      resolve(0, 1);
+    }
+
+    // rejected proposals and lost matches move on to the next candidate
+    nextProposingA_.clear();
+    auto proposeNext = [this](int indexA) {
+      const unsigned char next = ++nextCandidates_[indexA];
+      if (next < numBest_ && bestLists_[indexA * numBest_ + next].indexA != -1) nextProposingA_.push_back(indexA);
+    };
+    for (int indexA : proposingA_) {
+      const int indexB = bestLists_[indexA * numBest_ + nextCandidates_[indexA]].indexA;
+      if (pairs_[indexB].indexA != indexA) proposeNext(indexA);
+    }
+    for (size_t t = 0; t < numThreads; ++t) {
+      for (int indexA : threadRejectedA_[t]) proposeNext(indexA);
+    }
+    proposingA_.swap(nextProposingA_);
+  }
+
+  // leave the proposal buffers unset for the next call
+  for (size_t t = 0; t < maxThreads; ++t) {
+    for (int indexB : threadProposedB_[t]) threadProposals_[t][indexB] = pairing_t();
+    threadProposedB_[t].clear();
+  }
+}
+
+// Collect the best proposal to each "B" point from every numThreads-th proposing "A" point.
+void DenseMatcher::propose(size_t threadIndex, size_t numThreads) {
+  pairing_list_t& proposals = threadProposals_[threadIndex];
+  std::vector<int>& proposedB = threadProposedB_[threadIndex];
+  for (int indexB : proposedB) proposals[indexB] = pairing_t();
+  proposedB.clear();
+
+  for (size_t i = threadIndex; i < proposingA_.size(); i += numThreads) {
+    const int indexA = proposingA_[i];
+    const pairing_t& candidate = bestLists_[indexA * numBest_ + nextCandidates_[indexA]];
+    pairing_t& proposal = proposals[candidate.indexA];
+    if (proposal.indexA == -1) proposedB.push_back(candidate.indexA);
+    const pairing_t mine(indexA, candidate.distance);
+    if (isBetter(mine, proposal)) proposal = mine;
+  }
+}
+
+// Merge the proposals of all threads to the "B" points with index % numThreads == threadIndex.
+void DenseMatcher::resolve(size_t threadIndex, size_t numThreads) {
+  std::vector<int>& rejectedA = threadRejectedA_[threadIndex];
+  rejectedA.clear();
+  for (size_t u = 0; u < numThreads; ++u) {
+    for (int indexB : threadProposedB_[u]) {
+      if (static_cast<size_t>(indexB) % numThreads != threadIndex) continue;
+      // visit each point once only, from the first thread with a proposal to it
+      bool seen = false;
+      for (size_t v = 0; v < u && !seen; ++v) seen = threadProposals_[v][indexB].indexA != -1;
+      if (seen) continue;
+
+      pairing_t best = pairs_[indexB];
+      for (size_t v = u; v < numThreads; ++v) {
+        if (isBetter(threadProposals_[v][indexB], best)) best = threadProposals_[v][indexB];
+      }
+      if (best.indexA != pairs_[indexB].indexA) {
+        if (pairs_[indexB].indexA != -1) rejectedA.push_back(pairs_[indexB].indexA);
+        pairs_[indexB] = best;
+      }
     }
   }
 }
@@ -0,0 +1,144 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file EpipolarBandIndex.cpp
+ * @brief Source file for the EpipolarBandIndex class.
+ */
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <okvis/EpipolarBandIndex.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+constexpr double EpipolarBandIndex::kMinSinBaseline;
+
+// Start a new camera pair, forgetting all keypoints.
+void EpipolarBandIndex::reset(const Eigen::Matrix3d& C_AB, const Eigen::Vector3d& t_AB) {
+  // rectified frame: x along the baseline, z as close as possible to the optical axis of A
+  const Eigen::Vector3d x = t_AB.normalized();
+  Eigen::Vector3d z = Eigen::Vector3d::UnitZ() - x * x[2];
+  if (z.norm() < kMinSinBaseline) z = Eigen::Vector3d::UnitY() - x * x[1];  // baseline along the optical axis
+  z.normalize();
+  C_RA_.row(0) = x.transpose();
+  C_RA_.row(1) = z.cross(x).transpose();
+  C_RA_.row(2) = z.transpose();
+  C_RB_ = C_RA_ * C_AB;
+  keypoints_.clear();
+  anyAngle_.clear();
+  for (size_t b = 0; b < numBands_; ++b) {
+    bands_[b].angles.clear();
+    bands_[b].halfWidth = 0.0;
+  }
+  numBands_ = 0;
+}
+
+// Add a keypoint of B.
+void EpipolarBandIndex::add(size_t index, const Eigen::Vector3d& ray_B, double sigma) {
+  double sinBaseline;
+  const double angle = rectifiedAngle(C_RB_ * ray_B, &sinBaseline);
+  if (sinBaseline < kMinSinBaseline) {
+    anyAngle_.push_back(index);
+    return;
+  }
+  keypoints_.push_back(Keypoint{angle, index, 3.0 * sigma / sinBaseline});
+}
+
+// Sort the keypoints by epipolar angle. A query widens its band by the half width of the keypoints of B, so they are
+// split into bands whose half widths are within a factor of two, each sorted on its own: the wide keypoints (coarse
+// octaves, rays close to the baseline) no longer widen the search for all others.
+void EpipolarBandIndex::finalize() {
+  if (keypoints_.empty()) return;
+  double minHalfWidth = keypoints_.front().halfWidth;
+  for (const Keypoint& keypoint : keypoints_) minHalfWidth = std::min(minHalfWidth, keypoint.halfWidth);
+  for (const Keypoint& keypoint : keypoints_) {
+    const size_t b = minHalfWidth > 0.0 ? static_cast<size_t>(std::log2(keypoint.halfWidth / minHalfWidth)) : 0;
+    if (b >= numBands_) {
+      if (b >= bands_.size()) bands_.resize(b + 1);
+      numBands_ = b + 1;
+    }
+    bands_[b].angles.emplace_back(keypoint.angle, keypoint.index);
+    bands_[b].halfWidth = std::max(bands_[b].halfWidth, keypoint.halfWidth);
+  }
+  for (size_t b = 0; b < numBands_; ++b) std::sort(bands_[b].angles.begin(), bands_[b].angles.end());
+}
+
+// Find the keypoints of B near the epipolar plane of a ray of A.
+size_t EpipolarBandIndex::queryBand(const Eigen::Vector3d& ray_A,
+                                    double halfWidth,
+                                    std::vector<size_t>& indices) const {
+  double sinBaseline;
+  const double angle = epipolarAngle(ray_A, &sinBaseline);
+  // a distance from the plane is a larger angle about the baseline for rays close to it
+  const double halfBandA = halfWidth / std::max(sinBaseline, kMinSinBaseline);
+  indices.insert(indices.end(), anyAngle_.begin(), anyAngle_.end());
+  size_t found = anyAngle_.size();
+  for (size_t b = 0; b < numBands_; ++b) {
+    const Band& band = bands_[b];
+    const double halfBand = halfBandA + band.halfWidth;
+    if (halfBand >= M_PI) {
+      found += addRange(band, -M_PI, M_PI, indices);
+      continue;
+    }
+    // the angle wraps around at +-pi
+    found += addRange(band, angle - halfBand, angle + halfBand, indices);
+    if (angle - halfBand < -M_PI) found += addRange(band, angle - halfBand + 2.0 * M_PI, M_PI, indices);
+    if (angle + halfBand > M_PI) found += addRange(band, -M_PI, angle + halfBand - 2.0 * M_PI, indices);
+  }
+  return found;
+}
+
+// Angle of the epipolar plane of a ray of A.
+double EpipolarBandIndex::epipolarAngle(const Eigen::Vector3d& ray_A, double* sinBaseline) const {
+  return rectifiedAngle(C_RA_ * ray_A, sinBaseline);
+}
+
+// Angle of the epipolar plane of a ray in the rectified frame, 0 straight ahead.
+double EpipolarBandIndex::rectifiedAngle(const Eigen::Vector3d& ray_R, double* sinBaseline) {
+  const double norm = ray_R.norm();
+  *sinBaseline = norm > 0.0 ? ray_R.tail<2>().norm() / norm : 0.0;
+  return std::atan2(ray_R[1], ray_R[2]);
+}
+
+// Append the keypoints of a band with an epipolar angle in [minAngle, maxAngle].
+size_t EpipolarBandIndex::addRange(const Band& band,
+                                   double minAngle,
+                                   double maxAngle,
+                                   std::vector<size_t>& indices) {
+  auto it = std::lower_bound(band.angles.begin(), band.angles.end(), std::make_pair(minAngle, size_t(0)));
+  size_t found = 0;
+  for (; it != band.angles.end() && it->first <= maxAngle; ++it, ++found) indices.push_back(it->second);
+  return found;
+}
+
+}  // namespace okvis
@@ -0,0 +1,103 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file KeypointGrid.cpp
+ * @brief Source file for the KeypointGrid class.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <okvis/KeypointGrid.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Constructor.
+KeypointGrid::KeypointGrid(double cellSize) : cellSize_(cellSize) {}
+
+// Start a new image, forgetting all keypoints.
+void KeypointGrid::reset(double imageWidth, double imageHeight) {
+  numColumns_ = std::max(1, static_cast<int>(std::ceil(imageWidth / cellSize_)));
+  numRows_ = std::max(1, static_cast<int>(std::ceil(imageHeight / cellSize_)));
+  added_.clear();
+  keypoints_.clear();
+  cellStarts_.assign(numColumns_ * numRows_ + 1, 0);
+}
+
+// Add a keypoint.
+void KeypointGrid::add(size_t index, double u, double v) {
+  const size_t cell = cellCoordinate(v, numRows_) * numColumns_ + cellCoordinate(u, numColumns_);
+  added_.push_back(Keypoint{index, u, v, cell});
+}
+
+// Sort the keypoints added since reset() into their cells: a counting sort, the cells are contiguous afterwards.
+void KeypointGrid::finalize() {
+  std::fill(cellStarts_.begin(), cellStarts_.end(), 0);
+  for (const Keypoint& keypoint : added_) ++cellStarts_[keypoint.cell + 1];
+  for (size_t cell = 1; cell < cellStarts_.size(); ++cell) cellStarts_[cell] += cellStarts_[cell - 1];
+  keypoints_.resize(added_.size());
+  std::vector<size_t> next(cellStarts_.begin(), cellStarts_.end() - 1);
+  for (const Keypoint& keypoint : added_) keypoints_[next[keypoint.cell]++] = keypoint;
+}
+
+// Find the keypoints inside a box.
+size_t KeypointGrid::queryBox(double u,
+                              double v,
+                              double halfWidth,
+                              double halfHeight,
+                              std::vector<size_t>& indices) const {
+  const int column0 = cellCoordinate(u - halfWidth, numColumns_);
+  const int column1 = cellCoordinate(u + halfWidth, numColumns_);
+  const int row0 = cellCoordinate(v - halfHeight, numRows_);
+  const int row1 = cellCoordinate(v + halfHeight, numRows_);
+  size_t found = 0;
+  for (int row = row0; row <= row1; ++row) {
+    // the cells of one row are contiguous
+    const size_t begin = cellStarts_[row * numColumns_ + column0];
+    const size_t end = cellStarts_[row * numColumns_ + column1 + 1];
+    for (size_t k = begin; k < end; ++k) {
+      const Keypoint& keypoint = keypoints_[k];
+      if (std::fabs(keypoint.u - u) <= halfWidth && std::fabs(keypoint.v - v) <= halfHeight) {
+        indices.push_back(keypoint.index);
+        ++found;
+      }
+    }
+  }
+  return found;
+}
+
+// Cell column or row of a coordinate, clamped to the grid.
+int KeypointGrid::cellCoordinate(double coordinate, int numCells) const {
+  const double cell = std::floor(coordinate / cellSize_);
+  return static_cast<int>(std::max(0.0, std::min(cell, static_cast<double>(numCells - 1))));
+}
+
+}  // namespace okvis
@@ -48,15 +48,15 @@ namespace okvis {
 MatchingAlgorithm::MatchingAlgorithm() {}
 MatchingAlgorithm::~MatchingAlgorithm() {}
 
-MatchingAlgorithm::listB_tree_structure_t::iterator MatchingAlgorithm::getListBStartIterator(size_t /* indexA */) {
+MatchingAlgorithm::listB_candidates_t::const_iterator MatchingAlgorithm::getListBStartIterator(size_t indexA) {
   OKVIS_THROW(std::runtime_error,
               "To use the listB iterators, implement this interface in your matching algorithm subclass.");
-  return dummy_.end();
+  return dummy_.end(indexA);
 }
-MatchingAlgorithm::listB_tree_structure_t::iterator MatchingAlgorithm::getListBEndIterator(size_t /* indexA */) {
+MatchingAlgorithm::listB_candidates_t::const_iterator MatchingAlgorithm::getListBEndIterator(size_t indexA) {
   OKVIS_THROW(std::runtime_error,
               "To use the listB iterators, implement this interface in your matching algorithm subclass.");
-  return dummy_.end();
+  return dummy_.end(indexA);
 }
 
 }  // namespace okvis
@@ -1,7 +1,17 @@
 #include <gtest/gtest.h>
 #include <math.h>
 
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <iostream>
+#include <limits>
 #include <okvis/DenseMatcher.hpp>
+#include <okvis/EpipolarBandIndex.hpp>
+#include <okvis/KeypointGrid.hpp>
+#include <random>
 #include <utility>
 #include <vector>
 
@@ -135,3 +145,382 @@ TEST(DenseMatcherTestSuite, denseMatcherDistanceRatioTest) {
     }
   }
 }
+
+// Landmarks of frame A projected into frame B, matched by descriptor distance and gated by their projection
+// uncertainty, as VioKeyframeWindowMatchingAlgorithm does for 3D-2D matching.
+class ProjectionMatchingAlgorithm : public okvis::MatchingAlgorithm {
+ public:
+  typedef std::array<uint64_t, 6> Descriptor;  // 384 bits, as BRISK
+
+  struct Point {
+    double u;
+    double v;
+    Descriptor descriptor;
+  };
+
+  ProjectionMatchingAlgorithm(double imageWidth, double imageHeight)
+      : imageWidth_(imageWidth), imageHeight_(imageHeight) {}
+
+  /// \brief Bucket B and list the keypoints around each projection.
+  virtual void doSetup() {
+    grid_.reset(imageWidth_, imageHeight_);
+    for (size_t indexB = 0; indexB < listB.size(); ++indexB) grid_.add(indexB, listB[indexB].u, listB[indexB].v);
+    grid_.finalize();
+    candidates_.clear();
+    std::vector<size_t> indices;
+    for (size_t indexA = 0; indexA < listA.size(); ++indexA) {
+      indices.clear();
+      const double halfSize = std::sqrt(kMaxChi2) * sigmasA[indexA];
+      grid_.queryBox(listA[indexA].u, listA[indexA].v, halfSize, halfSize, indices);
+      for (size_t indexB : indices) candidates_.add(indexA, indexB);
+    }
+  }
+
+  virtual size_t sizeA() const { return listA.size(); }
+  virtual size_t sizeB() const { return listB.size(); }
+  virtual float distanceThreshold() const { return 60.0f; }
+
+  virtual listB_candidates_t::const_iterator getListBStartIterator(size_t indexA) { return candidates_.begin(indexA); }
+  virtual listB_candidates_t::const_iterator getListBEndIterator(size_t indexA) { return candidates_.end(indexA); }
+
+  virtual float distance(size_t indexA, size_t indexB) const {
+    size_t dist = 0;
+    for (size_t i = 0; i < listA[indexA].descriptor.size(); ++i) {
+      dist += std::bitset<64>(listA[indexA].descriptor[i] ^ listB[indexB].descriptor[i]).count();
+    }
+    if (dist < distanceThreshold()) {
+      const double du = (listA[indexA].u - listB[indexB].u) / sigmasA[indexA];
+      const double dv = (listA[indexA].v - listB[indexB].v) / sigmasA[indexA];
+      if (du * du + dv * dv < kMaxChi2) return static_cast<float>(dist);
+    }
+    return std::numeric_limits<float>::max();
+  }
+
+  virtual void reserveMatches(size_t numMatches) {
+    matches.clear();
+    matches.reserve(numMatches);
+  }
+
+  virtual void setBestMatch(size_t indexA, size_t indexB, double /* distance */) {
+    matches.push_back(std::make_pair(indexA, indexB));
+  }
+
+  std::vector<Point> listA;     ///< Projections of the landmarks into B.
+  std::vector<double> sigmasA;  ///< Projection standard deviations. [pixels]
+  std::vector<Point> listB;     ///< Keypoints of B.
+  std::vector<std::pair<int, int> > matches;
+
+ private:
+  static constexpr double kMaxChi2 = 4.0;
+  double imageWidth_;
+  double imageHeight_;
+  okvis::KeypointGrid grid_;
+  listB_candidates_t candidates_;
+};
+
+// A frame with numPoints keypoints, most of which re-observe a landmark with a few flipped descriptor bits.
+void createProjectionScene(size_t numPoints, ProjectionMatchingAlgorithm& algorithm) {  // NOLINT
+  std::mt19937_64 rng(numPoints);
+  std::uniform_real_distribution<double> u(0.0, 752.0), v(0.0, 480.0), sigma(1.0, 4.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  std::uniform_int_distribution<int> bit(0, 383), octave(0, 3);
+  algorithm.listA.clear();
+  algorithm.sigmasA.clear();
+  algorithm.listB.clear();
+  for (size_t i = 0; i < numPoints; ++i) {
+    ProjectionMatchingAlgorithm::Point keypoint = {u(rng), v(rng), {}};
+    for (uint64_t& word : keypoint.descriptor) word = rng();
+    algorithm.listB.push_back(keypoint);
+    if (i % 5 == 4) continue;  // a new keypoint, without landmark
+    ProjectionMatchingAlgorithm::Point projection = keypoint;
+    algorithm.sigmasA.push_back(sigma(rng));
+    projection.u += noise(rng) * algorithm.sigmasA.back();
+    projection.v += noise(rng) * algorithm.sigmasA.back();
+    for (int flip = 0; flip < 20; ++flip) {
+      const int b = bit(rng);
+      projection.descriptor[b / 64] ^= uint64_t(1) << (b % 64);
+    }
+    algorithm.listA.push_back(projection);
+  }
+}
+
+TEST(DenseMatcherTestSuite, imageSpaceMatchingBenchmark) {
+  okvis::DenseMatcher matcher(4);
+  ProjectionMatchingAlgorithm algorithm(752.0, 480.0);
+  typedef std::chrono::steady_clock clock;
+  std::cout << "3D-2D matching, all pairs vs. keypoints around the projections:" << std::endl;
+  for (size_t numPoints : {200, 500, 1000, 2000}) {
+    createProjectionScene(numPoints, algorithm);
+    const int repetitions = 10;
+
+    clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) matcher.match(algorithm);
+    const double linearMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / repetitions;
+    std::vector<std::pair<int, int> > linearMatches = algorithm.matches;
+
+    start = clock::now();
+    for (int r = 0; r < repetitions; ++r) matcher.matchInImageSpace(algorithm);
+    const double imageSpaceMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / repetitions;
+    std::vector<std::pair<int, int> > imageSpaceMatches = algorithm.matches;
+
+    // the candidates hold every pair the gating accepts, so the matches are the same
+    std::sort(linearMatches.begin(), linearMatches.end());
+    std::sort(imageSpaceMatches.begin(), imageSpaceMatches.end());
+    EXPECT_EQ(linearMatches, imageSpaceMatches);
+    EXPECT_GT(imageSpaceMatches.size(), algorithm.sizeA() / 2);
+
+    std::cout << "  " << algorithm.sizeA() << " x " << algorithm.sizeB() << ": all pairs " << linearMs
+              << " ms, image space " << imageSpaceMs << " ms (" << linearMs / imageSpaceMs << "x), "
+              << imageSpaceMatches.size() << " matches" << std::endl;
+  }
+}
+
+// Each A competes with its neighbours for a few B, with a cheap distance: the time goes into the assignment.
+class CandidateListMatchingAlgorithm : public okvis::MatchingAlgorithm {
+ public:
+  explicit CandidateListMatchingAlgorithm(size_t size) : size_(size) {
+    for (size_t indexA = 0; indexA < size_; ++indexA) {
+      for (size_t j = 0; j < 8; ++j) candidates_.add(indexA, (indexA + 7 * j) % size_);
+    }
+  }
+
+  virtual size_t sizeA() const { return size_; }
+  virtual size_t sizeB() const { return size_; }
+  virtual float distanceThreshold() const { return 60.0f; }
+
+  virtual listB_candidates_t::const_iterator getListBStartIterator(size_t indexA) { return candidates_.begin(indexA); }
+  virtual listB_candidates_t::const_iterator getListBEndIterator(size_t indexA) { return candidates_.end(indexA); }
+
+  virtual float distance(size_t indexA, size_t indexB) const {
+    return static_cast<float>((indexA * 2654435761u + indexB * 40503u) % 80);
+  }
+
+  virtual void reserveMatches(size_t numMatches) {
+    matches.clear();
+    matches.reserve(numMatches);
+  }
+
+  virtual void setBestMatch(size_t indexA, size_t indexB, double /* distance */) {
+    matches.push_back(std::make_pair(indexA, indexB));
+  }
+
+  std::vector<std::pair<int, int> > matches;
+
+ private:
+  size_t size_;
+  listB_candidates_t candidates_;
+};
+
+TEST(DenseMatcherTestSuite, assignmentBenchmark) {
+  okvis::DenseMatcher matcher(4);
+  typedef std::chrono::steady_clock clock;
+  std::cout << "Match assignment, 8 candidates per A:" << std::endl;
+  for (size_t size : {200, 1000, 5000}) {
+    CandidateListMatchingAlgorithm algorithm(size);
+    matcher.matchInImageSpace(algorithm);
+    std::vector<std::pair<int, int> > firstMatches = algorithm.matches;
+    std::sort(firstMatches.begin(), firstMatches.end());
+
+    // one to one
+    std::vector<bool> matchedA(size, false), matchedB(size, false);
+    for (const std::pair<int, int>& match : firstMatches) {
+      EXPECT_FALSE(matchedA[match.first]);
+      EXPECT_FALSE(matchedB[match.second]);
+      matchedA[match.first] = matchedB[match.second] = true;
+    }
+
+    const int repetitions = 50;
+    clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+      matcher.matchInImageSpace(algorithm);
+      std::sort(algorithm.matches.begin(), algorithm.matches.end());
+      EXPECT_EQ(firstMatches, algorithm.matches);
+    }
+    const double us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+    std::cout << "  " << size << " x " << size << ": " << us << " us, " << firstMatches.size() << " matches"
+              << std::endl;
+  }
+}
+
+// The keypoints of a stereo pair, matched by descriptor distance and gated by their distance from the epipolar plane,
+// as VioKeyframeWindowMatchingAlgorithm does for 2D-2D stereo matching.
+class StereoMatchingAlgorithm : public okvis::MatchingAlgorithm {
+ public:
+  typedef std::array<uint64_t, 6> Descriptor;  // 384 bits, as BRISK
+
+  struct Ray {
+    Eigen::Vector3d direction;
+    double sigma;  ///< [rad]
+    Descriptor descriptor;
+  };
+
+  StereoMatchingAlgorithm(const Eigen::Matrix3d& C_AB, const Eigen::Vector3d& t_AB) : C_AB_(C_AB), t_AB_(t_AB) {}
+
+  /// \brief Sort B by epipolar plane and list the keypoints in the band of each A.
+  virtual void doSetup() {
+    index_.reset(C_AB_, t_AB_);
+    for (size_t indexB = 0; indexB < listB.size(); ++indexB) {
+      index_.add(indexB, listB[indexB].direction, listB[indexB].sigma);
+    }
+    index_.finalize();
+    candidates_.clear();
+    std::vector<size_t> indices;
+    for (size_t indexA = 0; indexA < listA.size(); ++indexA) {
+      indices.clear();
+      index_.queryBand(listA[indexA].direction, halfWidth(indexA), indices);
+      std::sort(indices.begin(), indices.end());
+      for (size_t indexB : indices) candidates_.add(indexA, indexB);
+    }
+  }
+
+  virtual size_t sizeA() const { return listA.size(); }
+  virtual size_t sizeB() const { return listB.size(); }
+  virtual float distanceThreshold() const { return 60.0f; }
+
+  virtual listB_candidates_t::const_iterator getListBStartIterator(size_t indexA) { return candidates_.begin(indexA); }
+  virtual listB_candidates_t::const_iterator getListBEndIterator(size_t indexA) { return candidates_.end(indexA); }
+
+  virtual float distance(size_t indexA, size_t indexB) const {
+    size_t dist = 0;
+    for (size_t i = 0; i < listA[indexA].descriptor.size(); ++i) {
+      dist += std::bitset<64>(listA[indexA].descriptor[i] ^ listB[indexB].descriptor[i]).count();
+    }
+    if (dist < distanceThreshold() && inBand(indexA, indexB)) return static_cast<float>(dist);
+    return std::numeric_limits<float>::max();
+  }
+
+  /// \brief Is the ray of B within the band of A? The angle between the half planes bounded by the baseline that hold
+  ///        the rays, both in camera A.
+  bool inBand(size_t indexA, size_t indexB) const {
+    const Eigen::Vector3d baseline = t_AB_.normalized();
+    const Eigen::Vector3d rayA = listA[indexA].direction.normalized();
+    const Eigen::Vector3d rayB = (C_AB_ * listB[indexB].direction).normalized();
+    const Eigen::Vector3d perpendicularA = rayA - baseline * baseline.dot(rayA);
+    const Eigen::Vector3d perpendicularB = rayB - baseline * baseline.dot(rayB);
+    const double sinBaselineB = perpendicularB.norm();
+    if (sinBaselineB < okvis::EpipolarBandIndex::kMinSinBaseline) return true;
+    const double sinBaselineA = perpendicularA.norm();
+    const double angle = std::acos(std::max(-1.0, std::min(1.0, perpendicularA.dot(perpendicularB) /
+                                                                     (sinBaselineA * sinBaselineB))));
+    return angle <= halfWidth(indexA) / std::max(sinBaselineA, okvis::EpipolarBandIndex::kMinSinBaseline) +
+                        3.0 * listB[indexB].sigma / sinBaselineB;
+  }
+
+  double halfWidth(size_t indexA) const { return kBand / kFocalLength + 3.0 * listA[indexA].sigma; }
+
+  virtual void reserveMatches(size_t numMatches) {
+    matches.clear();
+    matches.reserve(numMatches);
+  }
+
+  virtual void setBestMatch(size_t indexA, size_t indexB, double /* distance */) {
+    matches.push_back(std::make_pair(indexA, indexB));
+  }
+
+  static constexpr double kFocalLength = 460.0;  ///< [pixels]
+  static constexpr double kBand = 2.0;           ///< [pixels]
+
+  std::vector<Ray> listA;  ///< Keypoints of camera A.
+  std::vector<Ray> listB;  ///< Keypoints of camera B.
+  std::vector<std::pair<int, int> > matches;
+
+ private:
+  Eigen::Matrix3d C_AB_;
+  Eigen::Vector3d t_AB_;
+  okvis::EpipolarBandIndex index_;
+  listB_candidates_t candidates_;
+};
+
+constexpr double StereoMatchingAlgorithm::kFocalLength;
+constexpr double StereoMatchingAlgorithm::kBand;
+
+// A stereo pair seeing numPoints points, most of them in both cameras with a few flipped descriptor bits.
+void createStereoScene(size_t numPoints, StereoMatchingAlgorithm& algorithm,  // NOLINT
+                       const Eigen::Matrix3d& C_AB, const Eigen::Vector3d& t_AB) {
+  std::mt19937_64 rng(numPoints);
+  std::uniform_real_distribution<double> bearing(-0.7, 0.7), depth(0.5, 10.0), pixelSigma(0.5, 2.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  std::uniform_int_distribution<int> bit(0, 383), octave(0, 3);
+  algorithm.listA.clear();
+  algorithm.listB.clear();
+  auto noisyRay = [&](const Eigen::Vector3d& point) {
+    // keypoints of coarser pyramid levels are less accurate
+    const double sigma = pixelSigma(rng) * (1 << octave(rng)) / StereoMatchingAlgorithm::kFocalLength;
+    StereoMatchingAlgorithm::Ray ray = {point.normalized(), sigma, {}};
+    const Eigen::Vector3d perturbation(noise(rng), noise(rng), noise(rng));
+    ray.direction = (ray.direction + perturbation * ray.sigma).normalized();
+    return ray;
+  };
+  for (size_t i = 0; i < numPoints; ++i) {
+    const Eigen::Vector3d point_A = Eigen::Vector3d(bearing(rng), bearing(rng), 1.0) * depth(rng);
+    StereoMatchingAlgorithm::Ray rayA = noisyRay(point_A);
+    for (uint64_t& word : rayA.descriptor) word = rng();
+    algorithm.listA.push_back(rayA);
+    if (i % 5 == 4) continue;  // seen by A only
+    StereoMatchingAlgorithm::Ray rayB = noisyRay(C_AB.transpose() * (point_A - t_AB));
+    rayB.descriptor = rayA.descriptor;
+    for (int flip = 0; flip < 20; ++flip) {
+      const int b = bit(rng);
+      rayB.descriptor[b / 64] ^= uint64_t(1) << (b % 64);
+    }
+    algorithm.listB.push_back(rayB);
+  }
+  std::shuffle(algorithm.listB.begin(), algorithm.listB.end(), rng);
+}
+
+TEST(EpipolarBandIndexTestSuite, bandHoldsEveryGatedPair) {
+  const Eigen::Matrix3d C_AB = Eigen::AngleAxisd(0.02, Eigen::Vector3d(0.3, 1.0, 0.1).normalized()).toRotationMatrix();
+  // a sideways rig, and one looking along the baseline
+  for (const Eigen::Vector3d& t_AB : {Eigen::Vector3d(0.11, 0.002, -0.003), Eigen::Vector3d(0.01, 0.0, 0.2)}) {
+    StereoMatchingAlgorithm algorithm(C_AB, t_AB);
+    createStereoScene(500, algorithm, C_AB, t_AB);
+    algorithm.doSetup();
+    size_t numCandidates = 0;
+    for (size_t indexA = 0; indexA < algorithm.sizeA(); ++indexA) {
+      std::vector<size_t> band;
+      for (auto it = algorithm.getListBStartIterator(indexA); it != algorithm.getListBEndIterator(indexA); ++it) {
+        band.push_back(*it);
+      }
+      numCandidates += band.size();
+      for (size_t indexB = 0; indexB < algorithm.sizeB(); ++indexB) {
+        if (algorithm.inBand(indexA, indexB)) {
+          EXPECT_TRUE(std::binary_search(band.begin(), band.end(), indexB)) << indexA << " " << indexB;
+        }
+      }
+    }
+    EXPECT_LT(numCandidates, algorithm.sizeA() * algorithm.sizeB() / 5);
+  }
+}
+
+TEST(DenseMatcherTestSuite, epipolarBandMatchingBenchmark) {
+  okvis::DenseMatcher matcher(4);
+  const Eigen::Matrix3d C_AB = Eigen::AngleAxisd(0.02, Eigen::Vector3d(0.3, 1.0, 0.1).normalized()).toRotationMatrix();
+  const Eigen::Vector3d t_AB(0.11, 0.002, -0.003);
+  StereoMatchingAlgorithm algorithm(C_AB, t_AB);
+  typedef std::chrono::steady_clock clock;
+  std::cout << "2D-2D stereo matching, all pairs vs. keypoints in the epipolar band:" << std::endl;
+  for (size_t numPoints : {200, 500, 1000, 2000}) {
+    createStereoScene(numPoints, algorithm, C_AB, t_AB);
+    const int repetitions = 10;
+
+    clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) matcher.match(algorithm);
+    const double linearMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / repetitions;
+    std::vector<std::pair<int, int> > linearMatches = algorithm.matches;
+
+    start = clock::now();
+    for (int r = 0; r < repetitions; ++r) matcher.matchInImageSpace(algorithm);
+    const double bandMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / repetitions;
+    std::vector<std::pair<int, int> > bandMatches = algorithm.matches;
+
+    // the band holds every pair the gating accepts, so the matches are the same
+    std::sort(linearMatches.begin(), linearMatches.end());
+    std::sort(bandMatches.begin(), bandMatches.end());
+    EXPECT_EQ(linearMatches, bandMatches);
+    EXPECT_GT(bandMatches.size(), algorithm.sizeB() / 2);
+
+    std::cout << "  " << algorithm.sizeA() << " x " << algorithm.sizeB() << ": all pairs " << linearMs
+              << " ms, epipolar band " << bandMs << " ms (" << linearMs / bandMs << "x), " << bandMatches.size()
+              << " matches" << std::endl;
+  }
+}
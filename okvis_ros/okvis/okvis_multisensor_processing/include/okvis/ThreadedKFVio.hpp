@@ -50,6 +50,7 @@
 #include <okvis/FrameSynchronizer.hpp>
 #include <okvis/Frontend.hpp>
 #include <okvis/ImuFrameSynchronizer.hpp>
+#include <okvis/MeasurementBuffer.hpp>
 #include <okvis/Measurements.hpp>
 #include <okvis/MultiFrame.hpp>
 #include <okvis/Parameters.hpp>
@@ -59,9 +60,12 @@
 #include <okvis/assert_macros.hpp>
 #include <okvis/cameras/NCameraSystem.hpp>
 #include <okvis/kinematics/Transformation.hpp>
+#include <okvis/threadsafe/LockFreeQueue.hpp>
 #include <okvis/threadsafe/ThreadsafeQueue.hpp>
+#include <okvis/timing/FrameTracer.hpp>
 #include <okvis/timing/Timer.hpp>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #ifdef USE_MOCK
@@ -307,9 +311,9 @@ class ThreadedKFVio : public VioInterface {
    * @param start The first IMU measurement in the return value will be older than this timestamp.
    * @param end The last IMU measurement in the return value will be newer than this timestamp.
    * @remark This function is threadsafe.
-   * @return The IMU Measurement spanning at least the time between start and end.
+   * @return View on the IMU Measurements spanning at least the time between start and end.
    */
-  okvis::ImuMeasurementDeque getImuMeasurments(okvis::Time& start, okvis::Time& end);  // NOLINT
+  okvis::ImuMeasurementSpan getImuMeasurments(okvis::Time& start, okvis::Time& end);  // NOLINT
 
   /**
    * @Sharmin
@@ -321,7 +325,7 @@ class ThreadedKFVio : public VioInterface {
    * @Sharmin
    * @brief Get the depth measurement in-between/nearest to start and end. Depth sensor has a slowed rate, 1 Hz.
    */
-  okvis::DepthMeasurementDeque getDepthMeasurements(okvis::Time& start, okvis::Time& end);  // NOLINT
+  okvis::DepthMeasurementSpan getDepthMeasurements(okvis::Time& start, okvis::Time& end);  // NOLINT
 
   /**
    * @Sharmin
@@ -329,9 +333,9 @@ class ThreadedKFVio : public VioInterface {
    * @param start The first Sonar measurement in the return value will be older than this timestamp.
    * @param end The last Sonar measurement in the return value will be newer than this timestamp.
    * @remark This function is threadsafe.
-   * @return The Sonar Measurement spanning at least the time between start and end.
+   * @return View on the Sonar Measurements spanning at least the time between start and end.
    */
-  okvis::SonarMeasurementDeque getSonarMeasurements(okvis::Time& start, okvis::Time& end);  // NOLINT
+  okvis::SonarMeasurementSpan getSonarMeasurements(okvis::Time& start, okvis::Time& end);  // NOLINT
 
   /**
    * @brief Remove IMU measurements from the internal buffer.
@@ -357,6 +361,7 @@ class ThreadedKFVio : public VioInterface {
     okvis::MapPointVector transferredLandmarks;  ///< Vector of the landmarks that have been marginalized out.
     bool
         onlyPublishLandmarks;  ///< Boolean to signalise the publisherLoop() that only the landmarks should be published
+    uint64_t traceId = 0;      ///< Frame of the okvis::timing::FrameTracer, 0 for IMU propagated states.
   };
 
   /// @name State variables
@@ -405,23 +410,23 @@ class ThreadedKFVio : public VioInterface {
   /// Camera measurement input queues. For each camera in the configuration one.
   std::vector<std::shared_ptr<okvis::threadsafe::ThreadSafeQueue<std::shared_ptr<okvis::CameraMeasurement>>>>
       cameraMeasurementsReceived_;
-  /// IMU measurement input queue.
-  okvis::threadsafe::ThreadSafeQueue<okvis::ImuMeasurement> imuMeasurementsReceived_;
+  /// IMU measurement input queue. Lock-free, since it is hit at the IMU rate.
+  okvis::threadsafe::LockFreeQueue<okvis::ImuMeasurement> imuMeasurementsReceived_;
 
   /// Position measurement input queue.
-  okvis::threadsafe::ThreadSafeQueue<okvis::PositionMeasurement> positionMeasurementsReceived_;
+  okvis::threadsafe::LockFreeQueue<okvis::PositionMeasurement> positionMeasurementsReceived_;
 
   /// @Sharmin
   /// Sonar measurement input queue.
-  okvis::threadsafe::ThreadSafeQueue<okvis::SonarMeasurement> sonarMeasurementsReceived_;
+  okvis::threadsafe::LockFreeQueue<okvis::SonarMeasurement> sonarMeasurementsReceived_;
 
   /// @Sharmin
   /// Depth measurement input queue.
-  okvis::threadsafe::ThreadSafeQueue<okvis::DepthMeasurement> depthMeasurementsReceived_;
+  okvis::threadsafe::LockFreeQueue<okvis::DepthMeasurement> depthMeasurementsReceived_;
 
   /// @Sharmin
   /// Reloc measurement input queue.
-  okvis::threadsafe::ThreadSafeQueue<okvis::RelocMeasurement> relocMeasurementsReceived_;
+  okvis::threadsafe::LockFreeQueue<okvis::RelocMeasurement> relocMeasurementsReceived_;
 
   /// @}
   /// @name Measurement operation queues.
@@ -431,14 +436,12 @@ class ThreadedKFVio : public VioInterface {
   okvis::threadsafe::ThreadSafeQueue<std::shared_ptr<okvis::MultiFrame>> keypointMeasurements_;
   /// The queue containing multiframes with completely matched frames. These are already part of the estimator state.
   okvis::threadsafe::ThreadSafeQueue<std::shared_ptr<okvis::MultiFrame>> matchedFrames_;
-  /// \brief The IMU measurements.
-  /// \warning Lock with imuMeasurements_mutex_.
-  okvis::ImuMeasurementDeque imuMeasurements_;
-  /// \brief The Sonar measurements.
-  /// \warning Lock with sonarMeasurements_mutex_.
-  okvis::SonarMeasurementDeque sonarMeasurements_;  /// @Sharmin
-  okvis::DepthMeasurementDeque depthMeasurements_;  /// @Sharmin
-  okvis::RelocMeasurementDeque relocMeasurements_;  /// @Sharmin
+  /// \brief The IMU measurements. Only imuConsumerLoop() pushes, any thread may read windows.
+  okvis::ImuMeasurementBuffer imuMeasurements_;
+  /// \brief The Sonar measurements. Only sonarConsumerLoop() pushes, any thread may read windows.
+  okvis::SonarMeasurementBuffer sonarMeasurements_;  /// @Sharmin
+  okvis::DepthMeasurementBuffer depthMeasurements_;  /// @Sharmin
+  okvis::RelocMeasurementBuffer relocMeasurements_;  /// @Sharmin
   /// \brief The Position measurements.
   /// \warning Lock with positionMeasurements_mutex_.
   okvis::PositionMeasurementDeque positionMeasurements_;
@@ -453,10 +456,6 @@ class ThreadedKFVio : public VioInterface {
   /// @name Mutexes
   /// @{
 
-  std::mutex sonarMeasurements_mutex_;     ///< Lock when accessing sonarMeasurements_ @Sharmin
-  std::mutex depthMeasurements_mutex_;     ///< Lock when accessing depthMeasurements_ @Sharmin
-  std::mutex relocMeasurements_mutex_;     ///< Lock when accessing relocMeasurements_ @Sharmin
-  std::mutex imuMeasurements_mutex_;       ///< Lock when accessing imuMeasurements_
   std::mutex positionMeasurements_mutex_;  ///< Lock when accessing imuMeasurements_
   std::mutex frameSynchronizer_mutex_;     ///< Lock when accessing the frameSynchronizer_.
   std::mutex estimator_mutex_;             ///< Lock when accessing the estimator_.
@@ -527,9 +526,10 @@ class ThreadedKFVio : public VioInterface {
   // std::vector<Eigen::Vector3d> stereoMatch_;  // Sharmin
   // okvis::kinematics::Transformation kf_T_WS_;     // Sharmin: keyframe pose.
   // std::vector<Eigen::Matrix<double, Dynamic, 3>> kf_points_; // Sharmin: keyframe points.
-  int kf_index_;                    // Sharmin: keyframe index
-  std::map<int, size_t> kf_f_map_;  // Sharmin: for publishing MapPoint observation
-  std::mutex kf_f_map_mutex_;
+  int kf_index_;  // Sharmin: keyframe index
+  /// Keyframe index by multiframe ID, for the covisibilities of keyframePacket_. Only used by optimizationLoop().
+  std::unordered_map<uint64_t, int> keyframeIndices_;
+  okvis::KeyframePacket keyframePacket_;  ///< Handed to the keyframeCallback_, reused to keep its memory.
 
   // Sharmin: for easy access to relocalization related info
   bool isNewReloMsg_;
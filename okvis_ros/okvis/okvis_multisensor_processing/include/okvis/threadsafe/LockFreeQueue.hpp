@@ -0,0 +1,326 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file LockFreeQueue.hpp
+ * @brief Header file for the LockFreeQueue class.
+ */
+
+#ifndef INCLUDE_OKVIS_THREADSAFE_LOCKFREEQUEUE_HPP_
+#define INCLUDE_OKVIS_THREADSAFE_LOCKFREEQUEUE_HPP_
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/// \brief Namespace for helper classes for threadsafe operation.
+namespace threadsafe {
+
+/**
+ * @brief Bounded FIFO queue with the same push/pop semantics as ThreadSafeQueue, but without a lock on the
+ *        data path. Any number of producers and consumers may use it concurrently (array based queue by
+ *        D. Vyukov), which covers the single and multi producer cases in ThreadedKFVio.
+ *        Threads only sleep on a condition variable if the queue stays empty (or full) after a short spin.
+ * @tparam QueueType Datatype that is saved in the queue.
+ */
+template <typename QueueType>
+class LockFreeQueue {
+ public:
+  /// \brief Constructor.
+  /// \param[in] capacity Maximum number of entries, rounded up to a power of two.
+  explicit LockFreeQueue(size_t capacity = 1024) : enqueuePos_(0), dequeuePos_(0), shutdown_(false) {
+    size_t roundedCapacity = 2;
+    while (roundedCapacity < capacity) roundedCapacity <<= 1;
+    capacity_ = roundedCapacity;
+    mask_ = roundedCapacity - 1;
+    cells_.reset(new Cell[roundedCapacity]);
+    for (size_t i = 0; i < roundedCapacity; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    numWaitingConsumers_ = 0;
+    numWaitingProducers_ = 0;
+  }
+
+  LockFreeQueue(const LockFreeQueue&) = delete;
+  LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+  /// \brief Destructor.
+  ~LockFreeQueue() { Shutdown(); }
+
+  /// \brief Notify all waiting threads. Only used in destructor and when shutting down.
+  void NotifyAll() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_empty_.notify_all();
+    condition_full_.notify_all();
+  }
+
+  /// \brief Tell the queue shut down. This will notify all threads to wake up.
+  void Shutdown() {
+    shutdown_ = true;
+    NotifyAll();
+  }
+
+  /// \brief Tell the queue to resume after a shutdown request.
+  void Resume() {
+    shutdown_ = false;
+    NotifyAll();
+  }
+
+  /// \brief Return the (approximate, if other threads are pushing or popping) size of the queue.
+  size_t Size() const {
+    const size_t dequeuePos = dequeuePos_.load(std::memory_order_acquire);
+    const size_t enqueuePos = enqueuePos_.load(std::memory_order_acquire);
+    return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+  }
+
+  /// \brief Return true if the queue is empty.
+  bool Empty() const { return Size() == 0; }
+
+  /// \brief Return the maximum number of entries.
+  size_t Capacity() const { return capacity_; }
+
+  /// \brief Push non-blocking to the queue.
+  void Push(const QueueType& value) { PushNonBlocking(value); }
+
+  /// \brief Push to the queue. Since the queue is bounded, the oldest entry is dropped if it is full.
+  void PushNonBlocking(const QueueType& value) { PushNonBlockingDroppingIfFull(value, capacity_); }
+
+  /// \brief Push to the queue if the size is less than max_queue_size, else block.
+  /// \param[in] value New entry in queue.
+  /// \param[in] max_queue_size Maximum queue size. Limited to the capacity of the queue.
+  /// \return False if shutdown is requested.
+  bool PushBlockingIfFull(const QueueType& value, size_t max_queue_size) {
+    max_queue_size = std::min(max_queue_size, capacity_);
+    int spins = 0;
+    while (!shutdown_) {
+      if (Size() < max_queue_size && tryPush(value)) {
+        notifyConsumer();
+        return true;
+      }
+      if (++spins < kNumSpins) {
+        std::this_thread::yield();
+        continue;
+      }
+      // wait until a consumer signals that space is available
+      std::unique_lock<std::mutex> lock(mutex_);
+      numWaitingProducers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the fence in notify
+      condition_full_.wait_for(lock, kMaxWait, [&] { return shutdown_ || Size() < max_queue_size; });
+      numWaitingProducers_.fetch_sub(1);
+      spins = 0;
+    }
+    return false;
+  }
+
+  /// \brief Push to the queue. If full, drop the oldest entry.
+  /// \param[in] value New entry in queue.
+  /// \param[in] max_queue_size Maximum queue size. Limited to the capacity of the queue.
+  /// \return True if oldest was dropped because queue was full.
+  bool PushNonBlockingDroppingIfFull(const QueueType& value, size_t max_queue_size) {
+    max_queue_size = std::min(max_queue_size, capacity_);
+    bool result = false;
+    QueueType dropped;
+    while (Size() >= max_queue_size && tryPop(&dropped)) result = true;
+    while (!tryPush(value)) {
+      // another producer filled the last slot in the meantime
+      if (tryPop(&dropped)) result = true;
+    }
+    notifyConsumer();
+    return result;
+  }
+
+  /**
+   * @brief Get the oldest entry still in the queue. Blocking if queue is empty.
+   * @param[out] value Oldest entry in queue.
+   * @return False if shutdown is requested.
+   */
+  bool Pop(QueueType* value) { return PopBlocking(value); }
+
+  /**
+   * @brief Get the oldest entry still in the queue. Blocking if queue is empty.
+   * @param[out] value Oldest entry in queue.
+   * @return False if shutdown is requested.
+   */
+  bool PopBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    int spins = 0;
+    while (!shutdown_) {
+      if (tryPop(value)) {
+        notifyProducer();
+        return true;
+      }
+      if (++spins < kNumSpins) {
+        std::this_thread::yield();
+        continue;
+      }
+      // wait until a producer signals that data is available
+      std::unique_lock<std::mutex> lock(mutex_);
+      numWaitingConsumers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the fence in notify
+      condition_empty_.wait_for(lock, kMaxWait, [&] { return shutdown_ || !Empty(); });
+      numWaitingConsumers_.fetch_sub(1);
+      spins = 0;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Get the oldest entry still in the queue. If queue is empty value is not altered.
+   * @param[out] value Oldest entry in queue if queue was not empty.
+   * @return True if queue was not empty.
+   */
+  bool PopNonBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    if (!tryPop(value)) return false;
+    notifyProducer();
+    return true;
+  }
+
+  /**
+   * @brief Get the oldest entry still in the queue. If the queue is empty wait for a given
+   *        amount of time. If during this time an entry was pushed alter the value. If the
+   *        queue is still empty, the value is not altered and it will return false
+   * @param[out] value Oldest entry in queue if queue was not empty.
+   * @param timeout_nanoseconds Maximum amount of time to wait for an entry if queue is empty.
+   * @return True if value was updated. False if queue was empty and no new entry was pushed
+   *         during the given timeout.
+   */
+  bool PopTimeout(QueueType* value, int64_t timeout_nanoseconds) {
+    CHECK_NOTNULL(value);
+    if (PopNonBlocking(value)) return true;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      numWaitingConsumers_.fetch_add(1);
+      condition_empty_.wait_for(
+          lock, std::chrono::nanoseconds(timeout_nanoseconds), [&] { return shutdown_ || !Empty(); });
+      numWaitingConsumers_.fetch_sub(1);
+    }
+    return PopNonBlocking(value);
+  }
+
+ private:
+  /// \brief Number of times a blocking call retries (yielding in between) before it sleeps.
+  static constexpr int kNumSpins = 64;
+  /// \brief Upper bound for sleeping, guards against missing a notification on shutdown.
+  static constexpr std::chrono::milliseconds kMaxWait{10};
+
+  /// \brief A slot in the ring. The sequence number tells producers and consumers whose turn it is.
+  struct Cell {
+    std::atomic<size_t> sequence;
+    QueueType data;
+  };
+
+  /// \brief Try to append an entry. Fails if the queue is full.
+  bool tryPush(const QueueType& value) {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// \brief Try to remove the oldest entry. Fails if the queue is empty.
+  bool tryPop(QueueType* value) {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          *value = std::move(cell.data);
+          cell.data = QueueType();  // do not keep shared pointers etc. alive
+          cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// \brief Wake up a sleeping consumer, if there is one.
+  void notifyConsumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (numWaitingConsumers_.load() == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_empty_.notify_one();
+  }
+
+  /// \brief Wake up a sleeping producer, if there is one.
+  void notifyProducer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (numWaitingProducers_.load() == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_full_.notify_one();
+  }
+
+  std::unique_ptr<Cell[]> cells_;  ///< The ring of entries.
+  size_t capacity_;                ///< Number of cells.
+  size_t mask_;                    ///< capacity_ - 1.
+
+  alignas(64) std::atomic<size_t> enqueuePos_;  ///< Next position to push to. On its own cache line.
+  alignas(64) std::atomic<size_t> dequeuePos_;  ///< Next position to pop from. On its own cache line.
+  alignas(64) std::atomic_bool shutdown_;       ///< Flag if shutdown is requested.
+
+  std::atomic<int> numWaitingConsumers_;            ///< Number of consumers sleeping on condition_empty_.
+  std::atomic<int> numWaitingProducers_;            ///< Number of producers sleeping on condition_full_.
+  mutable std::mutex mutex_;                        ///< Only protects sleeping, not the data.
+  mutable std::condition_variable condition_empty_;  ///< Condition variable to wait for data.
+  mutable std::condition_variable condition_full_;   ///< Condition variable to wait for space.
+};
+
+}  // namespace threadsafe
+
+}  // namespace okvis
+
+#endif  // INCLUDE_OKVIS_THREADSAFE_LOCKFREEQUEUE_HPP_
@@ -41,6 +41,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cmath>
 #include <list>
 #include <map>
 #include <memory>
@@ -104,6 +105,18 @@ static const int max_camera_input_queue_size = 10;
 static const okvis::Duration temporal_imu_data_overlap(
     0.02);  // overlap of imu data before and after two consecutive frames [seconds]
 okvis::Duration temporal_relo_data_overlap(0.2);
+static const double measurement_buffer_duration = 30.0;  // time span held by the IMU and sonar buffers [seconds]
+static const size_t reloc_buffer_capacity = 64;
+
+// The maximum input queue size before IMU measurements are dropped.
+static size_t maxImuInputQueueSize(const okvis::VioParameters& parameters) {
+  return 2 * max_camera_input_queue_size * parameters.imu.rate / parameters.sensors_information.cameraRate;
+}
+
+// The number of IMU (and sonar, at the same rate, and depth, slower) measurements the buffers hold.
+static size_t measurementBufferCapacity(const okvis::VioParameters& parameters) {
+  return static_cast<size_t>(std::floor(measurement_buffer_duration * parameters.imu.rate));
+}
 
 #ifdef USE_MOCK
 // Constructor for gmock.
@@ -115,6 +128,12 @@ ThreadedKFVio::ThreadedKFVio(okvis::VioParameters& parameters,
       repropagationNeeded_(false),
       frameSynchronizer_(okvis::FrameSynchronizer(parameters)),
       lastAddedImageTimestamp_(okvis::Time(0, 0)),
+      imuMeasurementsReceived_(60),
+      sonarMeasurementsReceived_(60),
+      imuMeasurements_(measurementBufferCapacity(parameters)),
+      sonarMeasurements_(measurementBufferCapacity(parameters)),
+      depthMeasurements_(measurementBufferCapacity(parameters)),
+      relocMeasurements_(reloc_buffer_capacity),
       optimizationDone_(true),
       estimator_(estimator),
       frontend_(frontend),
@@ -130,12 +149,17 @@ ThreadedKFVio::ThreadedKFVio(okvis::VioParameters& parameters)
       repropagationNeeded_(false),
       frameSynchronizer_(okvis::FrameSynchronizer(parameters)),
       lastAddedImageTimestamp_(okvis::Time(0, 0)),
+      imuMeasurementsReceived_(maxImuInputQueueSize(parameters)),
+      sonarMeasurementsReceived_(maxImuInputQueueSize(parameters)),  // running same rate as imu
+      imuMeasurements_(measurementBufferCapacity(parameters)),
+      sonarMeasurements_(measurementBufferCapacity(parameters)),  // running same rate as imu
+      depthMeasurements_(measurementBufferCapacity(parameters)),  // no faster than the imu
+      relocMeasurements_(reloc_buffer_capacity),
       optimizationDone_(true),
       estimator_(),
       frontend_(parameters.nCameraSystem.numCameras()),
       parameters_(parameters),
-      maxImuInputQueueSize_(2 * max_camera_input_queue_size * parameters.imu.rate /
-                            parameters.sensors_information.cameraRate) {
+      maxImuInputQueueSize_(maxImuInputQueueSize(parameters)) {
   setBlocking(false);
   init();
 }
@@ -153,6 +177,11 @@ void ThreadedKFVio::init() {
   frontend_.setBriskDetectionOctaves(parameters_.optimization.detectionOctaves);
   frontend_.setBriskDetectionThreshold(parameters_.optimization.detectionThreshold);
   frontend_.setBriskDetectionMaximumKeypoints(parameters_.optimization.maxNoKeypoints);
+  frontend_.setDetectionTiles(parameters_.optimization.detectionTilesX,
+                              parameters_.optimization.detectionTilesY,
+                              parameters_.optimization.detectionTileOverlap,
+                              parameters_.optimization.detectionThreads);
+  frontend_.setStereoMatchingBand(parameters_.optimization.stereoMatchingBand);
 
   lastOptimizedStateTimestamp_ =
       okvis::Time(0.0) +
@@ -162,6 +191,9 @@ void ThreadedKFVio::init() {
       temporal_imu_data_overlap;  // s.t. last_timestamp_ - overlap >= 0 (since okvis::time(-0.02) returns big number)
 
   estimator_.addImu(parameters_.imu);
+  if (!estimator_.setSolverOptions(parameters_.optimization)) {
+    LOG(WARNING) << "Unsupported ceres_options, using SPARSE_SCHUR with DOGLEG.";
+  }
   for (size_t i = 0; i < numCameras_; ++i) {
     // parameters_.camera_extrinsics is never set (default 0's)...
     // do they ever change?
@@ -276,6 +308,18 @@ ThreadedKFVio::~ThreadedKFVio() {
   s << endPosition.r();
   LOG(INFO) << "Sensor end position:\n" << s.str();
   LOG(INFO) << "Distance to origin: " << endPosition.r().norm();*/
+  if (imuMeasurements_.numDropped() > 0 || sonarMeasurements_.numDropped() > 0 ||
+      depthMeasurements_.numDropped() > 0) {
+    LOG(WARNING) << "measurement buffers were full, dropped " << imuMeasurements_.numDropped() << " IMU, "
+                 << sonarMeasurements_.numDropped() << " sonar and " << depthMeasurements_.numDropped()
+                 << " depth measurements";
+  }
+#ifndef USE_MOCK
+  const Frontend::StereoMatchingStatistics& stereoStatistics = frontend_.getStereoMatchingStatistics();
+  LOG(INFO) << "stereo matching " << (frontend_.getStereoMatchingBand() > 0.0 ? "in the epipolar band" : "all pairs")
+            << ": " << stereoStatistics.numCameraPairs << " camera pairs, " << stereoStatistics.numCandidates
+            << " keypoint pairs compared, " << stereoStatistics.numMatches << " matches";
+#endif
 #ifndef DEACTIVATE_TIMERS
   LOG(INFO) << okvis::timing::Timing::print();
 #endif
@@ -300,6 +344,7 @@ bool ThreadedKFVio::addImage(const okvis::Time& stamp,
   frame->measurement.image = image;
   frame->timeStamp = stamp;
   frame->sensorId = cameraIndex;
+  frame->measurement.arrivalTime = okvis::timing::FrameTracer::Clock::now();
 
   if (keypoints != nullptr) {
     frame->measurement.deliversKeypoints = true;
@@ -488,6 +533,7 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
     if (cameraMeasurementsReceived_[cameraIndex]->PopBlocking(&frame) == false) {
       return;
     }
+    const okvis::timing::FrameTracer::Clock::time_point popped = okvis::timing::FrameTracer::Clock::now();
     beforeDetectTimer.start();
     {  // lock the frame synchronizer
       waitForFrameSynchronizerMutexTimer.start();
@@ -498,6 +544,9 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
       multiFrame = frameSynchronizer_.addNewFrame(frame);
       addNewFrameToSynchronizerTimer.stop();
     }  // unlock frameSynchronizer only now as we can be sure that not two states are added for the same timestamp
+    // the multiframe timestamp identifies the frame in the trace, from here to publisherLoop
+    const uint64_t traceId = multiFrame->timestamp().toNSec();
+    okvis::timing::FrameTracer::span(traceId, "camera queue", frame->measurement.arrivalTime, popped);
     okvis::kinematics::Transformation T_WS;
     okvis::Time lastTimestamp;
     okvis::SpeedAndBias speedAndBiases;
@@ -622,10 +671,10 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
         return;
       }
       OKVIS_ASSERT_TRUE_DBG(Exception,
-                            depthDataEndTime < depthMeasurements_.back().timeStamp,
+                            depthDataEndTime < depthMeasurements_.newestTimeStamp(),
                             "Waiting for up to date depth data seems to have failed!");
 
-      okvis::DepthMeasurementDeque depthData = getDepthMeasurements(depthDataBeginTime, depthDataEndTime);
+      okvis::DepthMeasurementSpan depthData = getDepthMeasurements(depthDataBeginTime, depthDataEndTime);
 
       // if depth_data is empty, either end_time > begin_time or
       // no measurements in timeframe, should not happen, as we waited for measurements
@@ -654,10 +703,10 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
         return;
       }
       OKVIS_ASSERT_TRUE_DBG(Exception,
-                            sonarDataEndTime < sonarMeasurements_.back().timeStamp,
+                            sonarDataEndTime < sonarMeasurements_.newestTimeStamp(),
                             "Waiting for up to date sonar data seems to have failed!");
 
-      okvis::SonarMeasurementDeque sonarData = getSonarMeasurements(sonarDataBeginTime, sonarDataEndTime);
+      okvis::SonarMeasurementSpan sonarData = getSonarMeasurements(sonarDataBeginTime, sonarDataEndTime);
 
       // if sonar_data is empty, either end_time > begin_time or
       // no measurements in timeframe, should not happen, as we waited for measurements
@@ -679,7 +728,7 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
 
       // TODO(sharmin) check it
       // Add sonar landmark (in world frame) to the graph
-      for (okvis::SonarMeasurementDeque::const_iterator it = sonarData.begin(); it != sonarData.end(); ++it) {
+      for (okvis::SonarMeasurementSpan::const_iterator it = sonarData.begin(); it != sonarData.end(); ++it) {
         double range = it->measurement.range;
         double heading = it->measurement.heading;
         uint64_t lmId = okvis::IdProvider::instance().newId();
@@ -710,10 +759,10 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
       return;
     }
     OKVIS_ASSERT_TRUE_DBG(Exception,
-                          imuDataEndTime < imuMeasurements_.back().timeStamp,
+                          imuDataEndTime < imuMeasurements_.newestTimeStamp(),
                           "Waiting for up to date imu data seems to have failed!");
 
-    okvis::ImuMeasurementDeque imuData = getImuMeasurments(imuDataBeginTime, imuDataEndTime);
+    okvis::ImuMeasurementSpan imuData = getImuMeasurments(imuDataBeginTime, imuDataEndTime);
 
     // if imu_data is empty, either end_time > begin_time or
     // no measurements in timeframe, should not happen, as we waited for measurements
@@ -753,8 +802,11 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
     }
     okvis::kinematics::Transformation T_WC = T_WS * (*parameters_.nCameraSystem.T_SC(frame->sensorId));
     beforeDetectTimer.stop();
+    const okvis::timing::FrameTracer::Clock::time_point detectionStart = okvis::timing::FrameTracer::Clock::now();
+    okvis::timing::FrameTracer::span(traceId, "before detection", popped, detectionStart);
     detectTimer.start();
     frontend_.detectAndDescribe(frame->sensorId, multiFrame, T_WC, nullptr);
+    okvis::timing::FrameTracer::span(traceId, "detection", detectionStart, okvis::timing::FrameTracer::Clock::now());
 
     // Added by Sharmin
     // std::cout<<"detection for camera id: "<<frame->sensorId<<std::endl;
@@ -781,9 +833,12 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
       // use queue size 1 to propagate a congestion to the _cameraMeasurementsReceived queue
       // and check for termination request
       waitForMatchingThreadTimer.start();
+      const okvis::timing::FrameTracer::Clock::time_point pushStart = okvis::timing::FrameTracer::Clock::now();
       if (keypointMeasurements_.PushBlockingIfFull(multiFrame, 1) == false) {
         return;
       }
+      okvis::timing::FrameTracer::span(
+          traceId, "wait for matching thread", pushStart, okvis::timing::FrameTracer::Clock::now());
       waitForMatchingThreadTimer.stop();
     }
   }
@@ -802,6 +857,8 @@ void ThreadedKFVio::matchingLoop() {
 
     // get data and check for termination request
     if (keypointMeasurements_.PopBlocking(&frame) == false) return;
+    const uint64_t traceId = frame->timestamp().toNSec();
+    okvis::timing::FrameTracer::stage(traceId, "keypoint queue");
 
     prepareToAddStateTimer.start();
     // -- get relevant imu messages for new state
@@ -818,12 +875,12 @@ void ThreadedKFVio::matchingLoop() {
     // wait until all relevant imu messages have arrived and check for termination request
     if (imuFrameSynchronizer_.waitForUpToDateImuData(okvis::Time(imuDataEndTime)) == false) return;
     OKVIS_ASSERT_TRUE_DBG(Exception,
-                          imuDataEndTime < imuMeasurements_.back().timeStamp,
+                          imuDataEndTime < imuMeasurements_.newestTimeStamp(),
                           "Waiting for up to date imu data seems to have failed!");
 
     // TODO(Sharmin): check if needed to wait until all relevant sonar messages
 
-    okvis::ImuMeasurementDeque imuData = getImuMeasurments(imuDataBeginTime, imuDataEndTime);
+    okvis::ImuMeasurementSpan imuData = getImuMeasurments(imuDataBeginTime, imuDataEndTime);
 
     prepareToAddStateTimer.stop();
     // if imu_data is empty, either end_time > begin_time or
@@ -832,7 +889,7 @@ void ThreadedKFVio::matchingLoop() {
 
     // @Sharmin
     // Sonar Data
-    okvis::SonarMeasurementDeque sonarData;
+    okvis::SonarMeasurementSpan sonarData;
     if (parameters_.sensorList.isSonarUsed) {
       // -- get relevant sonar messages for new state
       okvis::Time sonarDataEndTime = frame->timestamp();
@@ -846,7 +903,7 @@ void ThreadedKFVio::matchingLoop() {
         return;
       }
       OKVIS_ASSERT_TRUE_DBG(Exception,
-                            sonarDataEndTime < sonarMeasurements_.back().timeStamp,
+                            sonarDataEndTime < sonarMeasurements_.newestTimeStamp(),
                             "Waiting for up to date sonar data seems to have failed!");
 
       sonarData = getSonarMeasurements(sonarDataBeginTime, sonarDataEndTime);
@@ -857,7 +914,7 @@ void ThreadedKFVio::matchingLoop() {
       if (sonarData.size() == 0) continue;
     }
     // Depth data
-    okvis::DepthMeasurementDeque depthData;
+    okvis::DepthMeasurementSpan depthData;
     if (parameters_.sensorList.isDepthUsed) {
       // -- get relevant depth message for new state
       okvis::Time depthDataEndTime = frame->timestamp();
@@ -871,7 +928,7 @@ void ThreadedKFVio::matchingLoop() {
         return;
       }
       OKVIS_ASSERT_TRUE_DBG(Exception,
-                            depthDataEndTime < depthMeasurements_.back().timeStamp,
+                            depthDataEndTime < depthMeasurements_.newestTimeStamp(),
                             "Waiting for up to date depth data seems to have failed!");
 
       depthData = getDepthMeasurements(depthDataBeginTime, depthDataEndTime);
@@ -890,18 +947,28 @@ void ThreadedKFVio::matchingLoop() {
     // make sure that optimization of last frame is over.
     // TODO(sharmin) If we didn't actually 'pop' the _matchedFrames queue until after optimization this would not be
     // necessary
+    okvis::timing::FrameTracer::stage(traceId, "wait for sensor data");
     {
       waitForOptimizationTimer.start();
       std::unique_lock<std::mutex> l(estimator_mutex_);
       while (!optimizationDone_) optimizationNotification_.wait(l);
       waitForOptimizationTimer.stop();
+      okvis::timing::FrameTracer::stage(traceId, "wait for optimization");
       addStateTimer.start();
       okvis::Time t0Matching = okvis::Time::now();
       bool asKeyframe = false;
       // @Sharmin
-      if (estimator_.addStates(frame, imuData, parameters_, sonarData, depthData, firstDepth_, asKeyframe)) {
+      // the IMU error term keeps its own copy of the measurements, so this is where we copy out of the buffers
+      if (estimator_.addStates(frame,
+                               imuData.toDeque(),
+                               parameters_,
+                               sonarData.toDeque(),
+                               depthData.toDeque(),
+                               firstDepth_,
+                               asKeyframe)) {
         lastAddedStateTimestamp_ = frame->timestamp();
         addStateTimer.stop();
+        okvis::timing::FrameTracer::stage(traceId, "add state");
       } else {
         LOG(ERROR) << "Failed to add state! will drop multiframe.";
         addStateTimer.stop();
@@ -914,6 +981,7 @@ void ThreadedKFVio::matchingLoop() {
       matchingTimer.start();
       frontend_.dataAssociationAndInitialization(estimator_, T_WS, parameters_, map_, frame, &asKeyframe);
       matchingTimer.stop();
+      okvis::timing::FrameTracer::stage(traceId, "matching");
       if (asKeyframe) estimator_.setKeyframe(frame->id(), asKeyframe);
       if (!blocking_) {
         double timeLimit =
@@ -939,14 +1007,9 @@ void ThreadedKFVio::imuConsumerLoop() {
     okvis::Time start;
     const okvis::Time* end;  // do not need to copy end timestamp
     {
-      std::lock_guard<std::mutex> imuLock(imuMeasurements_mutex_);
-      OKVIS_ASSERT_TRUE(Exception,
-                        imuMeasurements_.empty() || imuMeasurements_.back().timeStamp < data.timeStamp,
-                        "IMU measurement from the past received");
-
       if (parameters_.publishing.publishImuPropagatedState) {
-        if (!repropagationNeeded_ && imuMeasurements_.size() > 0) {
-          start = imuMeasurements_.back().timeStamp;
+        if (!repropagationNeeded_ && !imuMeasurements_.empty()) {
+          start = imuMeasurements_.newestTimeStamp();
         } else if (repropagationNeeded_) {
           std::lock_guard<std::mutex> lastStateLock(lastState_mutex_);
           start = lastOptimizedStateTimestamp_;
@@ -958,8 +1021,12 @@ void ThreadedKFVio::imuConsumerLoop() {
         }
         end = &data.timeStamp;
       }
-      imuMeasurements_.push_back(data);
-    }  // unlock _imuMeasurements_mutex
+      const okvis::ImuMeasurementBuffer::PushResult pushed = imuMeasurements_.push(data);
+      OKVIS_ASSERT_TRUE(
+          Exception, pushed != okvis::ImuMeasurementBuffer::OutOfOrder, "IMU measurement from the past received");
+      LOG_IF_EVERY_N(WARNING, pushed == okvis::ImuMeasurementBuffer::Full, 100)
+          << "IMU buffer full, dropped " << imuMeasurements_.numDropped() << " measurements";
+    }
 
     // notify other threads that imu data with timeStamp is here.
     imuFrameSynchronizer_.gotImuData(data.timeStamp);
@@ -969,7 +1036,7 @@ void ThreadedKFVio::imuConsumerLoop() {
       Eigen::Matrix<double, 15, 15> jacobian;
 
       // TODO(sharmin): check if using sonarMeasurements_ is ok or not? @Sharmin
-      frontend_.propagation(imuMeasurements_,
+      frontend_.propagation(imuMeasurements_.getRange(start, *end),
                             imu_params_,
                             T_WS_propagated_,
                             speedAndBiases_propagated_,
@@ -981,7 +1048,7 @@ void ThreadedKFVio::imuConsumerLoop() {
       result.stamp = *end;
       result.T_WS = T_WS_propagated_;
       result.speedAndBiases = speedAndBiases_propagated_;
-      result.omega_S = imuMeasurements_.back().measurement.gyroscopes - speedAndBiases_propagated_.segment<3>(3);
+      result.omega_S = data.measurement.gyroscopes - speedAndBiases_propagated_.segment<3>(3);
       for (size_t i = 0; i < parameters_.nCameraSystem.numCameras(); ++i) {
         result.vector_of_T_SCi.push_back(okvis::kinematics::Transformation(*parameters_.nCameraSystem.T_SC(i)));
       }
@@ -1001,21 +1068,12 @@ void ThreadedKFVio::relocConsumerLoop() {
     // get data and check for termination request
     if (relocMeasurementsReceived_.PopBlocking(&data) == false) return;
     processRelocTimer.start();
-    okvis::Time start;
-    const okvis::Time* end;  // do not need to copy end timestamp
-    {
-      std::lock_guard<std::mutex> relocLock(relocMeasurements_mutex_);
-      OKVIS_ASSERT_TRUE(Exception,
-                        relocMeasurements_.empty() || relocMeasurements_.back().timeStamp < data.timeStamp,
-                        "Reloc measurement from the past received");
-      if (relocMeasurements_.size() > 0)
-        start = relocMeasurements_.back().timeStamp;
-      else
-        start = okvis::Time(0, 0);
-      end = &data.timeStamp;
-      relocMeasurements_.push_back(data);
-      std::cout << "Read reloc data is ts: " << data.timeStamp << std::endl;
-    }  // unlock relocMeasurements_mutex_
+    const okvis::RelocMeasurementBuffer::PushResult pushed = relocMeasurements_.push(data);
+    OKVIS_ASSERT_TRUE(
+        Exception, pushed != okvis::RelocMeasurementBuffer::OutOfOrder, "Reloc measurement from the past received");
+    LOG_IF_EVERY_N(WARNING, pushed == okvis::RelocMeasurementBuffer::Full, 100)
+        << "Reloc buffer full, dropped " << relocMeasurements_.numDropped() << " measurements";
+    std::cout << "Read reloc data is ts: " << data.timeStamp << std::endl;
 
     // notify other threads that reloc data with timeStamp is here.
     relocFrameSynchronizer_.gotRelocData(data.timeStamp);
@@ -1033,20 +1091,11 @@ void ThreadedKFVio::depthConsumerLoop() {
     // get data and check for termination request
     if (depthMeasurementsReceived_.PopBlocking(&data) == false) return;
     processDepthTimer.start();
-    okvis::Time start;
-    const okvis::Time* end;  // do not need to copy end timestamp
-    {
-      std::lock_guard<std::mutex> depthLock(depthMeasurements_mutex_);
-      OKVIS_ASSERT_TRUE(Exception,
-                        depthMeasurements_.empty() || depthMeasurements_.back().timeStamp < data.timeStamp,
-                        "Depth measurement from the past received");
-      if (depthMeasurements_.size() > 0)
-        start = depthMeasurements_.back().timeStamp;
-      else
-        start = okvis::Time(0, 0);
-      end = &data.timeStamp;
-      depthMeasurements_.push_back(data);
-    }  // unlock depthMeasurements_mutex_
+    const okvis::DepthMeasurementBuffer::PushResult pushed = depthMeasurements_.push(data);
+    OKVIS_ASSERT_TRUE(
+        Exception, pushed != okvis::DepthMeasurementBuffer::OutOfOrder, "Depth measurement from the past received");
+    LOG_IF_EVERY_N(WARNING, pushed == okvis::DepthMeasurementBuffer::Full, 100)
+        << "Depth buffer full, dropped " << depthMeasurements_.numDropped() << " measurements";
 
     // notify other threads that depth data with timeStamp is here.
     depthFrameSynchronizer_.gotDepthData(data.timeStamp);
@@ -1064,20 +1113,11 @@ void ThreadedKFVio::sonarConsumerLoop() {
     // get data and check for termination request
     if (sonarMeasurementsReceived_.PopBlocking(&data) == false) return;
     processSonarTimer.start();
-    okvis::Time start;
-    const okvis::Time* end;  // do not need to copy end timestamp
-    {
-      std::lock_guard<std::mutex> sonarLock(sonarMeasurements_mutex_);
-      OKVIS_ASSERT_TRUE(Exception,
-                        sonarMeasurements_.empty() || sonarMeasurements_.back().timeStamp < data.timeStamp,
-                        "Sonar measurement from the past received");
-      if (sonarMeasurements_.size() > 0)
-        start = sonarMeasurements_.back().timeStamp;
-      else
-        start = okvis::Time(0, 0);
-      end = &data.timeStamp;
-      sonarMeasurements_.push_back(data);
-    }  // unlock sonarMeasurements_mutex_
+    const okvis::SonarMeasurementBuffer::PushResult pushed = sonarMeasurements_.push(data);
+    OKVIS_ASSERT_TRUE(
+        Exception, pushed != okvis::SonarMeasurementBuffer::OutOfOrder, "Sonar measurement from the past received");
+    LOG_IF_EVERY_N(WARNING, pushed == okvis::SonarMeasurementBuffer::Full, 100)
+        << "Sonar buffer full, dropped " << sonarMeasurements_.numDropped() << " measurements";
 
     // notify other threads that sonar data with timeStamp is here.
     sonarFrameSynchronizer_.gotSonarData(data.timeStamp);
@@ -1147,35 +1187,10 @@ void ThreadedKFVio::display() {
 }
 
 // Get a subset of the recorded IMU measurements.
-okvis::ImuMeasurementDeque ThreadedKFVio::getImuMeasurments(okvis::Time& imuDataBeginTime,
-                                                            okvis::Time& imuDataEndTime) {
-  // sanity checks:
-  // if end time is smaller than begin time, return empty queue.
-  // if begin time is larger than newest imu time, return empty queue.
-  if (imuDataEndTime < imuDataBeginTime || imuDataBeginTime > imuMeasurements_.back().timeStamp)
-    return okvis::ImuMeasurementDeque();
-
-  std::lock_guard<std::mutex> lock(imuMeasurements_mutex_);
-  // get iterator to imu data before previous frame
-  okvis::ImuMeasurementDeque::iterator first_imu_package = imuMeasurements_.begin();
-  okvis::ImuMeasurementDeque::iterator last_imu_package = imuMeasurements_.end();
-  // TODO(sharmin) go backwards through queue. Is probably faster.
-  for (auto iter = imuMeasurements_.begin(); iter != imuMeasurements_.end(); ++iter) {
-    // move first_imu_package iterator back until iter->timeStamp is higher than requested begintime
-    if (iter->timeStamp <= imuDataBeginTime) first_imu_package = iter;
-
-    // set last_imu_package iterator as soon as we hit first timeStamp higher than requested endtime & break
-    if (iter->timeStamp >= imuDataEndTime) {
-      last_imu_package = iter;
-      // since we want to include this last imu measurement in returned Deque we
-      // increase last_imu_package iterator once.
-      ++last_imu_package;
-      break;
-    }
-  }
-
-  // create copy of imu buffer
-  return okvis::ImuMeasurementDeque(first_imu_package, last_imu_package);
+okvis::ImuMeasurementSpan ThreadedKFVio::getImuMeasurments(okvis::Time& imuDataBeginTime,
+                                                           okvis::Time& imuDataEndTime) {
+  // binary search in the buffer, the sanity checks are done there
+  return imuMeasurements_.getRange(imuDataBeginTime, imuDataEndTime);
 }
 // @Sharmin
 // Get the reloc measurement in-between/nearest to start and end
@@ -1187,121 +1202,41 @@ okvis::RelocMeasurementDeque ThreadedKFVio::getRelocMeasurements(okvis::Time& be
   // sanity checks:
   // if end time is smaller than begin time, return empty queue.
   // if begin time is larger than newest sonar time, return empty queue.
-  if (endTime < beginTime || beginTime > relocMeasurements_.back().timeStamp) {
+  if (endTime < beginTime || beginTime > relocMeasurements_.newestTimeStamp()) {
     std::cout << "begin time is larger than relo time" << std::endl;
     return okvis::RelocMeasurementDeque();
   }
 
-  std::lock_guard<std::mutex> lock(relocMeasurements_mutex_);
-  // get iterator to reloc data before previous frame
-  okvis::RelocMeasurementDeque::iterator first_reloc_package = relocMeasurements_.begin();
-  okvis::RelocMeasurementDeque::iterator last_reloc_package = relocMeasurements_.end();
-
-  // TODO(sharmin) go backwards through queue. Is probably faster.
-  // TODO(Sharmin) check it
-  for (auto iter = relocMeasurements_.begin(); iter != relocMeasurements_.end(); ++iter) {
-    // move reloc_package iterator back until iter->timeStamp is higher than requested begintime
-    if (iter->timeStamp <= beginTime) first_reloc_package = iter;
-
-    if (iter->timeStamp >= endTime) {
-      last_reloc_package = iter;
-      ++last_reloc_package;
-      break;
-    }
-  }
-
-  okvis::RelocMeasurementDeque copy_buffer = okvis::RelocMeasurementDeque(first_reloc_package, last_reloc_package);
+  // reloc measurements are consumed, so we return a copy rather than a view
+  okvis::RelocMeasurementDeque copy_buffer = relocMeasurements_.getRange(beginTime, endTime).toDeque();
   // Sharmin: pop reloc data
-  relocMeasurements_.pop_front();
+  relocMeasurements_.popFront();
 
-  // create copy of reloc buffer
   return copy_buffer;
 }
 
 // @Sharmin
 // Get the depth measurement in-between/nearest to start and end. Depth sensor has a slowed rate, 1 Hz.
-okvis::DepthMeasurementDeque ThreadedKFVio::getDepthMeasurements(okvis::Time& beginTime, okvis::Time& endTime) {
-  // sanity checks:
-  // if end time is smaller than begin time, return empty queue.
-  // if begin time is larger than newest sonar time, return empty queue.
-  if (endTime < beginTime || beginTime > depthMeasurements_.back().timeStamp) return okvis::DepthMeasurementDeque();
-
-  std::lock_guard<std::mutex> lock(depthMeasurements_mutex_);
-  // get iterator to depth data before previous frame
-  okvis::DepthMeasurementDeque::iterator first_depth_package = depthMeasurements_.begin();
-  okvis::DepthMeasurementDeque::iterator last_depth_package = depthMeasurements_.end();
-
-  // TODO(sharmin) go backwards through queue. Is probably faster.
-  // TODO(Sharmin) check it
-  for (auto iter = depthMeasurements_.begin(); iter != depthMeasurements_.end(); ++iter) {
-    // move depth_package iterator back until iter->timeStamp is higher than requested begintime
-    if (iter->timeStamp <= beginTime) first_depth_package = iter;
-
-    if (iter->timeStamp >= endTime) {
-      last_depth_package = iter;
-      ++last_depth_package;
-      break;
-    }
-  }
-
-  // create copy of depth buffer
-  return okvis::DepthMeasurementDeque(first_depth_package, last_depth_package);
+okvis::DepthMeasurementSpan ThreadedKFVio::getDepthMeasurements(okvis::Time& beginTime, okvis::Time& endTime) {
+  return depthMeasurements_.getRange(beginTime, endTime);
 }
 
 // @Sharmin
 // Get a subset of the recorded Sonar measurements.
-okvis::SonarMeasurementDeque ThreadedKFVio::getSonarMeasurements(okvis::Time& sonarDataBeginTime,
-                                                                 okvis::Time& sonarDataEndTime) {
-  // sanity checks:
-  // if end time is smaller than begin time, return empty queue.
-  // if begin time is larger than newest sonar time, return empty queue.
-  if (sonarDataEndTime < sonarDataBeginTime || sonarDataBeginTime > sonarMeasurements_.back().timeStamp)
-    return okvis::SonarMeasurementDeque();
-
-  std::lock_guard<std::mutex> lock(sonarMeasurements_mutex_);
-  // get iterator to sonar data before previous frame
-  okvis::SonarMeasurementDeque::iterator first_sonar_package = sonarMeasurements_.begin();
-  okvis::SonarMeasurementDeque::iterator last_sonar_package = sonarMeasurements_.end();
-  // TODO(sharmin) go backwards through queue. Is probably faster.
-  for (auto iter = sonarMeasurements_.begin(); iter != sonarMeasurements_.end(); ++iter) {
-    // move first_sonar_package iterator back until iter->timeStamp is higher than requested begintime
-    if (iter->timeStamp <= sonarDataBeginTime) first_sonar_package = iter;
-
-    // set last_sonar_package iterator as soon as we hit first timeStamp higher than requested endtime & break
-    if (iter->timeStamp >= sonarDataEndTime) {
-      last_sonar_package = iter;
-      // since we want to include this last sonar measurement in returned Deque we
-      // increase last_sonar_package iterator once.
-      ++last_sonar_package;
-      break;
-    }
-  }
-
-  // create copy of sonar buffer
-  return okvis::SonarMeasurementDeque(first_sonar_package, last_sonar_package);
+okvis::SonarMeasurementSpan ThreadedKFVio::getSonarMeasurements(okvis::Time& sonarDataBeginTime,
+                                                                okvis::Time& sonarDataEndTime) {
+  return sonarMeasurements_.getRange(sonarDataBeginTime, sonarDataEndTime);
 }
 
 // Remove IMU measurements from the internal buffer.
 int ThreadedKFVio::deleteImuMeasurements(const okvis::Time& eraseUntil) {
-  std::lock_guard<std::mutex> lock(imuMeasurements_mutex_);
-  if (imuMeasurements_.front().timeStamp > eraseUntil) return 0;
-
-  okvis::ImuMeasurementDeque::iterator eraseEnd;
-  int removed = 0;
-  for (auto it = imuMeasurements_.begin(); it != imuMeasurements_.end(); ++it) {
-    eraseEnd = it;
-    if (it->timeStamp >= eraseUntil) break;
-    ++removed;
-  }
-
-  imuMeasurements_.erase(imuMeasurements_.begin(), eraseEnd);
-
-  return removed;
+  return static_cast<int>(imuMeasurements_.eraseUntil(eraseUntil));
 }
 
 // Loop that performs the optimization and marginalisation.
 void ThreadedKFVio::optimizationLoop() {
   TimerSwitchable optimizationTimer("3.1 optimization", true);
+  TimerSwitchable landmarkQualityTimer("3.1.1 landmarkQuality", true);
   TimerSwitchable marginalizationTimer("3.2 marginalization", true);
   TimerSwitchable afterOptimizationTimer("3.3 afterOptimization", true);
 
@@ -1311,11 +1246,14 @@ void ThreadedKFVio::optimizationLoop() {
     okvis::Time deleteImuMeasurementsUntil(0, 0);
     if (matchedFrames_.PopBlocking(&frame_pairs) == false) return;
     OptimizationResults result;
+    result.traceId = frame_pairs->timestamp().toNSec();
+    okvis::timing::FrameTracer::stage(result.traceId, "matched queue");
     {
       std::lock_guard<std::mutex> l(estimator_mutex_);
+      okvis::timing::FrameTracer::stage(result.traceId, "wait for estimator");
       optimizationTimer.start();
       // if(frontend_.isInitialized()){
-      estimator_.optimize(parameters_.optimization.max_iterations, 2, false);
+      estimator_.optimize(parameters_.optimization.max_iterations, parameters_.optimization.solverThreads, false);
       //}
       /*if (estimator_.numFrames() > 0 && !frontend_.isInitialized()){
         // undo translation
@@ -1334,6 +1272,11 @@ void ThreadedKFVio::optimizationLoop() {
       }*/
 
       optimizationTimer.stop();
+      okvis::timing::FrameTracer::stage(result.traceId, "optimization");
+      landmarkQualityTimer.start();
+      estimator_.updateLandmarks(parameters_.optimization.solverThreads);
+      landmarkQualityTimer.stop();
+      okvis::timing::FrameTracer::stage(result.traceId, "landmark quality");
 
       // get timestamp of last frame in IMU window. Need to do this before marginalization as it will be removed there
       // (if not keyframe)
@@ -1347,10 +1290,14 @@ void ThreadedKFVio::optimizationLoop() {
       estimator_.applyMarginalizationStrategy(
           parameters_.optimization.numKeyframes, parameters_.optimization.numImuFrames, result.transferredLandmarks);
       marginalizationTimer.stop();
+      okvis::timing::FrameTracer::stage(result.traceId, "marginalization");
       afterOptimizationTimer.start();
 
-      // now actually remove measurements
+      // now actually remove measurements. Sonar and depth windows start with their last measurement before the frame,
+      // which can be older than the IMU overlap for these slower sensors, so it is kept
       deleteImuMeasurements(deleteImuMeasurementsUntil);
+      sonarMeasurements_.eraseBefore(deleteImuMeasurementsUntil);
+      depthMeasurements_.eraseBefore(deleteImuMeasurementsUntil);
 
       // saving optimized state and saving it in OptimizationResults struct
       {
@@ -1379,108 +1326,42 @@ void ThreadedKFVio::optimizationLoop() {
         if (estimator_.isKeyframe(frame_pairs->id())) {
           // publish keyframe image, pose, and points
           if (keyframeCallback_ && !result.landmarksVector.empty()) {
-            {
-              std::lock_guard<std::mutex> lock(kf_f_map_mutex_);
-              kf_f_map_.insert(std::make_pair(kf_index_, frame_pairs->id()));
-            }
-
-            // @Reloc: it's redundant, but reduces a lot of hassels
-            PointMap lmMap;  // get a copy of landmarksMap_
-            estimator_.getLandmarks(lmMap);
+            keyframeIndices_[frame_pairs->id()] = kf_index_;
 
             const size_t CamIndexA = 0;                                 // for left camera
             cv::Mat image_l = frame_pairs->frames_[CamIndexA].image();  // image to publish
 
-            std::vector<std::list<std::vector<double>>> kf_points;
-            int num_keypoint = 0;
-            cv::Mat temp_image = image_l;
-
-            for (PointMap::const_iterator cit = lmMap.begin(); cit != lmMap.end(); ++cit) {
-              std::map<okvis::KeypointIdentifier, uint64_t> observations =
-                  cit->second.observations;  // result.landmarksVector.at(l).observations;
-
-              for (std::map<okvis::KeypointIdentifier, uint64_t>::iterator mit = observations.begin();
-                   mit != observations.end();
-                   ++mit) {
-                if ((mit->first).frameId == frame_pairs->id()) {
-                  std::list<std::vector<double>> ptList;
-                  int obs_num = 0;
-
-                  Eigen::Vector4d landmark = cit->second.point;  // 3D point to publish
-                  std::vector<double> pt3d;
-                  pt3d.push_back(landmark[0] / landmark[3]);
-                  pt3d.push_back(landmark[1] / landmark[3]);
-                  pt3d.push_back(landmark[2] / landmark[3]);
-                  ptList.push_back(pt3d);
-
-                  obs_num++;
-
-                  cv::KeyPoint cvkeypoint;  // Associated 2D point in left image to publish
-                  frame_pairs->getCvKeypoint(CamIndexA, (mit->first).keypointIndex, cvkeypoint);
-
-                  if ((mit->first).keypointIndex >= frame_pairs->numKeypoints(CamIndexA)) {
-                    // TODO(Sharmin): check--> to avoid segfault for being keypoint out-of-range
-
-                    // LOG(ERROR) << "Keypoint " << (mit->first).keypointIndex << " out of bounds ("
-                    //            << frame_pairs->numKeypoints(CamIndexA) << ")";
-                    break;
-                  }
-
-                  std::vector<double> pt_id_w_uv;
-                  if (isnan(cvkeypoint.pt.x) || isnan(cvkeypoint.pt.y) ||
-                      isnan(cvkeypoint.size))  // TODO(Sharmin): Better way to fix this?
-                    break;
-
-                  // @Reloc
-                  pt_id_w_uv.push_back(cit->first);                  // landmarkId
-                  pt_id_w_uv.push_back(frame_pairs->id());           // poseId or MultiFrameId
-                  pt_id_w_uv.push_back((mit->first).keypointIndex);  // keypointIdx
-                  pt_id_w_uv.push_back(cit->second.quality);         // u
-
-                  // cv::keypoint. Size 8
-                  pt_id_w_uv.push_back(kf_index_);
-                  pt_id_w_uv.push_back(cvkeypoint.pt.x);
-                  pt_id_w_uv.push_back(cvkeypoint.pt.y);
-
-                  pt_id_w_uv.push_back(cvkeypoint.size);
-                  pt_id_w_uv.push_back(cvkeypoint.angle);
-                  pt_id_w_uv.push_back(static_cast<double>(cvkeypoint.octave));
-                  pt_id_w_uv.push_back(cvkeypoint.response);
-                  pt_id_w_uv.push_back(static_cast<double>(cvkeypoint.class_id));
-
-                  ptList.push_back(pt_id_w_uv);
-
-                  obs_num++;
-
-                  for (std::map<okvis::KeypointIdentifier, uint64_t>::iterator mMPit = observations.begin();
-                       mMPit != observations.end();
-                       ++mMPit) {
-                    if ((mMPit->first).frameId == frame_pairs->id()) continue;
-
-                    {
-                      std::lock_guard<std::mutex> lock(kf_f_map_mutex_);
-                      for (std::map<int, size_t>::iterator mKfId = kf_f_map_.begin(); mKfId != kf_f_map_.end();
-                           ++mKfId) {
-                        if ((mMPit->first).frameId == mKfId->second) {
-                          ptList.push_back({mKfId->first});
-
-                          obs_num++;
-                          break;
-                        }
-                      }
-                    }
-                  }
-                  kf_points.push_back(ptList);
-
-                  num_keypoint++;
-                  break;
+            // one pass over the landmarks the keyframe observes in the left camera
+            keyframePacket_.clear();
+            keyframePacket_.frameId = frame_pairs->id();
+            keyframePacket_.keyframeIndex = kf_index_;
+            const size_t numKeypoints = frame_pairs->numKeypoints(CamIndexA);
+            keyframePacket_.reserve(numKeypoints);
+            okvis::MapPoint landmark;
+            for (size_t k = 0; k < numKeypoints; ++k) {
+              const uint64_t landmarkId = frame_pairs->landmarkId(CamIndexA, k);
+              if (landmarkId == 0 || !estimator_.isLandmarkAdded(landmarkId)) continue;
+
+              cv::KeyPoint cvkeypoint;  // Associated 2D point in left image to publish
+              frame_pairs->getCvKeypoint(CamIndexA, k, cvkeypoint);
+              if (std::isnan(cvkeypoint.pt.x) || std::isnan(cvkeypoint.pt.y) || std::isnan(cvkeypoint.size)) continue;
+
+              estimator_.getLandmark(landmarkId, landmark);
+              // indices of the other keyframes where this MapPoint has been observed
+              for (const auto& observation : landmark.observations) {
+                if (observation.first.frameId == frame_pairs->id()) continue;
+                auto keyframeIndex = keyframeIndices_.find(observation.first.frameId);
+                if (keyframeIndex != keyframeIndices_.end()) {
+                  keyframePacket_.covisibilities.push_back(keyframeIndex->second);
                 }
               }
+              keyframePacket_.add(
+                  landmark.point.head<3>() / landmark.point[3], landmarkId, k, landmark.quality, cvkeypoint);
             }
 
             okvis::kinematics::Transformation T_WCa =
                 lastOptimized_T_WS_ * (*parameters_.nCameraSystem.T_SC(CamIndexA));
-            keyframeCallback_(lastOptimizedStateTimestamp_, image_l, T_WCa, kf_points);
+            keyframeCallback_(lastOptimizedStateTimestamp_, image_l, T_WCa, keyframePacket_);
 
             std::cout << "Keyframe Index: " << kf_index_ << std::endl;
             kf_index_++;
@@ -1534,6 +1415,7 @@ void ThreadedKFVio::optimizationLoop() {
         result.vector_of_T_SCi.push_back(okvis::kinematics::Transformation(*parameters_.nCameraSystem.T_SC(i)));
       }
     }
+    okvis::timing::FrameTracer::stage(result.traceId, "after optimization");
     optimizationResults_.Push(result);
 
     // adding further elements to visualization data that do not access estimator
@@ -1551,6 +1433,7 @@ void ThreadedKFVio::publisherLoop() {
     // get the result data
     OptimizationResults result;
     if (optimizationResults_.PopBlocking(&result) == false) return;
+    okvis::timing::FrameTracer::stage(result.traceId, "results queue");
 
     // call all user callbacks
     if (stateCallback_ && !result.onlyPublishLandmarks) stateCallback_(result.stamp, result.T_WS);
@@ -1566,6 +1449,7 @@ void ThreadedKFVio::publisherLoop() {
       landmarksCallback_(result.stamp,
                          result.landmarksVector,
                          result.transferredLandmarks);  // TODO(gohlp): why two maps?
+    okvis::timing::FrameTracer::finish(result.traceId, "publish");
   }
 }
 
@@ -60,7 +60,9 @@ class MockVioBackendInterface : public VioBackendInterface {
   MOCK_METHOD3(applyMarginalizationStrategy,
                bool(size_t numKeyframes, size_t numImuFrames, okvis::MapPointVector& removedLandmarks));  // NOLINT
   MOCK_METHOD3(optimize, void(size_t, size_t, bool));
+  MOCK_METHOD1(updateLandmarks, void(size_t));
   MOCK_METHOD2(setOptimizationTimeLimit, bool(double timeLimit, int minIterations));
+  MOCK_METHOD1(setSolverOptions, bool(const okvis::Optimization& optimization));
   MOCK_CONST_METHOD1(isLandmarkAdded, bool(uint64_t landmarkId));
   MOCK_CONST_METHOD1(isLandmarkInitialized, bool(uint64_t landmarkId));
   MOCK_CONST_METHOD2(getLandmark, bool(uint64_t landmarkId, MapPoint& mapPoint));  // NOLINT
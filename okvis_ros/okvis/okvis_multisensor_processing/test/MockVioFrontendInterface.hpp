@@ -58,7 +58,7 @@ class MockVioFrontendInterface {
                     std::shared_ptr<okvis::MultiFrame> framesInOut,
                     bool* asKeyframe));
   MOCK_CONST_METHOD8(propagation,
-                     bool(const okvis::ImuMeasurementDeque& imuMeasurements,
+                     bool(const okvis::ImuMeasurementSpan& imuMeasurements,
                           const okvis::ImuParameters& imuParams,
                           okvis::kinematics::Transformation& T_WS_propagated,  // NOLINT
                           okvis::SpeedAndBias& speedAndBiases,                 // NOLINT
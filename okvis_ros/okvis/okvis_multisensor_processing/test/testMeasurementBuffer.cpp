@@ -0,0 +1,238 @@
+#include <chrono>
+#include <iostream>
+#include <okvis/MeasurementBuffer.hpp>
+#include <okvis/Measurements.hpp>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+okvis::ImuMeasurement makeImuMeasurement(double t) {
+  okvis::ImuMeasurement imu;
+  imu.timeStamp = okvis::Time(t);
+  imu.measurement.gyroscopes = Eigen::Vector3d(t, 0.0, 0.0);
+  imu.measurement.accelerometers = Eigen::Vector3d(0.0, 0.0, 9.81);
+  return imu;
+}
+
+// the window extraction ThreadedKFVio used to do on a std::deque, as reference
+okvis::ImuMeasurementDeque getRangeFromDeque(const okvis::ImuMeasurementDeque& imuMeasurements,
+                                             const okvis::Time& imuDataBeginTime,
+                                             const okvis::Time& imuDataEndTime) {
+  if (imuMeasurements.empty() || imuDataEndTime < imuDataBeginTime ||
+      imuDataBeginTime > imuMeasurements.back().timeStamp)
+    return okvis::ImuMeasurementDeque();
+
+  okvis::ImuMeasurementDeque::const_iterator first_imu_package = imuMeasurements.begin();
+  okvis::ImuMeasurementDeque::const_iterator last_imu_package = imuMeasurements.end();
+  for (auto iter = imuMeasurements.begin(); iter != imuMeasurements.end(); ++iter) {
+    if (iter->timeStamp <= imuDataBeginTime) first_imu_package = iter;
+    if (iter->timeStamp >= imuDataEndTime) {
+      last_imu_package = iter;
+      ++last_imu_package;
+      break;
+    }
+  }
+  return okvis::ImuMeasurementDeque(first_imu_package, last_imu_package);
+}
+
+// the IMU deletion ThreadedKFVio used to do on a std::deque, as reference
+int eraseUntilFromDeque(okvis::ImuMeasurementDeque& imuMeasurements, const okvis::Time& eraseUntil) {  // NOLINT
+  if (imuMeasurements.front().timeStamp > eraseUntil) return 0;
+  okvis::ImuMeasurementDeque::iterator eraseEnd;
+  int removed = 0;
+  for (auto it = imuMeasurements.begin(); it != imuMeasurements.end(); ++it) {
+    eraseEnd = it;
+    if (it->timeStamp >= eraseUntil) break;
+    ++removed;
+  }
+  imuMeasurements.erase(imuMeasurements.begin(), eraseEnd);
+  return removed;
+}
+
+}  // namespace
+
+TEST(MeasurementBuffer, rangeMatchesDequeScan) {
+  okvis::ImuMeasurementBuffer buffer(256);
+  okvis::ImuMeasurementDeque deque;
+  for (int i = 0; i < 200; ++i) {
+    okvis::ImuMeasurement imu = makeImuMeasurement(10.0 + 0.005 * i);
+    EXPECT_EQ(buffer.push(imu), okvis::ImuMeasurementBuffer::Pushed);
+    deque.push_back(imu);
+  }
+  // out of order measurements are rejected
+  EXPECT_EQ(buffer.push(makeImuMeasurement(10.0)), okvis::ImuMeasurementBuffer::OutOfOrder);
+  EXPECT_EQ(buffer.size(), 200u);
+
+  const double queries[][2] = {{9.0, 9.5},     {9.0, 10.3},     {10.0, 10.0},   {10.0021, 10.2487},
+                               {10.25, 10.25}, {10.5, 11.5},    {10.99, 12.0},  {11.0, 12.0},
+                               {10.3, 10.2},   {10.7333, 10.74}};
+  for (const auto& query : queries) {
+    const okvis::Time begin(query[0]);
+    const okvis::Time end(query[1]);
+    okvis::ImuMeasurementSpan span = buffer.getRange(begin, end);
+    okvis::ImuMeasurementDeque reference = getRangeFromDeque(deque, begin, end);
+    ASSERT_EQ(span.size(), reference.size()) << "query [" << query[0] << ", " << query[1] << "]";
+    size_t i = 0;
+    for (okvis::ImuMeasurementSpan::const_iterator it = span.begin(); it != span.end(); ++it, ++i) {
+      EXPECT_EQ(it->timeStamp, reference[i].timeStamp);
+    }
+    EXPECT_TRUE(span.valid());
+  }
+}
+
+TEST(MeasurementBuffer, eraseMatchesDeque) {
+  okvis::ImuMeasurementBuffer buffer(256);
+  okvis::ImuMeasurementDeque deque;
+  for (int i = 0; i < 100; ++i) {
+    okvis::ImuMeasurement imu = makeImuMeasurement(1.0 + 0.01 * i);
+    buffer.push(imu);
+    deque.push_back(imu);
+  }
+  EXPECT_EQ(buffer.eraseUntil(okvis::Time(0.5)), 0u);
+  const int removed = eraseUntilFromDeque(deque, okvis::Time(1.255));
+  EXPECT_EQ(buffer.eraseUntil(okvis::Time(1.255)), static_cast<size_t>(removed));
+  EXPECT_EQ(buffer.size(), deque.size());
+  EXPECT_EQ(buffer.oldestTimeStamp(), deque.front().timeStamp);
+
+  // the newest measurement is always kept
+  buffer.eraseUntil(okvis::Time(5.0));
+  EXPECT_EQ(buffer.size(), 1u);
+  EXPECT_EQ(buffer.newestTimeStamp(), deque.back().timeStamp);
+}
+
+TEST(MeasurementBuffer, fullBufferDropsNewest) {
+  okvis::ImuMeasurementBuffer buffer(16);
+  ASSERT_EQ(buffer.capacity(), 16u);
+  for (int i = 0; i < 16; ++i) buffer.push(makeImuMeasurement(1.0 + 0.1 * i));
+  okvis::ImuMeasurementSpan oldest = buffer.getRange(okvis::Time(1.0), okvis::Time(1.2));
+  const okvis::ImuMeasurement oldestMeasurement = oldest.front();
+
+  // the held measurements are never overwritten
+  EXPECT_EQ(buffer.push(makeImuMeasurement(2.6)), okvis::ImuMeasurementBuffer::Full);
+  EXPECT_EQ(buffer.size(), 16u);
+  EXPECT_EQ(buffer.numDropped(), 1u);
+  EXPECT_TRUE(oldest.valid());
+  EXPECT_EQ(oldest.front().timeStamp, oldestMeasurement.timeStamp);
+  EXPECT_EQ(buffer.newestTimeStamp(), okvis::Time(2.5));
+
+  // until they are removed
+  EXPECT_EQ(buffer.eraseUntil(okvis::Time(1.25)), 3u);
+  EXPECT_FALSE(oldest.valid());
+  EXPECT_EQ(buffer.push(makeImuMeasurement(2.6)), okvis::ImuMeasurementBuffer::Pushed);
+  EXPECT_EQ(buffer.oldestTimeStamp(), okvis::Time(1.3));
+  EXPECT_EQ(buffer.newestTimeStamp(), okvis::Time(2.6));
+}
+
+TEST(MeasurementBuffer, eraseBeforeKeepsWindowStart) {
+  okvis::ImuMeasurementBuffer buffer(16);
+  for (int i = 0; i < 10; ++i) buffer.push(makeImuMeasurement(1.0 + i));
+  const okvis::Time windowBegin(4.5);
+  const okvis::Time windowStart = buffer.getRange(windowBegin, okvis::Time(6.0)).front().timeStamp;
+  EXPECT_EQ(buffer.eraseBefore(okvis::Time(0.5)), 0u);
+  EXPECT_EQ(buffer.eraseBefore(okvis::Time(4.2)), 3u);
+  EXPECT_EQ(buffer.oldestTimeStamp(), windowStart);
+  EXPECT_EQ(buffer.getRange(windowBegin, okvis::Time(6.0)).front().timeStamp, windowStart);
+  // the newest measurement is always kept
+  EXPECT_EQ(buffer.eraseBefore(okvis::Time(20.0)), 6u);
+  EXPECT_EQ(buffer.size(), 1u);
+}
+
+// The depth cycle of ThreadedKFVio: 1 Hz depth read at 20 Hz frames and trimmed behind the IMU window, for many times
+// the capacity of the buffer.
+TEST(MeasurementBuffer, depthCycleNeverFills) {
+  okvis::DepthMeasurementBuffer buffer(16);
+  const double depthPeriod = 1.0;
+  const double framePeriod = 0.05;
+  const int numImuFrames = 3;
+  const size_t numDepth = 10 * buffer.capacity();
+  size_t numPushed = 0;
+  okvis::Time lastFrame(0.0);
+  for (double t = 0.5; numPushed < numDepth; t += framePeriod) {
+    // the depth synchronizer waits for a measurement newer than the frame
+    const okvis::Time frame(t);
+    while (buffer.empty() || buffer.newestTimeStamp() < frame) {
+      okvis::DepthMeasurement depth;
+      depth.timeStamp = okvis::Time(numPushed * depthPeriod + 0.01);
+      depth.measurement.depth = 1.0;
+      ASSERT_EQ(buffer.push(depth), okvis::DepthMeasurementBuffer::Pushed) << "at " << t;
+      ++numPushed;
+    }
+    // consume the window of the frame, it starts with the last depth measurement before the previous frame
+    okvis::DepthMeasurementSpan window = buffer.getRange(lastFrame, frame);
+    ASSERT_FALSE(window.empty()) << "at " << t;
+    if (lastFrame >= buffer.oldestTimeStamp()) EXPECT_FALSE(lastFrame < window.front().timeStamp) << "at " << t;
+    lastFrame = frame;
+    // trim as the optimization loop does
+    buffer.eraseBefore(frame - okvis::Duration(numImuFrames * framePeriod + 0.02));
+    EXPECT_TRUE(window.valid());
+  }
+  EXPECT_LE(buffer.size(), 3u);
+  EXPECT_EQ(buffer.numDropped(), 0u);
+}
+
+// Window extraction as done by the frame consumer and matching loops: 800 Hz IMU, 20 Hz stereo.
+TEST(MeasurementBuffer, benchmarkImuWindowExtraction) {
+  const double imuRate = 800.0;
+  const double cameraRate = 20.0;
+  const double duration = 600.0;
+  const double overlap = 0.02;  // temporal_imu_data_overlap in ThreadedKFVio
+  const int numImuFrames = 3;
+
+  okvis::ImuMeasurementBuffer buffer(30.0 * imuRate);
+  okvis::ImuMeasurementDeque deque;
+
+  typedef std::chrono::steady_clock clock;
+  clock::duration bufferTime = clock::duration::zero();
+  clock::duration dequeTime = clock::duration::zero();
+  size_t bufferWindowSize = 0;
+  size_t dequeWindowSize = 0;
+  size_t numFrames = 0;
+
+  const int imuPerFrame = static_cast<int>(imuRate / cameraRate);
+  double lastFrameTime = 0.0;
+  for (int i = 0; i < static_cast<int>(duration * imuRate); ++i) {
+    okvis::ImuMeasurement imu = makeImuMeasurement(1.0 + i / imuRate);
+    buffer.push(imu);
+    deque.push_back(imu);
+    if (i % imuPerFrame != imuPerFrame - 1 || i < imuPerFrame * 2) continue;
+
+    // a (stereo) frame arrives slightly before the newest IMU measurement
+    const double frameTime = imu.timeStamp.toSec() - 2.5 / imuRate - overlap;
+    if (lastFrameTime == 0.0) {
+      lastFrameTime = frameTime - 1.0 / cameraRate;
+    }
+    okvis::Time begin(lastFrameTime - overlap);
+    okvis::Time end(frameTime + overlap);
+    okvis::Time eraseUntil(frameTime - numImuFrames / cameraRate - overlap);
+
+    clock::time_point t0 = clock::now();
+    for (int loop = 0; loop < 2; ++loop) {  // frameConsumerLoop and matchingLoop
+      okvis::ImuMeasurementSpan window = buffer.getRange(begin, end);
+      bufferWindowSize += window.size();
+    }
+    buffer.eraseUntil(eraseUntil);
+    clock::time_point t1 = clock::now();
+    for (int loop = 0; loop < 2; ++loop) {
+      okvis::ImuMeasurementDeque window = getRangeFromDeque(deque, begin, end);
+      dequeWindowSize += window.size();
+    }
+    eraseUntilFromDeque(deque, eraseUntil);
+    clock::time_point t2 = clock::now();
+
+    bufferTime += t1 - t0;
+    dequeTime += t2 - t1;
+    lastFrameTime = frameTime;
+    ++numFrames;
+  }
+
+  EXPECT_EQ(bufferWindowSize, dequeWindowSize);
+  EXPECT_EQ(buffer.size(), deque.size());
+  EXPECT_EQ(buffer.numDropped(), 0u);
+
+  const double bufferUs = std::chrono::duration<double, std::micro>(bufferTime).count() / numFrames;
+  const double dequeUs = std::chrono::duration<double, std::micro>(dequeTime).count() / numFrames;
+  std::cout << "IMU window extraction per frame (" << imuRate << " Hz IMU, " << cameraRate << " Hz stereo, "
+            << numFrames << " frames): MeasurementBuffer " << bufferUs << " us, std::deque copy " << dequeUs
+            << " us" << std::endl;
+}
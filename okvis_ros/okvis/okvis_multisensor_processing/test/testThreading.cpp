@@ -8,8 +8,15 @@
 #include <opencv2/highgui/highgui.hpp>
 #pragma GCC diagnostic pop
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <okvis/ThreadedKFVio.hpp>
 #include <okvis/kinematics/Transformation.hpp>
+#include <okvis/threadsafe/LockFreeQueue.hpp>
+#include <okvis/threadsafe/ThreadsafeQueue.hpp>
+#include <thread>
+#include <vector>
 
 #include "MockVioBackendInterface.hpp"
 #include "MockVioFrontendInterface.hpp"
@@ -125,3 +132,87 @@ TEST(OkvisVioInterfaces, testDestructionWithIMUData) {
         okvis::Time(now + j * 0.01), imu_data.measurement.accelerometers, imu_data.measurement.gyroscopes);
   }
 }
+
+namespace {
+
+typedef std::chrono::steady_clock::rep TimePoint;
+
+// Push timestamps from several producers into one consumer and collect the push-to-pop latencies [ns].
+template <class QUEUE_T>
+std::vector<TimePoint> measurePushToPopLatency(QUEUE_T& queue, int numProducers, int numPushesPerProducer) {
+  std::vector<TimePoint> latencies;
+  latencies.reserve(numProducers * numPushesPerProducer);
+  std::thread consumer([&] {
+    TimePoint pushTime;
+    for (int i = 0; i < numProducers * numPushesPerProducer; ++i) {
+      if (!queue.PopBlocking(&pushTime)) return;
+      latencies.push_back(std::chrono::steady_clock::now().time_since_epoch().count() - pushTime);
+    }
+  });
+  std::vector<std::thread> producers;
+  for (int p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < numPushesPerProducer; ++i) {
+        queue.PushBlockingIfFull(std::chrono::steady_clock::now().time_since_epoch().count(), 64);
+      }
+    });
+  }
+  for (std::thread& producer : producers) producer.join();
+  consumer.join();
+  return latencies;
+}
+
+void printLatencies(const std::string& name, int numProducers, std::vector<TimePoint> latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] * 1e-3; };
+  std::cout << name << ", " << numProducers << " producer(s): push to pop latency p50 " << percentile(0.5)
+            << " us, p99 " << percentile(0.99) << " us, p99.9 " << percentile(0.999) << " us, max "
+            << percentile(1.0) << " us" << std::endl;
+}
+
+}  // namespace
+
+// Contention benchmark of the two queue backends: one consumer, one (SPSC) or several (MPSC) producers.
+TEST(ThreadSafeQueue, benchmarkContention) {
+  const int numPushes = 100000;
+  for (int numProducers : {1, 4}) {
+    okvis::threadsafe::ThreadSafeQueue<TimePoint> lockedQueue;
+    std::vector<TimePoint> locked = measurePushToPopLatency(lockedQueue, numProducers, numPushes / numProducers);
+    okvis::threadsafe::LockFreeQueue<TimePoint> lockFreeQueue(64);
+    std::vector<TimePoint> lockFree = measurePushToPopLatency(lockFreeQueue, numProducers, numPushes / numProducers);
+
+    ASSERT_EQ(locked.size(), lockFree.size());
+    EXPECT_TRUE(lockFreeQueue.Empty());
+    printLatencies("ThreadSafeQueue", numProducers, locked);
+    printLatencies("LockFreeQueue", numProducers, lockFree);
+  }
+}
+
+TEST(ThreadSafeQueue, lockFreeQueueSemantics) {
+  okvis::threadsafe::LockFreeQueue<int> queue(4);
+  EXPECT_EQ(queue.Capacity(), 4u);
+  EXPECT_FALSE(queue.PushNonBlockingDroppingIfFull(1, 3));
+  EXPECT_FALSE(queue.PushNonBlockingDroppingIfFull(2, 3));
+  EXPECT_FALSE(queue.PushNonBlockingDroppingIfFull(3, 3));
+  EXPECT_TRUE(queue.PushNonBlockingDroppingIfFull(4, 3));  // drops 1
+  EXPECT_EQ(queue.Size(), 3u);
+
+  int value = 0;
+  EXPECT_TRUE(queue.PopBlocking(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_TRUE(queue.PopNonBlocking(&value));
+  EXPECT_EQ(value, 3);
+  EXPECT_TRUE(queue.PopTimeout(&value, 1000000));
+  EXPECT_EQ(value, 4);
+  EXPECT_FALSE(queue.PopTimeout(&value, 1000000));
+  EXPECT_FALSE(queue.PopNonBlocking(&value));
+
+  // a blocked consumer returns false on shutdown
+  std::thread consumer([&] { EXPECT_FALSE(queue.PopBlocking(&value)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.Shutdown();
+  consumer.join();
+  EXPECT_FALSE(queue.PushBlockingIfFull(5, 1));
+  queue.Resume();
+  EXPECT_TRUE(queue.PushBlockingIfFull(5, 1));
+}
@@ -0,0 +1,138 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file FrameTracer.hpp
+ * @brief Header file for the FrameTracer class.
+ */
+
+#ifndef INCLUDE_OKVIS_TIMING_FRAMETRACER_HPP_
+#define INCLUDE_OKVIS_TIMING_FRAMETRACER_HPP_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace okvis {
+namespace timing {
+
+/**
+ * @brief Records the stages every multiframe goes through, from image arrival to state publication, in the Chrome
+ *        trace-event JSON format (chrome://tracing, ui.perfetto.dev).
+ *
+ * A frame is identified by an id the stages agree on, e.g. the multiframe timestamp in nanoseconds. Every stage is a
+ * slice on the thread that recorded it, connected to the other stages of its frame by flow arrows, and the whole
+ * frame is one asynchronous slice. Waiting in queues and for mutexes are stages too.
+ *
+ * All functions are thread safe. As long as tracing is not started they only load an atomic flag.
+ */
+class FrameTracer {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// \brief Is tracing running?
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Start writing the trace to a file. A running trace is stopped first.
+   * @return False if the file could not be created.
+   */
+  static bool start(const std::string& path);
+
+  /// \brief Write the remaining events and close the file.
+  static void stop();
+
+  /**
+   * @brief Record a stage of a frame.
+   * @param frameId The frame.
+   * @param name Name of the stage. Must be a string literal or outlive the trace.
+   * @param start Begin of the stage.
+   * @param end End of the stage.
+   */
+  static void span(uint64_t frameId, const char* name, Clock::time_point start, Clock::time_point end);
+
+  /// \brief Record a stage from the end of the latest stage of the frame until now.
+  static void stage(uint64_t frameId, const char* name);
+
+  /**
+   * @brief Record the last stage of a frame, like stage(), and the whole frame.
+   *
+   * Frames with smaller ids that did not finish, e.g. because they were dropped, are forgotten.
+   */
+  static void finish(uint64_t frameId, const char* name);
+
+ private:
+  /// \brief A stage as written to the file.
+  struct Event {
+    const char* name;    ///< Name of the stage, nullptr for a whole frame.
+    uint64_t frameId;    ///< The frame.
+    int64_t startUs;     ///< Begin in microseconds since start().
+    int64_t durationUs;  ///< Duration in microseconds.
+    uint32_t threadId;   ///< Small number of the recording thread.
+    char flow;           ///< Chrome flow phase: 's' first stage of the frame, 't' further, 'f' last.
+  };
+
+  /// \brief What is known about a frame that did not finish yet.
+  struct FrameState {
+    Clock::time_point first;  ///< Begin of its first stage.
+    Clock::time_point last;   ///< End of its latest stage.
+  };
+
+  static FrameTracer& instance();
+
+  /// \brief Queue an event, lock mutex_.
+  void record(uint64_t frameId, const char* name, Clock::time_point start, Clock::time_point end, char flow);
+  /// \brief Small number of the calling thread, lock mutex_.
+  uint32_t threadId();
+  /// \brief Write and clear the queued events, lock mutex_.
+  void flush();
+
+  static std::atomic<bool> enabled_;  ///< Is tracing running?
+
+  std::mutex mutex_;                               ///< Lock when accessing any of the below.
+  std::ofstream file_;                             ///< The trace.
+  bool fileEmpty_ = true;                          ///< No event written to file_ yet.
+  Clock::time_point origin_;                     ///< Time zero of the trace.
+  std::map<uint64_t, FrameState> frames_;          ///< Frames that did not finish, by id.
+  std::vector<Event> events_;                      ///< Events not written yet.
+  std::map<std::thread::id, uint32_t> threadIds_;  ///< Small numbers of the threads.
+};
+
+}  // namespace timing
+}  // namespace okvis
+
+#endif  // INCLUDE_OKVIS_TIMING_FRAMETRACER_HPP_
@@ -0,0 +1,128 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file LatencyHistogram.hpp
+ * @brief Header file for the LatencyHistogram class.
+ */
+
+#ifndef INCLUDE_OKVIS_TIMING_LATENCYHISTOGRAM_HPP_
+#define INCLUDE_OKVIS_TIMING_LATENCYHISTOGRAM_HPP_
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace okvis {
+namespace timing {
+
+/**
+ * @brief Logarithmic buckets: every power of two is split into kSubBuckets equal parts, so a bucket is at most
+ *        1/kSubBuckets of its value wide. Bucket 0 takes zero, negative and tiny values, the last one the huge ones.
+ *
+ * pose_graph's utils::Statistics uses the same layout, that keeps the snapshots of both pipelines mergeable.
+ */
+struct HistogramLayout {
+  static constexpr int kSubBucketBits = 5;                              ///< log2 of the buckets per power of two.
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;               ///< Buckets per power of two.
+  static constexpr int kMinExponent = -30;                              ///< Values below 2^-31 go to bucket 0.
+  static constexpr int kNumOctaves = 64;                                ///< Powers of two covered.
+  static constexpr size_t kNumBuckets = 1 + kNumOctaves * kSubBuckets;  ///< Including the underflow bucket.
+
+  /// \brief Bucket of a value.
+  static size_t index(double value);
+  /// \brief Smallest value of a bucket.
+  static double lowerBound(size_t index);
+  /// \brief Smallest value of the next bucket.
+  static double upperBound(size_t index);
+};
+
+/// \brief Contents of a histogram at one point in time.
+struct HistogramSnapshot {
+  uint64_t count = 0;            ///< Number of values.
+  double sum = 0.0;              ///< Sum of the values.
+  double min = 0.0;              ///< Smallest value, if count > 0.
+  double max = 0.0;              ///< Largest value, if count > 0.
+  std::vector<uint64_t> buckets;  ///< Number of values per bucket of HistogramLayout, or empty if count == 0.
+
+  /// \brief Mean of the values.
+  double mean() const { return count > 0 ? sum / count : 0.0; }
+
+  /**
+   * @brief Value below which percentile percent of the values are, accurate to the bucket width.
+   * @param[in] percentile Between 0 and 100.
+   * @return The middle of the bucket holding the percentile, clamped to [min, max]. 0 if empty.
+   */
+  double percentile(double percentile) const;
+
+  /// \brief Add the values of another histogram, e.g. of the same timer in another process.
+  void merge(const HistogramSnapshot& other);
+
+  /**
+   * @brief The values added after an earlier snapshot of the same histogram, i.e. a rolling window.
+   * @note Minimum and maximum are only known to the bucket width.
+   */
+  HistogramSnapshot since(const HistogramSnapshot& earlier) const;
+};
+
+/**
+ * @brief Histogram of positive values such as latencies, accurate to about 3%.
+ *
+ * Adding a value is lock-free and wait-free apart from the minimum, maximum and sum, which are updated with
+ * compare-and-swap loops. Any number of threads may add and take snapshots at the same time.
+ */
+class LatencyHistogram {
+ public:
+  /// \brief Constructor.
+  LatencyHistogram();
+
+  /// \brief Add a value.
+  void add(double value);
+
+  /// \brief Remove all values. Not atomic with respect to concurrent add().
+  void reset();
+
+  /// \brief Copy of the current contents. Concurrent add() calls may be partially included.
+  HistogramSnapshot snapshot() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, HistogramLayout::kNumBuckets> buckets_;  ///< Number of values per bucket.
+  std::atomic<uint64_t> count_;  ///< Number of values.
+  std::atomic<double> sum_;      ///< Sum of the values.
+  std::atomic<double> min_;      ///< Smallest value.
+  std::atomic<double> max_;      ///< Largest value.
+};
+
+}  // namespace timing
+}  // namespace okvis
+
+#endif  // INCLUDE_OKVIS_TIMING_LATENCYHISTOGRAM_HPP_
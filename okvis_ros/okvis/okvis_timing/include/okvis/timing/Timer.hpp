@@ -50,8 +50,11 @@
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 #include <boost/accumulators/statistics/rolling_mean.hpp>
+#include <deque>
 #include <mutex>
 #include <okvis/assert_macros.hpp>
+#include <okvis/timing/LatencyHistogram.hpp>
+#include <okvis/timing/TimingSnapshot.hpp>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -69,6 +72,10 @@ OKVIS_DEFINE_EXCEPTION(TimerException, std::runtime_error)
 struct TimerMapValue {
   // Initialize the window size for the rolling mean.
   TimerMapValue() : m_acc(boost::accumulators::tag::rolling_window::window_size = 50) {}
+  void reset() {
+    m_acc = decltype(m_acc)(boost::accumulators::tag::rolling_window::window_size = 50);
+    m_histogram.reset();
+  }
   boost::accumulators::accumulator_set<double,
                                        boost::accumulators::features<boost::accumulators::tag::lazy_variance,
                                                                      boost::accumulators::tag::sum,
@@ -77,6 +84,8 @@ struct TimerMapValue {
                                                                      boost::accumulators::tag::rolling_mean,
                                                                      boost::accumulators::tag::mean> >
       m_acc;
+  // All timings, for the percentiles.
+  LatencyHistogram m_histogram;
 };
 
 // A class that has the timer interface but does nothing.
@@ -138,6 +147,11 @@ class Timing {
   static double getMaxSeconds(std::string const& tag);
   static double getHz(size_t handle);
   static double getHz(std::string const& tag);
+  // percentile between 0 and 100, accurate to about 3%
+  static double getPercentileSeconds(size_t handle, double percentile);
+  static double getPercentileSeconds(std::string const& tag, double percentile);
+  // The histograms of all timers. Take one periodically and use TimingSnapshot::since() for rolling windows.
+  static TimingSnapshot snapshot();
   static void print(std::ostream& out);
   static void reset(size_t handle);
   static void reset(std::string const& tag);
@@ -154,7 +168,7 @@ class Timing {
   ~Timing();
 
   typedef std::unordered_map<std::string, size_t> map_t;
-  typedef std::vector<TimerMapValue> list_t;
+  typedef std::deque<TimerMapValue> list_t;  // the histograms can not be moved
 
   std::mutex addNewHandleMutex_;
 
@@ -0,0 +1,79 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file TimingSnapshot.hpp
+ * @brief Header file for the TimingSnapshot struct.
+ */
+
+#ifndef INCLUDE_OKVIS_TIMING_TIMINGSNAPSHOT_HPP_
+#define INCLUDE_OKVIS_TIMING_TIMINGSNAPSHOT_HPP_
+
+#include <iostream>
+#include <map>
+#include <okvis/timing/LatencyHistogram.hpp>
+#include <string>
+
+namespace okvis {
+namespace timing {
+
+/**
+ * @brief The histograms of several timers by tag, e.g. taken from Timing::snapshot() periodically.
+ *
+ * The text format of write() and read() is shared with pose_graph's utils::Statistics::WriteSnapshot(), so the
+ * timings of both pipelines can be merged into one report, see the okvis_timing_report tool. Timing stores seconds,
+ * utils::Statistics the unit in its tags.
+ */
+struct TimingSnapshot {
+  std::map<std::string, HistogramSnapshot> histograms;  ///< Histograms by tag.
+
+  /// \brief Add the histograms of another snapshot, tags present in both are merged.
+  void merge(const TimingSnapshot& other);
+
+  /// \brief The values added after an earlier snapshot, i.e. a rolling window.
+  TimingSnapshot since(const TimingSnapshot& earlier) const;
+
+  /// \brief Write in the text format: one line per tag, its fields separated by tabs.
+  void write(std::ostream& out) const;
+
+  /**
+   * @brief Read what write() wrote.
+   * @return False if the stream is not a snapshot, the histograms read so far are kept.
+   */
+  bool read(std::istream& in);
+
+  /// \brief Print a table with the number of values, mean, 50th, 95th, 99th, 99.9th percentile and maximum per tag.
+  void print(std::ostream& out) const;
+};
+
+}  // namespace timing
+}  // namespace okvis
+
+#endif  // INCLUDE_OKVIS_TIMING_TIMINGSNAPSHOT_HPP_
@@ -0,0 +1,170 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file FrameTracer.cpp
+ * @brief Source file for the FrameTracer class.
+ */
+
+#include <algorithm>
+#include <okvis/timing/FrameTracer.hpp>
+
+namespace okvis {
+namespace timing {
+
+namespace {
+const size_t kFlushEvents = 1024;   // events queued before they are written
+const size_t kMaxOpenFrames = 1000;  // frames that never finish are forgotten beyond this
+}  // namespace
+
+std::atomic<bool> FrameTracer::enabled_(false);
+
+FrameTracer& FrameTracer::instance() {
+  static FrameTracer tracer;
+  return tracer;
+}
+
+// Start writing the trace to a file.
+bool FrameTracer::start(const std::string& path) {
+  stop();
+  FrameTracer& tracer = instance();
+  std::lock_guard<std::mutex> lock(tracer.mutex_);
+  tracer.file_.open(path);
+  if (!tracer.file_.good()) return false;
+  tracer.file_ << "[\n";
+  tracer.fileEmpty_ = true;
+  tracer.origin_ = Clock::now();
+  enabled_ = true;
+  return true;
+}
+
+// Write the remaining events and close the file.
+void FrameTracer::stop() {
+  FrameTracer& tracer = instance();
+  std::lock_guard<std::mutex> lock(tracer.mutex_);
+  if (!enabled_) return;
+  enabled_ = false;
+  tracer.flush();
+  tracer.file_ << "\n]\n";
+  tracer.file_.close();
+  tracer.frames_.clear();
+}
+
+// Record a stage of a frame.
+void FrameTracer::span(uint64_t frameId, const char* name, Clock::time_point start, Clock::time_point end) {
+  if (!enabled()) return;
+  FrameTracer& tracer = instance();
+  std::lock_guard<std::mutex> lock(tracer.mutex_);
+  if (!enabled_) return;
+  tracer.record(frameId, name, start, end, 't');
+}
+
+// Record a stage from the end of the latest stage of the frame until now.
+void FrameTracer::stage(uint64_t frameId, const char* name) {
+  if (!enabled()) return;
+  const Clock::time_point now = Clock::now();
+  FrameTracer& tracer = instance();
+  std::lock_guard<std::mutex> lock(tracer.mutex_);
+  if (!enabled_) return;
+  auto frame = tracer.frames_.find(frameId);
+  if (frame == tracer.frames_.end()) return;  // nothing to start the stage from
+  tracer.record(frameId, name, frame->second.last, now, 't');
+}
+
+// Record the last stage of a frame and the whole frame.
+void FrameTracer::finish(uint64_t frameId, const char* name) {
+  if (!enabled()) return;
+  const Clock::time_point now = Clock::now();
+  FrameTracer& tracer = instance();
+  std::lock_guard<std::mutex> lock(tracer.mutex_);
+  if (!enabled_) return;
+  auto frame = tracer.frames_.find(frameId);
+  if (frame == tracer.frames_.end()) return;
+  const Clock::time_point first = frame->second.first;
+  tracer.record(frameId, name, frame->second.last, now, 'f');
+  tracer.record(frameId, nullptr, first, now, 0);
+  tracer.frames_.erase(tracer.frames_.begin(), tracer.frames_.upper_bound(frameId));
+}
+
+// Queue an event.
+void FrameTracer::record(uint64_t frameId, const char* name, Clock::time_point start, Clock::time_point end,
+                         char flow) {
+  if (name != nullptr) {
+    auto inserted = frames_.emplace(frameId, FrameState{start, end});
+    if (inserted.second) {
+      flow = 's';
+      if (frames_.size() > kMaxOpenFrames) frames_.erase(frames_.begin());
+    } else {
+      inserted.first->second.first = std::min(inserted.first->second.first, start);
+      inserted.first->second.last = std::max(inserted.first->second.last, end);
+    }
+  }
+  Event event;
+  event.name = name;
+  event.frameId = frameId;
+  event.startUs = std::chrono::duration_cast<std::chrono::microseconds>(start - origin_).count();
+  event.durationUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+  event.threadId = threadId();
+  event.flow = flow;
+  events_.push_back(event);
+  if (events_.size() >= kFlushEvents) flush();
+}
+
+// Small number of the calling thread.
+uint32_t FrameTracer::threadId() {
+  return threadIds_.emplace(std::this_thread::get_id(), static_cast<uint32_t>(threadIds_.size() + 1)).first->second;
+}
+
+// Write and clear the queued events. Ids are strings, nanosecond timestamps do not fit into a JavaScript number.
+void FrameTracer::flush() {
+  for (const Event& event : events_) {
+    file_ << (fileEmpty_ ? "" : ",\n");
+    fileEmpty_ = false;
+    if (event.name == nullptr) {
+      // the whole frame as asynchronous slice, one row per frame in flight
+      file_ << "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"b\",\"id\":\"" << event.frameId
+            << "\",\"ts\":" << event.startUs << ",\"pid\":1,\"tid\":" << event.threadId << "},\n";
+      file_ << "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"e\",\"id\":\"" << event.frameId
+            << "\",\"ts\":" << event.startUs + event.durationUs << ",\"pid\":1,\"tid\":" << event.threadId << "}";
+      continue;
+    }
+    file_ << "{\"name\":\"" << event.name << "\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":" << event.startUs
+          << ",\"dur\":" << event.durationUs << ",\"pid\":1,\"tid\":" << event.threadId
+          << ",\"args\":{\"frame\":\"" << event.frameId << "\"}},\n";
+    // flow arrow between the stages of the frame, bound to the slice above
+    file_ << "{\"name\":\"frame\",\"cat\":\"flow\",\"ph\":\"" << event.flow << "\",\"bp\":\"e\",\"id\":\""
+          << event.frameId << "\",\"ts\":" << event.startUs << ",\"pid\":1,\"tid\":" << event.threadId << "}";
+  }
+  events_.clear();
+  file_.flush();
+}
+
+}  // namespace timing
+}  // namespace okvis
@@ -0,0 +1,186 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file LatencyHistogram.cpp
+ * @brief Source file for the LatencyHistogram class.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <okvis/timing/LatencyHistogram.hpp>
+
+namespace okvis {
+namespace timing {
+
+namespace {
+// Atomically replace target by value if value is better, i.e. compare(value, target).
+template <class Compare>
+void updateIf(std::atomic<double>& target, double value, Compare compare) {
+  double current = target.load(std::memory_order_relaxed);
+  while (compare(value, current) && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+}  // namespace
+
+constexpr int HistogramLayout::kSubBucketBits;
+constexpr int HistogramLayout::kSubBuckets;
+constexpr int HistogramLayout::kMinExponent;
+constexpr int HistogramLayout::kNumOctaves;
+constexpr size_t HistogramLayout::kNumBuckets;
+
+// Bucket of a value.
+size_t HistogramLayout::index(double value) {
+  if (!(value > 0.0)) return 0;
+  int exponent;
+  const double mantissa = std::frexp(value, &exponent);  // in [0.5, 1)
+  const int octave = exponent - kMinExponent;
+  if (octave < 0) return 0;
+  if (octave >= kNumOctaves) return kNumBuckets - 1;
+  const int subBucket = std::min(static_cast<int>((2.0 * mantissa - 1.0) * kSubBuckets), kSubBuckets - 1);
+  return 1 + octave * kSubBuckets + subBucket;
+}
+
+// Smallest value of a bucket.
+double HistogramLayout::lowerBound(size_t index) {
+  if (index == 0) return 0.0;
+  const int octave = static_cast<int>(index - 1) / kSubBuckets;
+  const int subBucket = static_cast<int>(index - 1) % kSubBuckets;
+  return std::ldexp(1.0 + static_cast<double>(subBucket) / kSubBuckets, octave + kMinExponent - 1);
+}
+
+// Smallest value of the next bucket.
+double HistogramLayout::upperBound(size_t index) {
+  if (index == 0) return lowerBound(1);
+  if (index + 1 >= kNumBuckets) return std::numeric_limits<double>::infinity();
+  return lowerBound(index + 1);
+}
+
+// Value below which percentile percent of the values are.
+double HistogramSnapshot::percentile(double percentile) const {
+  if (count == 0) return 0.0;
+  const double clamped = std::max(0.0, std::min(100.0, percentile));
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      const double upper = std::min(HistogramLayout::upperBound(i), max);
+      const double middle = 0.5 * (HistogramLayout::lowerBound(i) + upper);
+      return std::max(min, std::min(max, middle));
+    }
+  }
+  return max;
+}
+
+// Add the values of another histogram.
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+  if (other.count == 0) return;
+  if (count == 0) {
+    *this = other;
+    return;
+  }
+  count += other.count;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+}
+
+// The values added after an earlier snapshot of the same histogram.
+HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot& earlier) const {
+  if (earlier.count == 0) return *this;
+  HistogramSnapshot window;
+  if (count <= earlier.count) return window;
+  window.count = count - earlier.count;
+  window.sum = sum - earlier.sum;
+  window.buckets.assign(buckets.size(), 0);
+  size_t first = buckets.size(), last = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    window.buckets[i] = buckets[i] - std::min(buckets[i], earlier.buckets[i]);
+    if (window.buckets[i] > 0) {
+      first = std::min(first, i);
+      last = i;
+    }
+  }
+  window.min = std::max(min, HistogramLayout::lowerBound(first));
+  window.max = std::min(max, HistogramLayout::upperBound(last));
+  return window;
+}
+
+// Constructor.
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+// Add a value.
+void LatencyHistogram::add(double value) {
+  buckets_[HistogramLayout::index(value)].fetch_add(1, std::memory_order_relaxed);
+  updateIf(min_, value, std::less<double>());
+  updateIf(max_, value, std::greater<double>());
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+  }
+  count_.fetch_add(1, std::memory_order_release);
+}
+
+// Remove all values.
+void LatencyHistogram::reset() {
+  for (std::atomic<uint64_t>& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+  sum_.store(0.0, std::memory_order_relaxed);
+  min_.store(std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+  max_.store(-std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+  count_.store(0, std::memory_order_release);
+}
+
+// Copy of the current contents.
+HistogramSnapshot LatencyHistogram::snapshot() const {
+  HistogramSnapshot snapshot;
+  if (count_.load(std::memory_order_acquire) == 0) return snapshot;
+  snapshot.buckets.resize(buckets_.size());
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  if (snapshot.count == 0) return HistogramSnapshot();
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.min = min_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  if (!(snapshot.min <= snapshot.max)) {
+    // caught the first add() half way, fall back to the bucket bounds
+    const auto first = std::find_if(snapshot.buckets.begin(), snapshot.buckets.end(), [](uint64_t n) { return n > 0; });
+    snapshot.min = HistogramLayout::lowerBound(first - snapshot.buckets.begin());
+    snapshot.max = HistogramLayout::upperBound(first - snapshot.buckets.begin());
+  }
+  return snapshot;
+}
+
+}  // namespace timing
+}  // namespace okvis
@@ -67,7 +67,7 @@ size_t Timing::getHandle(std::string const& tag) {
     // If it is not there, create a tag.
     size_t handle = instance().m_timers.size();
     instance().m_tagMap[tag] = handle;
-    instance().m_timers.push_back(TimerMapValue());
+    instance().m_timers.emplace_back();
     // Track the maximum tag length to help printing a table of timing values later.
     instance().m_maxTagLength = std::max(instance().m_maxTagLength, tag.size());
     return handle;
@@ -141,7 +141,10 @@ bool Timer::isTiming() { return m_timing; }
 
 void Timer::discardTiming() { m_timing = false; }
 
-void Timing::addTime(size_t handle, double seconds) { m_timers[handle].m_acc(seconds); }
+void Timing::addTime(size_t handle, double seconds) {
+  m_timers[handle].m_acc(seconds);
+  m_timers[handle].m_histogram.add(seconds);
+}
 
 double Timing::getTotalSeconds(size_t handle) {
   OKVIS_ASSERT_TRUE(TimerException,
@@ -195,11 +198,30 @@ double Timing::getHz(size_t handle) {
 
 double Timing::getHz(std::string const& tag) { return getHz(getHandle(tag)); }
 
+double Timing::getPercentileSeconds(size_t handle, double percentile) {
+  OKVIS_ASSERT_TRUE(TimerException,
+                    handle < instance().m_timers.size(),
+                    "Handle is out of range: " << handle << ", number of timers: " << instance().m_timers.size());
+  return instance().m_timers[handle].m_histogram.snapshot().percentile(percentile);
+}
+double Timing::getPercentileSeconds(std::string const& tag, double percentile) {
+  return getPercentileSeconds(getHandle(tag), percentile);
+}
+
+TimingSnapshot Timing::snapshot() {
+  TimingSnapshot snapshot;
+  std::lock_guard<std::mutex> l(instance().addNewHandleMutex_);
+  for (const map_t::value_type& tag : instance().m_tagMap) {
+    snapshot.histograms[tag.first] = instance().m_timers[tag.second].m_histogram.snapshot();
+  }
+  return snapshot;
+}
+
 void Timing::reset(size_t handle) {
   OKVIS_ASSERT_TRUE(TimerException,
                     handle < instance().m_timers.size(),
                     "Handle is out of range: " << handle << ", number of timers: " << instance().m_timers.size());
-  instance().m_timers[handle] = TimerMapValue();
+  instance().m_timers[handle].reset();
 }
 
 void Timing::reset(std::string const& tag) { return reset(getHandle(tag)); }
@@ -246,7 +268,14 @@ void Timing::print(std::ostream& out) {
       double maxsec = getMaxSeconds(i);
 
       // The min or max are out of bounds.
-      out << "[" << secondsToTimeString(minsec) << "," << secondsToTimeString(maxsec) << "]";
+      out << "[" << secondsToTimeString(minsec) << "," << secondsToTimeString(maxsec) << "]\t";
+
+      // The tail latencies.
+      const HistogramSnapshot histogram = instance().m_timers[i].m_histogram.snapshot();
+      out << "{p50 " << secondsToTimeString(histogram.percentile(50.0));
+      out << ", p95 " << secondsToTimeString(histogram.percentile(95.0));
+      out << ", p99 " << secondsToTimeString(histogram.percentile(99.0));
+      out << ", p99.9 " << secondsToTimeString(histogram.percentile(99.9)) << "}";
     }
     out << std::endl;
   }
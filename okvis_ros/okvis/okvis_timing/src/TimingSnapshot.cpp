@@ -0,0 +1,127 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file TimingSnapshot.cpp
+ * @brief Source file for the TimingSnapshot struct.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <okvis/timing/TimingSnapshot.hpp>
+#include <sstream>
+
+namespace okvis {
+namespace timing {
+
+namespace {
+const char* const kHeader = "# timing snapshot 1";
+}  // namespace
+
+// Add the histograms of another snapshot.
+void TimingSnapshot::merge(const TimingSnapshot& other) {
+  for (const auto& histogram : other.histograms) histograms[histogram.first].merge(histogram.second);
+}
+
+// The values added after an earlier snapshot.
+TimingSnapshot TimingSnapshot::since(const TimingSnapshot& earlier) const {
+  TimingSnapshot window;
+  for (const auto& histogram : histograms) {
+    auto previous = earlier.histograms.find(histogram.first);
+    window.histograms[histogram.first] =
+        previous == earlier.histograms.end() ? histogram.second : histogram.second.since(previous->second);
+  }
+  return window;
+}
+
+// Write in the text format.
+void TimingSnapshot::write(std::ostream& out) const {
+  out << kHeader << "\n";
+  out << std::setprecision(std::numeric_limits<double>::max_digits10);
+  for (const auto& histogram : histograms) {
+    const HistogramSnapshot& h = histogram.second;
+    out << histogram.first << "\t" << h.count << "\t" << h.sum << "\t" << h.min << "\t" << h.max << "\t";
+    for (size_t i = 0; i < h.buckets.size(); ++i) {
+      if (h.buckets[i] > 0) out << " " << i << ":" << h.buckets[i];
+    }
+    out << "\n";
+  }
+}
+
+// Read what write() wrote.
+bool TimingSnapshot::read(std::istream& in) {
+  std::string line;
+  if (!std::getline(in, line) || line != kHeader) return false;
+  while (std::getline(in, line)) {
+    if (line.empty()) continue;
+    std::stringstream fields(line);
+    std::string tag;
+    HistogramSnapshot h;
+    if (!std::getline(fields, tag, '\t') || !(fields >> h.count >> h.sum >> h.min >> h.max)) return false;
+    h.buckets.assign(HistogramLayout::kNumBuckets, 0);
+    size_t index;
+    char colon;
+    uint64_t n;
+    while (fields >> index >> colon >> n) {
+      if (colon != ':' || index >= h.buckets.size()) return false;
+      h.buckets[index] = n;
+    }
+    if (h.count == 0) h.buckets.clear();
+    histograms[tag] = h;
+  }
+  return true;
+}
+
+// Print a table with percentiles.
+void TimingSnapshot::print(std::ostream& out) const {
+  size_t tagLength = 3;
+  for (const auto& histogram : histograms) tagLength = std::max(tagLength, histogram.first.size());
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision(4);
+  out << std::left << std::setw(tagLength) << "tag" << std::right << std::setw(9) << "#";
+  for (const char* column : {"mean", "p50", "p95", "p99", "p99.9", "max"}) out << std::setw(11) << column;
+  out << "\n";
+  for (const auto& histogram : histograms) {
+    const HistogramSnapshot& h = histogram.second;
+    out << std::left << std::setw(tagLength) << histogram.first << std::right << std::setw(9) << h.count;
+    if (h.count > 0) {
+      out << std::setw(11) << h.mean();
+      for (double percentile : {50.0, 95.0, 99.0, 99.9}) out << std::setw(11) << h.percentile(percentile);
+      out << std::setw(11) << h.max;
+    }
+    out << "\n";
+  }
+  out.precision(precision);
+  out.flags(flags);
+}
+
+}  // namespace timing
+}  // namespace okvis
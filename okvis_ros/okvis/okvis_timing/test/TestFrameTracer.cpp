@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <okvis/timing/FrameTracer.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef okvis::timing::FrameTracer::Clock Clock;
+
+std::string readFile(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+size_t occurrences(const std::string& text, const std::string& pattern) {
+  size_t n = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) ++n;
+  return n;
+}
+
+}  // namespace
+
+TEST(FrameTracer, pipeline) {
+  const std::string path = "frame_tracer_test.json";
+  EXPECT_FALSE(okvis::timing::FrameTracer::enabled());
+  okvis::timing::FrameTracer::stage(1, "ignored");  // not started: no-op
+  ASSERT_TRUE(okvis::timing::FrameTracer::start(path));
+  EXPECT_TRUE(okvis::timing::FrameTracer::enabled());
+
+  // two cameras detect in parallel, then the frames go through the stages of the other threads
+  const uint64_t kFrames = 50;
+  for (uint64_t frame = 1; frame <= kFrames; ++frame) {
+    const uint64_t id = 1500000000000000000ull + frame;  // nanosecond timestamps
+    std::vector<std::thread> cameras;
+    for (int camera = 0; camera < 2; ++camera) {
+      cameras.emplace_back([id]() {
+        const Clock::time_point arrival = Clock::now();
+        okvis::timing::FrameTracer::span(id, "detection", arrival, Clock::now());
+      });
+    }
+    for (std::thread& camera : cameras) camera.join();
+    std::thread([id]() {
+      okvis::timing::FrameTracer::stage(id, "keypoint queue");
+      okvis::timing::FrameTracer::stage(id, "matching");
+    }).join();
+    if (frame % 10 != 0) okvis::timing::FrameTracer::finish(id, "publish");  // the others are dropped
+  }
+  okvis::timing::FrameTracer::stop();
+  EXPECT_FALSE(okvis::timing::FrameTracer::enabled());
+
+  const std::string trace = readFile(path);
+  std::remove(path.c_str());
+  ASSERT_EQ(trace.substr(0, 2), "[\n");
+  EXPECT_EQ(trace.substr(trace.size() - 3), "\n]\n");
+  const size_t finished = kFrames - kFrames / 10;
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"X\""), kFrames * 4 + finished);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"s\""), kFrames);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"f\""), finished);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"b\""), finished);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"e\""), finished);
+  EXPECT_EQ(occurrences(trace, "\"id\":\"1500000000000000001\""), 7u);  // 5 stages, begin and end
+  EXPECT_EQ(occurrences(trace, "},\n{"), occurrences(trace, "{\"name\"") - 1);
+}
+
+TEST(FrameTracer, disabledOverhead) {
+  const int n = 1000000;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) okvis::timing::FrameTracer::stage(i, "disabled");
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+  std::cout << "FrameTracer::stage while disabled " << ns << " ns" << std::endl;
+  EXPECT_LT(ns, 100.0);
+}
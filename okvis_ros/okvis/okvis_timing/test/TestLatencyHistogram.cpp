@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <okvis/timing/LatencyHistogram.hpp>
+#include <okvis/timing/Timer.hpp>
+#include <okvis/timing/TimingSnapshot.hpp>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// exact percentile of a sorted sample, same rank definition as the histogram
+double exactPercentile(const std::vector<double>& sorted, double percentile) {
+  const size_t rank = std::max<size_t>(1, static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size())));
+  return sorted[rank - 1];
+}
+
+}  // namespace
+
+TEST(LatencyHistogram, layout) {
+  using okvis::timing::HistogramLayout;
+  EXPECT_EQ(HistogramLayout::index(0.0), 0u);
+  EXPECT_EQ(HistogramLayout::index(-1.0), 0u);
+  EXPECT_EQ(HistogramLayout::index(1e300), HistogramLayout::kNumBuckets - 1);
+  for (double value : {1e-9, 3.3e-6, 1e-3, 0.0125, 1.0, 2.0, 17.5, 3600.0}) {
+    const size_t index = HistogramLayout::index(value);
+    EXPECT_LE(HistogramLayout::lowerBound(index), value);
+    EXPECT_LT(value, HistogramLayout::upperBound(index));
+    EXPECT_LE(HistogramLayout::upperBound(index) - HistogramLayout::lowerBound(index),
+              value / HistogramLayout::kSubBuckets * 1.0001);
+  }
+}
+
+TEST(LatencyHistogram, percentilesMatchSample) {
+  // a long tailed latency distribution
+  std::mt19937 rng(3);
+  std::lognormal_distribution<double> latency(std::log(0.01), 0.6);
+  okvis::timing::LatencyHistogram histogram;
+  std::vector<double> values;
+  for (int i = 0; i < 100000; ++i) {
+    values.push_back(latency(rng));
+    histogram.add(values.back());
+  }
+  std::sort(values.begin(), values.end());
+  const okvis::timing::HistogramSnapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, values.size());
+  EXPECT_DOUBLE_EQ(snapshot.min, values.front());
+  EXPECT_DOUBLE_EQ(snapshot.max, values.back());
+  for (double percentile : {1.0, 50.0, 95.0, 99.0, 99.9, 100.0}) {
+    const double exact = exactPercentile(values, percentile);
+    EXPECT_NEAR(snapshot.percentile(percentile), exact, exact / 32) << "p" << percentile;
+  }
+}
+
+TEST(LatencyHistogram, concurrentAdds) {
+  okvis::timing::LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t]() {
+      for (int i = 1; i <= 10000; ++i) histogram.add(1e-3 * (t + 1));
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  const okvis::timing::HistogramSnapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 40000u);
+  EXPECT_NEAR(snapshot.sum, 100.0, 1e-6);
+  EXPECT_DOUBLE_EQ(snapshot.min, 1e-3);
+  EXPECT_DOUBLE_EQ(snapshot.max, 4e-3);
+}
+
+TEST(LatencyHistogram, snapshotsMergeAndWindow) {
+  okvis::timing::LatencyHistogram a, b;
+  for (int i = 0; i < 900; ++i) a.add(0.001);
+  okvis::timing::TimingSnapshot first;
+  first.histograms["matching"] = a.snapshot();
+  for (int i = 0; i < 100; ++i) a.add(0.1);
+  for (int i = 0; i < 10; ++i) b.add(5.0);
+  okvis::timing::TimingSnapshot second;
+  second.histograms["matching"] = a.snapshot();
+
+  // rolling window: only the slow ones
+  okvis::timing::TimingSnapshot window = second.since(first);
+  EXPECT_EQ(window.histograms["matching"].count, 100u);
+  EXPECT_NEAR(window.histograms["matching"].percentile(50.0), 0.1, 0.1 / 32);
+  EXPECT_NEAR(second.histograms["matching"].percentile(50.0), 0.001, 0.001 / 32);
+
+  // round trip through the text format, then merge with another process
+  std::stringstream file;
+  second.write(file);
+  okvis::timing::TimingSnapshot read;
+  ASSERT_TRUE(read.read(file));
+  ASSERT_EQ(read.histograms.size(), 1u);
+  EXPECT_EQ(read.histograms["matching"].count, 1000u);
+  EXPECT_DOUBLE_EQ(read.histograms["matching"].sum, second.histograms["matching"].sum);
+  EXPECT_EQ(read.histograms["matching"].buckets, second.histograms["matching"].buckets);
+  okvis::timing::TimingSnapshot other;
+  other.histograms["Keyframe BoW [ms]"] = b.snapshot();
+  other.histograms["matching"] = b.snapshot();
+  read.merge(other);
+  EXPECT_EQ(read.histograms.size(), 2u);
+  EXPECT_EQ(read.histograms["matching"].count, 1010u);
+  EXPECT_DOUBLE_EQ(read.histograms["matching"].max, 5.0);
+  std::stringstream notASnapshot("tag,1,2,3");
+  EXPECT_FALSE(read.read(notASnapshot));
+}
+
+TEST(LatencyHistogram, timerPercentilesAndOverhead) {
+  const size_t handle = okvis::timing::Timing::getHandle("test histogram");
+  for (int i = 0; i < 20; ++i) {
+    okvis::timing::Timer timer(handle);
+    std::this_thread::sleep_for(std::chrono::milliseconds(i == 19 ? 20 : 1));
+  }
+  EXPECT_GE(okvis::timing::Timing::getPercentileSeconds(handle, 50.0), 0.0009);
+  EXPECT_LT(okvis::timing::Timing::getPercentileSeconds(handle, 50.0), 0.01);
+  EXPECT_GE(okvis::timing::Timing::getPercentileSeconds(handle, 100.0), 0.019);
+  EXPECT_EQ(okvis::timing::Timing::snapshot().histograms["test histogram"].count, 20u);
+
+  okvis::timing::LatencyHistogram histogram;
+  const int n = 1000000;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) histogram.add(1e-4 * (i % 1000 + 1));
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+  std::cout << "LatencyHistogram::add " << ns << " ns" << std::endl;
+  EXPECT_EQ(histogram.snapshot().count, static_cast<uint64_t>(n));
+}
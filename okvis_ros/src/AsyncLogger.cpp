@@ -0,0 +1,285 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file AsyncLogger.cpp
+ * @brief Source file for the AsyncLogger class.
+ */
+
+#include <glog/logging.h>
+#include <inttypes.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <okvis/AsyncLogger.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+namespace {
+const char kMagic[8] = {'O', 'K', 'V', 'I', 'S', 'L', 'O', 'G'};
+const uint32_t kVersion = 1;
+
+template <typename T>
+void appendBinary(const T& value, std::string& buffer) {  // NOLINT
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readBinary(std::istream& in, T& value) {  // NOLINT
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+}  // namespace
+
+constexpr std::chrono::milliseconds AsyncLogger::kWritePeriod;
+
+// Default constructor.
+AsyncLogger::AsyncLogger()
+    : format_(Format::Csv),
+      stream_(nullptr),
+      queue_(256),
+      numDropped_(0),
+      closing_(false),
+      headerWritten_(false) {}
+
+// Destructor.
+AsyncLogger::~AsyncLogger() { close(); }
+
+// Create a file and start the writer thread.
+bool AsyncLogger::open(const std::string& filename, Format format) {
+  close();
+  file_.reset(new std::ofstream(
+      filename.c_str(), format == Format::Binary ? std::ios_base::out | std::ios_base::binary : std::ios_base::out));
+  if (!file_->good()) {
+    LOG(ERROR) << "Could not create " << filename;
+    file_.reset();
+    return false;
+  }
+  stream_ = file_.get();
+  return start(format);
+}
+
+// Write to a stream and start the writer thread.
+bool AsyncLogger::open(std::ostream& stream, Format format) {
+  close();
+  stream_ = &stream;
+  return start(format);
+}
+
+// Start the writer thread.
+bool AsyncLogger::start(Format format) {
+  format_ = format;
+  columns_.clear();
+  pending_.clear();
+  numDropped_ = 0;
+  headerWritten_ = false;
+  buffer_.clear();
+  blockRows_.clear();
+  closing_ = false;
+  queue_.Resume();
+  writer_ = std::thread(&AsyncLogger::writerLoop, this);
+  return stream_->good();
+}
+
+// Write all committed rows and stop the writer thread.
+void AsyncLogger::close() {
+  if (!stream_) return;
+  closing_ = true;
+  queue_.Shutdown();
+  writer_.join();
+  stream_->flush();
+  if (numDropped_ > 0) LOG(WARNING) << "AsyncLogger dropped " << numDropped_ << " batches, the disk is too slow";
+  file_.reset();
+  stream_ = nullptr;
+}
+
+// Set the columns.
+void AsyncLogger::setColumns(const std::vector<Column>& columns) {
+  CHECK(columns_.empty()) << "the columns of a log can only be set once";
+  columns_ = columns;
+}
+
+// Hand all complete rows over to the writer thread.
+void AsyncLogger::commit() {
+  if (!stream_ || columns_.empty()) {
+    pending_.clear();
+    return;
+  }
+  DCHECK_EQ(pending_.size() % columns_.size(), 0u) << "incomplete row";
+  pending_.resize(pending_.size() - pending_.size() % columns_.size());
+  if (pending_.empty()) return;
+  // the queue publishes columns_ to the writer thread along with the first batch
+  if (queue_.PushNonBlockingDroppingIfFull(pending_, queue_.Capacity())) ++numDropped_;
+  pending_.clear();
+}
+
+// The writer thread.
+void AsyncLogger::writerLoop() {
+  Batch batch;
+  std::chrono::steady_clock::time_point lastWrite = std::chrono::steady_clock::now();
+  while (true) {
+    const bool closing = closing_;
+    if (queue_.PopTimeout(&batch, std::chrono::nanoseconds(kWritePeriod).count())) {
+      append(batch);
+    } else if (closing) {
+      break;  // everything committed before close() is written
+    }
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (buffer_.size() >= kWriteSize || (now - lastWrite >= kWritePeriod && queue_.Empty())) {
+      write();
+      lastWrite = now;
+    }
+  }
+  write();
+}
+
+// Format a batch into the output buffer, or gather it for the next binary block.
+void AsyncLogger::append(const Batch& batch) {
+  const size_t numColumns = columns_.size();
+  if (!headerWritten_) {
+    if (format_ == Format::Csv) {
+      appendCsvHeader(columns_, buffer_);
+    } else {
+      buffer_.append(kMagic, sizeof(kMagic));
+      appendBinary(kVersion, buffer_);
+      appendBinary(static_cast<uint32_t>(numColumns), buffer_);
+      for (const Column& column : columns_) {
+        appendBinary(static_cast<uint8_t>(column.type), buffer_);
+        appendBinary(static_cast<uint8_t>(std::min<size_t>(column.name.size(), 255)), buffer_);
+        buffer_.append(column.name, 0, 255);
+      }
+    }
+    headerWritten_ = true;
+  }
+
+  if (format_ == Format::Csv) {
+    for (size_t row = 0; row < batch.size(); row += numColumns) appendCsvRow(columns_, &batch[row], 1, buffer_);
+    return;
+  }
+  blockRows_.insert(blockRows_.end(), batch.begin(), batch.end());
+  if (blockRows_.size() >= kRowsPerBlock * numColumns) write();
+}
+
+// Write the output buffer to the stream.
+void AsyncLogger::write() {
+  if (format_ == Format::Binary && !blockRows_.empty()) {
+    // transpose the gathered rows into one columnar block
+    const size_t numColumns = columns_.size();
+    const size_t numRows = blockRows_.size() / numColumns;
+    appendBinary(static_cast<uint32_t>(numRows), buffer_);
+    const size_t offset = buffer_.size();
+    buffer_.resize(offset + numRows * numColumns * sizeof(Cell));
+    Cell* cells = reinterpret_cast<Cell*>(&buffer_[offset]);
+    for (size_t column = 0; column < numColumns; ++column) {
+      for (size_t row = 0; row < numRows; ++row) {
+        std::memcpy(&cells[column * numRows + row], &blockRows_[row * numColumns + column], sizeof(Cell));
+      }
+    }
+    blockRows_.clear();
+  }
+  if (buffer_.empty()) return;
+  stream_->write(buffer_.data(), buffer_.size());
+  stream_->flush();
+  buffer_.clear();
+}
+
+// Append the CSV header.
+void AsyncLogger::appendCsvHeader(const std::vector<Column>& columns, std::string& buffer) {
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (i > 0) buffer += ", ";
+    buffer += columns[i].name;
+  }
+  buffer += '\n';
+}
+
+// Append a row as a CSV line.
+void AsyncLogger::appendCsvRow(const std::vector<Column>& columns,
+                               const Cell* row,
+                               size_t stride,
+                               std::string& buffer) {
+  char text[64];
+  for (size_t i = 0; i < columns.size(); ++i) {
+    Cell cell;
+    std::memcpy(&cell, row + i * stride, sizeof(Cell));
+    int length = 0;
+    switch (columns[i].type) {
+      case ColumnType::Timestamp:
+        length = snprintf(text,
+                          sizeof(text),
+                          "%" PRId64 "%09" PRId64,
+                          cell.integer / 1000000000,
+                          cell.integer % 1000000000);
+        break;
+      case ColumnType::Integer:
+        length = snprintf(text, sizeof(text), "%" PRId64, cell.integer);
+        break;
+      case ColumnType::Double:
+        length = snprintf(text, sizeof(text), "%.18e", cell.real);
+        break;
+    }
+    if (i > 0) buffer += ", ";
+    buffer.append(text, length);
+  }
+  buffer += '\n';
+}
+
+// Convert a binary log to CSV.
+bool AsyncLogger::convertToCsv(std::istream& in, std::ostream& out) {
+  char magic[sizeof(kMagic)];
+  uint32_t version = 0, numColumns = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) return false;
+  if (!readBinary(in, version) || version != kVersion) return false;
+  if (!readBinary(in, numColumns) || numColumns == 0) return false;
+  std::vector<Column> columns(numColumns);
+  for (Column& column : columns) {
+    uint8_t type = 0, nameLength = 0;
+    if (!readBinary(in, type) || !readBinary(in, nameLength) || type > uint8_t(ColumnType::Double)) return false;
+    column.type = static_cast<ColumnType>(type);
+    column.name.resize(nameLength);
+    if (nameLength > 0 && !in.read(&column.name[0], nameLength)) return false;
+  }
+
+  std::string buffer;
+  appendCsvHeader(columns, buffer);
+  std::vector<Cell> block;
+  uint32_t numRows = 0;
+  while (readBinary(in, numRows)) {
+    block.resize(size_t(numRows) * numColumns);
+    if (!in.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(Cell))) return false;
+    for (size_t row = 0; row < numRows; ++row) appendCsvRow(columns, &block[row], numRows, buffer);
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+  out.write(buffer.data(), buffer.size());
+  return in.eof() && out.good();
+}
+
+}  // namespace okvis
@@ -0,0 +1,206 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file ImagePreprocessor.cpp
+ * @brief Source file for the ImagePreprocessor class.
+ */
+
+#include <glog/logging.h>
+
+#include <cmath>
+#include <okvis/ImagePreprocessor.hpp>
+#include <string>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+namespace {
+// Multiframes remembered while their images come in, the oldest are forgotten if a camera never delivers.
+const size_t kMaxPendingAdmissions = 8;
+}  // namespace
+
+// Constructor of the state of one camera.
+// The queue has room for the images of the multiframes admitted while the other cameras were still below maxQueueSize,
+// an admitted image must not push out an older one.
+ImagePreprocessor::Lane::Lane(size_t cameraIndex, size_t maxQueueSize)
+    : queue(maxQueueSize + kMaxPendingAdmissions),
+      convertTimer("0.1 imageConvert" + std::to_string(cameraIndex), true),
+      resizeTimer("0.2 imageResize" + std::to_string(cameraIndex), true),
+      medianTimer("0.3 imageMedianFilter" + std::to_string(cameraIndex), true),
+      histogramTimer("0.4 imageHistogram" + std::to_string(cameraIndex), true),
+      numReceived(0),
+      numProcessed(0),
+      numDropped(0) {}
+
+// Constructor. Starts one worker thread per camera.
+ImagePreprocessor::ImagePreprocessor(const okvis::VioParameters& parameters,
+                                     size_t numCameras,
+                                     const ImageCallback& callback,
+                                     size_t maxQueueSize)
+    : miscParams_(parameters.miscParams),
+      histogramParams_(parameters.histogramParams),
+      useMedianFilter_(parameters.optimization.useMedianFilter),
+      callback_(callback),
+      frameTimestampTolerance_(parameters.sensors_information.frameTimestampTolerance),
+      maxQueueSize_(maxQueueSize) {
+  for (size_t i = 0; i < numCameras; ++i) {
+    lanes_.emplace_back(new Lane(i, maxQueueSize_));
+    if (histogramParams_.histogramMethod == HistogramMethod::CLAHE) {
+      lanes_.back()->clahe = cv::createCLAHE();
+      lanes_.back()->clahe->setClipLimit(histogramParams_.claheClipLimit);
+      lanes_.back()->clahe->setTilesGridSize(
+          cv::Size(histogramParams_.claheTilesGridSize, histogramParams_.claheTilesGridSize));
+    }
+  }
+  // start the workers once all lanes exist
+  for (size_t i = 0; i < numCameras; ++i) {
+    lanes_[i]->worker = std::thread(&ImagePreprocessor::workerLoop, this, i);
+  }
+}
+
+// Destructor. Stops the workers.
+ImagePreprocessor::~ImagePreprocessor() {
+  for (std::unique_ptr<Lane>& lane : lanes_) lane->queue.Shutdown();
+  for (std::unique_ptr<Lane>& lane : lanes_) lane->worker.join();
+}
+
+// Queue an image, or drop it with the other images of its multiframe.
+void ImagePreprocessor::addImage(const okvis::Time& stamp,
+                                 size_t cameraIndex,
+                                 const cv::Mat& image,
+                                 int colorConversion,
+                                 const std::shared_ptr<const void>& owner) {
+  CHECK_LT(cameraIndex, lanes_.size());
+  Lane& lane = *lanes_[cameraIndex];
+  ++lane.numReceived;
+  if (!admit(stamp)) {
+    ++lane.numDropped;
+    LOG(WARNING) << "Image preprocessing fell behind, dropped the image of camera " << cameraIndex << " at time "
+                 << stamp;
+    return;
+  }
+  lane.queue.PushNonBlocking(Job{stamp, image, colorConversion, owner});
+}
+
+// Decide whether to queue an image. Dropping the images of a stereo pair independently would leave the estimator
+// with incomplete multiframes, so the first image of a timestamp decides for all cameras: it is dropped if the queue
+// of any camera is full, i.e. the slowest camera decides.
+bool ImagePreprocessor::admit(const okvis::Time& stamp) {
+  std::lock_guard<std::mutex> lock(admissionMutex_);
+  auto admission = admissions_.begin();
+  while (admission != admissions_.end() && admission->stamp != stamp &&
+         std::fabs((admission->stamp - stamp).toSec()) >= frameTimestampTolerance_) {
+    ++admission;
+  }
+  if (admission == admissions_.end()) {
+    bool admitted = true;
+    for (const std::unique_ptr<Lane>& lane : lanes_) admitted = admitted && lane->queue.Size() < maxQueueSize_;
+    if (admissions_.size() == kMaxPendingAdmissions) admissions_.pop_front();
+    admissions_.push_back(Admission{stamp, admitted, 0});
+    admission = admissions_.end() - 1;
+  }
+  const bool admitted = admission->admitted;
+  if (++admission->numImages == lanes_.size()) admissions_.erase(admission);
+  return admitted;
+}
+
+// Counters of one camera.
+ImagePreprocessor::Statistics ImagePreprocessor::statistics(size_t cameraIndex) const {
+  const Lane& lane = *lanes_.at(cameraIndex);
+  return Statistics{lane.numReceived, lane.numProcessed, lane.numDropped};
+}
+
+// The worker thread of a camera.
+void ImagePreprocessor::workerLoop(size_t cameraIndex) {
+  Lane& lane = *lanes_[cameraIndex];
+  Job job;
+  while (lane.queue.PopBlocking(&job)) {
+    const okvis::Time stamp = job.stamp;
+    const cv::Mat image = preprocess(lane, job);
+    job = Job();  // release the ROS message
+    ++lane.numProcessed;
+    if (!callback_(stamp, cameraIndex, image)) {
+      LOG(WARNING) << "Frame delayed at time " << stamp;
+    }
+  }
+}
+
+// Run all stages on one image.
+cv::Mat ImagePreprocessor::preprocess(Lane& lane, const Job& job) {
+  const bool convert = job.colorConversion >= 0;
+  const bool resize = miscParams_.resizeFactor != 1.0;
+  const bool median = useMedianFilter_;
+  const bool histogram = histogramParams_.histogramMethod != HistogramMethod::NONE;
+
+  // every stage reads the output of the previous one. The last stage writes into a new image, since the estimator keeps
+  // it, the others into the buffers of the lane.
+  int remainingStages = convert + resize + median + histogram;
+  if (remainingStages == 0) return job.image.clone();  // the input is only borrowed
+  cv::Mat output;
+  auto target = [&](cv::Mat& buffer) -> cv::Mat& { return --remainingStages == 0 ? output : buffer; };
+
+  cv::Mat current = job.image;
+  if (convert) {
+    lane.convertTimer.start();
+    cv::Mat& converted = target(lane.grey);
+    cv::cvtColor(current, converted, job.colorConversion);
+    current = converted;
+    lane.convertTimer.stop();
+  }
+  // resizing factor( e.g., with a factor = 0.8, an image will convert from 800x600 to 640x480)
+  if (resize) {
+    lane.resizeTimer.start();
+    cv::Mat& resized = target(lane.resized);
+    cv::resize(current, resized, cv::Size(), miscParams_.resizeFactor, miscParams_.resizeFactor);
+    current = resized;
+    lane.resizeTimer.stop();
+  }
+  if (median) {
+    lane.medianTimer.start();
+    cv::Mat& filtered = target(lane.filtered);
+    cv::medianBlur(current, filtered, 3);
+    current = filtered;
+    lane.medianTimer.stop();
+  }
+  // Added by Sharmin for CLAHE
+  if (histogram) {
+    lane.histogramTimer.start();
+    if (histogramParams_.histogramMethod == HistogramMethod::CLAHE) {
+      lane.clahe->apply(current, output);
+    } else {
+      cv::equalizeHist(current, output);
+    }
+    lane.histogramTimer.stop();
+  }
+  return output;
+}
+
+}  // namespace okvis
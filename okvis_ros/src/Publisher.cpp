@@ -61,24 +61,25 @@
 
 /// \brief okvis Main namespace of this package.
 namespace okvis {
+
+// float32 holds integers exactly up to 2^24: the 64 bit ids of the keyframe points are sent as 24 bit halves, exact
+// up to 2^48. The channel name tells pose_graph's Subscriber the layout, recorded bags without it carry whole ids.
+static const char* const keyframe_point_channel_name = "split_ids";
+static const int id_split_bits = 24;
+static const uint64_t id_low_mask = (uint64_t(1) << id_split_bits) - 1;
+
 // Default constructor.
 Publisher::Publisher() : nh_(nullptr), ctr2_(0) {}
 
 Publisher::~Publisher() {
-  // close file
-  if (csvLandmarksFile_) {
-    // write down also the current landmarks
-    if (csvLandmarksFile_->good()) {
-      for (size_t l = 0; l < pointsMatched2_.size(); ++l) {
-        Eigen::Vector4d landmark = pointsMatched2_.at(l).point;
-        *csvLandmarksFile_ << std::setprecision(19) << pointsMatched2_.at(l).id << ", " << std::scientific
-                           << std::setprecision(18) << landmark[0] << ", " << landmark[1] << ", " << landmark[2] << ", "
-                           << landmark[3] << ", " << pointsMatched2_.at(l).quality << std::endl;
-      }
-    }
-    csvLandmarksFile_->close();
+  // write down also the current landmarks, the logs are closed by their destructors
+  for (size_t l = 0; l < pointsMatched2_.size(); ++l) {
+    landmarksLogger_.timestamp(okvis::Time(_t.sec, _t.nsec))
+        .integer(pointsMatched2_.at(l).id)
+        .reals(pointsMatched2_.at(l).point)
+        .real(pointsMatched2_.at(l).quality);
   }
-  if (csvFile_) csvFile_->close();
+  landmarksLogger_.commit();
 }
 
 // Constructor. Calls setNodeHandle().
@@ -193,7 +194,7 @@ void Publisher::publishRelocRelativePoseAsCallback(const okvis::Time& t,
 void Publisher::publishKeyframeAsCallback(const okvis::Time& t,
                                           const cv::Mat& imageL,
                                           const okvis::kinematics::Transformation& T_WCa,
-                                          std::vector<std::list<std::vector<double>>>& keyframePoints) {
+                                          const okvis::KeyframePacket& keyframePoints) {
   /*sensor_msgs::Image msg;
   msg.header.stamp = ros::Time::now();
   msg.header.frame_id = "slave1";
@@ -249,51 +250,57 @@ void Publisher::publishKeyframeAsCallback(const okvis::Time& t,
   point_cloud.header.stamp = ros::Time(t.sec, t.nsec);
 
   uint32_t new_feature_keypoints = 0;
-  for (std::vector<std::list<std::vector<double>>>::iterator it = keyframePoints.begin(); it != keyframePoints.end();
-       it++) {
-    std::list<std::vector<double>> ptList = *it;
-
-    std::list<std::vector<double>>::iterator lit = ptList.begin();
-    // Note: Every time you ptList.push_back(...) in ThreadedKFVio, you advance lit by 1.
-
-    std::vector<double> pt3d = *lit;
-    // std::cout<<"MapPoint 3d:"<< pt3d.at(0) << " , "<< pt3d.at(1)<< " , "<< pt3d.at(2) <<std::endl;
-
-    Eigen::Vector4d pt4d_eigen(pt3d.at(0), pt3d.at(1), pt3d.at(2), 1.0);
-    Eigen::Vector4d pt4d_Wc_eigen = T_Wc_W * pt4d_eigen;
-
+  point_cloud.points.reserve(keyframePoints.size());
+  point_cloud.channels.reserve(keyframePoints.size());
+  for (size_t i = 0; i < keyframePoints.size(); ++i) {
+    const Eigen::Vector4d pt4d_Wc_eigen = T_Wc_W * Eigen::Vector4d(keyframePoints.points[i].homogeneous());
     geometry_msgs::Point32 p;  // 3d position of MapPoint in W coordinate
     p.x = pt4d_Wc_eigen[0];
     p.y = pt4d_Wc_eigen[1];
     p.z = pt4d_Wc_eigen[2];
     point_cloud.points.push_back(p);
-    std::advance(lit, 1);  // advancing by 1 after getting the 3d W-coordinate
 
     // SVIN health
     svinInfo.points3D.push_back(p);
 
+    // The float32 channel layout is what pose_graph reads, with the ids split into exact halves.
+    const cv::KeyPoint& keypoint = keyframePoints.keypoints[i];
+    const size_t covis = keyframePoints.numCovisibilities(i);
     sensor_msgs::ChannelFloat32 p_id_w_uv;
-    std::vector<double> cvKeypoint_w_id = *lit;
-
+    p_id_w_uv.name = keyframe_point_channel_name;
+    p_id_w_uv.values.reserve(14 + covis);
     // @Reloc
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(0));  // landmark id
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(1));  // poseId or multiframeId
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(2));  // keypointIndex
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(3));  // quality
+    p_id_w_uv.values.push_back(keyframePoints.landmarkIds[i] & id_low_mask);  // landmark id, low bits
+    p_id_w_uv.values.push_back(keyframePoints.frameId & id_low_mask);         // poseId or multiframeId, low bits
+    p_id_w_uv.values.push_back(keyframePoints.keypointIndices[i]);  // keypointIndex
+    p_id_w_uv.values.push_back(keyframePoints.qualities[i]);        // quality
 
     // kf_index where the MapPoint has been observed and it's corresponding 2d position in image
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(4));   // kf_index
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(5));   // cv Point2f: x -> corres to column
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(6));   // cv Point2f: y -> corres to row
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(7));   // keypoint size
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(8));   // keypoint angle/orientation
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(9));   // keypoint octave
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(10));  // keypoint response
-    p_id_w_uv.values.push_back(cvKeypoint_w_id.at(11));  // keypoint class_id
+    p_id_w_uv.values.push_back(keyframePoints.keyframeIndex);  // kf_index
+    p_id_w_uv.values.push_back(keypoint.pt.x);                 // cv Point2f: x -> corres to column
+    p_id_w_uv.values.push_back(keypoint.pt.y);                 // cv Point2f: y -> corres to row
+    p_id_w_uv.values.push_back(keypoint.size);                 // keypoint size
+    p_id_w_uv.values.push_back(keypoint.angle);                // keypoint angle/orientation
+    p_id_w_uv.values.push_back(keypoint.octave);               // keypoint octave
+    p_id_w_uv.values.push_back(keypoint.response);             // keypoint response
+    p_id_w_uv.values.push_back(keypoint.class_id);             // keypoint class_id
+    p_id_w_uv.values.push_back(keyframePoints.landmarkIds[i] >> id_split_bits);  // landmark id, high bits
+    p_id_w_uv.values.push_back(keyframePoints.frameId >> id_split_bits);         // multiframeId, high bits
+
+    if (tracksLogger_.isOpen()) {
+      tracksLogger_.timestamp(t)
+          .integer(static_cast<int64_t>(keyframePoints.landmarkIds[i]))
+          .integer(static_cast<int64_t>(keyframePoints.frameId))
+          .integer(keyframePoints.keypointIndices[i])
+          .integer(keyframePoints.keyframeIndex)
+          .real(keypoint.pt.x)
+          .real(keypoint.pt.y)
+          .real(keyframePoints.qualities[i]);
+    }
 
     // SVIN health
-    int x_coord = cvKeypoint_w_id.at(5);
-    int y_coord = cvKeypoint_w_id.at(6);
+    int x_coord = keypoint.pt.x;
+    int y_coord = keypoint.pt.y;
     // q00 = image[int(0):int(0.5*nrows), int(0):int(0.5*ncols)]
     // q01 = image[int(0):int(0.5*nrows), int(0.5*ncols):int(ncols)]
     // q10 = image[int(0.5*nrows):int(nrows), int(0):int(0.5*ncols)]
@@ -308,19 +315,9 @@ void Publisher::publishKeyframeAsCallback(const okvis::Time& t,
       q11_counter++;
     }
 
-    std::advance(lit, 1);  // advancing by 1 after getting the id and 2d image-coordinate and other cv::KeyPoint
-                           // information (Total size 8)
-
     // Id of other kfs where this MapPoint has been observed.
-    // i = 2, because: ptList has been advanced by 2.
-
-    int covis = 0;
-    while (lit != ptList.end()) {
-      std::vector<double> kf_id = *lit;
-      // std::cout<<"MapPoint observed ID:"<< kf_id.at(0) <<" In KF"<< cvKeypoint_w_id.at(3)<<std::endl;
-      p_id_w_uv.values.push_back(kf_id.at(0));  // kf_index
-      lit++;                                    // advancing by 1 after getting the kf_id
-      covis++;
+    for (size_t j = 0; j < covis; ++j) {
+      p_id_w_uv.values.push_back(keyframePoints.covisibility(i, j));  // kf_index
     }
 
     if (covis == 0) {
@@ -328,19 +325,13 @@ void Publisher::publishKeyframeAsCallback(const okvis::Time& t,
     }
     // SVIN health
     svinInfo.covisibilities.push_back(covis);
-    svinInfo.quality.push_back(cvKeypoint_w_id.at(3));
-    svinInfo.responseStrengths.push_back(cvKeypoint_w_id.at(10));
-    // This also works fine as above
-    /*for (size_t i = 2; i < ptList.size(); i++){
-            std::vector<double> kf_id = *lit;
-            //std::cout<<"MapPoint observed ID:"<< kf_id.at(0) <<" In KF"<< cvKeypoint_w_id.at(0)<<std::endl;
-            p_id_w_uv.values.push_back(kf_id.at(0));  // kf_index
-            std::advance(lit, 1); // advancing by 1 after getting the kf_id
-    }*/
-
-    point_cloud.channels.push_back(p_id_w_uv);
+    svinInfo.quality.push_back(keyframePoints.qualities[i]);
+    svinInfo.responseStrengths.push_back(keypoint.response);
+
+    point_cloud.channels.push_back(std::move(p_id_w_uv));
   }
   pubKeyframePoints_.publish(point_cloud);
+  tracksLogger_.commit();
 
   // Sharmin: svin health. No. of minimum match required = 10
   if (pointsMatched_.size() <= 10) {
@@ -359,108 +350,111 @@ void Publisher::publishKeyframeAsCallback(const okvis::Time& t,
 }
 // *************** End ***********************//
 
-// Write CSV header.
-bool Publisher::writeCsvDescription() {
-  if (!csvFile_) return false;
-  if (!csvFile_->good()) return false;
-  *csvFile_ << "timestamp"
-            << ", "
-            << "p_WS_W_x"
-            << ", "
-            << "p_WS_W_y"
-            << ", "
-            << "p_WS_W_z"
-            << ", "
-            << "q_WS_x"
-            << ", "
-            << "q_WS_y"
-            << ", "
-            << "q_WS_z"
-            << ", "
-            << "q_WS_w"
-            << ", "
-            << "v_WS_W_x"
-            << ", "
-            << "v_WS_W_y"
-            << ", "
-            << "v_WS_W_z"
-            << ", "
-            << "b_g_x"
-            << ", "
-            << "b_g_y"
-            << ", "
-            << "b_g_z"
-            << ", "
-            << "b_a_x"
-            << ", "
-            << "b_a_y"
-            << ", "
-            << "b_a_z" << std::endl;
-  return true;
+namespace {
+// Columns of the state log. The extrinsics are only known once the first state arrives.
+std::vector<AsyncLogger::Column> stateColumns(size_t numExtrinsics) {
+  std::vector<AsyncLogger::Column> columns;
+  columns.push_back({"timestamp", AsyncLogger::ColumnType::Timestamp});
+  for (const char* name : {"p_WS_W_x", "p_WS_W_y", "p_WS_W_z", "q_WS_x", "q_WS_y", "q_WS_z", "q_WS_w",
+                           "v_WS_W_x", "v_WS_W_y", "v_WS_W_z", "b_g_x", "b_g_y", "b_g_z", "b_a_x", "b_a_y", "b_a_z"}) {
+    columns.push_back({name, AsyncLogger::ColumnType::Double});
+  }
+  for (size_t i = 0; i < numExtrinsics; ++i) {
+    const std::string camera = std::to_string(i);
+    for (const char* axis : {"_x", "_y", "_z"})
+      columns.push_back({"p_SC" + camera + axis, AsyncLogger::ColumnType::Double});
+    for (const char* axis : {"_x", "_y", "_z", "_w"})
+      columns.push_back({"q_SC" + camera + axis, AsyncLogger::ColumnType::Double});
+  }
+  return columns;
 }
 
-// Write CSV header for landmarks file.
-bool Publisher::writeLandmarksCsvDescription() {
-  if (!csvLandmarksFile_) return false;
-  if (!csvLandmarksFile_->good()) return false;
-  *csvLandmarksFile_ << ", "
-                     << "id"
-                     << ", "
-                     << "l_x"
-                     << ", "
-                     << "l_y"
-                     << ", "
-                     << "l_z"
-                     << ", "
-                     << "l_w"
-                     << ", "
-                     << "quality, "
-                     << "distance" << std::endl;
-  return true;
+// Columns of the landmarks log.
+std::vector<AsyncLogger::Column> landmarkColumns() {
+  return {{"timestamp", AsyncLogger::ColumnType::Timestamp},
+          {"id", AsyncLogger::ColumnType::Integer},
+          {"l_x", AsyncLogger::ColumnType::Double},
+          {"l_y", AsyncLogger::ColumnType::Double},
+          {"l_z", AsyncLogger::ColumnType::Double},
+          {"l_w", AsyncLogger::ColumnType::Double},
+          {"quality", AsyncLogger::ColumnType::Double}};
 }
 
-// Set an odometry output CSV file.
-bool Publisher::setCsvFile(std::fstream& csvFile) {
-  if (csvFile_) {
-    csvFile_->close();
-  }
-  csvFile_.reset(&csvFile);
-  writeCsvDescription();
-  return csvFile_->good();
+// Columns of the keyframe tracks log.
+std::vector<AsyncLogger::Column> trackColumns() {
+  return {{"timestamp", AsyncLogger::ColumnType::Timestamp},
+          {"landmark_id", AsyncLogger::ColumnType::Integer},
+          {"multiframe_id", AsyncLogger::ColumnType::Integer},
+          {"keypoint_index", AsyncLogger::ColumnType::Integer},
+          {"kf_index", AsyncLogger::ColumnType::Integer},
+          {"u", AsyncLogger::ColumnType::Double},
+          {"v", AsyncLogger::ColumnType::Double},
+          {"quality", AsyncLogger::ColumnType::Double}};
 }
+}  // namespace
+
+// Set an odometry output CSV file.
+bool Publisher::setCsvFile(std::fstream& csvFile) { return stateLogger_.open(csvFile, AsyncLogger::Format::Csv); }
 // Set an odometry output CSV file.
 bool Publisher::setCsvFile(std::string& csvFileName) {
-  csvFile_.reset(new std::fstream(csvFileName.c_str(), std::ios_base::out));
-  writeCsvDescription();
-  return csvFile_->good();
+  return setStateLogFile(csvFileName, AsyncLogger::Format::Csv);
 }
 // Set an odometry output CSV file.
-bool Publisher::setCsvFile(std::string csvFileName) {
-  csvFile_.reset(new std::fstream(csvFileName.c_str(), std::ios_base::out));
-  writeCsvDescription();
-  return csvFile_->good();
-}
+bool Publisher::setCsvFile(std::string csvFileName) { return setStateLogFile(csvFileName, AsyncLogger::Format::Csv); }
 
 // Set a CVS file where the landmarks will be saved to.
 bool Publisher::setLandmarksCsvFile(std::fstream& csvFile) {
-  if (csvLandmarksFile_) {
-    csvLandmarksFile_->close();
-  }
-  csvLandmarksFile_.reset(&csvFile);
-  writeLandmarksCsvDescription();
-  return csvLandmarksFile_->good();
+  if (!landmarksLogger_.open(csvFile, AsyncLogger::Format::Csv)) return false;
+  landmarksLogger_.setColumns(landmarkColumns());
+  return true;
 }
 // Set a CVS file where the landmarks will be saved to.
 bool Publisher::setLandmarksCsvFile(std::string& csvFileName) {
-  csvLandmarksFile_.reset(new std::fstream(csvFileName.c_str(), std::ios_base::out));
-  writeLandmarksCsvDescription();
-  return csvLandmarksFile_->good();
+  return setLandmarksLogFile(csvFileName, AsyncLogger::Format::Csv);
 }
 // Set a CVS file where the landmarks will be saved to.
 bool Publisher::setLandmarksCsvFile(std::string csvFileName) {
-  csvLandmarksFile_.reset(new std::fstream(csvFileName.c_str(), std::ios_base::out));
-  writeLandmarksCsvDescription();
-  return csvLandmarksFile_->good();
+  return setLandmarksLogFile(csvFileName, AsyncLogger::Format::Csv);
+}
+
+// Set an odometry output file, written on a background thread.
+bool Publisher::setStateLogFile(const std::string& fileName, AsyncLogger::Format format) {
+  return stateLogger_.open(fileName, format);
+}
+// Set a file where the landmarks will be saved to, written on a background thread.
+bool Publisher::setLandmarksLogFile(const std::string& fileName, AsyncLogger::Format format) {
+  if (!landmarksLogger_.open(fileName, format)) return false;
+  landmarksLogger_.setColumns(landmarkColumns());
+  return true;
+}
+// Set a file where the keyframe tracks will be saved to, written on a background thread.
+bool Publisher::setTracksLogFile(const std::string& fileName, AsyncLogger::Format format) {
+  if (!tracksLogger_.open(fileName, format)) return false;
+  tracksLogger_.setColumns(trackColumns());
+  return true;
+}
+
+// Hand a state row over to the state log.
+void Publisher::logState(
+    const okvis::Time& t,
+    const okvis::kinematics::Transformation& T_WS,
+    const Eigen::Matrix<double, 9, 1>& speedAndBiases,
+    const std::vector<okvis::kinematics::Transformation, Eigen::aligned_allocator<okvis::kinematics::Transformation>>&
+        extrinsics) {
+  if (!stateLogger_.isOpen()) {
+    LOG(WARNING) << "state log not open";
+    return;
+  }
+  if (!stateLogger_.hasColumns()) stateLogger_.setColumns(stateColumns(extrinsics.size()));
+  if (stateLogger_.columns().size() != 17 + 7 * extrinsics.size()) {  // timestamp, state, extrinsics
+    LOG(WARNING) << "number of extrinsics changed, state not logged";
+    return;
+  }
+  stateLogger_.timestamp(t).reals(T_WS.r()).reals(T_WS.q().coeffs()).reals(speedAndBiases);
+  for (size_t i = 0; i < extrinsics.size(); ++i) {
+    stateLogger_.reals(extrinsics[i].r()).reals(extrinsics[i].q().coeffs());
+  }
+  stateLogger_.commit();
 }
 
 // Set the pose message that is published next.
@@ -697,10 +691,13 @@ void Publisher::setPoints(const okvis::MapPointVector& pointsMatched,
                parameters_.publishing.maxLandmarkQuality);
 
     // added by Sharmin
-    if (csvLandmarksFile_)
-      *csvLandmarksFile_ << ", " << pointsMatched.at(i).id << ", " << point[0] << ", " << point[1] << ", " << point[2]
-                         << ", " << point[3] << ", " << pointsMatched.at(i).quality << std::endl;
+    if (landmarksLogger_.isOpen())
+      landmarksLogger_.timestamp(okvis::Time(_t.sec, _t.nsec))
+          .integer(pointsMatched.at(i).id)
+          .reals(point)
+          .real(pointsMatched.at(i).quality);
   }
+  landmarksLogger_.commit();
   pointsMatched_.header.frame_id = "world";
 
 #if PCL_VERSION >= PCL_VERSION_CALC(1, 7, 0)
@@ -839,23 +836,11 @@ void Publisher::csvSaveFullStateAsCallback(const okvis::Time& t,
               speedAndBiases,
               omega_S,
               okvis::kinematics::Transformation());  // TODO(sharmin): provide setters for this hack
-  if (!csvFile_) {
-    LOG(WARNING) << "csvFile_ not ok";
-  } else {
-    // LOG(INFO)<<"filePtr: ok; ";
-    if (csvFile_->good()) {
-      // LOG(INFO)<<"file: good.";
-      Eigen::Vector3d p_WS_W = T_WS.r();
-      Eigen::Quaterniond q_WS = T_WS.q();
-      std::stringstream time;
-      time << t.sec << std::setw(9) << std::setfill('0') << t.nsec;
-      *csvFile_ << time.str() << ", " << std::scientific << std::setprecision(18) << p_WS_W[0] << ", " << p_WS_W[1]
-                << ", " << p_WS_W[2] << ", " << q_WS.x() << ", " << q_WS.y() << ", " << q_WS.z() << ", " << q_WS.w()
-                << ", " << speedAndBiases[0] << ", " << speedAndBiases[1] << ", " << speedAndBiases[2] << ", "
-                << speedAndBiases[3] << ", " << speedAndBiases[4] << ", " << speedAndBiases[5] << ", "
-                << speedAndBiases[6] << ", " << speedAndBiases[7] << ", " << speedAndBiases[8] << std::endl;
-    }
-  }
+  logState(t,
+           T_WS,
+           speedAndBiases,
+           std::vector<okvis::kinematics::Transformation,
+                       Eigen::aligned_allocator<okvis::kinematics::Transformation>>());
 }
 
 // Set and write full state including camera extrinsics to file.
@@ -872,26 +857,7 @@ void Publisher::csvSaveFullStateWithExtrinsicsAsCallback(
               speedAndBiases,
               omega_S,
               okvis::kinematics::Transformation());  // TODO(sharmin): provide setters for this hack
-  if (csvFile_) {
-    if (csvFile_->good()) {
-      Eigen::Vector3d p_WS_W = T_WS.r();
-      Eigen::Quaterniond q_WS = T_WS.q();
-      std::stringstream time;
-      time << t.sec << std::setw(9) << std::setfill('0') << t.nsec;
-      *csvFile_ << time.str() << ", " << std::scientific << std::setprecision(18) << p_WS_W[0] << ", " << p_WS_W[1]
-                << ", " << p_WS_W[2] << ", " << q_WS.x() << ", " << q_WS.y() << ", " << q_WS.z() << ", " << q_WS.w()
-                << ", " << speedAndBiases[0] << ", " << speedAndBiases[1] << ", " << speedAndBiases[2] << ", "
-                << speedAndBiases[3] << ", " << speedAndBiases[4] << ", " << speedAndBiases[5] << ", "
-                << speedAndBiases[6] << ", " << speedAndBiases[7] << ", " << speedAndBiases[8];
-      for (size_t i = 0; i < extrinsics.size(); ++i) {
-        Eigen::Vector3d p_SCi = extrinsics[i].r();
-        Eigen::Quaterniond q_SCi = extrinsics[i].q();
-        *csvFile_ << ", " << p_SCi[0] << ", " << p_SCi[1] << ", " << p_SCi[2] << ", " << q_SCi.x() << ", " << q_SCi.y()
-                  << ", " << q_SCi.z() << ", " << q_SCi.w();
-      }
-      *csvFile_ << std::endl;
-    }
-  }
+  logState(t, T_WS, speedAndBiases, extrinsics);
 }
 
 // Set and publish landmarks.
@@ -912,20 +878,7 @@ void Publisher::csvSaveLandmarksAsCallback(const okvis::Time& /*t*/,
                                            const okvis::MapPointVector& transferredLandmarks) {
   ROS_WARN("Landmarks Callback csv");
   okvis::MapPointVector empty;
-  setPoints(actualLandmarks, empty, transferredLandmarks);
-  if (csvLandmarksFile_) {
-    if (csvLandmarksFile_->good()) {
-      for (size_t l = 0; l < actualLandmarks.size(); ++l) {
-        Eigen::Vector4d landmark = actualLandmarks.at(l).point;
-        *csvLandmarksFile_ << std::setprecision(19) << actualLandmarks.at(l).id << ", " << std::scientific
-                           << std::setprecision(18) << landmark[0] << ", " << landmark[1] << ", " << landmark[2] << ", "
-                           << landmark[3] << ", "
-                           << actualLandmarks.at(l).quality
-                           // << ", " << actualLandmarks.at(l).distance
-                           << std::endl;
-      }
-    }
-  }
+  setPoints(actualLandmarks, empty, transferredLandmarks);  // also logs them
 }
 
 // Publish the last set points.
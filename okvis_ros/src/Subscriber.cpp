@@ -52,6 +52,12 @@ namespace okvis {
 
 Subscriber::~Subscriber() {
   if (imgTransport_ != 0) delete imgTransport_;
+  for (size_t i = 0; i < vioParameters_.nCameraSystem.numCameras(); ++i) {
+    const ImagePreprocessor::Statistics statistics = imagePreprocessor_->statistics(i);
+    LOG(INFO) << "camera " << i << ": received " << statistics.numReceived << " images, preprocessed "
+              << statistics.numProcessed << ", dropped " << statistics.numDropped;
+  }
+  imagePreprocessor_.reset();  // stop the workers before anything they use is destroyed
 }
 
 Subscriber::Subscriber(ros::NodeHandle& nh,
@@ -63,6 +69,11 @@ Subscriber::Subscriber(ros::NodeHandle& nh,
   tfListener_.reset(new tf2_ros::TransformListener(*tfBuffer_));
   param_reader.getParameters(vioParameters_);
   imgTransport_ = 0;
+  imagePreprocessor_.reset(new okvis::ImagePreprocessor(
+      vioParameters_,
+      vioParameters_.nCameraSystem.numCameras(),
+      std::bind(&Subscriber::addPreprocessedImage, this, std::placeholders::_1, std::placeholders::_2,
+                std::placeholders::_3)));
   if (param_reader.useDriver) {
 #ifdef HAVE_LIBVISENSOR
     if (param_reader.viSensor != nullptr)
@@ -85,11 +96,6 @@ Subscriber::Subscriber(ros::NodeHandle& nh,
   imgRightCounter = 0;  // @Sharmin
   // Added by Sharmin
   if (vioParameters_.histogramParams.histogramMethod == HistogramMethod::CLAHE) {
-    clahe = cv::createCLAHE();
-    clahe->setClipLimit(vioParameters_.histogramParams.claheClipLimit);
-    clahe->setTilesGridSize(
-        cv::Size(vioParameters_.histogramParams.claheTilesGridSize, vioParameters_.histogramParams.claheTilesGridSize));
-
     std::cout << "Set Clahe Params " << vioParameters_.histogramParams.claheClipLimit << " "
               << vioParameters_.histogramParams.claheTilesGridSize << std::endl;
   }
@@ -135,42 +141,38 @@ void Subscriber::setNodeHandle(ros::NodeHandle& nh) {
 void Subscriber::setT_Wc_W(okvis::kinematics::Transformation T_Wc_W) { vioParameters_.publishing.T_Wc_W = T_Wc_W; }
 
 void Subscriber::imageCallback(const sensor_msgs::ImageConstPtr& msg, unsigned int cameraIndex) {
-  const cv::Mat raw = readRosImage(msg);
-
-  // resizing factor( e.g., with a factor = 0.8, an image will convert from 800x600 to 640x480)
-  cv::Mat raw_resized;
-  if (vioParameters_.miscParams.resizeFactor != 1.0) {
-    cv::resize(
-        raw, raw_resized, cv::Size(), vioParameters_.miscParams.resizeFactor, vioParameters_.miscParams.resizeFactor);
-  } else {
-    raw_resized = raw.clone();
-  }
-
-  cv::Mat filtered;
-  if (vioParameters_.optimization.useMedianFilter) {
-    cv::medianBlur(raw_resized, filtered, 3);
-  } else {
-    filtered = raw_resized.clone();
+  // the preprocessing only reads the image, so it can point into the message
+  cv_bridge::CvImageConstPtr cv_ptr;
+  try {
+    cv_ptr = cv_bridge::toCvShare(msg);
+  } catch (cv_bridge::Exception& exception) {
+    ROS_FATAL("cv_bridge exception: %s", exception.what());
+    ros::shutdown();
+    return;
   }
-
-  // Added by Sharmin for CLAHE
-  cv::Mat histogram_equalized_image;
-  if (vioParameters_.histogramParams.histogramMethod == HistogramMethod::CLAHE) {
-    clahe->apply(filtered, histogram_equalized_image);
-  } else if (vioParameters_.histogramParams.histogramMethod == HistogramMethod::HISTOGRAM) {
-    cv::equalizeHist(filtered, histogram_equalized_image);
+  int colorConversion = -1;
+  if (msg->encoding == sensor_msgs::image_encodings::BGR8) {
+    colorConversion = cv::COLOR_BGR2GRAY;
+  } else if (msg->encoding == sensor_msgs::image_encodings::RGB8) {
+    colorConversion = cv::COLOR_RGB2GRAY;
   } else {
-    histogram_equalized_image = filtered;
+    CHECK_EQ(cv_ptr->encoding, sensor_msgs::image_encodings::MONO8)
+        << "Expected image with MONO8, BGR8, or RGB8 encoding."
+           "Add in here more conversions if you wish.";
   }
-  // End Added by Sharmin
 
   // adapt timestamp
   okvis::Time t(msg->header.stamp.sec, msg->header.stamp.nsec);
   t -= okvis::Duration(vioParameters_.sensors_information.imageDelay);
 
-  if (!vioInterface_->addImage(t, cameraIndex, histogram_equalized_image)) {
-    LOG(WARNING) << "Frame delayed at time " << t;
-  }
+  // keeps the message alive until the image is preprocessed
+  std::shared_ptr<const void> owner(cv_ptr.get(), [cv_ptr](const void*) {});
+  imagePreprocessor_->addImage(t, cameraIndex, cv_ptr->image, colorConversion, owner);
+}
+
+bool Subscriber::addPreprocessedImage(const okvis::Time& t, size_t cameraIndex, const cv::Mat& image) {
+  std::lock_guard<std::mutex> lock(addImageMutex_);
+  return vioInterface_->addImage(t, cameraIndex, image);
 }
 
 void Subscriber::imuCallback(const sensor_msgs::ImuConstPtr& msg) {
@@ -256,36 +258,6 @@ void Subscriber::sonarCallback(const imagenex831l::ProcessedRange::ConstPtr& msg
   }
 }
 
-const cv::Mat Subscriber::readRosImage(const sensor_msgs::ImageConstPtr& img_msg) const {
-  CHECK(img_msg);
-  cv_bridge::CvImageConstPtr cv_ptr;
-  try {
-    // TODO(Toni): here we should consider using toCvShare...
-    cv_ptr = cv_bridge::toCvCopy(img_msg);
-  } catch (cv_bridge::Exception& exception) {
-    ROS_FATAL("cv_bridge exception: %s", exception.what());
-    ros::shutdown();
-  }
-
-  CHECK(cv_ptr);
-  const cv::Mat img_const = cv_ptr->image;  // Don't modify shared image in ROS.
-  cv::Mat converted_img(img_const.size(), CV_8U);
-  if (img_msg->encoding == sensor_msgs::image_encodings::BGR8) {
-    // LOG_EVERY_N(WARNING, 10) << "Converting image...";
-    cv::cvtColor(img_const, converted_img, cv::COLOR_BGR2GRAY);
-    return converted_img;
-  } else if (img_msg->encoding == sensor_msgs::image_encodings::RGB8) {
-    // LOG_EVERY_N(WARNING, 10) << "Converting image...";
-    cv::cvtColor(img_const, converted_img, cv::COLOR_RGB2GRAY);
-    return converted_img;
-  } else {
-    CHECK_EQ(cv_ptr->encoding, sensor_msgs::image_encodings::MONO8)
-        << "Expected image with MONO8, BGR8, or RGB8 encoding."
-           "Add in here more conversions if you wish.";
-    return img_const;
-  }
-}
-
 #ifdef HAVE_LIBVISENSOR
 void Subscriber::initialiseDriverCallbacks() {
   // mostly copied from https://github.com/ethz-asl/visensor_node_devel
@@ -386,7 +358,7 @@ void Subscriber::directFrameCallback(visensor::ViFrame::Ptr frame_ptr, visensor:
   if (vioParameters_.optimization.useMedianFilter) {
     cv::medianBlur(raw, filtered, 3);
   } else {
-    filtered = raw.clone();
+    filtered = raw;  // already a copy of the driver buffer
   }
 
   // adapt timestamp
@@ -0,0 +1,61 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+/**
+ * @file okvis_log_to_csv.cpp
+ * @brief Converts binary logs written by okvis::AsyncLogger to CSV.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <okvis/AsyncLogger.hpp>
+#include <string>
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cout << "Usage: " << argv[0] << " log.bin output.csv" << std::endl;
+    return 1;
+  }
+  std::ifstream in(argv[1], std::ios_base::in | std::ios_base::binary);
+  if (!in.good()) {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::ofstream out(argv[2]);
+  if (!out.good()) {
+    std::cerr << "Could not create " << argv[2] << std::endl;
+    return 1;
+  }
+  if (!okvis::AsyncLogger::convertToCsv(in, out)) {
+    std::cerr << argv[1] << " is no binary log or is truncated" << std::endl;
+    return 1;
+  }
+  return 0;
+}
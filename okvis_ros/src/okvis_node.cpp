@@ -43,6 +43,7 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <sstream>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
@@ -55,6 +56,8 @@
 #include <okvis/RosParametersReader.hpp>
 #include <okvis/Subscriber.hpp>
 #include <okvis/ThreadedKFVio.hpp>
+#include <okvis/timing/FrameTracer.hpp>
+#include <okvis/timing/Timer.hpp>
 #include <string>
 
 #include "sensor_msgs/Imu.h"
@@ -197,11 +200,25 @@ int main(int argc, char** argv) {
   vio_parameters_reader.getParameters(parameters);
   okvis::kinematics::Transformation orig_T_Wc_W = parameters.publishing.T_Wc_W;
 
+  // Per-frame latency trace from image arrival to state publication, for chrome://tracing or ui.perfetto.dev.
+  std::string traceFilename;
+  if (nh.getParam("trace_filename", traceFilename) && !okvis::timing::FrameTracer::start(traceFilename)) {
+    LOG(ERROR) << "Could not create the trace " << traceFilename;
+  }
+
   okvis::ThreadedKFVio okvis_estimator(parameters);
 
-  // Like okvis_node_synchronous to setup files to be written
-  publisher.setCsvFile("okvis_estimator_output.csv");
-  publisher.setLandmarksCsvFile("okvis_estimator_landmarks.csv");
+  // Like okvis_node_synchronous to setup files to be written. The binary logs are converted with okvis_log_to_csv.
+  std::string logFormat = "csv";
+  nh.getParam("log_format", logFormat);
+  if (logFormat == "binary") {
+    publisher.setStateLogFile("okvis_estimator_output.bin", okvis::AsyncLogger::Format::Binary);
+    publisher.setLandmarksLogFile("okvis_estimator_landmarks.bin", okvis::AsyncLogger::Format::Binary);
+    publisher.setTracksLogFile("okvis_estimator_tracks.bin", okvis::AsyncLogger::Format::Binary);
+  } else {
+    publisher.setCsvFile("okvis_estimator_output.csv");
+    publisher.setLandmarksCsvFile("okvis_estimator_landmarks.csv");
+  }
 
   okvis::initEstimator(&okvis_estimator,
                        &publisher,
@@ -241,10 +258,35 @@ int main(int argc, char** argv) {
     srvSmoothReset_ = nh.advertiseService("smooth_reset", smoothResetFunction);
   }
 
+  // Periodic latency histograms: the file is overwritten with the totals (okvis_timing_report merges it with the
+  // pose graph snapshot), the log gets the percentiles of the last period only.
+  std::string timingSnapshotPath;
+  nh.getParam("timing_snapshot_path", timingSnapshotPath);
+  double timingSnapshotPeriod = 10.0;
+  nh.getParam("timing_snapshot_period", timingSnapshotPeriod);
+  okvis::timing::TimingSnapshot lastTimingSnapshot;
+  ros::WallTime lastTimingSnapshotTime = ros::WallTime::now();
+
   while (ros::ok()) {
     ros::spinOnce();
     okvis_estimator.display();
+
+    if (timingSnapshotPeriod > 0.0 &&
+        ros::WallTime::now() - lastTimingSnapshotTime > ros::WallDuration(timingSnapshotPeriod)) {
+      lastTimingSnapshotTime = ros::WallTime::now();
+      const okvis::timing::TimingSnapshot timingSnapshot = okvis::timing::Timing::snapshot();
+      std::stringstream window;
+      timingSnapshot.since(lastTimingSnapshot).print(window);
+      LOG(INFO) << "Timings of the last " << timingSnapshotPeriod << " s [s]:\n" << window.str();
+      if (!timingSnapshotPath.empty()) {
+        std::ofstream snapshotFile(timingSnapshotPath);
+        timingSnapshot.write(snapshotFile);
+        if (!snapshotFile.good()) LOG(WARNING) << "Could not write the timing snapshot to " << timingSnapshotPath;
+      }
+      lastTimingSnapshot = timingSnapshot;
+    }
   }
 
+  okvis::timing::FrameTracer::stop();
   return 0;
 }
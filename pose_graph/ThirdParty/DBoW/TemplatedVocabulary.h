@@ -12,8 +12,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cstdlib>
 #include <fstream>
+#include <memory>
 #include <numeric>
 #include <opencv2/core.hpp>
 #include <string>
@@ -29,6 +31,7 @@
 
 #include "../VocabularyBinary.hpp"
 // Added by VINS ]]]
+#include "utils/HammingDistance.h"
 
 namespace DBoW2 {
 
@@ -140,6 +143,22 @@ class TemplatedVocabulary {
    */
   virtual WordId transform(const TDescriptor& feature) const;
 
+  /**
+   * Transforms all features of an image at once. The features descend the
+   * flat tree level by level, scoring the children of every node with the
+   * inline Hamming kernel
+   * @param features
+   * @param word_ids (out) word id of every feature
+   * @param weights (out) word weight of every feature
+   * @param nids (out) if given, id of the node "levelsup" levels up of every feature
+   * @param levelsup
+   */
+  void transformBatch(const std::vector<TDescriptor>& features,
+                      std::vector<WordId>& word_ids,
+                      std::vector<WordValue>& weights,
+                      std::vector<NodeId>* nids = NULL,
+                      int levelsup = 0) const;
+
   /**
    * Returns the score of two vectors
    * @param a vector
@@ -252,6 +271,30 @@ class TemplatedVocabulary {
   virtual void loadBin(const std::string& filename);
   // Added by VINS ]]]
 
+  /**
+   * Maps a vocabulary saved with saveMapped. The tree is used in place from
+   * the read-only mapping and shared by all copies of this vocabulary
+   * @param filename
+   */
+  void loadMapped(const std::string& filename);
+
+  /**
+   * Saves the vocabulary in the binary format read by loadBin
+   * @param filename
+   */
+  void saveBin(const std::string& filename) const;
+
+  /**
+   * Saves the vocabulary in the memory mapped format read by loadMapped
+   * @param filename
+   */
+  void saveMapped(const std::string& filename) const;
+
+  /**
+   * Returns whether the tree is used from a memory mapped file
+   */
+  inline bool isMapped() const { return m_flat && m_flat->isMapped(); }
+
   /**
    * Stops those words whose weight is below minWeight.
    * Words are stopped by setting their weight to 0. There are not returned
@@ -420,6 +463,25 @@ class TemplatedVocabulary {
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Breadth-first copy of the tree used by transform, shared by all copies
+  /// of the vocabulary. If it is memory mapped, m_nodes and m_words are empty
+  std::shared_ptr<const SVINLoop::FlatVocabulary> m_flat;
+
+  /// Builds m_flat from m_nodes and m_words
+  void createFlatTree();
+
+  /// Adds the words of transformBatch to a bow vector and, if nids and fv
+  /// are given, the features to a feature vector
+  void addWords(const std::vector<WordId>& word_ids,
+                const std::vector<WordValue>& weights,
+                const std::vector<NodeId>* nids,
+                BowVector& v,
+                FeatureVector* fv) const;
+
+  /// Descriptor as the four 64 bit words of the mapped format
+  static void toWords(const TDescriptor& d, uint64_t* words);
+  static void fromWords(const uint64_t* words, TDescriptor& d);
 };
 
 // --------------------------------------------------------------------------
@@ -437,7 +499,10 @@ TemplatedVocabulary<TDescriptor, F>::TemplatedVocabulary(const std::string& file
   // m_scoring = KL;
   // Changed by VINS [[[
   // printf("loop start load bin\n");
-  loadBin(filename);
+  if (SVINLoop::FlatVocabulary::isMappedFile(filename))
+    loadMapped(filename);
+  else
+    loadBin(filename);
   // Changed by VINS ]]]
 }
 
@@ -448,7 +513,10 @@ TemplatedVocabulary<TDescriptor, F>::TemplatedVocabulary(const char* filename) :
   // m_scoring = KL;
   // Changed by VINS [[[
   // printf("loop start load bin\n");
-  loadBin(filename);
+  if (SVINLoop::FlatVocabulary::isMappedFile(filename))
+    loadMapped(filename);
+  else
+    loadBin(filename);
   // Changed by VINS ]]]
 }
 
@@ -533,6 +601,7 @@ TemplatedVocabulary<TDescriptor, F>& TemplatedVocabulary<TDescriptor, F>::operat
 
   this->m_nodes = voc.m_nodes;
   this->createWords();
+  this->m_flat = voc.m_flat;  // shared, read-only
 
   return *this;
 }
@@ -543,6 +612,7 @@ template <class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor, F>::create(const std::vector<std::vector<TDescriptor> >& training_features) {
   m_nodes.clear();
   m_words.clear();
+  m_flat.reset();
 
   // expected_nodes = Sum_{i=0..L} ( k^i )
   int expected_nodes = (int)((pow((double)m_k, (double)m_L + 1) - 1) / (m_k - 1));
@@ -563,6 +633,8 @@ void TemplatedVocabulary<TDescriptor, F>::create(const std::vector<std::vector<T
 
   // and set the weight of each node of the tree
   setNodeWeights(training_features);
+
+  createFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -923,6 +995,7 @@ void TemplatedVocabulary<TDescriptor, F>::setNodeWeights(
 
 template <class TDescriptor, class F>
 inline unsigned int TemplatedVocabulary<TDescriptor, F>::size() const {
+  if (isMapped()) return m_flat->nWords();
   return m_words.size();
 }
 
@@ -930,6 +1003,7 @@ inline unsigned int TemplatedVocabulary<TDescriptor, F>::size() const {
 
 template <class TDescriptor, class F>
 inline bool TemplatedVocabulary<TDescriptor, F>::empty() const {
+  if (isMapped()) return m_flat->nWords() == 0;
   return m_words.empty();
 }
 
@@ -938,6 +1012,16 @@ inline bool TemplatedVocabulary<TDescriptor, F>::empty() const {
 template <class TDescriptor, class F>
 float TemplatedVocabulary<TDescriptor, F>::getEffectiveLevels() const {
   long sum = 0;
+
+  if (isMapped()) {
+    const SVINLoop::FlatNode* nodes = m_flat->nodes();
+    const int32_t* words = m_flat->words();
+    for (int32_t wid = 0; wid < m_flat->nWords(); ++wid) {
+      for (int32_t i = words[wid]; i != 0; sum++) i = nodes[i].parent;
+    }
+    return (float)((double)sum / (double)m_flat->nWords());
+  }
+
   typename std::vector<Node*>::const_iterator wit;
   for (wit = m_words.begin(); wit != m_words.end(); ++wit) {
     const Node* p = *wit;
@@ -952,6 +1036,11 @@ float TemplatedVocabulary<TDescriptor, F>::getEffectiveLevels() const {
 
 template <class TDescriptor, class F>
 TDescriptor TemplatedVocabulary<TDescriptor, F>::getWord(WordId wid) const {
+  if (isMapped()) {
+    TDescriptor d;
+    fromWords(m_flat->descriptors()[m_flat->words()[wid]].words, d);
+    return d;
+  }
   return m_words[wid]->descriptor;
 }
 
@@ -959,6 +1048,7 @@ TDescriptor TemplatedVocabulary<TDescriptor, F>::getWord(WordId wid) const {
 
 template <class TDescriptor, class F>
 WordValue TemplatedVocabulary<TDescriptor, F>::getWordWeight(WordId wid) const {
+  if (isMapped()) return m_flat->nodes()[m_flat->words()[wid]].weight;
   return m_words[wid]->weight;
 }
 
@@ -989,40 +1079,16 @@ void TemplatedVocabulary<TDescriptor, F>::transform(const std::vector<TDescripto
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
 
-  typename std::vector<TDescriptor>::const_iterator fit;
-
-  if (m_weighting == TF || m_weighting == TF_IDF) {
-    for (fit = features.begin(); fit < features.end(); ++fit) {
-      WordId id;
-      WordValue w;
-      // w is the idf value if TF_IDF, 1 if TF
-
-      transform(*fit, id, w);
+  std::vector<WordId> word_ids;
+  std::vector<WordValue> weights;
+  transformBatch(features, word_ids, weights);
+  addWords(word_ids, weights, NULL, v, NULL);
 
-      // not stopped
-      if (w > 0) v.addWeight(id, w);
-    }
-
-    if (!v.empty() && !must) {
-      // unnecessary when normalizing
-      const double nd = v.size();
-      for (BowVector::iterator vit = v.begin(); vit != v.end(); vit++) vit->second /= nd;
-    }
-
-  } else  // IDF || BINARY
-  {
-    for (fit = features.begin(); fit < features.end(); ++fit) {
-      WordId id;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
-
-      transform(*fit, id, w);
-
-      // not stopped
-      if (w > 0) v.addIfNotExist(id, w);
-
-    }  // if add_features
-  }    // if m_weighting == ...
+  if ((m_weighting == TF || m_weighting == TF_IDF) && !v.empty() && !must) {
+    // unnecessary when normalizing
+    const double nd = v.size();
+    for (BowVector::iterator vit = v.begin(); vit != v.end(); vit++) vit->second /= nd;
+  }
 
   if (must) v.normalize(norm);
 }
@@ -1046,51 +1112,114 @@ void TemplatedVocabulary<TDescriptor, F>::transform(const std::vector<TDescripto
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
 
-  typename std::vector<TDescriptor>::const_iterator fit;
+  std::vector<WordId> word_ids;
+  std::vector<WordValue> weights;
+  std::vector<NodeId> nids;
+  transformBatch(features, word_ids, weights, &nids, levelsup);
+  addWords(word_ids, weights, &nids, v, &fv);
+
+  if ((m_weighting == TF || m_weighting == TF_IDF) && !v.empty() && !must) {
+    // unnecessary when normalizing
+    const double nd = v.size();
+    for (BowVector::iterator vit = v.begin(); vit != v.end(); vit++) vit->second /= nd;
+  }
 
-  if (m_weighting == TF || m_weighting == TF_IDF) {
-    unsigned int i_feature = 0;
-    for (fit = features.begin(); fit < features.end(); ++fit, ++i_feature) {
-      WordId id;
-      NodeId nid;
-      WordValue w;
-      // w is the idf value if TF_IDF, 1 if TF
+  if (must) v.normalize(norm);
+}
 
-      transform(*fit, id, w, &nid, levelsup);
+// --------------------------------------------------------------------------
 
-      if (w > 0)  // not stopped
-      {
-        v.addWeight(id, w);
-        fv.addFeature(nid, i_feature);
-      }
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::addWords(const std::vector<WordId>& word_ids,
+                                                   const std::vector<WordValue>& weights,
+                                                   const std::vector<NodeId>* nids,
+                                                   BowVector& v,
+                                                   FeatureVector* fv) const {
+  // Sorted by word and by node, so that both maps are filled by appending at their end instead of a search per
+  // feature. Words of the same id have the same weight, the sums do not depend on the order.
+  std::vector<std::pair<WordId, WordValue> > words;
+  std::vector<std::pair<NodeId, unsigned int> > features;
+  words.reserve(word_ids.size());
+  if (fv != NULL) features.reserve(word_ids.size());
+  for (unsigned int i_feature = 0; i_feature < word_ids.size(); ++i_feature) {
+    if (weights[i_feature] > 0)  // not stopped
+    {
+      words.push_back(std::make_pair(word_ids[i_feature], weights[i_feature]));
+      if (fv != NULL) features.push_back(std::make_pair((*nids)[i_feature], i_feature));
+    }
+  }
+  std::sort(words.begin(), words.end());
+  std::sort(features.begin(), features.end());
+
+  // TF, TF_IDF: the weight is summed over the features of the word, IDF, BINARY: added once
+  const bool sum = m_weighting == TF || m_weighting == TF_IDF;
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (!v.empty() && v.rbegin()->first == words[i].first) {
+      if (sum) v.rbegin()->second += words[i].second;
+    } else {
+      v.insert(v.end(), words[i]);
     }
+  }
 
-    if (!v.empty() && !must) {
-      // unnecessary when normalizing
-      const double nd = v.size();
-      for (BowVector::iterator vit = v.begin(); vit != v.end(); vit++) vit->second /= nd;
+  for (size_t i = 0; i < features.size(); ++i) {
+    if (fv->empty() || fv->rbegin()->first != features[i].first) {
+      fv->insert(fv->end(), std::make_pair(features[i].first, std::vector<unsigned int>()));
     }
+    fv->rbegin()->second.push_back(features[i].second);
+  }
+}
 
-  } else  // IDF || BINARY
-  {
-    unsigned int i_feature = 0;
-    for (fit = features.begin(); fit < features.end(); ++fit, ++i_feature) {
-      WordId id;
-      NodeId nid;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
+// --------------------------------------------------------------------------
 
-      transform(*fit, id, w, &nid, levelsup);
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::transformBatch(const std::vector<TDescriptor>& features,
+                                                         std::vector<WordId>& word_ids,
+                                                         std::vector<WordValue>& weights,
+                                                         std::vector<NodeId>* nids,
+                                                         int levelsup) const {
+  const size_t n = features.size();
+  word_ids.assign(n, 0);
+  weights.assign(n, 0);
+  if (nids != NULL) nids->assign(n, 0);
+  if (n == 0 || empty()) return;
+
+  if (!m_flat) {
+    for (size_t i = 0; i < n; ++i) transform(features[i], word_ids[i], weights[i], nids ? &(*nids)[i] : NULL, levelsup);
+    return;
+  }
 
-      if (w > 0)  // not stopped
-      {
-        v.addIfNotExist(id, w);
-        fv.addFeature(nid, i_feature);
+  const SVINLoop::FlatNode* nodes = m_flat->nodes();
+  const utils::Descriptor256* descriptors = m_flat->descriptors();
+  const int nid_level = m_L - levelsup;  // nids stay at the root if nid_level <= 0
+
+  std::vector<utils::Descriptor256> queries(n);
+  for (size_t i = 0; i < n; ++i) toWords(features[i], queries[i].words);
+
+  // level by level descent of all features that have not reached a leaf yet
+  std::vector<int32_t> current(n, 0);  // flat node of every feature, the root first
+  std::vector<size_t> active(n), next_active;
+  for (size_t i = 0; i < n; ++i) active[i] = i;
+  next_active.reserve(n);
+
+  for (int level = 1; !active.empty(); ++level) {
+    next_active.clear();
+    for (size_t a = 0; a < active.size(); ++a) {
+      const size_t i = active[a];
+      const SVINLoop::FlatNode& node = nodes[current[i]];
+      const int32_t child =
+          node.firstChild + utils::nearestHamming(queries[i], descriptors + node.firstChild, node.nChildren);
+      current[i] = child;
+
+      if (nids != NULL && level == nid_level) (*nids)[i] = nodes[child].nodeId;
+      if (nodes[child].nChildren == 0) {
+        word_ids[i] = nodes[child].wordId;
+        weights[i] = nodes[child].weight;
+      } else {
+        next_active.push_back(i);
       }
     }
-  }  // if m_weighting == ...
-
-  if (must) v.normalize(norm);
+    active.swap(next_active);
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -1116,6 +1245,30 @@ void TemplatedVocabulary<TDescriptor, F>::transform(const TDescriptor& feature,
                                                     WordValue& weight,
                                                     NodeId* nid,
                                                     int levelsup) const {
+  if (m_flat) {
+    // same descent on the flat tree, the children of a node are one block of packed descriptors
+    const SVINLoop::FlatNode* nodes = m_flat->nodes();
+    utils::Descriptor256 query;
+    toWords(feature, query.words);
+
+    const int nid_level = m_L - levelsup;
+    if (nid_level <= 0 && nid != NULL) *nid = 0;  // root
+
+    int32_t current = 0;  // root
+    int current_level = 0;
+    do {
+      ++current_level;
+      const SVINLoop::FlatNode& node = nodes[current];
+      current = node.firstChild + utils::nearestHamming(query, m_flat->descriptors() + node.firstChild, node.nChildren);
+
+      if (nid != NULL && current_level == nid_level) *nid = nodes[current].nodeId;
+    } while (nodes[current].nChildren > 0);
+
+    word_id = nodes[current].wordId;
+    weight = nodes[current].weight;
+    return;
+  }
+
   // propagate the feature down the tree
   std::vector<NodeId> nodes;
   typename std::vector<NodeId>::const_iterator nit;
@@ -1156,6 +1309,12 @@ void TemplatedVocabulary<TDescriptor, F>::transform(const TDescriptor& feature,
 
 template <class TDescriptor, class F>
 NodeId TemplatedVocabulary<TDescriptor, F>::getParentNode(WordId wid, int levelsup) const {
+  if (isMapped()) {
+    int32_t i = m_flat->words()[wid];
+    for (; levelsup > 0 && i != 0; --levelsup) i = m_flat->nodes()[i].parent;
+    return m_flat->nodes()[i].nodeId;
+  }
+
   NodeId ret = m_words[wid]->id;    // node id
   while (levelsup > 0 && ret != 0)  // ret == 0 --> root
   {
@@ -1171,6 +1330,22 @@ template <class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor, F>::getWordsFromNode(NodeId nid, std::vector<WordId>& words) const {
   words.clear();
 
+  if (isMapped()) {
+    const SVINLoop::FlatNode* nodes = m_flat->nodes();
+    std::vector<int32_t> parents(1, m_flat->flatIndex()[nid]);
+    while (!parents.empty()) {
+      const SVINLoop::FlatNode& node = nodes[parents.back()];
+      parents.pop_back();
+      if (node.nChildren == 0) {
+        words.push_back(node.wordId);
+        continue;
+      }
+      // reversed, so that the words come out in the same order as for the unmapped tree
+      for (int32_t c = node.nChildren - 1; c >= 0; --c) parents.push_back(node.firstChild + c);
+    }
+    return;
+  }
+
   if (m_nodes[nid].isLeaf()) {
     words.push_back(m_nodes[nid].word_id);
   } else {
@@ -1203,6 +1378,8 @@ void TemplatedVocabulary<TDescriptor, F>::getWordsFromNode(NodeId nid, std::vect
 
 template <class TDescriptor, class F>
 int TemplatedVocabulary<TDescriptor, F>::stopWords(double minWeight) {
+  if (isMapped()) throw std::string("Cannot stop words of a memory mapped vocabulary");
+
   int c = 0;
   typename std::vector<Node*>::iterator wit;
   for (wit = m_words.begin(); wit != m_words.end(); ++wit) {
@@ -1211,6 +1388,7 @@ int TemplatedVocabulary<TDescriptor, F>::stopWords(double minWeight) {
       (*wit)->weight = 0;
     }
   }
+  if (c > 0) createFlatTree();
   return c;
 }
 
@@ -1238,6 +1416,8 @@ void TemplatedVocabulary<TDescriptor, F>::load(const std::string& filename) {
 
 template <class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor, F>::save(cv::FileStorage& f, const std::string& name) const {
+  if (isMapped()) throw std::string("Cannot save a memory mapped vocabulary in text format");
+
   // Format YAML:
   // vocabulary
   // {
@@ -1332,6 +1512,7 @@ template <class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor, F>::load(const cv::FileStorage& fs, const std::string& name) {
   m_words.clear();
   m_nodes.clear();
+  m_flat.reset();
 
   cv::FileNode fvoc = fs[name];
 
@@ -1374,6 +1555,8 @@ void TemplatedVocabulary<TDescriptor, F>::load(const cv::FileStorage& fs, const
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // Added by VINS [[[
@@ -1381,6 +1564,7 @@ template <class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor, F>::loadBin(const std::string& filename) {
   m_words.clear();
   m_nodes.clear();
+  m_flat.reset();
   // printf("loop load bin\n");
   std::ifstream ifStream(filename);
   SVINLoop::Vocabulary voc;
@@ -1425,12 +1609,141 @@ void TemplatedVocabulary<TDescriptor, F>::loadBin(const std::string& filename) {
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // Added by VINS ]]]
 
 // --------------------------------------------------------------------------
 
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::loadMapped(const std::string& filename) {
+  m_words.clear();
+  m_nodes.clear();
+  m_flat = std::make_shared<const SVINLoop::FlatVocabulary>(filename);
+
+  const SVINLoop::MappedHeader& header = m_flat->header();
+  m_k = header.k;
+  m_L = header.L;
+  m_scoring = (ScoringType)header.scoringType;
+  m_weighting = (WeightingType)header.weightingType;
+
+  createScoringObject();
+}
+
+// --------------------------------------------------------------------------
+
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::saveBin(const std::string& filename) const {
+  if (isMapped()) throw std::string("Cannot save a memory mapped vocabulary in binary format");
+
+  SVINLoop::Vocabulary voc;
+  voc.k = m_k;
+  voc.L = m_L;
+  voc.scoringType = m_scoring;
+  voc.weightingType = m_weighting;
+  voc.nNodes = m_nodes.empty() ? 0 : m_nodes.size() - 1;  // the root is not saved
+  voc.nWords = m_words.size();
+  voc.nodes = new SVINLoop::Node[voc.nNodes];
+  voc.words = new SVINLoop::Word[voc.nWords];
+
+  // parents before their children, children in order, as loadBin rebuilds the child lists in file order
+  std::vector<NodeId> parents(1, 0);
+  int i = 0;
+  for (size_t p = 0; p < parents.size(); ++p) {
+    for (NodeId cid : m_nodes[parents[p]].children) {
+      const Node& child = m_nodes[cid];
+      voc.nodes[i].nodeId = cid;
+      voc.nodes[i].parentId = parents[p];
+      voc.nodes[i].weight = child.weight;
+      toWords(child.descriptor, voc.nodes[i].descriptor);
+      ++i;
+      if (!child.isLeaf()) parents.push_back(cid);
+    }
+  }
+
+  for (size_t wid = 0; wid < m_words.size(); ++wid) {
+    voc.words[wid].wordId = wid;
+    voc.words[wid].nodeId = m_words[wid]->id;
+  }
+
+  std::ofstream stream(filename, std::ios::binary);
+  if (!stream.is_open()) throw std::string("Could not open file ") + filename;
+  voc.serialize(stream);
+}
+
+// --------------------------------------------------------------------------
+
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::saveMapped(const std::string& filename) const {
+  if (!m_flat) throw std::string("Cannot save an empty vocabulary");
+  m_flat->save(filename);
+}
+
+// --------------------------------------------------------------------------
+
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::createFlatTree() {
+  m_flat.reset();
+  if (m_nodes.empty()) return;
+
+  // breadth-first order: the children of every node are appended together
+  std::vector<int32_t> flat_index(m_nodes.size(), -1);
+  std::vector<NodeId> order(1, 0);
+  order.reserve(m_nodes.size());
+  flat_index[0] = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (NodeId cid : m_nodes[order[i]].children) {
+      flat_index[cid] = order.size();
+      order.push_back(cid);
+    }
+  }
+
+  std::vector<utils::Descriptor256> descriptors(order.size());
+  std::vector<SVINLoop::FlatNode> nodes(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    const Node& node = m_nodes[order[i]];
+    toWords(node.descriptor, descriptors[i].words);
+    SVINLoop::FlatNode& flat = nodes[i];
+    flat.weight = node.weight;
+    flat.nodeId = node.id;
+    flat.parent = i == 0 ? -1 : flat_index[node.parent];
+    flat.firstChild = node.isLeaf() ? 0 : flat_index[node.children.front()];
+    flat.nChildren = node.children.size();
+    flat.wordId = node.isLeaf() && i != 0 ? (int32_t)node.word_id : -1;
+    flat.padding = 0;
+  }
+
+  std::vector<int32_t> words(m_words.size());
+  for (size_t wid = 0; wid < m_words.size(); ++wid) words[wid] = flat_index[m_words[wid]->id];
+
+  m_flat = std::make_shared<const SVINLoop::FlatVocabulary>(m_k,
+                                                            m_L,
+                                                            m_scoring,
+                                                            m_weighting,
+                                                            std::move(descriptors),
+                                                            std::move(nodes),
+                                                            std::move(words),
+                                                            std::move(flat_index));
+}
+
+// --------------------------------------------------------------------------
+
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::toWords(const TDescriptor& d, uint64_t* words) {
+  // bit b of the descriptor is bit b % 64 of word b / 64, as in loadBin. Sorry to break template here
+  const TDescriptor word_mask(~uint64_t(0));
+  for (int w = 0; w < 4; ++w) words[w] = ((d >> (64 * w)) & word_mask).to_ullong();
+}
+
+template <class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor, F>::fromWords(const uint64_t* words, TDescriptor& d) {
+  for (int i = 0; i < F::L; ++i) d[i] = (words[i >> 6] >> (i & 63)) & 1;
+}
+
+// --------------------------------------------------------------------------
+
 /**
  * Writes printable information of the vocabulary
  * @param os stream to write to
@@ -1,5 +1,14 @@
 #include "VocabularyBinary.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
 #include <opencv2/core/core.hpp>
+#include <utility>
 
 SVINLoop::Vocabulary::Vocabulary() : nNodes(0), nodes(nullptr), nWords(0), words(nullptr) {}
 
@@ -30,3 +39,126 @@ void SVINLoop::Vocabulary::deserialize(std::ifstream& stream) {
   words = new Word[nWords];
   stream.read((char*)words, sizeof(Word) * nWords);
 }
+
+namespace {
+
+// Checks every index of the mapped tables before they are used in place, returns the first problem or nullptr.
+// Children come after their node and parents before it (breadth-first order), so that every walk through the
+// tree terminates.
+const char* checkMappedTables(const SVINLoop::FlatNode* nodes,
+                              const int32_t* words,
+                              const int32_t* flatIndex,
+                              int32_t nNodes,
+                              int32_t nWords) {
+  if (nNodes < 1 || nWords < 0) return "bad node or word count";
+  for (int32_t i = 0; i < nNodes; ++i) {
+    const SVINLoop::FlatNode& node = nodes[i];
+    if (i == 0 ? node.parent != -1 : node.parent < 0 || node.parent >= i) return "bad parent index";
+    if (node.nodeId < 0 || node.nodeId >= nNodes) return "bad node id";
+    if (node.nChildren < 0 || node.nChildren > nNodes) return "bad child count";
+    if (node.nChildren > 0 && (node.firstChild <= i || node.firstChild > nNodes - node.nChildren)) {
+      return "bad child index";
+    }
+    if (node.nChildren == 0 && i != 0 && (node.wordId < 0 || node.wordId >= nWords)) return "bad word id";
+  }
+  for (int32_t w = 0; w < nWords; ++w) {
+    if (words[w] <= 0 || words[w] >= nNodes || nodes[words[w]].nChildren != 0) return "bad word index";
+  }
+  for (int32_t n = 0; n < nNodes; ++n) {
+    if (flatIndex[n] < 0 || flatIndex[n] >= nNodes) return "bad flat index";
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+const char SVINLoop::MappedHeader::kMagic[8] = {'S', 'V', 'I', 'N', 'V', 'O', 'C', '\0'};
+
+SVINLoop::FlatVocabulary::FlatVocabulary(int32_t k,
+                                         int32_t L,
+                                         int32_t scoringType,
+                                         int32_t weightingType,
+                                         std::vector<utils::Descriptor256>&& descriptors,
+                                         std::vector<FlatNode>&& nodes,
+                                         std::vector<int32_t>&& words,
+                                         std::vector<int32_t>&& flatIndex)
+    : data_(nullptr),
+      size_(0),
+      ownedDescriptors_(std::move(descriptors)),
+      ownedNodes_(std::move(nodes)),
+      ownedWords_(std::move(words)),
+      ownedFlatIndex_(std::move(flatIndex)) {
+  std::memset(&header_, 0, sizeof(header_));
+  std::memcpy(header_.magic, MappedHeader::kMagic, sizeof(header_.magic));
+  header_.version = MappedHeader::kVersion;
+  header_.k = k;
+  header_.L = L;
+  header_.scoringType = scoringType;
+  header_.weightingType = weightingType;
+  header_.nNodes = ownedNodes_.size();
+  header_.nWords = ownedWords_.size();
+
+  descriptors_ = ownedDescriptors_.data();
+  nodes_ = ownedNodes_.data();
+  words_ = ownedWords_.data();
+  flatIndex_ = ownedFlatIndex_.data();
+}
+
+SVINLoop::FlatVocabulary::FlatVocabulary(const std::string& filename) : data_(nullptr), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw std::string("Could not open file ") + filename;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(MappedHeader))) {
+    close(fd);
+    throw std::string("Not a mapped vocabulary: ") + filename;
+  }
+  size_ = file_stat.st_size;
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) throw std::string("Could not map file ") + filename;
+
+  std::memcpy(&header_, data, sizeof(header_));
+  const size_t nNodes = std::max(header_.nNodes, 0);
+  const size_t nWords = std::max(header_.nWords, 0);
+  const size_t expected_size = sizeof(MappedHeader) + (sizeof(utils::Descriptor256) + sizeof(FlatNode)) * nNodes +
+                               sizeof(int32_t) * (nWords + nNodes);
+  if (std::memcmp(header_.magic, MappedHeader::kMagic, sizeof(header_.magic)) != 0 ||
+      header_.version != MappedHeader::kVersion || expected_size != size_) {
+    munmap(data, size_);
+    throw std::string("Not a mapped vocabulary or wrong version: ") + filename;
+  }
+
+  descriptors_ = reinterpret_cast<const utils::Descriptor256*>(static_cast<const MappedHeader*>(data) + 1);
+  nodes_ = reinterpret_cast<const FlatNode*>(descriptors_ + nNodes);
+  words_ = reinterpret_cast<const int32_t*>(nodes_ + nNodes);
+  flatIndex_ = words_ + nWords;
+  const char* error = checkMappedTables(nodes_, words_, flatIndex_, header_.nNodes, header_.nWords);
+  if (error != nullptr) {
+    munmap(data, size_);
+    throw std::string("Corrupted mapped vocabulary (") + error + "): " + filename;
+  }
+  data_ = data;
+  // every transform descends through the upper levels, fault the pages in ahead of time
+  madvise(data_, size_, MADV_WILLNEED);
+}
+
+SVINLoop::FlatVocabulary::~FlatVocabulary() {
+  if (data_ != nullptr) munmap(data_, size_);
+}
+
+bool SVINLoop::FlatVocabulary::isMappedFile(const std::string& filename) {
+  std::ifstream stream(filename, std::ios::binary);
+  char magic[sizeof(MappedHeader::kMagic)];
+  return stream.read(magic, sizeof(magic)) && std::memcmp(magic, MappedHeader::kMagic, sizeof(magic)) == 0;
+}
+
+void SVINLoop::FlatVocabulary::save(const std::string& filename) const {
+  std::ofstream stream(filename, std::ios::binary);
+  if (!stream.is_open()) throw std::string("Could not open file ") + filename;
+  stream.write((const char*)&header_, sizeof(MappedHeader));
+  stream.write((const char*)descriptors_, sizeof(utils::Descriptor256) * header_.nNodes);
+  stream.write((const char*)nodes_, sizeof(FlatNode) * header_.nNodes);
+  stream.write((const char*)words_, sizeof(int32_t) * header_.nWords);
+  stream.write((const char*)flatIndex_, sizeof(int32_t) * header_.nNodes);
+  if (!stream.good()) throw std::string("Could not write file ") + filename;
+}
@@ -1,9 +1,13 @@
 #ifndef VocabularyBinary_hpp
 #define VocabularyBinary_hpp
 
+#include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <string>
+#include <vector>
+
+#include "utils/HammingDistance.h"
 
 namespace SVINLoop {
 
@@ -40,6 +44,86 @@ struct Vocabulary {
   inline static size_t staticDataSize() { return sizeof(Vocabulary) - sizeof(Node*) - sizeof(Word*); }
 };
 
+// Vocabulary tree in breadth-first order. The children of a node are consecutive, so that their descriptors
+// form one contiguous block that the Hamming kernel can scan.
+struct FlatNode {
+  double weight;
+  int32_t nodeId;      // id of the node in TemplatedVocabulary
+  int32_t parent;      // flat index, -1 for the root
+  int32_t firstChild;  // flat index
+  int32_t nChildren;
+  int32_t wordId;  // -1 if the node is not a leaf
+  int32_t padding;
+};
+
+// Header of the memory mapped vocabulary file. It is followed by the tables of FlatVocabulary: descriptors,
+// nodes, words and flat indices. The tables are used in place, nothing is parsed or copied when loading.
+struct MappedHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t k;
+  int32_t L;
+  int32_t scoringType;
+  int32_t weightingType;
+  int32_t nNodes;  // including the root
+  int32_t nWords;
+  uint8_t padding[28];  // the tables start on a cache line
+
+  static const char kMagic[8];
+  static const uint32_t kVersion = 2;
+};
+
+static_assert(sizeof(FlatNode) == 32, "FlatNode has to be 32 bytes");
+static_assert(sizeof(MappedHeader) == 64, "MappedHeader has to be 64 bytes");
+
+class FlatVocabulary {
+ public:
+  // Takes over the tables built from a TemplatedVocabulary.
+  FlatVocabulary(int32_t k,
+                 int32_t L,
+                 int32_t scoringType,
+                 int32_t weightingType,
+                 std::vector<utils::Descriptor256>&& descriptors,
+                 std::vector<FlatNode>&& nodes,
+                 std::vector<int32_t>&& words,
+                 std::vector<int32_t>&& flatIndex);
+  // Maps a file written by save read-only. Throws a std::string if the file cannot be mapped, is no mapped
+  // vocabulary or any of its node, child, parent or word indices is out of range.
+  explicit FlatVocabulary(const std::string& filename);
+  ~FlatVocabulary();
+  FlatVocabulary(const FlatVocabulary&) = delete;
+  FlatVocabulary& operator=(const FlatVocabulary&) = delete;
+
+  // Checks the magic number only.
+  static bool isMappedFile(const std::string& filename);
+
+  void save(const std::string& filename) const;
+
+  bool isMapped() const { return data_ != nullptr; }
+  const MappedHeader& header() const { return header_; }
+  int32_t nNodes() const { return header_.nNodes; }
+  int32_t nWords() const { return header_.nWords; }
+
+  const utils::Descriptor256* descriptors() const { return descriptors_; }
+  const FlatNode* nodes() const { return nodes_; }
+  const int32_t* words() const { return words_; }          // flat index of every word
+  const int32_t* flatIndex() const { return flatIndex_; }  // flat index of every node id
+
+ private:
+  MappedHeader header_;
+  void* data_;  // mapping, nullptr if the tables are owned
+  size_t size_;
+  std::vector<utils::Descriptor256> ownedDescriptors_;
+  std::vector<FlatNode> ownedNodes_;
+  std::vector<int32_t> ownedWords_;
+  std::vector<int32_t> ownedFlatIndex_;
+
+  const utils::Descriptor256* descriptors_;
+  const FlatNode* nodes_;
+  const int32_t* words_;
+  const int32_t* flatIndex_;
+};
+
 }  // namespace SVINLoop
 
 #endif /* VocabularyBinary_hpp */
@@ -9,6 +9,8 @@
 #include <opencv2/core.hpp>
 
 using Timestamp = int64_t;
+// @Reloc: landmark id, multiframe id and keypoint index of a keyframe point, the okvis ids are 64 bit
+using PointIds = Eigen::Matrix<int64_t, 3, 1>;
 
 struct TrackingInfo {
  public:
@@ -51,7 +53,7 @@ struct KeyframeInfo {
                const TrackingInfo& tracking_info,
                const std::vector<cv::Point3f>& keyframe_points,
                const std::vector<cv::KeyPoint>& keypoints,
-               const std::vector<Eigen::Vector3i>& points_ids,
+               const std::vector<PointIds>& points_ids,
                const std::vector<std::vector<int64_t>>& points_covisibilities)
       : keyframe_index_(keyframe_index),
         keyframe_image_(image),
@@ -72,7 +74,7 @@ struct KeyframeInfo {
                const Eigen::Matrix3d& rotation,
                const std::vector<cv::Point3f>& keyframe_points,
                const std::vector<cv::KeyPoint>& keypoints,
-               const std::vector<Eigen::Vector3i>& points_ids,
+               const std::vector<PointIds>& points_ids,
                const std::vector<std::vector<int64_t>>& points_observations)
       : timestamp_(timestamp),
         keyframe_index_(keyframe_index),
@@ -94,10 +96,17 @@ struct KeyframeInfo {
   std::vector<cv::Point3f> keyfame_points_;
   std::vector<cv::KeyPoint> cv_keypoints_;
   // @Reloc: landmarkId, mfId, keypointIdx related to each point
-  std::vector<Eigen::Vector3i> keypoint_ids_;
+  std::vector<PointIds> keypoint_ids_;
   std::vector<std::vector<int64_t>> point_covisibilities_;
 };
 
+// Pose of a keyframe in the loop closed world frame.
+struct KeyframePose {
+  int64_t index;
+  Eigen::Vector3d translation;
+  Eigen::Matrix3d rotation;
+};
+
 enum TrackingStatus { NOT_INITIALIZED = 0, TRACKING_VIO = 1, TRACKING_PRIMITIVE_ESTIMATOR = 2 };
 
 typedef std::function<void(const uint64_t)> EventCallback;
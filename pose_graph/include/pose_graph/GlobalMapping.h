@@ -1,11 +1,15 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <atomic>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "common/Definitions.h"
 
@@ -43,6 +47,7 @@ struct Landmark {
   std::unordered_map<uint64_t, Observation> keyframe_observations_;  // < Keyframe index, observation
 
   uint64_t latest_kf_obs_;
+  size_t slot_;  //< Index of the point in the snapshots.
 
   void updateObservation(uint64_t keyframe_id,
                          const Eigen::Vector3d& position,
@@ -59,19 +64,71 @@ typedef std::unordered_map<uint64_t,
                            Eigen::aligned_allocator<std::pair<const uint64_t, Landmark>>>
     LandmarkMap;
 
+// Landmark as published: position, color and quality only.
+struct MapPoint {
+  float x, y, z;
+  uint8_t r, g, b;
+  float quality;
+};
+
+// Read-only view of the map points at one time. The chunks the map did not touch since the previous snapshot are
+// shared with it, taking a snapshot copies the changed chunks only.
+class GlobalMapSnapshot {
+ public:
+  static constexpr size_t kChunkSize = 4096;
+  typedef std::vector<MapPoint> Chunk;
+
+  size_t size() const { return size_; }
+  const MapPoint& operator[](size_t index) const { return (*chunks_[index / kChunkSize])[index % kChunkSize]; }
+  const std::shared_ptr<const Chunk>& chunk(size_t index) const { return chunks_[index]; }
+  size_t numChunks() const { return chunks_.size(); }
+
+  // One point per voxel of the given size: the quality weighted mean of the points above min_quality in it.
+  void downsample(double voxel_size, double min_quality, std::vector<MapPoint>& points) const;  // NOLINT
+
+ private:
+  friend class GlobalMap;
+  std::vector<std::shared_ptr<const Chunk>> chunks_;
+  size_t size_ = 0;
+};
+
+typedef std::function<std::shared_ptr<const GlobalMapSnapshot>()> GlobalMapSnapshotCallback;
+
 class GlobalMap {
  private:
-  // Map of all points.
+  struct KeyframeAnchor {
+    Eigen::Vector3d translation;  // pose the landmark positions were last computed with
+    Eigen::Matrix3d rotation;
+    std::vector<uint64_t> landmark_ids;  // landmarks observed by the keyframe
+  };
+
+  // Recomputes the position of a landmark from all its observations and the anchored keyframe poses.
+  void reanchorLandmark(Landmark& landmark);  // NOLINT
+  // Copies the landmark to its slot in points_, setPoint also marks the chunk as changed.
+  void writePoint(const Landmark& landmark);
+  void setPoint(const Landmark& landmark);
+
+  mutable std::mutex mutex_;  // the map is filled by the loop closure and read by the publisher
 
+  // Map of all points.
   LandmarkMap map_points_;
+  std::unordered_map<uint64_t, KeyframeAnchor> keyframes_;
   uint64_t last_loop_closure_optimization_time_;
 
+  // Points by slot and the chunks that changed since the last snapshot.
+  std::vector<MapPoint> points_;
+  std::vector<bool> dirty_chunks_;
+  std::shared_ptr<const GlobalMapSnapshot> snapshot_;
+
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   GlobalMap();
   virtual ~GlobalMap() = default;
 
+  // Pose of a keyframe whose landmarks are added next, replaces the anchor if it is there already.
+  void addKeyframe(const KeyframePose& pose);
+
   void addLandmark(const Eigen::Vector3d& global_pos,
                    uint64_t landmark_id,
                    double quality,
@@ -84,8 +141,17 @@ class GlobalMap {
                       double quality,
                       const Eigen::Vector3d& color);
 
-  LandmarkMap getMapPoints() const { return map_points_; }
+  // Moves the keyframes to their optimized poses and re-anchors the landmarks they observe, the others are not
+  // touched. Poses closer than the tolerances to the anchored ones and unknown keyframes are skipped. Returns the
+  // number of re-anchored landmarks.
+  size_t updateKeyframePoses(const std::vector<KeyframePose>& poses,
+                             size_t num_threads = 0,
+                             double translation_tolerance = 1e-6,
+                             double rotation_tolerance = 1e-6);
+
+  std::shared_ptr<const GlobalMapSnapshot> snapshot();
+  size_t size() const;
 
   void loopClosureOptimizationFinishCallback(const Timestamp time);
-  bool loop_closure_optimization_finished_;  // this flag is set to true when loop closure optimization is done
+  std::atomic<bool> loop_closure_optimization_finished_;  // set to true when loop closure optimization is done
 };
@@ -6,6 +6,7 @@
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include <map>
+#include <mutex>
 #include <opencv2/core.hpp>
 #include <opencv2/core/eigen.hpp>
 #include <opencv2/features2d.hpp>
@@ -16,9 +17,12 @@
 
 #include "DBoW/DBoW2.h"
 #include "DVision/DVision.h"
+#include "common/Definitions.h"
 #include "pose_graph/Parameters.h"
+#include "utils/HammingDistance.h"
 #include "utils/Utils.h"
 
+// Immutable after construction: one instance is loaded at startup and shared by all keyframes.
 class BriefExtractor {
  public:
   virtual void operator()(const cv::Mat& im,
@@ -33,7 +37,7 @@ class Keyframe {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   Keyframe(int64_t _time_stamp,
-           std::vector<Eigen::Vector3i>& _point_ids,  // NOLINT
+           std::vector<PointIds>& _point_ids,  // NOLINT
            int _index,
            Eigen::Vector3d& _svin_T_w_i,             // NOLINT
            Eigen::Matrix3d& _svin_R_w_i,             // NOLINT
@@ -43,6 +47,7 @@ class Keyframe {
            std::map<Keyframe*, int>& KFcounter,      // NOLINT
            int _sequence,
            BriefVocabulary* vocBrief,
+           const BriefExtractor& brief_extractor,
            const Parameters& params,
            const bool vio_keyframe = true);
 
@@ -55,28 +60,26 @@ class Keyframe {
            const Parameters& params,
            const bool is_vio_keyframe = false);
 
-  bool findConnection(Keyframe* old_kf);
-  void computeWindowBRIEFPoint();
-  void computeBRIEFPoint();
-
-  int HammingDis(const DVision::BRIEF256::bitset& a, const DVision::BRIEF256::bitset& b);
-  bool searchInAera(const DVision::BRIEF256::bitset window_descriptor,
-                    const std::vector<DVision::BRIEF256::bitset>& descriptors_old,
-                    const std::vector<cv::KeyPoint>& keypoints_old,
-                    const std::vector<cv::KeyPoint>& keypoints_old_norm,
-                    cv::Point2f& best_match,                            // NOLINT
-                    cv::Point2f& best_match_norm);                      // NOLINT
+  // Descriptor search and PnP RANSAC against a loop candidate. Only fills relative_pose (the loop_info of a
+  // verified loop), the caller registers the loop: verification runs concurrently to the pose graph. In debug
+  // mode, debug_output_mutex (if set) serializes the appends to loop_closure.txt of concurrent verifications.
+  bool findConnection(const Keyframe* old_kf,
+                      Eigen::Matrix<double, 8, 1>& relative_pose,  // NOLINT
+                      std::mutex* debug_output_mutex = nullptr) const;
+  void computeWindowBRIEFPoint(const BriefExtractor& extractor);
+  void computeBRIEFPoint(const BriefExtractor& extractor);
+
   void searchByBRIEFDes(std::vector<cv::Point2f>& matched_2d_old,       // NOLINT
                         std::vector<cv::Point2f>& matched_2d_old_norm,  // NOLINT
                         std::vector<uchar>& status,                     // NOLINT
-                        const std::vector<DVision::BRIEF256::bitset>& descriptors_old,
+                        const std::vector<utils::Descriptor256>& descriptors_old,
                         const std::vector<cv::KeyPoint>& keypoints_old,
-                        const std::vector<cv::KeyPoint>& keypoints_old_norm);
+                        const std::vector<cv::KeyPoint>& keypoints_old_norm) const;
   void PnPRANSAC(const std::vector<cv::Point2f>& matched_2d_old_norm,
                  const std::vector<cv::Point3f>& matched_3d,
                  std::vector<uchar>& status,                           // NOLINT
                  Eigen::Vector3d& PnP_T_old,                           // NOLINT
-                 Eigen::Matrix3d& PnP_R_old);                          // NOLINT
+                 Eigen::Matrix3d& PnP_R_old) const;                    // NOLINT
   void getSVInPose(Eigen::Vector3d& _T_w_i, Eigen::Matrix3d& _R_w_i);  // NOLINT
   void getPose(Eigen::Vector3d& _T_w_i, Eigen::Matrix3d& _R_w_i);      // NOLINT
   void updatePose(const Eigen::Vector3d& _T_w_i, const Eigen::Matrix3d& _R_w_i);
@@ -121,7 +124,7 @@ class Keyframe {
   cv::Mat image;
   std::vector<cv::Point3f> point_3d;
   std::vector<cv::KeyPoint> point_2d_uv;
-  std::vector<Eigen::Vector3i> point_ids_;
+  std::vector<PointIds> point_ids_;
 
   std::vector<cv::KeyPoint> keypoints;
   std::vector<cv::KeyPoint> keypoints_norm;
@@ -129,6 +132,9 @@ class Keyframe {
   std::vector<cv::KeyPoint> window_keypoints;
   std::vector<DVision::BRIEF256::bitset> brief_descriptors;
   std::vector<DVision::BRIEF256::bitset> window_brief_descriptors;
+  // brief_descriptors and window_brief_descriptors packed for utils::matchHamming
+  std::vector<utils::Descriptor256> brief_descriptors_packed;
+  std::vector<utils::Descriptor256> window_brief_descriptors_packed;
   bool has_fast_point;
   int sequence;
 
@@ -5,11 +5,15 @@
 #include <pcl/point_types.h>
 #include <std_srvs/Trigger.h>
 
+#include <atomic>
 #include <boost/optional.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "common/Definitions.h"
@@ -18,19 +22,30 @@
 #include "pose_graph/Parameters.h"
 #include "pose_graph/PoseGraph.h"
 #include "pose_graph/SwitchingEstimator.h"
+#include "utils/Statistics.h"
 #include "utils/ThreadSafeQueue.h"
 #include "utils/ThreadsafeTemporalBuffer.h"
 
+/*
+    Keyframes go through three stages, each fed by its own queue: feature extraction (BRIEF descriptors and BoW
+    vector, loop_closure_params.extraction_workers threads), BoW query (database and pose graph insertion, one
+    thread in keyframe order) and geometric verification (descriptor search and PnP RANSAC,
+    loop_closure_params.verification_workers threads). run() only ingests keyframes: it drops new keyframes if
+    max_pending_keyframes are in the first two stages, and loop candidates beyond max_pending_loop_candidates
+    drop the oldest ones, so that a slow verification never stalls the ingestion.
+*/
 class LoopClosure {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   LoopClosure(Parameters& params);
-  ~LoopClosure() = default;
+  ~LoopClosure();
 
+  // Ingestion of the keyframes, returns after shutdown.
   void run();
 
   void getGlobalMap(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud);
+  std::shared_ptr<const GlobalMapSnapshot> getGlobalMapSnapshot();
   void updateGlobalMap();
   void getGlobalPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud);  // NOLINT (already pointer)
   void addPointsToGlobalMap(const int64_t keyframe_index,
@@ -39,7 +54,7 @@ class LoopClosure {
                             const Eigen::Vector3d& camera_position,
                             const std::vector<cv::Point3f>& keyframe_points,
                             const std::vector<float>& point_qualities,
-                            const std::vector<Eigen::Vector3i>& point_ids,
+                            const std::vector<PointIds>& point_ids,
                             const std::vector<cv::KeyPoint>& cv_keypoints);
 
   inline void fillKeyframeTrackingQueue(std::unique_ptr<KeyframeInfo> keyframe_info) {
@@ -70,6 +85,32 @@ class LoopClosure {
   void setup();
   static constexpr int64_t kBufferLengthNs = 2000000000;  // 2 seconds
 
+  typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+  // A keyframe on its way through the feature extraction and BoW query stages.
+  struct PendingKeyframe {
+    std::unique_ptr<KeyframeInfo> info;
+    Timestamp stamp;
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d translation;
+    uint32_t combined_kf_index;
+    uint32_t primitive_keyframes;
+    TimePoint ingestion_time;
+    // set by the extraction stage, owned until the BoW query stage hands it to the pose graph
+    std::unique_ptr<Keyframe> keyframe;
+    bool extracted = false;  // guarded by extraction_mutex_
+  };
+
+  struct LoopCandidate {
+    Keyframe* keyframe;
+    int loop_index;
+    TimePoint detection_time;
+  };
+
+  void extractionWorker();
+  void bowQueryWorker();
+  void verificationWorker();
+
   Parameters params_;
   std::unique_ptr<PoseGraph> pose_graph_;
   std::unique_ptr<GlobalMap> global_map_;
@@ -86,6 +127,8 @@ class LoopClosure {
   Eigen::Vector3d last_translation_;
 
   BriefVocabulary* voc_;
+  // Loaded once from params_.brief_pattern_file_ and shared by all keyframes.
+  std::shared_ptr<const BriefExtractor> brief_extractor_;
 
   std::vector<std::pair<Timestamp, Eigen::Matrix4d>> primitive_estimator_poses_;
   std::vector<std::pair<Timestamp, Eigen::Matrix4d>> robust_estimator_poses_;
@@ -104,7 +147,25 @@ class LoopClosure {
   // TODO(bjoshi): I had issues with using pointers to Eigen::Matrix4d. So using cv::Mat for now
   utils::ThreadsafeTemporalBuffer<cv::Mat> primitive_estimator_poses_buffer_;
 
-  bool shutdown_;
+  std::atomic_bool shutdown_;
+
+  ThreadsafeQueue<std::shared_ptr<PendingKeyframe>> extraction_queue_;
+  ThreadsafeQueue<std::shared_ptr<PendingKeyframe>> bow_query_queue_;  // in ingestion order
+  std::mutex extraction_mutex_;
+  std::condition_variable extraction_condition_;  // a keyframe was extracted or shutdown
+  ThreadsafeQueue<LoopCandidate> verification_queue_;
+  std::vector<std::thread> workers_;
+  std::mutex debug_output_mutex_;  // the verification workers append to the same debug files
+
+  // latency of every stage, and the time keyframes and candidates waited for it
+  utils::StatsCollector extraction_stats_;
+  utils::StatsCollector extraction_wait_stats_;
+  utils::StatsCollector bow_query_stats_;
+  utils::StatsCollector bow_query_wait_stats_;
+  utils::StatsCollector verification_stats_;
+  utils::StatsCollector verification_wait_stats_;
+  utils::StatsCollector dropped_keyframes_stats_;
+  utils::StatsCollector dropped_candidates_stats_;
 
   PoseCallback primitive_publish_callback_;
 };
@@ -16,6 +16,12 @@ struct LoopClosureParams {
   double pnp_reprojection_thresh;
   double pnp_ransac_iterations;
   int min_correspondences;
+
+  // Pipeline of LoopClosure: feature extraction -> BoW query -> geometric verification.
+  int extraction_workers = 2;
+  int verification_workers = 1;
+  size_t max_pending_keyframes = 10;       // in extraction or BoW query, new keyframes are dropped beyond
+  size_t max_pending_loop_candidates = 5;  // waiting for verification, the oldest are dropped beyond
 };
 
 struct HealthParams {
@@ -29,6 +35,7 @@ struct HealthParams {
 struct GlobalMappingParams {
   bool enabled = false;  // by default global mapping is disabled
   double min_lmk_quality = 0.001;
+  double voxel_size = 0.0;  // the published map keeps one point per voxel of this size [m], 0 publishes all points
 };
 
 class Parameters {
@@ -48,6 +55,7 @@ class Parameters {
   int fast_relocalization_;
 
   std::string vocabulary_file_;
+  std::string mapped_vocabulary_file_;  // empty if there is none, preferred over vocabulary_file_
 
   // for visulization
   double camera_visual_size_;
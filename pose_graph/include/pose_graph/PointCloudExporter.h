@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pose_graph/GlobalMapping.h"
+
+// Writes global map snapshots to binary PLY files from its own thread, one snapshot chunk at a time: neither the
+// service callback that queues the export nor the writer hold a copy of the whole map.
+class PointCloudExporter {
+ public:
+  explicit PointCloudExporter(double min_quality);
+  ~PointCloudExporter();  // writes the queued export before returning
+
+  // Queues the export of the points above the minimum quality, returns false if an export is still running. An
+  // append only writes the points added to the map since the last export to the same file and updates its vertex
+  // count, the points already in the file keep the positions they were saved with. If there is no such export or
+  // the file changed since, the whole snapshot is written.
+  bool save(std::shared_ptr<const GlobalMapSnapshot> snapshot, const std::string& filename, bool append);
+
+  bool busy() const;
+  double progress() const;  // fraction of the running export written, 1 when idle
+  void waitUntilIdle();
+
+ private:
+  struct Job {
+    std::shared_ptr<const GlobalMapSnapshot> snapshot;
+    std::string filename;
+    bool append;
+  };
+
+  void run();
+  bool write(const Job& job);
+
+  const double min_quality_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable job_condition_;   // a job was queued or shutdown
+  std::condition_variable idle_condition_;  // the job was written
+  std::unique_ptr<Job> job_;
+  bool busy_ = false;
+  bool shutdown_ = false;
+  std::atomic<double> progress_;
+
+  // What the last export wrote, for appending to it. Only used by the export thread.
+  std::string saved_filename_;
+  size_t saved_slots_ = 0;     // snapshot points covered by the file
+  size_t saved_vertices_ = 0;  // points in the file
+
+  std::thread thread_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <ceres/loss_function.h>
+#include <ceres/problem.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <memory>
+
+#include "pose_graph/FourDOFError.h"
+#include "pose_graph/PoseGraphState.h"
+
+/*
+    Persistent 4-DoF (x, y, z, yaw) pose graph. Parameter blocks and residuals stay in the ceres problem
+    across loop closures: only the keyframes and edges that are new since the last solve are added, and
+    every solve is warm started from the previous solution.
+*/
+class PoseGraph4DoF {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  PoseGraph4DoF();
+  ~PoseGraph4DoF() = default;
+
+  /**
+   * @brief Drop the graph and start a new one. The first keyframe added afterwards is the fixed anchor.
+   * @param first_index Index of the first keyframe of the new graph.
+   */
+  void reset(int first_index);
+
+  /**
+   * @brief Add the next keyframe together with its sequential edges. Indices have to be consecutive.
+   * @param index     Global index of the keyframe.
+   * @param sequence  Sequence the keyframe belongs to. Sequential edges only connect the same sequence.
+   * @param svin_t    Odometry position, used for the sequential edges.
+   * @param svin_r    Odometry orientation, used for the sequential edges.
+   * @param init_t    Initial position of the keyframe in the optimization (warm start).
+   * @param init_r    Initial orientation of the keyframe in the optimization (warm start).
+   */
+  void addKeyframe(int index,
+                   int sequence,
+                   const Eigen::Vector3d& svin_t,
+                   const Eigen::Matrix3d& svin_r,
+                   const Eigen::Vector3d& init_t,
+                   const Eigen::Matrix3d& init_r);
+
+  /**
+   * @brief Add a loop closure edge. Both keyframes have to be in the graph already.
+   * @param index         Index of the keyframe that closed the loop.
+   * @param loop_index    Index of the (older) connected keyframe.
+   * @param relative_t    Position of the keyframe in the frame of the connected keyframe.
+   * @param relative_yaw  Yaw of the keyframe relative to the connected keyframe [deg].
+   */
+  void addLoopEdge(int index, int loop_index, const Eigen::Vector3d& relative_t, double relative_yaw);
+
+  /// @brief Optimize the graph starting from the current estimate.
+  void solve(int max_num_iterations = 5);
+
+  /// @brief Optimized pose of a keyframe in the graph.
+  void getPose(int index, Eigen::Vector3d& t, Eigen::Matrix3d& r) const;  // NOLINT
+
+  bool empty() const { return last_index_ < first_index_; }
+  int firstIndex() const { return first_index_; }
+  /// @brief Index of the newest keyframe in the graph, firstIndex() - 1 if the graph is empty.
+  int lastIndex() const { return last_index_; }
+  size_t numResidualBlocks() const { return problem_ ? problem_->NumResidualBlocks() : 0; }
+
+ private:
+  // Odometry pose of one of the newest keyframes, needed to create the sequential edges.
+  struct OdometryPose {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Eigen::Vector3d t;
+    Eigen::Quaterniond q;
+    double yaw;
+  };
+  static constexpr int kNumSequentialEdges = 2;
+
+  std::unique_ptr<ceres::Problem> problem_;
+  ceres::LocalParameterization* angle_local_parameterization_;  // owned by problem_
+  ceres::LossFunction* loop_loss_function_;                     // owned by problem_
+
+  // Parameter blocks, indexed by keyframe index. Only the yaw of the euler angles is optimized,
+  // pitch and roll are the odometry ones. The chunked storage keeps the block pointers valid.
+  PoseGraphState state_;
+  OdometryPose odometry_window_[kNumSequentialEdges + 1];  // ring buffer, indexed by keyframe index
+  int first_index_;
+  int last_index_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+/*
+    Per-keyframe pose graph state (euler angles, translation, quaternion, sequence) stored as structure of
+    arrays and indexed by the global keyframe index.
+    The arrays grow in fixed-size chunks on the heap: growing never moves existing entries, so the pointers
+    handed to ceres as parameter blocks stay valid, and the memory is reused by the next optimization.
+*/
+class PoseGraphState {
+ public:
+  static constexpr int kChunkBits = 10;
+  static constexpr int kChunkSize = 1 << kChunkBits;
+
+  PoseGraphState() : size_(0) {}
+
+  // Make the indices [0, size) accessible. Allocated memory is never released.
+  void resize(int size) {
+    while (static_cast<int>(chunks_.size()) * kChunkSize < size) chunks_.emplace_back(new Chunk);
+    size_ = size;
+  }
+  void clear() { size_ = 0; }
+  int size() const { return size_; }
+
+  // yaw, pitch, roll [deg]
+  double* euler(int index) { return chunk(index).euler[index & kChunkMask]; }
+  double* t(int index) { return chunk(index).t[index & kChunkMask]; }
+  // x, y, z, w, i.e. the layout of Eigen::Quaterniond::coeffs()
+  double* q(int index) { return chunk(index).q[index & kChunkMask]; }
+  int& sequence(int index) { return chunk(index).sequence[index & kChunkMask]; }
+  const double* euler(int index) const { return chunk(index).euler[index & kChunkMask]; }
+  const double* t(int index) const { return chunk(index).t[index & kChunkMask]; }
+  const double* q(int index) const { return chunk(index).q[index & kChunkMask]; }
+  int sequence(int index) const { return chunk(index).sequence[index & kChunkMask]; }
+
+  Eigen::Map<Eigen::Vector3d> translation(int index) { return Eigen::Map<Eigen::Vector3d>(t(index)); }
+  Eigen::Map<Eigen::Quaterniond> rotation(int index) { return Eigen::Map<Eigen::Quaterniond>(q(index)); }
+
+ private:
+  static constexpr int kChunkMask = kChunkSize - 1;
+
+  struct Chunk {
+    double euler[kChunkSize][3];
+    double t[kChunkSize][3];
+    double q[kChunkSize][4];
+    int sequence[kChunkSize];
+  };
+
+  Chunk& chunk(int index) {
+    assert(index >= 0 && index < size_);
+    return *chunks_[index >> kChunkBits];
+  }
+  const Chunk& chunk(int index) const {
+    assert(index >= 0 && index < size_);
+    return *chunks_[index >> kChunkBits];
+  }
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  int size_;
+};
@@ -14,6 +14,7 @@
 
 #include "common/Definitions.h"
 #include "pose_graph/Parameters.h"
+#include "pose_graph/PointCloudExporter.h"
 #include "utils/CameraPoseVisualization.h"
 
 class Publisher {
@@ -37,7 +38,11 @@ class Publisher {
   void updatePublishGlobalMap(const ros::TimerEvent& event);
 
   void setGlobalPointCloudFunction(const PointCloudCallback& global_pointcloud_callback);
-  bool savePointCloud(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response);  // NOLINT
+  // The save services export the map from this snapshot, in the background.
+  void setGlobalMapSnapshotFunction(const GlobalMapSnapshotCallback& global_map_snapshot_callback,
+                                    double min_landmark_quality);
+  bool savePointCloud(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response);    // NOLINT
+  bool appendPointCloud(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response);  // NOLINT
 
   void saveTrajectory(const std::string& filename) const;
   void publishPrimitiveEstimator(const std::pair<Timestamp, Eigen::Matrix4d>& primitive_estimator_pose);
@@ -62,4 +67,8 @@ class Publisher {
   std::unique_ptr<CameraPoseVisualization> camera_pose_visualizer_;
 
   PointCloudCallback pointcloud_callback_;
+  GlobalMapSnapshotCallback global_map_snapshot_callback_;
+  std::unique_ptr<PointCloudExporter> pointcloud_exporter_;
+
+  bool exportPointCloud(bool append, std_srvs::TriggerResponse& response);  // NOLINT
 };
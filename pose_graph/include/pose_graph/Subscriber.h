@@ -20,7 +20,8 @@
 class Subscriber {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-  Subscriber(ros::NodeHandle& nh, Parameters& params);  // NOLINT
+  // subscribe_keyframes is false when the keyframes are handed over in-process (svin_node).
+  Subscriber(ros::NodeHandle& nh, Parameters& params, bool subscribe_keyframes = true);  // NOLINT
   Subscriber() {}
 
   ~Subscriber() = default;
@@ -38,6 +39,8 @@ class Subscriber {
 
   Parameters params_;  // The parameters of the node.
 
+  bool subscribe_keyframes_ = true;  // Whether to subscribe to the okvis keyframe topics.
+
   // Subscriber to the keyframe points, image, pose and svin health.
   typedef image_transport::SubscriberFilter ImageSubscriber;
   ImageSubscriber keyframe_image_subscriber_;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace utils {
+
+/*
+    Append-only vector that stores its elements in fixed-size chunks. Elements are never moved: pointers and
+    references stay valid while the vector grows, push_back never copies existing elements and indexing
+    is O(1).
+*/
+template <typename T, int kChunkBits = 10>
+class ChunkedVector {
+ public:
+  static constexpr size_t kChunkSize = size_t(1) << kChunkBits;
+
+  class const_iterator {
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    const_iterator() : vector_(nullptr), index_(0) {}
+    const_iterator(const ChunkedVector* vector, size_t index) : vector_(vector), index_(index) {}
+
+    reference operator*() const { return (*vector_)[index_]; }
+    pointer operator->() const { return &(*vector_)[index_]; }
+    reference operator[](difference_type n) const { return (*vector_)[index_ + n]; }
+    const_iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    const_iterator operator++(int) { return const_iterator(vector_, index_++); }
+    const_iterator& operator--() {
+      --index_;
+      return *this;
+    }
+    const_iterator operator--(int) { return const_iterator(vector_, index_--); }
+    const_iterator& operator+=(difference_type n) {
+      index_ += n;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+    const_iterator operator+(difference_type n) const { return const_iterator(vector_, index_ + n); }
+    const_iterator operator-(difference_type n) const { return const_iterator(vector_, index_ - n); }
+    difference_type operator-(const const_iterator& other) const {
+      return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+    bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+    bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+    bool operator<(const const_iterator& other) const { return index_ < other.index_; }
+    bool operator>(const const_iterator& other) const { return index_ > other.index_; }
+    bool operator<=(const const_iterator& other) const { return index_ <= other.index_; }
+    bool operator>=(const const_iterator& other) const { return index_ >= other.index_; }
+
+   private:
+    const ChunkedVector* vector_;
+    size_t index_;
+  };
+  typedef const_iterator iterator;
+
+  ChunkedVector() : size_(0) {}
+
+  void push_back(const T& value) {
+    if (size_ == chunks_.size() * kChunkSize) chunks_.emplace_back(new T[kChunkSize]);
+    chunks_[size_ >> kChunkBits][size_ & (kChunkSize - 1)] = value;
+    ++size_;
+  }
+
+  T& operator[](size_t index) {
+    assert(index < size_);
+    return chunks_[index >> kChunkBits][index & (kChunkSize - 1)];
+  }
+  const T& operator[](size_t index) const {
+    assert(index < size_);
+    return chunks_[index >> kChunkBits][index & (kChunkSize - 1)];
+  }
+
+  T& front() { return (*this)[0]; }
+  T& back() { return (*this)[size_ - 1]; }
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+
+ private:
+  std::vector<std::unique_ptr<T[]>> chunks_;
+  size_t size_;
+};
+
+}  // namespace utils
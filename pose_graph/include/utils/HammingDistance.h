@@ -0,0 +1,67 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+
+/*
+    256 bit binary descriptor (BRIEF256) packed into four 64 bit words, so that descriptor sets are contiguous
+    arrays instead of one std::bitset per keypoint.
+*/
+struct Descriptor256 {
+  uint64_t words[4];
+};
+
+// Best and second best match of a query descriptor. Indices are -1 if there is no train descriptor.
+struct HammingMatch {
+  int best_index;
+  int best_distance;
+  int second_best_index;
+  int second_best_distance;
+};
+
+// Pack DVision::BRIEF256 descriptors (std::bitset<256>) into contiguous words.
+void packDescriptors(const std::vector<std::bitset<256>>& descriptors, std::vector<Descriptor256>& packed);  // NOLINT
+
+int hammingDistance(const Descriptor256& a, const Descriptor256& b);
+
+// Index of the train descriptor closest to the query, the lower index on ties, -1 without train descriptors. Inline
+// for the few children of a vocabulary tree node, where the call and second best bookkeeping of matchHamming would
+// cost more than the distances.
+inline int nearestHamming(const Descriptor256& query, const Descriptor256* train, size_t num_train) {
+  int best_index = -1;
+  int best_distance = 257;
+  for (size_t j = 0; j < num_train; ++j) {
+    const uint64_t* t = train[j].words;
+    const int distance = __builtin_popcountll(query.words[0] ^ t[0]) + __builtin_popcountll(query.words[1] ^ t[1]) +
+                         __builtin_popcountll(query.words[2] ^ t[2]) + __builtin_popcountll(query.words[3] ^ t[3]);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best_index = static_cast<int>(j);
+    }
+  }
+  return best_index;
+}
+
+/**
+ * @brief Brute force matching of every query against every train descriptor. Ties keep the lower train index.
+ *        Uses the same popcount as std::bitset::count, the POPCNT instruction with -march=native.
+ * @param matches One entry per query, has to hold num_queries elements.
+ */
+void matchHamming(const Descriptor256* queries,
+                  size_t num_queries,
+                  const Descriptor256* train,
+                  size_t num_train,
+                  HammingMatch* matches);
+
+inline void matchHamming(const std::vector<Descriptor256>& queries,
+                         const std::vector<Descriptor256>& train,
+                         std::vector<HammingMatch>& matches) {  // NOLINT
+  matches.resize(queries.size());
+  matchHamming(queries.data(), queries.size(), train.data(), train.size(), matches.data());
+}
+
+}  // namespace utils
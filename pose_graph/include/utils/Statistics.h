@@ -30,6 +30,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <mutex>
 #include <string>
@@ -53,10 +54,25 @@ namespace utils {
 
 const double kNumSecondsPerNanosecond = 1.e-9;
 
+// Logarithmic histogram buckets, 32 per power of two. Same layout as okvis::timing::HistogramLayout so that the
+// snapshots of the pose graph and of okvis can be merged into one report.
+struct HistogramLayout {
+  static const int kSubBuckets = 32;
+  static const int kMinExponent = -30;
+  static const int kNumOctaves = 64;
+  static const size_t kNumBuckets = 1 + kNumOctaves * kSubBuckets;
+
+  static size_t Index(double value);
+  static double LowerBound(size_t index);
+  static double UpperBound(size_t index);
+};
+
 struct StatisticsMapValue {
   static const int kWindowSize = 100;
 
-  inline StatisticsMapValue() { time_last_called_ = std::chrono::system_clock::now(); }
+  inline StatisticsMapValue() : histogram_(HistogramLayout::kNumBuckets, 0) {
+    time_last_called_ = std::chrono::system_clock::now();
+  }
 
   inline void AddValue(double sample) {
     std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
@@ -67,6 +83,7 @@ struct StatisticsMapValue {
 
     values_.Add(sample);
     time_deltas_.Add(dt);
+    ++histogram_[HistogramLayout::Index(sample)];
   }
   inline double GetLastDeltaTime() const {
     if (time_deltas_.total_samples()) {
@@ -91,6 +108,9 @@ struct StatisticsMapValue {
   double Median() const { return values_.median(); }
   double Q1() const { return values_.q1(); }
   double Q3() const { return values_.q3(); }
+  // Over all samples, not only the window.
+  double Percentile(double percentile) const;
+  const std::vector<uint64_t>& Histogram() const { return histogram_; }
   double LazyVariance() const { return values_.LazyVariance(); }
   double MeanCallsPerSec() const {
     double mean_dt = time_deltas_.Mean();
@@ -112,6 +132,7 @@ struct StatisticsMapValue {
   // Create an accumulator with specified window size.
   Accumulator<double, double, kWindowSize> values_;
   Accumulator<double, double, kWindowSize> time_deltas_;
+  std::vector<uint64_t> histogram_;
   std::chrono::time_point<std::chrono::system_clock> time_last_called_;
 };
 
@@ -171,6 +192,8 @@ class Statistics {
   static double GetQ1(std::string const& tag);
   static double GetQ3(size_t handle);
   static double GetQ3(std::string const& tag);
+  static double GetPercentile(size_t handle, double percentile);
+  static double GetPercentile(std::string const& tag, double percentile);
   static double GetHz(size_t handle);
   static double GetHz(std::string const& tag);
 
@@ -189,6 +212,9 @@ class Statistics {
   // columns headers, and the subsequent values are the data.
   static void WriteAllSamplesToCsvFile(const std::string& path);
   static void WriteToYamlFile(const std::string& path);
+  // Histograms in the okvis timing snapshot format, to be merged with the okvis timings by okvis_timing_report.
+  // The values keep the unit of their tag.
+  static void WriteSnapshot(const std::string& path);
   static void Print(std::ostream& out);  // NOLINT
   static std::string Print();
   static std::string SecondsToTimeString(double seconds);
@@ -129,6 +129,14 @@ class ThreadsafeQueueBase {
     return data_queue_.empty();
   }
 
+  /** \brief Number of values in the queue.
+   * the state of the queue might change right after this query.
+   */
+  size_t size() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return data_queue_.size();
+  }
+
   /** \brief Checks if the queue is shutdown.
    * the state of the queue might change right after this query.
    */
@@ -140,4 +140,7 @@ class Utils {
 
   static std::string healthMsgToString(const okvis_ros::SvinHealthConstPtr& health);
   static ros::Time toRosTime(const Timestamp t);
+
+  // Empties the debug output directories and writes the headers of the loop closure and switch logs.
+  static void setupOutputLogDirectories(const std::string& base_path);
 };
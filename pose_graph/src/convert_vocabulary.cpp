@@ -0,0 +1,67 @@
+#include <boost/algorithm/string/predicate.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "DBoW/DBoW2.h"
+
+// Converts a BRIEF vocabulary between the text (.yml, .yml.gz), binary (.bin) and memory mapped (.mmap) formats,
+// e.g. Vocabulary/brief_k10L6.bin to Vocabulary/brief_k10L6.mmap, which pose_graph loads without parsing.
+
+namespace {
+
+enum class Format { kText, kBinary, kMapped };
+
+Format formatOf(const std::string& filename) {
+  if (boost::algorithm::ends_with(filename, ".yml") || boost::algorithm::ends_with(filename, ".yaml") ||
+      boost::algorithm::ends_with(filename, ".yml.gz") || boost::algorithm::ends_with(filename, ".yaml.gz")) {
+    return Format::kText;
+  }
+  return boost::algorithm::ends_with(filename, ".mmap") ? Format::kMapped : Format::kBinary;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <input vocabulary> <output vocabulary>" << std::endl
+              << "Formats by extension: .yml/.yml.gz text, .mmap memory mapped, anything else binary" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string input = argv[1];
+  const std::string output = argv[2];
+  if (formatOf(input) == Format::kMapped) {
+    std::cerr << "A memory mapped vocabulary cannot be converted back, use the original vocabulary" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    auto start = std::chrono::steady_clock::now();
+    BriefVocabulary voc;
+    if (formatOf(input) == Format::kText)
+      voc.load(input);
+    else
+      voc.loadBin(input);
+    std::cout << "Loaded " << input << " (" << voc.size() << " words) in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    switch (formatOf(output)) {
+      case Format::kText:
+        voc.save(output);
+        break;
+      case Format::kBinary:
+        voc.saveBin(output);
+        break;
+      case Format::kMapped:
+        voc.saveMapped(output);
+        break;
+    }
+    std::cout << "Saved " << output << " in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+  } catch (const std::string& error) {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -2,6 +2,10 @@
 
 #include <ros/console.h>
 
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <thread>
 #include <utility>
 
 std::ostream& operator<<(std::ostream& os, const Landmark& landmark) {
@@ -25,40 +29,229 @@ void Landmark::updateObservation(uint64_t keyframe_id,
   latest_kf_obs_ = keyframe_id;
 }
 
-GlobalMap::GlobalMap() {
+namespace {
+// Below this many landmarks per thread re-anchoring is not worth starting threads.
+const size_t kMinLandmarksPerThread = 2048;
+
+const int kBitsPerAxis = 21;
+const int64_t kMaxVoxelCoordinate = (int64_t(1) << (kBitsPerAxis - 1)) - 1;
+const uint64_t kAxisMask = (uint64_t(1) << kBitsPerAxis) - 1;
+
+uint64_t voxelKey(const MapPoint& point, double voxel_size) {
+  uint64_t key = 0;
+  int shift = 0;
+  for (float coordinate : {point.x, point.y, point.z}) {
+    const double voxel = std::floor(coordinate / voxel_size);
+    const int64_t clamped = static_cast<int64_t>(
+        std::max(std::min(voxel, double(kMaxVoxelCoordinate)), double(-kMaxVoxelCoordinate - 1)));
+    key |= (uint64_t(clamped) & kAxisMask) << shift;
+    shift += kBitsPerAxis;
+  }
+  return key;
+}
+}  // namespace
+
+void GlobalMapSnapshot::downsample(double voxel_size, double min_quality, std::vector<MapPoint>& points) const {
+  struct Voxel {
+    Eigen::Vector3d position = Eigen::Vector3d::Zero();
+    Eigen::Vector3d color = Eigen::Vector3d::Zero();
+    double weight = 0.0;
+    size_t count = 0;
+  };
+  std::vector<Voxel> voxels;
+  std::unordered_map<uint64_t, size_t> voxel_indices;  // in the order the voxels are first seen
+  for (const auto& chunk : chunks_) {
+    for (const MapPoint& point : *chunk) {
+      if (point.quality <= min_quality) continue;
+      auto inserted = voxel_indices.emplace(voxelKey(point, voxel_size), voxels.size());
+      if (inserted.second) voxels.emplace_back();
+      Voxel& voxel = voxels[inserted.first->second];
+      voxel.position += point.quality * Eigen::Vector3d(point.x, point.y, point.z);
+      voxel.color += point.quality * Eigen::Vector3d(point.r, point.g, point.b);
+      voxel.weight += point.quality;
+      voxel.count++;
+    }
+  }
+  points.reserve(points.size() + voxels.size());
+  for (const Voxel& voxel : voxels) {
+    const Eigen::Vector3d position = voxel.position / voxel.weight;
+    const Eigen::Vector3d color = voxel.color / voxel.weight;
+    MapPoint point;
+    point.x = position.x();
+    point.y = position.y();
+    point.z = position.z();
+    point.r = static_cast<uint8_t>(std::round(color.x()));
+    point.g = static_cast<uint8_t>(std::round(color.y()));
+    point.b = static_cast<uint8_t>(std::round(color.z()));
+    point.quality = voxel.weight / voxel.count;
+    points.push_back(point);
+  }
+}
+
+GlobalMap::GlobalMap() : snapshot_(std::make_shared<const GlobalMapSnapshot>()) {
   loop_closure_optimization_finished_ = false;
   last_loop_closure_optimization_time_ = 0;
 }
 
+void GlobalMap::addKeyframe(const KeyframePose& pose) {
+  std::lock_guard<std::mutex> l(mutex_);
+  KeyframeAnchor& anchor = keyframes_[pose.index];
+  anchor.translation = pose.translation;
+  anchor.rotation = pose.rotation;
+}
+
 void GlobalMap::addLandmark(const Eigen::Vector3d& global_pos,
                             uint64_t landmark_id,
                             double quality,
                             uint64_t keyframe_id,
                             const Eigen::Vector3d& local_pos,
                             const Eigen::Vector3d& color) {
-  if (!map_points_.count(landmark_id)) {  // If the point is not in the map, add it.
-    Landmark point_landmark = Landmark(landmark_id, global_pos, quality, color);
-    point_landmark.updateObservation(keyframe_id, local_pos, quality, color);
-    map_points_.insert(std::make_pair(landmark_id, point_landmark));
+  std::lock_guard<std::mutex> l(mutex_);
+  auto point = map_points_.find(landmark_id);
+  if (point == map_points_.end()) {  // If the point is not in the map, add it.
+    point = map_points_.insert(std::make_pair(landmark_id, Landmark(landmark_id, global_pos, quality, color))).first;
+    point->second.slot_ = points_.size();
+    points_.emplace_back();
   } else {
-    Landmark& point_landmark = map_points_.at(landmark_id);
+    Landmark& point_landmark = point->second;
     point_landmark.color_ = color;
     point_landmark.point_ = global_pos;
     point_landmark.quality_ = quality;
-    point_landmark.updateObservation(keyframe_id, local_pos, quality, color);
   }
+  Landmark& point_landmark = point->second;
+  if (!point_landmark.keyframe_observations_.count(keyframe_id)) {
+    auto anchor = keyframes_.find(keyframe_id);
+    if (anchor != keyframes_.end()) anchor->second.landmark_ids.push_back(landmark_id);
+  }
+  point_landmark.updateObservation(keyframe_id, local_pos, quality, color);
+  // the quality weighted mean of all observations, as the full recompute after a loop closure gave it. Keeps the
+  // position given here if no observing keyframe is anchored.
+  reanchorLandmark(point_landmark);
+  setPoint(point_landmark);
 }
 
 void GlobalMap::updateLandmark(uint64_t landmark_id,
                                const Eigen::Vector3d& global_pos,
                                double quality,
                                const Eigen::Vector3d& color) {
-  if (map_points_.count(landmark_id)) {
-    Landmark& point_landmark = map_points_.at(landmark_id);
+  std::lock_guard<std::mutex> l(mutex_);
+  auto point = map_points_.find(landmark_id);
+  if (point != map_points_.end()) {
+    Landmark& point_landmark = point->second;
     point_landmark.color_ = color;
     point_landmark.point_ = global_pos;
     point_landmark.quality_ = quality;
+    setPoint(point_landmark);
+  }
+}
+
+size_t GlobalMap::updateKeyframePoses(const std::vector<KeyframePose>& poses,
+                                      size_t num_threads,
+                                      double translation_tolerance,
+                                      double rotation_tolerance) {
+  std::lock_guard<std::mutex> l(mutex_);
+
+  // move all anchors first, a landmark can be observed by several of the moved keyframes
+  std::unordered_set<uint64_t> dirty_ids;
+  std::vector<Landmark*> dirty;
+  for (const KeyframePose& pose : poses) {
+    auto keyframe = keyframes_.find(pose.index);
+    if (keyframe == keyframes_.end()) continue;
+    KeyframeAnchor& anchor = keyframe->second;
+    const double translation_change = (pose.translation - anchor.translation).norm();
+    const double rotation_change = Eigen::AngleAxisd(anchor.rotation.transpose() * pose.rotation).angle();
+    if (translation_change <= translation_tolerance && rotation_change <= rotation_tolerance) continue;
+    anchor.translation = pose.translation;
+    anchor.rotation = pose.rotation;
+    for (uint64_t landmark_id : anchor.landmark_ids) {
+      if (dirty_ids.insert(landmark_id).second) dirty.push_back(&map_points_.at(landmark_id));
+    }
   }
+
+  // the landmarks and their slots are distinct, the anchors are only read
+  if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, dirty.size() / kMinLandmarksPerThread + 1);
+  const size_t per_thread = (dirty.size() + num_threads - 1) / num_threads;
+  auto reanchor = [this, &dirty, per_thread](size_t thread) {
+    const size_t end = std::min(dirty.size(), (thread + 1) * per_thread);
+    for (size_t i = thread * per_thread; i < end; ++i) reanchorLandmark(*dirty[i]);
+  };
+  std::vector<std::thread> workers;
+  for (size_t thread = 1; thread < num_threads; ++thread) workers.emplace_back(reanchor, thread);
+  reanchor(0);
+  for (std::thread& worker : workers) worker.join();
+
+  for (const Landmark* landmark : dirty) dirty_chunks_[landmark->slot_ / GlobalMapSnapshot::kChunkSize] = true;
+  return dirty.size();
+}
+
+void GlobalMap::reanchorLandmark(Landmark& landmark) {
+  Eigen::Vector3d point_3d = Eigen::Vector3d::Zero();
+  Eigen::Vector3d color = Eigen::Vector3d::Zero();
+  double quality = 0.0;
+  uint64_t total_observations = 0;
+  for (const auto& kf_observation : landmark.keyframe_observations_) {
+    auto keyframe = keyframes_.find(kf_observation.first);
+    if (keyframe == keyframes_.end()) continue;
+    const Observation& obs = kf_observation.second;
+    const KeyframeAnchor& anchor = keyframe->second;
+    point_3d += (anchor.rotation * obs.local_pos_ + anchor.translation) * obs.quality_;
+    color += obs.color_ * obs.quality_;
+    quality += obs.quality_;
+    total_observations++;
+  }
+  if (quality <= 0.0) return;
+
+  landmark.point_ = point_3d / quality;
+  landmark.color_ = color / quality;
+  landmark.quality_ = quality / total_observations;
+
+  writePoint(landmark);
+}
+
+void GlobalMap::writePoint(const Landmark& landmark) {
+  MapPoint& point = points_[landmark.slot_];
+  point.x = landmark.point_.x();
+  point.y = landmark.point_.y();
+  point.z = landmark.point_.z();
+  point.r = static_cast<uint8_t>(landmark.color_.x());
+  point.g = static_cast<uint8_t>(landmark.color_.y());
+  point.b = static_cast<uint8_t>(landmark.color_.z());
+  point.quality = landmark.quality_;
+}
+
+void GlobalMap::setPoint(const Landmark& landmark) {
+  writePoint(landmark);
+  const size_t chunk = landmark.slot_ / GlobalMapSnapshot::kChunkSize;
+  if (chunk >= dirty_chunks_.size()) dirty_chunks_.resize(chunk + 1, false);
+  dirty_chunks_[chunk] = true;
+}
+
+std::shared_ptr<const GlobalMapSnapshot> GlobalMap::snapshot() {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (std::find(dirty_chunks_.begin(), dirty_chunks_.end(), true) == dirty_chunks_.end()) return snapshot_;
+
+  const size_t chunk_size = GlobalMapSnapshot::kChunkSize;
+  auto snapshot = std::make_shared<GlobalMapSnapshot>();
+  snapshot->size_ = points_.size();
+  snapshot->chunks_.reserve(dirty_chunks_.size());
+  for (size_t chunk = 0; chunk < dirty_chunks_.size(); ++chunk) {
+    if (!dirty_chunks_[chunk] && chunk < snapshot_->chunks_.size()) {
+      snapshot->chunks_.push_back(snapshot_->chunks_[chunk]);  // shared, not copied
+    } else {
+      auto begin = points_.begin() + chunk * chunk_size;
+      auto end = points_.begin() + std::min(points_.size(), (chunk + 1) * chunk_size);
+      snapshot->chunks_.push_back(std::make_shared<const GlobalMapSnapshot::Chunk>(begin, end));
+    }
+    dirty_chunks_[chunk] = false;
+  }
+  snapshot_ = snapshot;
+  return snapshot_;
+}
+
+size_t GlobalMap::size() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return points_.size();
 }
 
 void GlobalMap::loopClosureOptimizationFinishCallback(const Timestamp optimization_finish_time) {
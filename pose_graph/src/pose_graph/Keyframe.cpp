@@ -2,13 +2,17 @@
 
 #include <sensor_msgs/PointCloud.h>
 
+#include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "pose_graph/Parameters.h"
+#include "utils/Statistics.h"
+#include "utils/Timer.h"
 #include "utils/UtilsOpenCV.h"
 
 const int Keyframe::TH_HIGH = 100;
@@ -30,7 +34,7 @@ static void reduceVector(std::vector<Derived>& v, std::vector<uchar> status) {
 }
 
 Keyframe::Keyframe(Timestamp _time_stamp,
-                   std::vector<Eigen::Vector3i>& _point_ids,
+                   std::vector<PointIds>& _point_ids,
                    int _index,
                    Eigen::Vector3d& _svin_T_w_i,
                    Eigen::Matrix3d& _svin_R_w_i,
@@ -40,6 +44,7 @@ Keyframe::Keyframe(Timestamp _time_stamp,
                    std::map<Keyframe*, int>& KFcounter,
                    int _sequence,
                    BriefVocabulary* vocBrief,
+                   const BriefExtractor& brief_extractor,
                    const Parameters& params,
                    const bool is_vio_keyframe)
     : params_(params) {
@@ -66,13 +71,28 @@ Keyframe::Keyframe(Timestamp _time_stamp,
   sequence = _sequence;
   is_vio_keyframe_ = is_vio_keyframe;
 
-  if (is_vio_keyframe_) computeWindowBRIEFPoint();
+  static utils::StatsCollector window_brief_stats("Keyframe window BRIEF [ms]");
+  static utils::StatsCollector bow_stats("Keyframe BoW [ms]");
+  static utils::StatsCollector connections_stats("Keyframe connections [ms]");
+  static utils::StatsCollector brief_stats("Keyframe FAST + BRIEF [ms]");
+
+  auto tic = utils::Timer::tic();
+  if (is_vio_keyframe_) {
+    computeWindowBRIEFPoint(brief_extractor);
+    window_brief_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+  }
   voc = vocBrief;
+  tic = utils::Timer::tic();
   computeBoW();
+  bow_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
   KFcounter_ = KFcounter;  // for Covisibility graph
-  updateConnections();     // for Covisibility graph
+  tic = utils::Timer::tic();
+  updateConnections();  // for Covisibility graph
+  connections_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
 
-  computeBRIEFPoint();
+  tic = utils::Timer::tic();
+  computeBRIEFPoint(brief_extractor);
+  brief_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
 
   if (!params.debug_mode_) image.release();
 }
@@ -164,12 +184,11 @@ void Keyframe::updateConnections() {
 }
 
 // Note Keypoints found by okvis_estimator
-void Keyframe::computeWindowBRIEFPoint() {
-  BriefExtractor extractor(params_.brief_pattern_file_.c_str());
-
+void Keyframe::computeWindowBRIEFPoint(const BriefExtractor& extractor) {
   window_keypoints = point_2d_uv;
 
   extractor(image, window_keypoints, window_brief_descriptors);
+  utils::packDescriptors(window_brief_descriptors, window_brief_descriptors_packed);
 
   for (int i = 0; i < static_cast<int>(window_keypoints.size()); i++) {
     Eigen::Vector3d tmp_p;
@@ -193,8 +212,7 @@ void Keyframe::project_normal(Eigen::Vector2d kp, Eigen::Vector3d& point3d) cons
   point3d[2] = 1.0;
 }
 
-void Keyframe::computeBRIEFPoint() {
-  BriefExtractor extractor(params_.brief_pattern_file_.c_str());
+void Keyframe::computeBRIEFPoint(const BriefExtractor& extractor) {
   const int fast_th = 20;  // corner detector response threshold
   if (1) {
     cv::FAST(image, keypoints, fast_th, true);
@@ -208,6 +226,7 @@ void Keyframe::computeBRIEFPoint() {
     }
   }
   extractor(image, keypoints, brief_descriptors);
+  utils::packDescriptors(brief_descriptors, brief_descriptors_packed);
 
   for (int i = 0; i < static_cast<int>(keypoints.size()); i++) {
     Eigen::Vector3d tmp_p;
@@ -263,47 +282,25 @@ void Keyframe::searchByBRISKDescriptor(std::vector<cv::Point2f>& matched_2d_old,
   }
 }
 
-bool Keyframe::searchInAera(const DVision::BRIEF256::bitset window_descriptor,
-                            const std::vector<DVision::BRIEF256::bitset>& descriptors_old,
-                            const std::vector<cv::KeyPoint>& keypoints_old,
-                            const std::vector<cv::KeyPoint>& keypoints_old_norm,
-                            cv::Point2f& best_match,
-                            cv::Point2f& best_match_norm) {
-  cv::Point2f best_pt;
-  int bestDist = 128;
-  int bestIndex = -1;
-  for (int i = 0; i < static_cast<int>(descriptors_old.size()); i++) {
-    int dis = HammingDis(window_descriptor, descriptors_old[i]);
-    if (dis < bestDist) {
-      bestDist = dis;
-      bestIndex = i;
-    }
-  }
-  // printf("best dist %d", bestDist);
-  if (bestIndex != -1 && bestDist < 80) {
-    best_match = keypoints_old[bestIndex].pt;
-    best_match_norm = keypoints_old_norm[bestIndex].pt;
-    return true;
-  } else {
-    return false;
-  }
-}
-
 void Keyframe::searchByBRIEFDes(std::vector<cv::Point2f>& matched_2d_old,
                                 std::vector<cv::Point2f>& matched_2d_old_norm,
                                 std::vector<uchar>& status,
-                                const std::vector<DVision::BRIEF256::bitset>& descriptors_old,
+                                const std::vector<utils::Descriptor256>& descriptors_old,
                                 const std::vector<cv::KeyPoint>& keypoints_old,
-                                const std::vector<cv::KeyPoint>& keypoints_old_norm) {
-  for (int i = 0; i < static_cast<int>(window_brief_descriptors.size()); i++) {
-    cv::Point2f pt(0.f, 0.f);
-    cv::Point2f pt_norm(0.f, 0.f);
-    if (searchInAera(window_brief_descriptors[i], descriptors_old, keypoints_old, keypoints_old_norm, pt, pt_norm))
+                                const std::vector<cv::KeyPoint>& keypoints_old_norm) const {
+  const int max_distance = 80;
+  std::vector<utils::HammingMatch> matches;
+  utils::matchHamming(window_brief_descriptors_packed, descriptors_old, matches);
+  for (const utils::HammingMatch& match : matches) {
+    if (match.best_index != -1 && match.best_distance < max_distance) {
       status.push_back(1);
-    else
+      matched_2d_old.push_back(keypoints_old[match.best_index].pt);
+      matched_2d_old_norm.push_back(keypoints_old_norm[match.best_index].pt);
+    } else {
       status.push_back(0);
-    matched_2d_old.push_back(pt);
-    matched_2d_old_norm.push_back(pt_norm);
+      matched_2d_old.push_back(cv::Point2f(0.f, 0.f));
+      matched_2d_old_norm.push_back(cv::Point2f(0.f, 0.f));
+    }
   }
 }
 
@@ -311,7 +308,7 @@ void Keyframe::PnPRANSAC(const std::vector<cv::Point2f>& matched_2d_old,
                          const std::vector<cv::Point3f>& matched_3d,
                          std::vector<uchar>& status,
                          Eigen::Vector3d& PnP_T_old,
-                         Eigen::Matrix3d& PnP_R_old) {
+                         Eigen::Matrix3d& PnP_R_old) const {
   cv::Mat r, rvec, t, tmp_r;
   cv::Mat K = (cv::Mat_<double>(3, 3) << params_.camera_calibration_.focal_length_.x(),
                0,
@@ -381,14 +378,16 @@ void Keyframe::PnPRANSAC(const std::vector<cv::Point2f>& matched_2d_old,
   PnP_T_old = T_w_c_old;
 }
 
-bool Keyframe::findConnection(Keyframe* old_kf) {
+bool Keyframe::findConnection(const Keyframe* old_kf,
+                              Eigen::Matrix<double, 8, 1>& relative_pose,
+                              std::mutex* debug_output_mutex) const {
   if (!old_kf->is_vio_keyframe_) return false;
 
   std::vector<cv::KeyPoint> matched_2d_cur;
   std::vector<cv::Point2f> matched_2d_old;
   std::vector<cv::Point2f> matched_2d_old_norm;
   std::vector<cv::Point3f> matched_3d;
-  std::vector<Eigen::Vector3i> matched_ids;  // Reloc
+  std::vector<PointIds> matched_ids;  // Reloc
   std::vector<uchar> status;
 
   matched_3d = point_3d;
@@ -407,7 +406,7 @@ bool Keyframe::findConnection(Keyframe* old_kf) {
   searchByBRIEFDes(matched_2d_old,
                    matched_2d_old_norm,
                    status,
-                   old_kf->brief_descriptors,
+                   old_kf->brief_descriptors_packed,
                    old_kf->keypoints,
                    old_kf->keypoints_norm);
   reduceVector(matched_2d_old, status);
@@ -527,6 +526,8 @@ bool Keyframe::findConnection(Keyframe* old_kf) {
             pnp_verified_dir + "loop_closure_" + std::to_string(index) + "_" + std::to_string(old_kf->index) + ".png";
         cv::imwrite(filename, loop_image);
         std::string loop_closure_stats = params_.debug_output_path_ + "/loop_closure.txt";
+        std::unique_lock<std::mutex> debug_output_lock;
+        if (debug_output_mutex) debug_output_lock = std::unique_lock<std::mutex>(*debug_output_mutex);
         std::ofstream loop_closure_file(loop_closure_stats, std::ios::app);
         loop_closure_file.setf(std::ios::fixed, std::ios::floatfield);
         Eigen::Vector3d relative_ypr = Utils::R2ypr(relative_q.toRotationMatrix());
@@ -536,10 +537,8 @@ bool Keyframe::findConnection(Keyframe* old_kf) {
                           << relative_ypr.transpose() << std::endl;
         loop_closure_file.close();
       }
-      has_loop = true;
-      loop_index = old_kf->index;
-      loop_info << relative_t.x(), relative_t.y(), relative_t.z(), relative_q.w(), relative_q.x(), relative_q.y(),
-          relative_q.z(), relative_yaw;
+      relative_pose << relative_t.x(), relative_t.y(), relative_t.z(), relative_q.w(), relative_q.x(),
+          relative_q.y(), relative_q.z(), relative_yaw;
       return true;
     }
   }
@@ -547,12 +546,6 @@ bool Keyframe::findConnection(Keyframe* old_kf) {
   return false;
 }
 
-int Keyframe::HammingDis(const DVision::BRIEF256::bitset& a, const DVision::BRIEF256::bitset& b) {
-  DVision::BRIEF256::bitset xor_of_bitset = a ^ b;
-  int dis = xor_of_bitset.count();
-  return dis;
-}
-
 void Keyframe::getSVInPose(Eigen::Vector3d& _T_w_i, Eigen::Matrix3d& _R_w_i) {
   _T_w_i = svin_T_w_i;
   _R_w_i = svin_R_w_i;
@@ -5,14 +5,17 @@
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 #include <boost/thread.hpp>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <opencv2/core/eigen.hpp>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "utils/Statistics.h"
+#include "utils/Timer.h"
 #include "utils/UtilsOpenCV.h"
 
 LoopClosure::LoopClosure(Parameters& params)
@@ -21,12 +24,27 @@ LoopClosure::LoopClosure(Parameters& params)
       global_map_(nullptr),
       keyframe_tracking_queue_("keyframe_queue"),
       raw_image_buffer_(kBufferLengthNs),
-      primitive_estimator_poses_buffer_(kBufferLengthNs) {
+      primitive_estimator_poses_buffer_(kBufferLengthNs),
+      shutdown_(false),
+      extraction_queue_("LoopClosure extraction queue"),
+      bow_query_queue_("LoopClosure BoW query queue"),
+      verification_queue_("LoopClosure verification queue"),
+      extraction_stats_("LoopClosure feature extraction [ms]"),
+      extraction_wait_stats_("LoopClosure feature extraction wait [ms]"),
+      bow_query_stats_("LoopClosure BoW query [ms]"),
+      bow_query_wait_stats_("LoopClosure BoW query wait [ms]"),
+      verification_stats_("LoopClosure geometric verification [ms]"),
+      verification_wait_stats_("LoopClosure geometric verification wait [ms]"),
+      dropped_keyframes_stats_("LoopClosure dropped keyframes [#]"),
+      dropped_candidates_stats_("LoopClosure dropped loop candidates [#]") {
   frame_index_ = 0;
   last_translation_ = Eigen::Vector3d(-100, -100, -100);
 
   setup();
-  shutdown_ = false;
+}
+
+LoopClosure::~LoopClosure() {
+  if (!shutdown_) shutdown();
 }
 
 void LoopClosure::setup() {
@@ -47,11 +65,34 @@ void LoopClosure::setup() {
   pose_graph_->startOptimizationThread();
 
   // Loading vocabulary
-  voc_ = new BriefVocabulary(params_.vocabulary_file_);
+  auto tic = utils::Timer::tic();
+  voc_ = nullptr;
+  if (!params_.mapped_vocabulary_file_.empty()) {
+    try {
+      voc_ = new BriefVocabulary(params_.mapped_vocabulary_file_);
+    } catch (const std::string& error) {
+      LOG(ERROR) << error << ", loading " << params_.vocabulary_file_ << " instead";
+    }
+  }
+  if (!voc_) voc_ = new BriefVocabulary(params_.vocabulary_file_);
   BriefDatabase db;
   db.setVocabulary(*voc_, false, 0);
+  utils::StatsCollector("LoopClosure vocabulary loading [ms]").AddSample(utils::Timer::toc(tic).count());
   LOG(INFO) << "Vocabulary loaded!";
   pose_graph_->setBriefVocAndDB(voc_, db);
+
+  // Loading the BRIEF pattern the vocabulary was built with, once for all keyframes
+  tic = utils::Timer::tic();
+  brief_extractor_ = std::make_shared<const BriefExtractor>(params_.brief_pattern_file_);
+  utils::StatsCollector("LoopClosure BRIEF pattern loading [ms]").AddSample(utils::Timer::toc(tic).count());
+
+  for (int i = 0; i < params_.loop_closure_params_.extraction_workers; ++i) {
+    workers_.emplace_back(&LoopClosure::extractionWorker, this);
+  }
+  workers_.emplace_back(&LoopClosure::bowQueryWorker, this);
+  for (int i = 0; i < params_.loop_closure_params_.verification_workers; ++i) {
+    workers_.emplace_back(&LoopClosure::verificationWorker, this);
+  }
 }
 
 void LoopClosure::run() {
@@ -98,37 +139,23 @@ void LoopClosure::run() {
         got_keyframe = true;
       }
       if (got_keyframe) {
-        // VLOG(10) << "VIO keyframe at: " << stamp;
-        uint32_t combined_kf_index = keyframe_info->keyframe_index_ + primitive_keyframes;
-        std::map<Keyframe*, int> KFcounter;
-        for (size_t i = 0; i < keyframe_info->keyfame_points_.size(); ++i) {
-          double quality = static_cast<double>(keyframe_info->tracking_info_.points_quality_[i]);
-          for (auto observed_kf_index : keyframe_info->point_covisibilities_[i]) {
-            observed_kf_index += primitive_keyframes;
-            if (kfMapper_.find(observed_kf_index) != kfMapper_.end()) {
-              Keyframe* observed_kf =
-                  kfMapper_.find(observed_kf_index)->second;  // Keyframe where this point_3d has been observed
-              KFcounter[observed_kf]++;
-            }
-          }
+        if (bow_query_queue_.size() >= params_.loop_closure_params_.max_pending_keyframes) {
+          // extraction or BoW query are behind, drop the new keyframe instead of stalling the ingestion
+          LOG(WARNING) << "Loop closure is behind, dropping keyframe at " << stamp;
+          dropped_keyframes_stats_.AddSample(1);
+          continue;
         }
-
-        Keyframe* keyframe = new Keyframe(stamp,
-                                          keyframe_info->keypoint_ids_,
-                                          combined_kf_index,
-                                          translation,
-                                          rotation,
-                                          keyframe_info->keyframe_image_,
-                                          keyframe_info->keyfame_points_,
-                                          keyframe_info->cv_keypoints_,
-                                          KFcounter,
-                                          sequence_,
-                                          voc_,
-                                          params_,
-                                          true);
-
-        kfMapper_.insert(std::make_pair(combined_kf_index, keyframe));
-        pose_graph_->addKFToPoseGraph(keyframe, params_.loop_closure_params_.enabled);
+        // VLOG(10) << "VIO keyframe at: " << stamp;
+        std::shared_ptr<PendingKeyframe> pending = std::make_shared<PendingKeyframe>();
+        pending->stamp = stamp;
+        pending->rotation = rotation;
+        pending->translation = translation;
+        pending->combined_kf_index = keyframe_info->keyframe_index_ + primitive_keyframes;
+        pending->primitive_keyframes = primitive_keyframes;
+        pending->info = std::move(keyframe_info);
+        pending->ingestion_time = utils::Timer::tic();
+        bow_query_queue_.push(pending);
+        extraction_queue_.push(std::move(pending));
 
         // if (params_.global_mapping_params_.enabled) {
         //   cv::Mat original_color_image;
@@ -186,31 +213,136 @@ void LoopClosure::run() {
   }
 }
 
+void LoopClosure::extractionWorker() {
+  std::shared_ptr<PendingKeyframe> pending;
+  while (extraction_queue_.popBlocking(pending)) {
+    extraction_wait_stats_.AddSample(
+        utils::Timer::toc<std::chrono::microseconds>(pending->ingestion_time).count() / 1000.0);
+    auto tic = utils::Timer::tic();
+    KeyframeInfo& info = *pending->info;
+    // the covisibility connections are set by the BoW query stage, once all older keyframes exist
+    std::map<Keyframe*, int> KFcounter;
+    pending->keyframe.reset(new Keyframe(pending->stamp,
+                                         info.keypoint_ids_,
+                                         pending->combined_kf_index,
+                                         pending->translation,
+                                         pending->rotation,
+                                         info.keyframe_image_,
+                                         info.keyfame_points_,
+                                         info.cv_keypoints_,
+                                         KFcounter,
+                                         sequence_,
+                                         voc_,
+                                         *brief_extractor_,
+                                         params_,
+                                         true));
+    extraction_stats_.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+    {
+      std::lock_guard<std::mutex> lock(extraction_mutex_);
+      pending->extracted = true;
+    }
+    extraction_condition_.notify_all();
+  }
+}
+
+void LoopClosure::bowQueryWorker() {
+  std::shared_ptr<PendingKeyframe> pending;
+  while (bow_query_queue_.popBlocking(pending)) {
+    // extracted in parallel, but the database and the pose graph take the keyframes in order
+    {
+      std::unique_lock<std::mutex> lock(extraction_mutex_);
+      extraction_condition_.wait(lock, [this, &pending] { return pending->extracted || shutdown_; });
+      // the keyframes still queued are deleted with their PendingKeyframe
+      if (!pending->extracted) return;
+    }
+    bow_query_wait_stats_.AddSample(
+        utils::Timer::toc<std::chrono::microseconds>(pending->ingestion_time).count() / 1000.0);
+    auto tic = utils::Timer::tic();
+    const KeyframeInfo& info = *pending->info;
+    Keyframe* keyframe = pending->keyframe.release();  // the pose graph owns it from here on
+
+    std::map<Keyframe*, int> KFcounter;
+    for (size_t i = 0; i < info.keyfame_points_.size(); ++i) {
+      for (auto observed_kf_index : info.point_covisibilities_[i]) {
+        observed_kf_index += pending->primitive_keyframes;
+        if (kfMapper_.find(observed_kf_index) != kfMapper_.end()) {
+          Keyframe* observed_kf =
+              kfMapper_.find(observed_kf_index)->second;  // Keyframe where this point_3d has been observed
+          KFcounter[observed_kf]++;
+        }
+      }
+    }
+    keyframe->KFcounter_ = KFcounter;  // for Covisibility graph
+    keyframe->updateConnections();
+
+    kfMapper_.insert(std::make_pair(pending->combined_kf_index, keyframe));
+    const int loop_index = pose_graph_->addKFToPoseGraph(keyframe, params_.loop_closure_params_.enabled);
+    bow_query_stats_.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+
+    if (loop_index != -1) {
+      const size_t max_candidates = params_.loop_closure_params_.max_pending_loop_candidates;
+      if (verification_queue_.size() >= max_candidates) dropped_candidates_stats_.AddSample(1);
+      verification_queue_.pushOverflowIfFull(LoopCandidate{keyframe, loop_index, utils::Timer::tic()},
+                                             max_candidates);
+    }
+  }
+}
+
+void LoopClosure::verificationWorker() {
+  LoopCandidate candidate;
+  while (verification_queue_.popBlocking(candidate)) {
+    verification_wait_stats_.AddSample(
+        utils::Timer::toc<std::chrono::microseconds>(candidate.detection_time).count() / 1000.0);
+    auto tic = utils::Timer::tic();
+    pose_graph_->verifyLoopCandidate(candidate.keyframe, candidate.loop_index, &debug_output_mutex_);
+    verification_stats_.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+  }
+}
+
 void LoopClosure::getGlobalMap(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud) {
   // only update the global map if the pose graph optimization is finished after loop closure
-  if (global_map_->loop_closure_optimization_finished_) {
+  if (global_map_->loop_closure_optimization_finished_.exchange(false)) {
     updateGlobalMap();
-    global_map_->loop_closure_optimization_finished_ = false;
   }
   getGlobalPointCloud(pointcloud);
 }
 
+std::shared_ptr<const GlobalMapSnapshot> LoopClosure::getGlobalMapSnapshot() {
+  if (global_map_->loop_closure_optimization_finished_.exchange(false)) {
+    updateGlobalMap();
+  }
+  return global_map_->snapshot();
+}
+
 void LoopClosure::getGlobalPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud) {
-  for (auto point_landmark_map : global_map_->getMapPoints()) {
-    Landmark point_landmark = point_landmark_map.second;
-    Eigen::Vector3d global_pos = point_landmark.point_;
-    Eigen::Vector3d color = point_landmark.color_;
-    double quality = point_landmark.quality_;
-
-    if (quality > params_.global_mapping_params_.min_lmk_quality) {
-      pcl::PointXYZRGB point;
-      point.x = global_pos(0);
-      point.y = global_pos(1);
-      point.z = global_pos(2);
-      point.r = static_cast<uint8_t>(color.x());
-      point.g = static_cast<uint8_t>(color.y());
-      point.b = static_cast<uint8_t>(color.z());
-      pointcloud->push_back(point);
+  static utils::StatsCollector snapshot_stats("LoopClosure global map snapshot [ms]");
+  auto tic = utils::Timer::tic();
+  std::shared_ptr<const GlobalMapSnapshot> snapshot = global_map_->snapshot();
+  snapshot_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+
+  auto add_point = [&pointcloud](const MapPoint& map_point) {
+    pcl::PointXYZRGB point;
+    point.x = map_point.x;
+    point.y = map_point.y;
+    point.z = map_point.z;
+    point.r = map_point.r;
+    point.g = map_point.g;
+    point.b = map_point.b;
+    pointcloud->push_back(point);
+  };
+
+  const double min_quality = params_.global_mapping_params_.min_lmk_quality;
+  if (params_.global_mapping_params_.voxel_size > 0.0) {
+    std::vector<MapPoint> points;
+    snapshot->downsample(params_.global_mapping_params_.voxel_size, min_quality, points);
+    pointcloud->reserve(points.size());
+    for (const MapPoint& point : points) add_point(point);
+    return;
+  }
+  pointcloud->reserve(snapshot->size());
+  for (size_t chunk = 0; chunk < snapshot->numChunks(); ++chunk) {
+    for (const MapPoint& point : *snapshot->chunk(chunk)) {
+      if (point.quality > min_quality) add_point(point);
     }
   }
 }
@@ -221,19 +353,20 @@ void LoopClosure::addPointsToGlobalMap(const int64_t keyframe_index,
                                        const Eigen::Vector3d& camera_translation,
                                        const std::vector<cv::Point3f>& keyframe_points,
                                        const std::vector<float>& point_qualities,
-                                       const std::vector<Eigen::Vector3i>& point_ids,
+                                       const std::vector<PointIds>& point_ids,
                                        const std::vector<cv::KeyPoint>& cv_keypoints) {
+  // the landmarks are anchored to the keyframe: they move with it when the pose graph corrects it
+  KeyframePose kf_pose;
+  kf_pose.index = keyframe_index;
+  kfMapper_.find(keyframe_index)->second->getPose(kf_pose.translation, kf_pose.rotation);
+  global_map_->addKeyframe(kf_pose);
+
   for (size_t i = 0; i < keyframe_points.size(); ++i) {
     float quality = point_qualities[i];
     if (quality < params_.global_mapping_params_.min_lmk_quality) continue;
     Eigen::Vector3d global_point_position(keyframe_points[i].x, keyframe_points[i].y, keyframe_points[i].z);
     Eigen::Vector3d point_cam_frame = camera_rotation.transpose() * (global_point_position - camera_translation);
-
-    Keyframe* kf = kfMapper_.find(keyframe_index)->second;
-    Eigen::Matrix3d R_w_kf;
-    Eigen::Vector3d T_w_kf;
-    kf->getPose(T_w_kf, R_w_kf);
-    global_point_position = R_w_kf * point_cam_frame + T_w_kf;
+    global_point_position = kf_pose.rotation * point_cam_frame + kf_pose.translation;
 
     cv::KeyPoint image_point = cv_keypoints[i];
     cv::Vec3b color =
@@ -248,44 +381,15 @@ void LoopClosure::addPointsToGlobalMap(const int64_t keyframe_index,
 }
 
 void LoopClosure::updateGlobalMap() {
-  for (auto point_landmark_map : global_map_->getMapPoints()) {
-    uint64_t landmark_id = point_landmark_map.first;
-    Landmark point_landmark = point_landmark_map.second;
-
-    Eigen::Vector3d point_3d = Eigen::Vector3d::Zero();
-    Eigen::Vector3d color = Eigen::Vector3d::Zero();
-    double quality = 0.0;
-    uint64_t total_observations = 0;
-    for (auto kf_observation : point_landmark.keyframe_observations_) {
-      uint64_t kf_id = kf_observation.first;
-      Observation obs = kf_observation.second;
-      Eigen::Vector3d local_pos = obs.local_pos_;
-      double kf_quality = obs.quality_;
-
-      // Converting to global coordinates
-      if (kfMapper_.find(kf_id) == kfMapper_.end()) {
-        LOG(WARNING) << "Keyframe not found";
-        continue;
-      }
-
-      Keyframe* kf = kfMapper_.find(kf_id)->second;
-      Eigen::Matrix3d R_kf_w;
-      Eigen::Vector3d T_kf_w;
-      kf->getPose(T_kf_w, R_kf_w);
-
-      Eigen::Vector3d global_pos = R_kf_w * local_pos + T_kf_w;
-      point_3d = point_3d + global_pos * kf_quality;
-      color = color + obs.color_ * kf_quality;
-      quality = quality + kf_quality;
-      total_observations += 1;
-    }
-
-    point_3d = point_3d / quality;
-    color = color / quality;
-    quality = quality / total_observations;
-
-    global_map_->updateLandmark(landmark_id, point_3d, quality, color);
-  }
+  // only the landmarks of the keyframes the optimizations moved are re-anchored
+  static utils::StatsCollector update_stats("LoopClosure global map update [ms]");
+  static utils::StatsCollector reanchored_stats("LoopClosure global map re-anchored landmarks [#]");
+  auto tic = utils::Timer::tic();
+  std::vector<KeyframePose> poses;
+  pose_graph_->takeChangedPoses(poses);
+  const size_t reanchored = global_map_->updateKeyframePoses(poses);
+  update_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+  reanchored_stats.AddSample(reanchored);
 }
 
 void LoopClosure::updatePrimiteEstimatorTrajectory(const nav_msgs::OdometryConstPtr& pose_msg) {
@@ -358,7 +462,17 @@ bool LoopClosure::healthCheck(const TrackingInfo& tracking_info, boost::optional
 void LoopClosure::shutdown() {
   LOG_IF(ERROR, shutdown_) << "Shutdown requested, but PoseGraph modile was already shutdown.";
   keyframe_tracking_queue_.shutdown();
-  shutdown_ = true;
+  extraction_queue_.shutdown();
+  bow_query_queue_.shutdown();
+  verification_queue_.shutdown();
+  {
+    std::lock_guard<std::mutex> lock(extraction_mutex_);
+    shutdown_ = true;
+  }
+  extraction_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    if (worker.joinable()) worker.join();
+  }
   LOG(INFO) << "Shutting down PoseGraph module.";
 }
 
@@ -3,6 +3,7 @@
 #include <glog/logging.h>
 #include <ros/package.h>
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <fstream>
 #include <string>
@@ -39,7 +40,12 @@ void Parameters::loadParameters(const std::string& config_file) {
   std::string pkg_path = ros::package::getPath("pose_graph");
 
   vocabulary_file_ = pkg_path + "/Vocabulary/brief_k10L6.bin";
-  std::cout << "vocabulary_file" << vocabulary_file_ << std::endl;
+  // the memory mapped vocabulary (created with convert_vocabulary) is used without parsing, prefer it if it exists.
+  // LoopClosure falls back to the binary one if it is corrupted.
+  mapped_vocabulary_file_ = pkg_path + "/Vocabulary/brief_k10L6.mmap";
+  if (!boost::filesystem::exists(mapped_vocabulary_file_)) mapped_vocabulary_file_.clear();
+  std::cout << "vocabulary_file" << (mapped_vocabulary_file_.empty() ? vocabulary_file_ : mapped_vocabulary_file_)
+            << std::endl;
 
   brief_pattern_file_ = pkg_path + "/Vocabulary/brief_pattern.yml";
 
@@ -67,6 +73,30 @@ void Parameters::loadParameters(const std::string& config_file) {
           static_cast<int>(fsSettings["loop_closure_params"]["pnp_ransac_iterations"]);
       LOG(INFO) << "PnP ransac iterations: " << loop_closure_params_.pnp_ransac_iterations;
     }
+
+    if (fsSettings["loop_closure_params"]["extraction_workers"].isInt()) {
+      loop_closure_params_.extraction_workers =
+          std::max(1, static_cast<int>(fsSettings["loop_closure_params"]["extraction_workers"]));
+      LOG(INFO) << "Feature extraction workers: " << loop_closure_params_.extraction_workers;
+    }
+
+    if (fsSettings["loop_closure_params"]["verification_workers"].isInt()) {
+      loop_closure_params_.verification_workers =
+          std::max(1, static_cast<int>(fsSettings["loop_closure_params"]["verification_workers"]));
+      LOG(INFO) << "Geometric verification workers: " << loop_closure_params_.verification_workers;
+    }
+
+    if (fsSettings["loop_closure_params"]["max_pending_keyframes"].isInt()) {
+      loop_closure_params_.max_pending_keyframes =
+          std::max(1, static_cast<int>(fsSettings["loop_closure_params"]["max_pending_keyframes"]));
+      LOG(INFO) << "Max pending keyframes: " << loop_closure_params_.max_pending_keyframes;
+    }
+
+    if (fsSettings["loop_closure_params"]["max_pending_loop_candidates"].isInt()) {
+      loop_closure_params_.max_pending_loop_candidates =
+          std::max(1, static_cast<int>(fsSettings["loop_closure_params"]["max_pending_loop_candidates"]));
+      LOG(INFO) << "Max pending loop candidates: " << loop_closure_params_.max_pending_loop_candidates;
+    }
   }
 
   if (fsSettings["debug"]["enable"].isInt()) {
@@ -91,6 +121,12 @@ void Parameters::loadParameters(const std::string& config_file) {
           static_cast<double>(fsSettings["global_map_params"]["min_landmark_quality"]);
       LOG(INFO) << "Minimum landmark quality to add to global map:" << global_mapping_params_.min_lmk_quality;
     }
+
+    if (fsSettings["global_map_params"]["voxel_size"].isInt() ||
+        fsSettings["global_map_params"]["voxel_size"].isReal()) {
+      global_mapping_params_.voxel_size = static_cast<double>(fsSettings["global_map_params"]["voxel_size"]);
+      LOG(INFO) << "Voxel size of the published global map:" << global_mapping_params_.voxel_size;
+    }
   }
 
   if (fsSettings["health"]["enable"].isInt()) {
@@ -0,0 +1,175 @@
+#include "pose_graph/PointCloudExporter.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "utils/Statistics.h"
+#include "utils/Timer.h"
+
+namespace {
+
+// x, y, z, red, green, blue, quality
+const size_t kVertexSize = 3 * sizeof(float) + 3 * sizeof(uint8_t) + sizeof(float);
+// The vertex count is written with a fixed width, so that an append can update it in place.
+const int kVertexCountWidth = 12;
+
+std::string plyHeader(size_t num_vertices) {
+  char count[kVertexCountWidth + 1];
+  std::snprintf(count, sizeof(count), "%0*zu", kVertexCountWidth, num_vertices);
+  // little endian as the machines we run on
+  return std::string("ply\n") + "format binary_little_endian 1.0\n" + "comment SVIn global map\n" +
+         "element vertex " + count + "\n" + "property float x\n" + "property float y\n" + "property float z\n" +
+         "property uchar red\n" + "property uchar green\n" + "property uchar blue\n" + "property float quality\n" +
+         "end_header\n";
+}
+
+const size_t kVertexCountOffset = plyHeader(0).find("element vertex ") + std::strlen("element vertex ");
+
+char* writeVertex(const MapPoint& point, char* out) {
+  std::memcpy(out, &point.x, sizeof(float));
+  std::memcpy(out + 4, &point.y, sizeof(float));
+  std::memcpy(out + 8, &point.z, sizeof(float));
+  out[12] = static_cast<char>(point.r);
+  out[13] = static_cast<char>(point.g);
+  out[14] = static_cast<char>(point.b);
+  std::memcpy(out + 15, &point.quality, sizeof(float));
+  return out + kVertexSize;
+}
+
+}  // namespace
+
+PointCloudExporter::PointCloudExporter(double min_quality) : min_quality_(min_quality), progress_(1.0) {
+  thread_ = std::thread(&PointCloudExporter::run, this);
+}
+
+PointCloudExporter::~PointCloudExporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  job_condition_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool PointCloudExporter::save(std::shared_ptr<const GlobalMapSnapshot> snapshot,
+                              const std::string& filename,
+                              bool append) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (busy_) return false;
+    job_.reset(new Job{std::move(snapshot), filename, append});
+    busy_ = true;
+    progress_ = 0.0;
+  }
+  job_condition_.notify_all();
+  return true;
+}
+
+bool PointCloudExporter::busy() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return busy_;
+}
+
+double PointCloudExporter::progress() const { return progress_; }
+
+void PointCloudExporter::waitUntilIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_condition_.wait(lock, [this] { return !busy_; });
+}
+
+void PointCloudExporter::run() {
+  while (true) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_condition_.wait(lock, [this] { return job_ || shutdown_; });
+      if (!job_) return;
+      job = std::move(job_);
+    }
+
+    static utils::StatsCollector export_stats("PointCloudExporter export [ms]");
+    auto tic = utils::Timer::tic();
+    if (!write(*job)) {
+      LOG(ERROR) << "Could not write the point cloud " << job->filename;
+      saved_filename_.clear();
+    }
+    export_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() / 1000.0);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+      progress_ = 1.0;
+    }
+    idle_condition_.notify_all();
+  }
+}
+
+bool PointCloudExporter::write(const Job& job) {
+  const GlobalMapSnapshot& snapshot = *job.snapshot;
+  const size_t header_size = plyHeader(0).size();
+  size_t first_slot = 0;
+  size_t num_vertices = 0;
+
+  std::fstream file;
+  if (job.append && job.filename == saved_filename_ && saved_slots_ <= snapshot.size()) {
+    // only if the file is still the one we wrote
+    file.open(job.filename, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(0, std::ios::end);
+    if (file && static_cast<size_t>(file.tellp()) == header_size + saved_vertices_ * kVertexSize) {
+      first_slot = saved_slots_;
+      num_vertices = saved_vertices_;
+    } else {
+      LOG(WARNING) << job.filename << " changed since the last export, writing all points";
+      file.close();
+    }
+  }
+  if (!file.is_open()) {
+    file.open(job.filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    file << plyHeader(0);
+  }
+  if (!file) return false;
+  LOG(INFO) << "Writing points " << first_slot << " to " << snapshot.size() << " of the global map to "
+            << job.filename;
+
+  std::vector<char> buffer(GlobalMapSnapshot::kChunkSize * kVertexSize);
+  const size_t num_slots = std::max<size_t>(snapshot.size() - first_slot, 1);
+  size_t next_report = 1;  // in tenths
+  for (size_t chunk = first_slot / GlobalMapSnapshot::kChunkSize; chunk < snapshot.numChunks(); ++chunk) {
+    const GlobalMapSnapshot::Chunk& points = *snapshot.chunk(chunk);
+    const size_t chunk_begin = chunk * GlobalMapSnapshot::kChunkSize;
+    char* out = buffer.data();
+    for (size_t i = std::max(first_slot, chunk_begin) - chunk_begin; i < points.size(); ++i) {
+      if (points[i].quality > min_quality_) out = writeVertex(points[i], out);
+    }
+    file.write(buffer.data(), out - buffer.data());
+    if (!file) return false;
+    num_vertices += (out - buffer.data()) / kVertexSize;
+
+    const size_t written = chunk_begin + points.size() - first_slot;
+    progress_ = static_cast<double>(written) / num_slots;
+    if (progress_ * 10 >= next_report) {
+      LOG(INFO) << "Point cloud export " << static_cast<int>(progress_ * 100) << "%";
+      next_report = static_cast<size_t>(progress_ * 10) + 1;
+    }
+  }
+
+  // the count last: an interrupted export leaves a file with the previous points
+  file.seekp(kVertexCountOffset);
+  file << plyHeader(num_vertices).substr(kVertexCountOffset, kVertexCountWidth);
+  file.close();
+  if (file.fail()) return false;
+
+  saved_filename_ = job.filename;
+  saved_slots_ = snapshot.size();
+  saved_vertices_ = num_vertices;
+  LOG(INFO) << job.filename << " has " << num_vertices << " points";
+  return true;
+}
@@ -5,10 +5,11 @@
 #include <ceres/problem.h>
 #include <ceres/solver.h>
 
-#include <list>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "pose_graph/Pose3DError.h"
 
@@ -23,6 +24,7 @@ PoseGraph::PoseGraph() {
   sequence_cnt = 0;
   sequence_loop.push_back(0);
   base_sequence = 1;
+  first_changed_index_ = std::numeric_limits<int>::max();
   is_fast_localization_ = true;
 }
 
@@ -43,30 +45,9 @@ void PoseGraph::startOptimizationThread(bool vio_only_optimization) {
   }
 }
 
-void PoseGraph::addKFToPoseGraph(Keyframe* cur_kf, bool flag_detect_loop) {
-  // shift to base frame
-  Eigen::Vector3d svin_P_cur;
-  Eigen::Matrix3d svin_R_cur;
-  if (sequence_cnt != cur_kf->sequence) {
-    sequence_cnt++;
-    sequence_loop.push_back(0);
-    w_t_svin = Eigen::Vector3d(0, 0, 0);
-    w_r_svin = Eigen::Matrix3d::Identity();
-
-    {
-      std::lock_guard<std::mutex> l(driftMutex_);
-      t_drift = Eigen::Vector3d(0, 0, 0);
-      r_drift = Eigen::Matrix3d::Identity();
-    }
-  }
-
-  cur_kf->getSVInPose(svin_P_cur, svin_R_cur);
-  svin_P_cur = w_r_svin * svin_P_cur + w_t_svin;
-  svin_R_cur = w_r_svin * svin_R_cur;
-  cur_kf->updateSVInPose(svin_P_cur, svin_R_cur);
+int PoseGraph::addKFToPoseGraph(Keyframe* cur_kf, bool flag_detect_loop) {
   cur_kf->index = global_index;
   global_index++;
-  std::set<Keyframe*> loopCandidates;
   int loop_index = -1;
 
   if (flag_detect_loop) {  // at least 20 KF has been passed
@@ -75,76 +56,37 @@ void PoseGraph::addKFToPoseGraph(Keyframe* cur_kf, bool flag_detect_loop) {
     db.add(cur_kf->brief_descriptors);
   }
 
-  if (loop_index != -1) {
-    Keyframe* old_kf = getKFPtr(loop_index);
-    if (cur_kf->findConnection(old_kf)) {
-      if (earliest_loop_index > loop_index || earliest_loop_index == -1) earliest_loop_index = loop_index;
-
-      Eigen::Vector3d w_P_old, w_P_cur, svin_P_cur;
-      Eigen::Matrix3d w_R_old, w_R_cur, svin_R_cur;
-      old_kf->getSVInPose(w_P_old, w_R_old);  // old_kf replaced by min_loop_kf
-      cur_kf->getSVInPose(svin_P_cur, svin_R_cur);
+  {
+    std::lock_guard<std::mutex> l(kflistMutex_);
+    // shift to base frame
+    if (sequence_cnt != cur_kf->sequence) {
+      sequence_cnt++;
+      sequence_loop.push_back(0);
+      w_t_svin = Eigen::Vector3d(0, 0, 0);
+      w_r_svin = Eigen::Matrix3d::Identity();
 
-      Eigen::Vector3d relative_t;
-      Eigen::Quaterniond relative_q;
-      relative_t = cur_kf->getLoopRelativeT();
-      relative_q = (cur_kf->getLoopRelativeQ()).toRotationMatrix();
-      w_P_cur = w_R_old * relative_t + w_P_old;
-      w_R_cur = w_R_old * relative_q;
-      double shift_yaw;
-      Eigen::Matrix3d shift_r;
-      Eigen::Vector3d shift_t;
-      shift_yaw = Utils::R2ypr(w_R_cur).x() - Utils::R2ypr(svin_R_cur).x();
-      shift_r = Utils::ypr2R(Eigen::Vector3d(shift_yaw, 0, 0));
-      shift_t = w_P_cur - w_R_cur * svin_R_cur.transpose() * svin_P_cur;
-      // shift svin pose of whole sequence to the world frame
-      if (old_kf->sequence != cur_kf->sequence && sequence_loop[cur_kf->sequence] == 0) {
-        w_r_svin = shift_r;
-        w_t_svin = shift_t;
-        svin_P_cur = w_r_svin * svin_P_cur + w_t_svin;
-        svin_R_cur = w_r_svin * svin_R_cur;
-        cur_kf->updateSVInPose(svin_P_cur, svin_R_cur);
-        std::list<Keyframe*>::iterator it = keyframelist.begin();
-        for (; it != keyframelist.end(); it++) {
-          if ((*it)->sequence == cur_kf->sequence) {
-            Eigen::Vector3d svin_P_cur;
-            Eigen::Matrix3d svin_R_cur;
-            (*it)->getSVInPose(svin_P_cur, svin_R_cur);
-            svin_P_cur = w_r_svin * svin_P_cur + w_t_svin;
-            svin_R_cur = w_r_svin * svin_R_cur;
-            (*it)->updateSVInPose(svin_P_cur, svin_R_cur);
-          }
-        }
-        sequence_loop[cur_kf->sequence] = 1;
+      {
+        std::lock_guard<std::mutex> l(driftMutex_);
+        t_drift = Eigen::Vector3d(0, 0, 0);
+        r_drift = Eigen::Matrix3d::Identity();
       }
-      std::lock_guard<std::mutex> l(optimizationMutex_);
-      optimizationBuffer_.push(cur_kf->index);
     }
-  }
 
-  {
-    std::lock_guard<std::mutex> l(kflistMutex_);
     Eigen::Vector3d P;
     Eigen::Matrix3d R;
+    cur_kf->getSVInPose(P, R);
+    cur_kf->updateSVInPose(w_r_svin * P + w_t_svin, w_r_svin * R);
+
     cur_kf->getSVInPose(P, R);
     P = r_drift * P + t_drift;
     R = r_drift * R;
     cur_kf->updatePose(P, R);
-    Eigen::Quaterniond Q{R};
 
+    // the loop of the keyframe is verified later, its edge is published with the optimized path
     std::pair<Eigen::Vector3d, Eigen::Vector3d> loop_info;
     loop_info.first = Eigen::Vector3d::Zero();
     loop_info.second = Eigen::Vector3d::Zero();
 
-    if (cur_kf->has_loop) {
-      Keyframe* connected_KF = getKFPtr(cur_kf->loop_index);
-      Eigen::Vector3d connected_P, P0;
-      Eigen::Matrix3d connected_R, R0;
-      connected_KF->getPose(connected_P, connected_R);
-      cur_kf->getPose(P0, R0);
-      loop_info = {P0, connected_P};
-    }
-
     keyframelist.push_back(cur_kf);
 
     std::pair<Timestamp, Eigen::Matrix4d> pose;
@@ -154,17 +96,91 @@ void PoseGraph::addKFToPoseGraph(Keyframe* cur_kf, bool flag_detect_loop) {
     CHECK(keyframe_pose_callback_);
     keyframe_pose_callback_(pose, loop_info);
   }
+  return loop_index;
 }
 
-Keyframe* PoseGraph::getKFPtr(int index) {
-  std::list<Keyframe*>::iterator it = keyframelist.begin();
-  for (; it != keyframelist.end(); it++) {
-    if ((*it)->index == index) break;
+bool PoseGraph::verifyLoopCandidate(Keyframe* cur_kf, int loop_index, std::mutex* debug_output_mutex) {
+  Keyframe* old_kf;
+  {
+    std::lock_guard<std::mutex> l(kflistMutex_);
+    old_kf = getKFPtr(loop_index);
+  }
+  // descriptors, keypoints and odometry pose of both keyframes do not change after they were added
+  Eigen::Matrix<double, 8, 1> relative_pose;
+  if (!old_kf || !cur_kf->findConnection(old_kf, relative_pose, debug_output_mutex)) return false;
+
+  std::lock_guard<std::mutex> l(kflistMutex_);
+  cur_kf->has_loop = true;
+  cur_kf->loop_index = loop_index;
+  cur_kf->loop_info = relative_pose;
+
+  Eigen::Vector3d w_P_old, w_P_cur, svin_P_cur;
+  Eigen::Matrix3d w_R_old, w_R_cur, svin_R_cur;
+  old_kf->getSVInPose(w_P_old, w_R_old);  // old_kf replaced by min_loop_kf
+  cur_kf->getSVInPose(svin_P_cur, svin_R_cur);
+
+  Eigen::Vector3d relative_t;
+  Eigen::Quaterniond relative_q;
+  relative_t = cur_kf->getLoopRelativeT();
+  relative_q = (cur_kf->getLoopRelativeQ()).toRotationMatrix();
+  w_P_cur = w_R_old * relative_t + w_P_old;
+  w_R_cur = w_R_old * relative_q;
+  double shift_yaw;
+  Eigen::Matrix3d shift_r;
+  Eigen::Vector3d shift_t;
+  shift_yaw = Utils::R2ypr(w_R_cur).x() - Utils::R2ypr(svin_R_cur).x();
+  shift_r = Utils::ypr2R(Eigen::Vector3d(shift_yaw, 0, 0));
+  shift_t = w_P_cur - w_R_cur * svin_R_cur.transpose() * svin_P_cur;
+  // shift svin pose of whole sequence to the world frame, including the keyframes added since cur_kf. Their pose
+  // was set from the unshifted svin pose in addKFToPoseGraph, so it is shifted too.
+  if (old_kf->sequence != cur_kf->sequence && sequence_loop[cur_kf->sequence] == 0) {
+    w_r_svin = shift_r;
+    w_t_svin = shift_t;
+    Eigen::Vector3d drift_t;
+    Eigen::Matrix3d drift_r;
+    {
+      std::lock_guard<std::mutex> l(driftMutex_);
+      drift_t = t_drift;
+      drift_r = r_drift;
+    }
+    for (size_t i = 0; i < keyframelist.size(); ++i) {
+      Keyframe* keyframe = keyframelist[i];
+      if (keyframe->sequence == cur_kf->sequence) {
+        Eigen::Vector3d svin_P_cur;
+        Eigen::Matrix3d svin_R_cur;
+        keyframe->getSVInPose(svin_P_cur, svin_R_cur);
+        svin_P_cur = w_r_svin * svin_P_cur + w_t_svin;
+        svin_R_cur = w_r_svin * svin_R_cur;
+        keyframe->updateSVInPose(svin_P_cur, svin_R_cur);
+        keyframe->updatePose(drift_r * svin_P_cur + drift_t, drift_r * svin_R_cur);
+        first_changed_index_ = std::min(first_changed_index_, static_cast<int>(i));
+      }
+    }
+    sequence_loop[cur_kf->sequence] = 1;
   }
-  if (it != keyframelist.end())
-    return *it;
-  else
-    return NULL;
+
+  std::lock_guard<std::mutex> optimization_lock(optimizationMutex_);
+  if (earliest_loop_index > loop_index || earliest_loop_index == -1) earliest_loop_index = loop_index;
+  optimizationBuffer_.push(cur_kf->index);
+  return true;
+}
+
+void PoseGraph::takeChangedPoses(std::vector<KeyframePose>& poses) {
+  std::lock_guard<std::mutex> l(kflistMutex_);
+  for (size_t i = std::max(first_changed_index_, 0); i < keyframelist.size(); ++i) {
+    KeyframePose pose;
+    pose.index = keyframelist[i]->index;
+    keyframelist[i]->getPose(pose.translation, pose.rotation);
+    poses.push_back(pose);
+  }
+  first_changed_index_ = std::numeric_limits<int>::max();
+}
+
+Keyframe* PoseGraph::getKFPtr(int index) {
+  // keyframes are stored in the order of their (consecutive) global index
+  if (index < 0 || index >= static_cast<int>(keyframelist.size())) return NULL;
+  assert(keyframelist[index]->index == index);
+  return keyframelist[index];
 }
 
 int PoseGraph::detectLoop(Keyframe* keyframe, int frame_index) {
@@ -227,131 +243,70 @@ void PoseGraph::optimize4DoFPoseGraph() {
   while (true) {
     int cur_index = -1;
     int first_looped_index = -1;
+    std::vector<int> looped_indices;
 
+    // Popped under the keyframe list lock, which verifyLoopCandidate holds while registering a loop: the loop
+    // edge of a keyframe is either added with the keyframe or as a late edge, never twice.
+    std::unique_lock<std::mutex> kflist_lock(kflistMutex_);
     {
       std::lock_guard<std::mutex> l(optimizationMutex_);
       while (!optimizationBuffer_.empty()) {
-        cur_index = optimizationBuffer_.front();
+        // loops are verified concurrently, not necessarily in keyframe order
+        looped_indices.push_back(optimizationBuffer_.front());
+        cur_index = std::max(cur_index, optimizationBuffer_.front());
         first_looped_index = earliest_loop_index;
         optimizationBuffer_.pop();
       }
     }
     if (cur_index != -1) {
-      ceres::Problem problem;
-      ceres::Solver::Options options;
-      options.linear_solver_type = ceres::SPARSE_SCHUR;
-      options.max_num_iterations = 5;
-      options.trust_region_strategy_type = ceres::DOGLEG;
-      options.logging_type = ceres::SILENT;
-      options.minimizer_progress_to_stdout = false;
-
-      ceres::Solver::Summary summary;
-      ceres::LossFunction* loss_function;
-      loss_function = new ceres::HuberLoss(0.1);
-
-      kflistMutex_.lock();
       Keyframe* cur_kf = getKFPtr(cur_index);
 
-      int max_length = cur_index + 1;
-
-      double t_array[max_length][3];
-      Eigen::Quaterniond q_array[max_length];  // NOLINT
-      double euler_array[max_length][3];       // NOLINT
-      double sequence_array[max_length];       // NOLINT
-
-      ceres::LocalParameterization* angle_local_parameterization = AngleLocalParameterization::Create();
-
-      std::list<Keyframe*>::iterator it;
-
-      int i = 0;
-      for (it = keyframelist.begin(); it != keyframelist.end(); it++) {
-        if ((*it)->index < first_looped_index) continue;
-        (*it)->local_index = i;
-        Eigen::Quaterniond tmp_q;
-        Eigen::Matrix3d tmp_r;
-        Eigen::Vector3d tmp_t;
-        (*it)->getSVInPose(tmp_t, tmp_r);
-        tmp_q = tmp_r;
-        t_array[i][0] = tmp_t(0);
-        t_array[i][1] = tmp_t(1);
-        t_array[i][2] = tmp_t(2);
-        q_array[i] = tmp_q;
-
-        Eigen::Vector3d euler_angle = Utils::R2ypr(tmp_q.toRotationMatrix());
-        euler_array[i][0] = euler_angle.x();
-        euler_array[i][1] = euler_angle.y();
-        euler_array[i][2] = euler_angle.z();
-
-        sequence_array[i] = (*it)->sequence;
-
-        problem.AddParameterBlock(euler_array[i], 1, angle_local_parameterization);
-        problem.AddParameterBlock(t_array[i], 3);
-
-        if ((*it)->index == first_looped_index) {
-          problem.SetParameterBlockConstant(euler_array[i]);
-          problem.SetParameterBlockConstant(t_array[i]);
-        }
+      // The graph is kept across loops. It is only rebuilt if a loop reached further into the past than
+      // its anchor; the rebuilt graph still starts from the current (optimized) keyframe poses.
+      if (pose_graph_4dof_.empty() || first_looped_index < pose_graph_4dof_.firstIndex()) {
+        pose_graph_4dof_.reset(first_looped_index);
+      }
 
-        // add edge
-        // adding sequential egde. Fixed sized window of length 4 serves as covisibility
-        for (int j = 1; j < 3; j++) {
-          if (i - j >= 0 && sequence_array[i] == sequence_array[i - j]) {
-            Eigen::Vector3d euler_conncected = Utils::R2ypr(q_array[i - j].toRotationMatrix());
-            Eigen::Vector3d relative_t(t_array[i][0] - t_array[i - j][0],
-                                       t_array[i][1] - t_array[i - j][1],
-                                       t_array[i][2] - t_array[i - j][2]);
-            relative_t = q_array[i - j].inverse() * relative_t;
-            double relative_yaw = euler_array[i][0] - euler_array[i - j][0];
-            ceres::CostFunction* cost_function = FourDOFError::Create(relative_t.x(),
-                                                                      relative_t.y(),
-                                                                      relative_t.z(),
-                                                                      relative_yaw,
-                                                                      euler_conncected.y(),
-                                                                      euler_conncected.z());
-            problem.AddResidualBlock(
-                cost_function, NULL, euler_array[i - j], t_array[i - j], euler_array[i], t_array[i]);
-          }
-        }
+      // loops verified after their keyframe was added to the graph by an earlier optimization
+      for (int looped_index : looped_indices) {
+        if (looped_index > pose_graph_4dof_.lastIndex()) continue;
+        Keyframe* looped_kf = getKFPtr(looped_index);
+        pose_graph_4dof_.addLoopEdge(looped_kf->index,
+                                     looped_kf->loop_index,
+                                     looped_kf->getLoopRelativeT(),
+                                     looped_kf->getLoopRelativeYaw());
+      }
 
-        // add loop edge
+      // add the new keyframes with their sequential and loop edges
+      KeyframeList::iterator it;
+      for (it = keyframelist.begin() + (pose_graph_4dof_.lastIndex() + 1); it != keyframelist.end(); it++) {
+        if ((*it)->index > cur_index) break;
+        Eigen::Vector3d svin_t, init_t;
+        Eigen::Matrix3d svin_r, init_r;
+        (*it)->getSVInPose(svin_t, svin_r);
+        (*it)->getPose(init_t, init_r);
+        pose_graph_4dof_.addKeyframe((*it)->index, (*it)->sequence, svin_t, svin_r, init_t, init_r);
 
         if ((*it)->has_loop) {
           assert((*it)->loop_index >= first_looped_index);
-          int connected_index = getKFPtr((*it)->loop_index)->local_index;
-          Eigen::Vector3d euler_conncected = Utils::R2ypr(q_array[connected_index].toRotationMatrix());
-          Eigen::Vector3d relative_t;
-          relative_t = (*it)->getLoopRelativeT();
-          double relative_yaw = (*it)->getLoopRelativeYaw();
-          ceres::CostFunction* cost_function = FourDOFWeightError::Create(
-              relative_t.x(), relative_t.y(), relative_t.z(), relative_yaw, euler_conncected.y(), euler_conncected.z());
-          problem.AddResidualBlock(cost_function,
-                                   loss_function,
-                                   euler_array[connected_index],
-                                   t_array[connected_index],
-                                   euler_array[i],
-                                   t_array[i]);
+          pose_graph_4dof_.addLoopEdge(
+              (*it)->index, (*it)->loop_index, (*it)->getLoopRelativeT(), (*it)->getLoopRelativeYaw());
         }
-
-        if ((*it)->index == cur_index) break;
-        i++;
       }
-      kflistMutex_.unlock();
+      kflist_lock.unlock();
 
-      ceres::Solve(options, &problem, &summary);
+      pose_graph_4dof_.solve(5);
 
       {
         std::lock_guard<std::mutex> l(kflistMutex_);
-        i = 0;
-        for (it = keyframelist.begin(); it != keyframelist.end(); it++) {
-          if ((*it)->index < first_looped_index) continue;
-          Eigen::Quaterniond tmp_q;
-          tmp_q = Utils::ypr2R(Eigen::Vector3d(euler_array[i][0], euler_array[i][1], euler_array[i][2]));
-          Eigen::Vector3d tmp_t = Eigen::Vector3d(t_array[i][0], t_array[i][1], t_array[i][2]);
-          Eigen::Matrix3d tmp_r = tmp_q.toRotationMatrix();
+        first_changed_index_ = std::min(first_changed_index_, pose_graph_4dof_.firstIndex());
+        for (it = keyframelist.begin() + pose_graph_4dof_.firstIndex(); it != keyframelist.end(); it++) {
+          Eigen::Vector3d tmp_t;
+          Eigen::Matrix3d tmp_r;
+          pose_graph_4dof_.getPose((*it)->index, tmp_t, tmp_r);
           (*it)->updatePose(tmp_t, tmp_r);
 
           if ((*it)->index == cur_index) break;
-          i++;
         }
 
         Eigen::Vector3d cur_t, svin_t;
@@ -377,9 +332,15 @@ void PoseGraph::optimize4DoFPoseGraph() {
       }
       updatePath();
       if (loop_closure_optimization_callback_) {
-        Keyframe* last_kf = keyframelist.back();
-        loop_closure_optimization_callback_(last_kf->time_stamp);
+        Timestamp last_time_stamp;
+        {
+          std::lock_guard<std::mutex> l(kflistMutex_);
+          last_time_stamp = keyframelist.back()->time_stamp;
+        }
+        loop_closure_optimization_callback_(last_time_stamp);
       }
+    } else {
+      kflist_lock.unlock();
     }
     std::chrono::milliseconds duration(500);
     std::this_thread::sleep_for(duration);
@@ -394,7 +355,8 @@ void PoseGraph::optimize6DoFPoseGraph() {
     {
       std::lock_guard<std::mutex> l(optimizationMutex_);
       while (!optimizationBuffer_.empty()) {
-        cur_index = optimizationBuffer_.front();
+        // loops are verified concurrently, not necessarily in keyframe order
+        cur_index = std::max(cur_index, optimizationBuffer_.front());
         first_looped_index = earliest_loop_index;
         optimizationBuffer_.pop();
       }
@@ -427,56 +389,43 @@ void PoseGraph::optimize6DoFPoseGraph() {
       kflistMutex_.lock();
       Keyframe* cur_kf = getKFPtr(cur_index);
 
-      int kMaxLength = cur_index + 1;
-
-      Eigen::Vector3d t_array[kMaxLength];
-      Eigen::Quaterniond q_array[kMaxLength];  // NOLINT
-      double sequence_array[kMaxLength];       // NOLINT
+      // indexed by keyframe index, the memory is kept for the next optimization
+      PoseGraphState& state = pose_graph_6dof_state_;
+      state.resize(cur_index + 1);
 
       ceres::LocalParameterization* quaternion_local_parameterization = new ceres::EigenQuaternionParameterization;
 
-      std::list<Keyframe*>::iterator it;
+      KeyframeList::iterator it;
 
-      int i = 0;
-      for (it = keyframelist.begin(); it != keyframelist.end(); it++) {
-        if ((*it)->index < first_looped_index) continue;
-        (*it)->local_index = i;
-        Eigen::Quaterniond tmp_q;
+      for (it = keyframelist.begin() + first_looped_index; it != keyframelist.end(); it++) {
+        const int i = (*it)->index;
         Eigen::Matrix3d tmp_r;
         Eigen::Vector3d tmp_t;
         (*it)->getSVInPose(tmp_t, tmp_r);
-        tmp_q = tmp_r;
-        t_array[i] = tmp_t;
-        q_array[i] = tmp_q;
-        sequence_array[i] = (*it)->sequence;
+        state.translation(i) = tmp_t;
+        state.rotation(i) = Eigen::Quaterniond(tmp_r);
+        state.sequence(i) = (*it)->sequence;
 
-        problem.AddParameterBlock(q_array[i].coeffs().data(), 4, quaternion_local_parameterization);
-        problem.AddParameterBlock(t_array[i].data(), 3);
+        problem.AddParameterBlock(state.q(i), 4, quaternion_local_parameterization);
+        problem.AddParameterBlock(state.t(i), 3);
 
         if ((*it)->index == first_looped_index || (*it)->sequence == 0) {
-          problem.SetParameterBlockConstant(t_array[i].data());
-          problem.SetParameterBlockConstant(q_array[i].coeffs().data());
+          problem.SetParameterBlockConstant(state.t(i));
+          problem.SetParameterBlockConstant(state.q(i));
         }
 
         // add edge
         // adding sequential egde. Fixed sized window of length 4 serves as covisibility
         for (int j = 1; j < 5; j++) {
-          if (i - j >= 0 && sequence_array[i] == sequence_array[i - j]) {
-            Eigen::Quaterniond relative_q = q_array[i - j].inverse() * q_array[i];
-            Eigen::Vector3d relative_t = q_array[i - j].inverse() * (t_array[i] - t_array[i - j]);
+          if (i - j >= first_looped_index && state.sequence(i) == state.sequence(i - j)) {
+            Eigen::Quaterniond q_inverse = state.rotation(i - j).inverse();
+            Eigen::Quaterniond relative_q = q_inverse * state.rotation(i);
+            Eigen::Vector3d relative_t = q_inverse * (state.translation(i) - state.translation(i - j));
             ceres::Pose3d relative_pose(relative_t, relative_q);
             ceres::CostFunction* cost_function =
                 ceres::PoseGraph3dErrorTerm::Create(relative_pose, relative_pose_sqrt_information);
 
-            problem.AddResidualBlock(cost_function,
-                                     NULL,
-                                     t_array[i - j].data(),
-                                     q_array[i - j].coeffs().data(),
-                                     t_array[i].data(),
-                                     q_array[i].coeffs().data());
-
-            // problem.SetParameterization(q_array[i - j].coeffs().data(), quaternion_local_parameterization);
-            // problem.SetParameterization(q_array[i].coeffs().data(), quaternion_local_parameterization);
+            problem.AddResidualBlock(cost_function, NULL, state.t(i - j), state.q(i - j), state.t(i), state.q(i));
           }
         }
 
@@ -490,20 +439,16 @@ void PoseGraph::optimize6DoFPoseGraph() {
           ceres::CostFunction* cost_function =
               ceres::PoseGraph3dErrorTerm::Create(relative_pose, loop_closure_sqrt_information);
 
-          int connected_index = getKFPtr((*it)->loop_index)->local_index;
+          int connected_index = (*it)->loop_index;
           problem.AddResidualBlock(cost_function,
                                    loss_function,
-                                   t_array[connected_index].data(),
-                                   q_array[connected_index].coeffs().data(),
-                                   t_array[i].data(),
-                                   q_array[i].coeffs().data());
-
-          // problem.SetParameterization(q_array[connected_index].coeffs().data(), quaternion_local_parameterization);
-          // problem.SetParameterization(q_array[i].coeffs().data(), quaternion_local_parameterization);
+                                   state.t(connected_index),
+                                   state.q(connected_index),
+                                   state.t(i),
+                                   state.q(i));
         }
 
         if ((*it)->index == cur_index) break;
-        i++;
       }
       kflistMutex_.unlock();
 
@@ -511,13 +456,12 @@ void PoseGraph::optimize6DoFPoseGraph() {
 
       {
         std::lock_guard<std::mutex> l(kflistMutex_);
-        i = 0;
-        for (it = keyframelist.begin(); it != keyframelist.end(); it++) {
-          if ((*it)->index < first_looped_index) continue;
-          (*it)->updatePose(t_array[i], q_array[i].toRotationMatrix());
+        first_changed_index_ = std::min(first_changed_index_, first_looped_index);
+        for (it = keyframelist.begin() + first_looped_index; it != keyframelist.end(); it++) {
+          const int i = (*it)->index;
+          (*it)->updatePose(state.translation(i), state.rotation(i).toRotationMatrix());
 
           if ((*it)->index == cur_index) break;
-          i++;
         }
 
         Eigen::Vector3d cur_t, svin_t;
@@ -543,8 +487,12 @@ void PoseGraph::optimize6DoFPoseGraph() {
       }
       updatePath();
       if (loop_closure_optimization_callback_) {
-        Keyframe* last_kf = keyframelist.back();
-        loop_closure_optimization_callback_(last_kf->time_stamp);
+        Timestamp last_time_stamp;
+        {
+          std::lock_guard<std::mutex> l(kflistMutex_);
+          last_time_stamp = keyframelist.back()->time_stamp;
+        }
+        loop_closure_optimization_callback_(last_time_stamp);
       }
     }
   }
@@ -553,7 +501,7 @@ void PoseGraph::optimize6DoFPoseGraph() {
 void PoseGraph::updatePath() {
   std::lock_guard<std::mutex> l(kflistMutex_);
 
-  std::list<Keyframe*>::iterator it;
+  KeyframeList::iterator it;
 
   std::vector<std::pair<Timestamp, Eigen::Matrix4d>> loop_closure_path;
   std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> loop_closure_edges;
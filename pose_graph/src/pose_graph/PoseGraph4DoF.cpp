@@ -0,0 +1,98 @@
+#include "pose_graph/PoseGraph4DoF.h"
+
+#include <ceres/solver.h>
+#include <glog/logging.h>
+
+#include "utils/Utils.h"
+
+PoseGraph4DoF::PoseGraph4DoF() { reset(0); }
+
+void PoseGraph4DoF::reset(int first_index) {
+  // the problem owns (and deletes) the local parameterization and the loss function
+  problem_.reset(new ceres::Problem());
+  angle_local_parameterization_ = AngleLocalParameterization::Create();
+  loop_loss_function_ = new ceres::HuberLoss(0.1);
+  state_.clear();
+  first_index_ = first_index;
+  last_index_ = first_index - 1;
+}
+
+void PoseGraph4DoF::addKeyframe(int index,
+                                int sequence,
+                                const Eigen::Vector3d& svin_t,
+                                const Eigen::Matrix3d& svin_r,
+                                const Eigen::Vector3d& init_t,
+                                const Eigen::Matrix3d& init_r) {
+  CHECK_EQ(index, lastIndex() + 1) << "Keyframes have to be added in order";
+  last_index_ = index;
+  state_.resize(index + 1);
+
+  OdometryPose& odometry = odometry_window_[index % (kNumSequentialEdges + 1)];
+  odometry.t = svin_t;
+  odometry.q = svin_r;
+  Eigen::Vector3d svin_euler = Utils::R2ypr(svin_r);
+  odometry.yaw = svin_euler.x();
+
+  double* euler = state_.euler(index);
+  double* t = state_.t(index);
+  euler[0] = Utils::R2ypr(init_r).x();
+  euler[1] = svin_euler.y();
+  euler[2] = svin_euler.z();
+  t[0] = init_t.x();
+  t[1] = init_t.y();
+  t[2] = init_t.z();
+  state_.sequence(index) = sequence;
+
+  problem_->AddParameterBlock(euler, 1, angle_local_parameterization_);
+  problem_->AddParameterBlock(t, 3);
+  if (index == first_index_) {
+    problem_->SetParameterBlockConstant(euler);
+    problem_->SetParameterBlockConstant(t);
+  }
+
+  // add sequential egde. Fixed sized window of length 4 serves as covisibility
+  for (int j = 1; j <= kNumSequentialEdges; j++) {
+    const int prev_index = index - j;
+    if (prev_index < first_index_) break;
+    if (state_.sequence(prev_index) != sequence) continue;
+    const OdometryPose& prev = odometry_window_[prev_index % (kNumSequentialEdges + 1)];
+    const double* prev_euler = state_.euler(prev_index);
+    Eigen::Vector3d relative_t = prev.q.inverse() * (odometry.t - prev.t);
+    double relative_yaw = odometry.yaw - prev.yaw;
+    ceres::CostFunction* cost_function = FourDOFError::Create(
+        relative_t.x(), relative_t.y(), relative_t.z(), relative_yaw, prev_euler[1], prev_euler[2]);
+    problem_->AddResidualBlock(cost_function, NULL, state_.euler(prev_index), state_.t(prev_index), euler, t);
+  }
+}
+
+void PoseGraph4DoF::addLoopEdge(int index, int loop_index, const Eigen::Vector3d& relative_t, double relative_yaw) {
+  CHECK(loop_index >= first_index_ && index <= lastIndex()) << "Loop edge outside of the pose graph";
+  // pitch and roll of the connected keyframe are its odometry ones
+  const double* connected_euler = state_.euler(loop_index);
+  ceres::CostFunction* cost_function = FourDOFWeightError::Create(
+      relative_t.x(), relative_t.y(), relative_t.z(), relative_yaw, connected_euler[1], connected_euler[2]);
+  problem_->AddResidualBlock(cost_function,
+                             loop_loss_function_,
+                             state_.euler(loop_index),
+                             state_.t(loop_index),
+                             state_.euler(index),
+                             state_.t(index));
+}
+
+void PoseGraph4DoF::solve(int max_num_iterations) {
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::SPARSE_SCHUR;
+  options.max_num_iterations = max_num_iterations;
+  options.trust_region_strategy_type = ceres::DOGLEG;
+  options.logging_type = ceres::SILENT;
+  options.minimizer_progress_to_stdout = false;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, problem_.get(), &summary);
+}
+
+void PoseGraph4DoF::getPose(int index, Eigen::Vector3d& t, Eigen::Matrix3d& r) const {
+  const double* euler = state_.euler(index);
+  t = Eigen::Map<const Eigen::Vector3d>(state_.t(index));
+  r = Utils::ypr2R(Eigen::Vector3d(euler[0], euler[1], euler[2]));
+}
@@ -2,7 +2,6 @@
 
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
-#include <pcl/io/ply_io.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
@@ -10,6 +9,8 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <visualization_msgs/MarkerArray.h>
 
+#include <fstream>
+#include <string>
 #include <vector>
 
 #include "utils/Utils.h"
@@ -132,17 +133,40 @@ void Publisher::updatePublishGlobalMap(const ros::TimerEvent& event) {
   publishGlobalMap(pcl_msg);
 }
 
+void Publisher::setGlobalMapSnapshotFunction(const GlobalMapSnapshotCallback& global_map_snapshot_callback,
+                                             double min_landmark_quality) {
+  global_map_snapshot_callback_ = global_map_snapshot_callback;
+  pointcloud_exporter_.reset(new PointCloudExporter(min_landmark_quality));
+}
+
 bool Publisher::savePointCloud(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response) {
-  ROS_INFO_STREAM("!! Saving Point Cloud !!");
-  pcl::PointCloud<pcl::PointXYZRGB>::Ptr pointcloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-  pointcloud_callback_(pointcloud);
+  return exportPointCloud(false, response);
+}
 
+// Appends the landmarks added since the last save, the ones saved before are not corrected for later loop closures.
+bool Publisher::appendPointCloud(std_srvs::TriggerRequest& request, std_srvs::TriggerResponse& response) {
+  return exportPointCloud(true, response);
+}
+
+bool Publisher::exportPointCloud(bool append, std_srvs::TriggerResponse& response) {
+  if (!pointcloud_exporter_) {
+    response.success = false;
+    response.message = "No global map";
+    return true;
+  }
   std::string pkg_path = ros::package::getPath("pose_graph");
   std::string pointcloud_file = pkg_path + "/reconstruction_results/pointcloud.ply";
 
-  pcl::io::savePLYFileBinary(pointcloud_file, *pointcloud);
+  // the snapshot shares the map chunks, the service returns before the file is written
+  if (!pointcloud_exporter_->save(global_map_snapshot_callback_(), pointcloud_file, append)) {
+    response.success = false;
+    response.message = "Point cloud export running, " +
+                       std::to_string(static_cast<int>(pointcloud_exporter_->progress() * 100)) + "% written";
+    return true;
+  }
+  ROS_INFO_STREAM("!! Saving Point Cloud !!");
   response.success = true;
-  response.message = "Saving Point Cloud ";
+  response.message = (append ? "Appending to point cloud " : "Saving point cloud ") + pointcloud_file;
   return true;
 }
 
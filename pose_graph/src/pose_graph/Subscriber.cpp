@@ -12,7 +12,19 @@
 #include "utils/Utils.h"
 #include "utils/UtilsOpenCV.h"
 
-Subscriber::Subscriber(ros::NodeHandle& nh, Parameters& params) : params_(params) {
+namespace {
+// The keyframe point channel layout of okvis::Publisher with split ids: values 0 and 1 are the low 24 bits of the
+// landmark and multiframe ids, values 12 and 13 their high bits, the covisible keyframes follow.
+const char kKeyframePointChannelName[] = "split_ids";
+const int kIdSplitBits = 24;
+
+int64_t joinId(float low, float high) {
+  return (static_cast<int64_t>(high) << kIdSplitBits) | static_cast<int64_t>(low);
+}
+}  // namespace
+
+Subscriber::Subscriber(ros::NodeHandle& nh, Parameters& params, bool subscribe_keyframes)
+    : params_(params), subscribe_keyframes_(subscribe_keyframes) {
   // TODO(bjoshi): pass as params from roslaunch file
   kf_image_topic_ = "/okvis_node/keyframe_imageL";
   kf_pose_topic_ = "/okvis_node/keyframe_pose";
@@ -31,19 +43,21 @@ void Subscriber::setNodeHandle(ros::NodeHandle& nh) {
   if (it_) it_.reset();
   it_ = std::make_unique<image_transport::ImageTransport>(std::move(*nh_));
 
-  keyframe_image_subscriber_.subscribe(*it_, kf_image_topic_, 10);
-  keyframe_points_subscriber_.subscribe(*nh_, kf_points_topic_, 10);
-  keyframe_pose_subscriber_.subscribe(*nh_, kf_pose_topic_, 10);
-  svin_health_subscriber_.subscribe(*nh_, svin_health_topic_, 10);
-
-  static constexpr size_t kMaxKeyframeSynchronizerQueueSize = 10u;
-  sync_keyframe_ = std::make_unique<message_filters::Synchronizer<keyframe_sync_policy>>(
-      keyframe_sync_policy(kMaxKeyframeSynchronizerQueueSize),
-      keyframe_image_subscriber_,
-      keyframe_pose_subscriber_,
-      keyframe_points_subscriber_,
-      svin_health_subscriber_);
-  sync_keyframe_->registerCallback(boost::bind(&Subscriber::keyframeCallback, this, _1, _2, _3, _4));
+  if (subscribe_keyframes_) {
+    keyframe_image_subscriber_.subscribe(*it_, kf_image_topic_, 10);
+    keyframe_points_subscriber_.subscribe(*nh_, kf_points_topic_, 10);
+    keyframe_pose_subscriber_.subscribe(*nh_, kf_pose_topic_, 10);
+    svin_health_subscriber_.subscribe(*nh_, svin_health_topic_, 10);
+
+    static constexpr size_t kMaxKeyframeSynchronizerQueueSize = 10u;
+    sync_keyframe_ = std::make_unique<message_filters::Synchronizer<keyframe_sync_policy>>(
+        keyframe_sync_policy(kMaxKeyframeSynchronizerQueueSize),
+        keyframe_image_subscriber_,
+        keyframe_pose_subscriber_,
+        keyframe_points_subscriber_,
+        svin_health_subscriber_);
+    sync_keyframe_->registerCallback(boost::bind(&Subscriber::keyframeCallback, this, _1, _2, _3, _4));
+  }
 
   if (params_.global_mapping_params_.enabled) {
     sub_orig_image_ =
@@ -134,7 +148,7 @@ void Subscriber::keyframeCallback(const sensor_msgs::ImageConstPtr& kf_image_msg
 
   std::vector<cv::Point3f> keyframe_points;
   std::vector<cv::KeyPoint> keypoint_observations;
-  std::vector<Eigen::Vector3i> point_ids;
+  std::vector<PointIds> point_ids;
   std::vector<int64_t> landmark_ids;
   std::vector<std::vector<int64_t>> kf_covisibilities;
 
@@ -142,16 +156,18 @@ void Subscriber::keyframeCallback(const sensor_msgs::ImageConstPtr& kf_image_msg
   cv::Mat kf_image = UtilsOpenCV::readRosImage(kf_image_msg);
 
   for (unsigned int i = 0; i < kf_points->points.size(); i++) {
-    keyframe_index = kf_points->channels[i].values[4];
+    const std::vector<float>& values = kf_points->channels[i].values;
+    // okvis::Publisher splits the 64 bit ids into exact 24 bit halves, older bags carry whole (inexact) ids
+    const bool split_ids = kf_points->channels[i].name == kKeyframePointChannelName;
+    keyframe_index = values[4];
 
     cv::Point3f point_3d(kf_points->points[i].x, kf_points->points[i].y, kf_points->points[i].z);
     keyframe_points.push_back(point_3d);
 
     // @Reloc landmarkId, poseId or MultiFrameId,  keypointIdx
-    int64_t landmark_id = kf_points->channels[i].values[0];
-    Eigen::Vector3i point_id(
-        kf_points->channels[i].values[0], kf_points->channels[i].values[1], kf_points->channels[i].values[2]);
-    point_ids.push_back(point_id);
+    const int64_t landmark_id = split_ids ? joinId(values[0], values[12]) : static_cast<int64_t>(values[0]);
+    const int64_t frame_id = split_ids ? joinId(values[1], values[13]) : static_cast<int64_t>(values[1]);
+    point_ids.push_back(PointIds(landmark_id, frame_id, static_cast<int64_t>(values[2])));
 
     cv::KeyPoint p_2d_uv;
     p_2d_uv.pt.x = kf_points->channels[i].values[5];
@@ -165,7 +181,7 @@ void Subscriber::keyframeCallback(const sensor_msgs::ImageConstPtr& kf_image_msg
     keypoint_observations.push_back(p_2d_uv);
 
     std::vector<int64_t> covisible_kfs;
-    for (size_t sz = 12; sz < kf_points->channels[i].values.size(); sz++) {
+    for (size_t sz = split_ids ? 14 : 12; sz < kf_points->channels[i].values.size(); sz++) {
       int observed_kf_index = kf_points->channels[i].values[sz];
       if (observed_kf_index != keyframe_index) {
         covisible_kfs.push_back(observed_kf_index);
@@ -185,6 +201,9 @@ void Subscriber::keyframeCallback(const sensor_msgs::ImageConstPtr& kf_image_msg
                                                                                  point_ids,
                                                                                  kf_covisibilities);
 
+    // Same tag as the in-process hand-off of svin_node, for comparing both setups.
+    const double ingest_latency = (ros::Time::now() - kf_odom->header.stamp).toSec();
+    utils::StatsCollector("Keyframe ingest latency [ms]").AddSample(ingest_latency * 1e3);
     keyframe_callback_(std::move(keyframe_info));
   } else {
     // LOG(WARNING) << "Skipping keyframe. Does not contain any triangulated points.";
@@ -2,94 +2,11 @@
 #include <glog/logging.h>
 #include <ros/package.h>
 
-#include <boost/filesystem.hpp>
-
 #include "pose_graph/LoopClosure.h"
 #include "pose_graph/Parameters.h"
 #include "pose_graph/Publisher.h"
 #include "pose_graph/Subscriber.h"
-
-void setupOutputLogDirectories(const std::string base_path) {
-  std::string output_dir = base_path + "/loop_candidates/";
-  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
-    boost::filesystem::create_directories(output_dir);
-  }
-  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
-    boost::filesystem::remove_all(entry.path());
-  }
-
-  output_dir = base_path + "/descriptor_matched/";
-  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
-    boost::filesystem::create_directories(output_dir);
-  }
-  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
-    boost::filesystem::remove_all(entry.path());
-  }
-
-  output_dir = base_path + "/pnp_verified/";
-  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
-    boost::filesystem::create_directories(output_dir);
-  }
-  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
-    boost::filesystem::remove_all(entry.path());
-  }
-
-  output_dir = base_path + "/loop_closure/";
-  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
-    boost::filesystem::create_directories(output_dir);
-  }
-  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
-    boost::filesystem::remove_all(entry.path());
-  }
-
-  output_dir = base_path + "/geometric_verification/";
-  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
-    boost::filesystem::create_directories(output_dir);
-  }
-  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
-    boost::filesystem::remove_all(entry.path());
-  }
-
-  std::string loop_closure_file = base_path + "/loop_closure.txt";
-  if (boost::filesystem::exists(loop_closure_file)) {
-    boost::filesystem::remove(loop_closure_file);
-  }
-  std::ofstream loop_path_file(loop_closure_file, std::ios::out);
-  loop_path_file << "cur_kf_id"
-                 << " "
-                 << "cur_kf_ts"
-                 << " "
-                 << "matched_kf_id"
-                 << " "
-                 << "matched_kf_ts"
-                 << " "
-                 << "relative_tx"
-                 << " "
-                 << "relative_ty"
-                 << " "
-                 << "relative_tz"
-                 << " "
-                 << "relative_yaw"
-                 << " "
-                 << "relative_pitch"
-                 << " "
-                 << "relative_roll" << std::endl;
-  loop_path_file.close();
-
-  std::string switch_info_file = base_path + "/switch_info.txt";
-  if (boost::filesystem::exists(switch_info_file)) {
-    boost::filesystem::remove(switch_info_file);
-  }
-  std::ofstream switch_info_file_stream(switch_info_file, std::ios::out);
-  switch_info_file_stream << "type"
-                          << " "
-                          << "vio_stamp"
-                          << " "
-                          << "prim_stamp"
-                          << " "
-                          << "uber_stamp" << std::endl;
-  switch_info_file_stream.close();
-}
+#include "utils/Utils.h"
 
 int main(int argc, char** argv) {
   ros::init(argc, argv, "pose_graph");
@@ -113,7 +30,7 @@ int main(int argc, char** argv) {
   params.loadParameters(config_file);
 
   if (params.debug_mode_) {
-    setupOutputLogDirectories(params.debug_output_path_);
+    Utils::setupOutputLogDirectories(params.debug_output_path_);
     FLAGS_v = 10;
   }
 
@@ -141,18 +58,26 @@ int main(int argc, char** argv) {
 
   ros::Timer timer;
   ros::ServiceServer pointcloud_service;
+  ros::ServiceServer append_pointcloud_service;
 
   if (params.global_mapping_params_.enabled) {
     publisher->setGlobalPointCloudFunction(
         std::bind(&LoopClosure::getGlobalMap, loop_closure.get(), std::placeholders::_1));
     subscriber->registerImageCallback(
         std::bind(&LoopClosure::fillImageQueue, loop_closure.get(), std::placeholders::_1));
+    publisher->setGlobalMapSnapshotFunction(std::bind(&LoopClosure::getGlobalMapSnapshot, loop_closure.get()),
+                                            params.global_mapping_params_.min_lmk_quality);
     timer = nh.createTimer(ros::Duration(5), &Publisher::updatePublishGlobalMap, publisher.get());
     pointcloud_service = nh.advertiseService("save_pointcloud", &Publisher::savePointCloud, publisher.get());
+    append_pointcloud_service = nh.advertiseService("append_pointcloud", &Publisher::appendPointCloud, publisher.get());
   }
 
   auto process_thread = std::thread(&LoopClosure::run, loop_closure.get());
 
+  // Histograms for okvis_timing_report, next to the okvis_node ones.
+  std::string timing_snapshot_path;
+  nh.getParam("timing_snapshot_path", timing_snapshot_path);
+
   ros::Time last_print_time = ros::Time::now();
 
   while (ros::ok()) {
@@ -160,6 +85,9 @@ int main(int argc, char** argv) {
     if (ros::Time::now() - last_print_time > ros::Duration(10.0)) {
       last_print_time = ros::Time::now();
       LOG(INFO) << utils::Statistics::Print();
+      if (!timing_snapshot_path.empty()) {
+        utils::Statistics::WriteSnapshot(timing_snapshot_path);
+      }
     }
   }
 
@@ -0,0 +1,267 @@
+// okvis and the pose graph in one process. Keyframes go from ThreadedKFVio to LoopClosure without the four topics and
+// the exact time synchronizer of the two node setup (okvis_node + pose_graph_node).
+
+#include <glog/logging.h>
+#include <ros/ros.h>
+
+#include <fstream>
+#include <memory>
+#include <okvis/KeyframePacket.hpp>
+#include <okvis/Publisher.hpp>
+#include <okvis/RosParametersReader.hpp>
+#include <okvis/Subscriber.hpp>
+#include <okvis/ThreadedKFVio.hpp>
+#include <okvis/timing/FrameTracer.hpp>
+#include <okvis/timing/Timer.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "common/Definitions.h"
+#include "pose_graph/LoopClosure.h"
+#include "pose_graph/Parameters.h"
+#include "pose_graph/Publisher.h"
+#include "pose_graph/Subscriber.h"
+#include "utils/Statistics.h"
+#include "utils/Timer.h"
+#include "utils/Utils.h"
+
+namespace {
+
+// What pose_graph's Subscriber::keyframeCallback assembles from the keyframe topics, built straight from the packet.
+// The image shares the MultiFrame buffer, Keyframe clones it before drawing on it.
+std::unique_ptr<KeyframeInfo> makeKeyframeInfo(const okvis::Time& t,
+                                               const cv::Mat& image,
+                                               const okvis::kinematics::Transformation& T_WcCa,
+                                               const okvis::kinematics::Transformation& T_Wc_W,
+                                               const okvis::KeyframePacket& packet) {
+  const size_t num_points = packet.size();
+  std::vector<cv::Point3f> keyframe_points;
+  std::vector<PointIds> point_ids;
+  std::vector<std::vector<int64_t>> point_covisibilities;
+  std::vector<int> covisibilities;
+  std::vector<float> responses;
+  std::vector<float> qualities;
+  keyframe_points.reserve(num_points);
+  point_ids.reserve(num_points);
+  point_covisibilities.reserve(num_points);
+  covisibilities.reserve(num_points);
+  responses.reserve(num_points);
+  qualities.reserve(num_points);
+
+  // svin health, as okvis::Publisher fills it: the midlines count to the first quadrant
+  std::vector<int> kps_per_quadrant(4, 0);
+  uint32_t num_new_keypoints = 0;
+  const double half_cols = 0.5 * image.cols;
+  const double half_rows = 0.5 * image.rows;
+
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Vector4d point = T_Wc_W * Eigen::Vector4d(packet.points[i].homogeneous());
+    keyframe_points.emplace_back(point[0], point[1], point[2]);
+    // @Reloc landmarkId, poseId or MultiFrameId, keypointIdx
+    point_ids.emplace_back(static_cast<int64_t>(packet.landmarkIds[i]),
+                           static_cast<int64_t>(packet.frameId),
+                           static_cast<int64_t>(packet.keypointIndices[i]));
+
+    const size_t num_covisibilities = packet.numCovisibilities(i);
+    std::vector<int64_t> covisible_kfs;
+    covisible_kfs.reserve(num_covisibilities);
+    for (size_t j = 0; j < num_covisibilities; ++j) {
+      covisible_kfs.push_back(packet.covisibility(i, j));
+    }
+    point_covisibilities.push_back(std::move(covisible_kfs));
+    if (num_covisibilities == 0) {
+      num_new_keypoints++;
+    }
+
+    const cv::KeyPoint& keypoint = packet.keypoints[i];
+    const int x = keypoint.pt.x;
+    const int y = keypoint.pt.y;
+    if (x >= 0 && x <= image.cols && y >= 0 && y <= image.rows) {
+      kps_per_quadrant[(y > half_rows ? 2 : 0) + (x > half_cols ? 1 : 0)]++;
+    }
+    covisibilities.push_back(num_covisibilities);
+    responses.push_back(keypoint.response);
+    qualities.push_back(packet.qualities[i]);
+  }
+
+  TrackingInfo tracking_info(
+      t.toNSec(), num_points, num_new_keypoints, kps_per_quadrant, covisibilities, responses, qualities);
+  return std::make_unique<KeyframeInfo>(packet.keyframeIndex,
+                                        image,
+                                        T_WcCa.r(),
+                                        T_WcCa.C(),
+                                        tracking_info,
+                                        keyframe_points,
+                                        packet.keypoints,
+                                        point_ids,
+                                        point_covisibilities);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "svin_node");
+
+  // okvis keeps its namespace so topics and services stay those of okvis_node, the pose graph parameters and
+  // topics are those of the node (name it pose_graph_node in the launch file to keep the rviz configurations).
+  ros::NodeHandle okvis_nh("okvis_node");
+  ros::NodeHandle nh("~");
+
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_stderrthreshold = 1;  // INFO: 0, WARNING: 1, ERROR: 2, FATAL: 3
+  FLAGS_colorlogtostderr = 1;
+  FLAGS_v = 0;
+
+  std::string config_file;
+  if (!nh.getParam("config_file", config_file)) {
+    LOG(ERROR) << "Please specify the configuration file (config_file)!";
+    return EXIT_FAILURE;
+  }
+
+  // pose graph, created first: it has to outlive the okvis threads that feed it
+  Parameters params;
+  params.loadParameters(config_file);
+  if (params.debug_mode_) {
+    Utils::setupOutputLogDirectories(params.debug_output_path_);
+    FLAGS_v = 10;
+  }
+
+  auto subscriber = std::make_unique<Subscriber>(nh, params, false);
+  auto loop_closure = std::make_unique<LoopClosure>(params);
+  auto publisher = std::make_unique<Publisher>(nh, params.debug_mode_);
+
+  loop_closure->setKeyframePoseCallback(
+      std::bind(&Publisher::publishKeyframePath, publisher.get(), std::placeholders::_1, std::placeholders::_2));
+  loop_closure->setLoopClosureCallback(
+      std::bind(&Publisher::publishLoopClosurePath, publisher.get(), std::placeholders::_1, std::placeholders::_2));
+  if (params.debug_mode_) {
+    loop_closure->setPrimitivePublishCallback(
+        std::bind(&Publisher::publishPrimitiveEstimator, publisher.get(), std::placeholders::_1));
+  }
+  if (params.health_params_.enabled) {
+    subscriber->registerPrimitiveEstimatorCallback(
+        std::bind(&LoopClosure::fillPrimitiveEstimatorBuffer, loop_closure.get(), std::placeholders::_1));
+  }
+
+  // okvis
+  okvis::Publisher okvis_publisher(okvis_nh);
+  okvis::RosParametersReader vio_parameters_reader(config_file);
+  okvis::VioParameters vio_parameters;
+  vio_parameters_reader.getParameters(vio_parameters);
+  if (vio_parameters.resetableParams.isResetable) {
+    LOG(WARNING) << "The reset services are only offered by okvis_node.";
+  }
+
+  std::string trace_filename;
+  if (nh.getParam("trace_filename", trace_filename) && !okvis::timing::FrameTracer::start(trace_filename)) {
+    LOG(ERROR) << "Could not create the trace " << trace_filename;
+  }
+
+  okvis::ThreadedKFVio okvis_estimator(vio_parameters);
+  okvis_publisher.setParameters(vio_parameters);
+  okvis_publisher.setCsvFile("okvis_estimator_output.csv");
+  okvis_publisher.setLandmarksCsvFile("okvis_estimator_landmarks.csv");
+  okvis_estimator.setFullStateCallback(std::bind(&okvis::Publisher::publishFullStateAsCallback,
+                                                 &okvis_publisher,
+                                                 std::placeholders::_1,
+                                                 std::placeholders::_2,
+                                                 std::placeholders::_3,
+                                                 std::placeholders::_4,
+                                                 std::placeholders::_5));
+  okvis_estimator.setLandmarksCallback(std::bind(&okvis::Publisher::publishLandmarksAsCallback,
+                                                 &okvis_publisher,
+                                                 std::placeholders::_1,
+                                                 std::placeholders::_2,
+                                                 std::placeholders::_3));
+  okvis_estimator.setStateCallback(std::bind(
+      &okvis::Publisher::publishStateAsCallback, &okvis_publisher, std::placeholders::_1, std::placeholders::_2));
+  okvis_estimator.setRelocRelativePoseCallback(std::bind(&okvis::Publisher::publishRelocRelativePoseAsCallback,
+                                                         &okvis_publisher,
+                                                         std::placeholders::_1,
+                                                         std::placeholders::_2,
+                                                         std::placeholders::_3,
+                                                         std::placeholders::_4,
+                                                         std::placeholders::_5));
+  if (vio_parameters.visualization.publishDebugImages) {
+    okvis_estimator.setDebugImgCallback(std::bind(&okvis::Publisher::publishDebugImageAsCallback,
+                                                  &okvis_publisher,
+                                                  std::placeholders::_1,
+                                                  std::placeholders::_2,
+                                                  std::placeholders::_3));
+  }
+
+  // The keyframe topics are still published on request, for recording or inspecting them.
+  bool publish_keyframes = false;
+  nh.getParam("publish_keyframes", publish_keyframes);
+  const okvis::kinematics::Transformation T_Wc_W = vio_parameters.publishing.T_Wc_W;
+  LoopClosure* loop_closure_ptr = loop_closure.get();
+  okvis_estimator.setKeyframeCallback([&okvis_publisher, loop_closure_ptr, T_Wc_W, publish_keyframes](
+                                          const okvis::Time& t,
+                                          const cv::Mat& image,
+                                          const okvis::kinematics::Transformation& T_WCa,
+                                          const okvis::KeyframePacket& packet) {
+    if (publish_keyframes) {
+      okvis_publisher.publishKeyframeAsCallback(t, image, T_WCa, packet);
+    }
+    if (packet.size() == 0) {
+      return;
+    }
+    static utils::StatsCollector conversion_stats("Keyframe conversion [ms]");
+    static utils::StatsCollector ingest_stats("Keyframe ingest latency [ms]");
+    auto tic = utils::Timer::tic();
+    std::unique_ptr<KeyframeInfo> keyframe_info = makeKeyframeInfo(t, image, T_Wc_W * T_WCa, T_Wc_W, packet);
+    conversion_stats.AddSample(utils::Timer::toc<std::chrono::microseconds>(tic).count() * 1e-3);
+    ingest_stats.AddSample((ros::Time::now() - ros::Time(t.sec, t.nsec)).toSec() * 1e3);
+    loop_closure_ptr->fillKeyframeTrackingQueue(std::move(keyframe_info));
+  });
+
+  okvis::Subscriber okvis_subscriber(okvis_nh, &okvis_estimator, vio_parameters_reader);
+
+  ros::Timer timer;
+  ros::ServiceServer pointcloud_service;
+  ros::ServiceServer append_pointcloud_service;
+  if (params.global_mapping_params_.enabled) {
+    publisher->setGlobalPointCloudFunction(
+        std::bind(&LoopClosure::getGlobalMap, loop_closure.get(), std::placeholders::_1));
+    subscriber->registerImageCallback(
+        std::bind(&LoopClosure::fillImageQueue, loop_closure.get(), std::placeholders::_1));
+    publisher->setGlobalMapSnapshotFunction(std::bind(&LoopClosure::getGlobalMapSnapshot, loop_closure.get()),
+                                            params.global_mapping_params_.min_lmk_quality);
+    timer = nh.createTimer(ros::Duration(5), &Publisher::updatePublishGlobalMap, publisher.get());
+    pointcloud_service = nh.advertiseService("save_pointcloud", &Publisher::savePointCloud, publisher.get());
+    append_pointcloud_service = nh.advertiseService("append_pointcloud", &Publisher::appendPointCloud, publisher.get());
+  }
+
+  auto process_thread = std::thread(&LoopClosure::run, loop_closure.get());
+
+  // One snapshot file per library, okvis_timing_report merges them.
+  std::string timing_snapshot_path;
+  nh.getParam("timing_snapshot_path", timing_snapshot_path);
+
+  ros::WallTime last_print_time = ros::WallTime::now();
+  while (ros::ok()) {
+    ros::spinOnce();
+    okvis_estimator.display();
+    if (ros::WallTime::now() - last_print_time > ros::WallDuration(10.0)) {
+      last_print_time = ros::WallTime::now();
+      LOG(INFO) << utils::Statistics::Print();
+      if (!timing_snapshot_path.empty()) {
+        utils::Statistics::WriteSnapshot(timing_snapshot_path + ".pose_graph");
+        std::ofstream okvis_snapshot(timing_snapshot_path + ".okvis");
+        okvis::timing::Timing::snapshot().write(okvis_snapshot);
+      }
+    }
+  }
+
+  publisher->saveTrajectory(params.svin_w_loop_path_);
+  LOG(INFO) << "Shutting down threads...";
+  loop_closure->shutdown();
+  if (process_thread.joinable()) {
+    process_thread.join();
+  }
+  okvis::timing::FrameTracer::stop();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include "utils/HammingDistance.h"
+
+#include <climits>
+
+namespace utils {
+
+namespace {
+
+static_assert(sizeof(Descriptor256) == 32, "Descriptor256 has to be exactly 256 bits");
+
+inline int distance256(const uint64_t* a, const uint64_t* b) {
+  return __builtin_popcountll(a[0] ^ b[0]) + __builtin_popcountll(a[1] ^ b[1]) + __builtin_popcountll(a[2] ^ b[2]) +
+         __builtin_popcountll(a[3] ^ b[3]);
+}
+
+inline void initMatch(HammingMatch& match) {
+  match.best_index = -1;
+  match.best_distance = INT_MAX;
+  match.second_best_index = -1;
+  match.second_best_distance = INT_MAX;
+}
+
+inline void updateMatch(HammingMatch& match, int index, int distance) {
+  if (distance < match.best_distance) {
+    match.second_best_index = match.best_index;
+    match.second_best_distance = match.best_distance;
+    match.best_index = index;
+    match.best_distance = distance;
+  } else if (distance < match.second_best_distance) {
+    match.second_best_index = index;
+    match.second_best_distance = distance;
+  }
+}
+
+}  // namespace
+
+void packDescriptors(const std::vector<std::bitset<256>>& descriptors, std::vector<Descriptor256>& packed) {
+  const std::bitset<256> word_mask(~uint64_t(0));
+  packed.resize(descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    // bit b of the bitset is bit b % 64 of word b / 64
+    for (int w = 0; w < 4; ++w) packed[i].words[w] = ((descriptors[i] >> (64 * w)) & word_mask).to_ullong();
+  }
+}
+
+int hammingDistance(const Descriptor256& a, const Descriptor256& b) { return distance256(a.words, b.words); }
+
+void matchHamming(const Descriptor256* queries,
+                  size_t num_queries,
+                  const Descriptor256* train,
+                  size_t num_train,
+                  HammingMatch* matches) {
+  for (size_t i = 0; i < num_queries; ++i) {
+    HammingMatch& match = matches[i];
+    initMatch(match);
+    for (size_t j = 0; j < num_train; ++j) {
+      updateMatch(match, static_cast<int>(j), distance256(queries[i].words, train[j].words));
+    }
+  }
+}
+
+}  // namespace utils
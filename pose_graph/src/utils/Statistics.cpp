@@ -33,11 +33,72 @@
 #include <cmath>
 #include <fstream>
 #include <iomanip>
+#include <limits>
 #include <ostream>
 #include <sstream>
 
 namespace utils {
 
+const int HistogramLayout::kSubBuckets;
+const int HistogramLayout::kMinExponent;
+const int HistogramLayout::kNumOctaves;
+const size_t HistogramLayout::kNumBuckets;
+
+size_t HistogramLayout::Index(double value) {
+  if (!(value > 0.0)) {
+    return 0;
+  }
+  int exponent;
+  const double mantissa = std::frexp(value, &exponent);  // in [0.5, 1)
+  const int octave = exponent - kMinExponent;
+  if (octave < 0) {
+    return 0;
+  }
+  if (octave >= kNumOctaves) {
+    return kNumBuckets - 1;
+  }
+  const int sub_bucket = std::min(static_cast<int>((2.0 * mantissa - 1.0) * kSubBuckets), kSubBuckets - 1);
+  return 1 + octave * kSubBuckets + sub_bucket;
+}
+
+double HistogramLayout::LowerBound(size_t index) {
+  if (index == 0) {
+    return 0.0;
+  }
+  const int octave = static_cast<int>(index - 1) / kSubBuckets;
+  const int sub_bucket = static_cast<int>(index - 1) % kSubBuckets;
+  return std::ldexp(1.0 + static_cast<double>(sub_bucket) / kSubBuckets, octave + kMinExponent - 1);
+}
+
+double HistogramLayout::UpperBound(size_t index) {
+  if (index == 0) {
+    return LowerBound(1);
+  }
+  if (index + 1 >= kNumBuckets) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return LowerBound(index + 1);
+}
+
+// Middle of the bucket holding the sample of that rank, clamped to [min, max].
+double StatisticsMapValue::Percentile(double percentile) const {
+  const int count = TotalSamples();
+  if (count == 0) {
+    return 0.0;
+  }
+  const double clamped = std::max(0.0, std::min(100.0, percentile));
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < histogram_.size(); ++i) {
+    seen += histogram_[i];
+    if (seen >= rank) {
+      const double middle = 0.5 * (HistogramLayout::LowerBound(i) + std::min(HistogramLayout::UpperBound(i), Max()));
+      return std::max(Min(), std::min(Max(), middle));
+    }
+  }
+  return Max();
+}
+
 Statistics& Statistics::Instance() {
   static Statistics instance;
   return instance;
@@ -152,6 +213,13 @@ double Statistics::GetQ3(size_t handle) {
   return Instance().stats_collectors_[handle].Q1();
 }
 double Statistics::GetQ3(std::string const& tag) { return GetQ3(GetHandle(tag)); }
+double Statistics::GetPercentile(size_t handle, double percentile) {
+  std::lock_guard<std::mutex> lock(Instance().mutex_);
+  return Instance().stats_collectors_[handle].Percentile(percentile);
+}
+double Statistics::GetPercentile(std::string const& tag, double percentile) {
+  return GetPercentile(GetHandle(tag), percentile);
+}
 double Statistics::GetHz(size_t handle) {
   std::lock_guard<std::mutex> lock(Instance().mutex_);
   return Instance().stats_collectors_[handle].MeanCallsPerSec();
@@ -228,7 +296,8 @@ void Statistics::Print(std::ostream& out) {  // NOLINT
   out << "#\t";
   out << "Log Hz\t";
   out << "{avg     +- std    }\t";
-  out << "[min,max]\n";
+  out << "[min,max]\t";
+  out << "{p50, p95, p99}\n";
 
   for (const typename map_t::value_type& t : tag_map) {
     size_t i = t.second;
@@ -252,7 +321,8 @@ void Statistics::Print(std::ostream& out) {  // NOLINT
       double max_value = GetMax(i);
 
       // out.width(5);
-      out << std::noshowpoint << "[" << min_value << "," << max_value << "]";
+      out << std::noshowpoint << "[" << min_value << "," << max_value << "]\t";
+      out << "{" << GetPercentile(i, 50.0) << ", " << GetPercentile(i, 95.0) << ", " << GetPercentile(i, 99.0) << "}";
     }
     out << std::endl;
   }
@@ -328,6 +398,33 @@ void Statistics::WriteToYamlFile(const std::string& path) {
   }
 }
 
+void Statistics::WriteSnapshot(const std::string& path) {
+  std::ofstream output_file(path);
+  if (!output_file) {
+    LOG(ERROR) << "Could not write statistics snapshot: Unable to open file: " << path;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(Instance().mutex_);
+  output_file << "# timing snapshot 1\n";
+  output_file << std::setprecision(std::numeric_limits<double>::max_digits10);
+  for (const map_t::value_type& tag : Instance().tag_map_) {
+    const StatisticsMapValue& stats = Instance().stats_collectors_[tag.second];
+    if (stats.TotalSamples() == 0) {
+      continue;
+    }
+    output_file << tag.first << "\t" << stats.TotalSamples() << "\t" << stats.Sum() << "\t" << stats.Min() << "\t"
+                << stats.Max() << "\t";
+    const std::vector<uint64_t>& histogram = stats.Histogram();
+    for (size_t i = 0; i < histogram.size(); ++i) {
+      if (histogram[i] > 0) {
+        output_file << " " << i << ":" << histogram[i];
+      }
+    }
+    output_file << "\n";
+  }
+}
+
 std::string Statistics::Print() {
   std::stringstream ss;
   Print(ss);
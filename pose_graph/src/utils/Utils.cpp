@@ -1,5 +1,7 @@
 #include "utils/Utils.h"
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <string>
 
 Eigen::Matrix3d Utils::g2R(const Eigen::Vector3d& g) {
@@ -76,3 +78,85 @@ ros::Time Utils::toRosTime(const Timestamp t) {
   uint32_t sec_part = static_cast<uint64_t>(t) / 1000000000UL;
   return ros::Time(sec_part, nsec_part);
 }
+
+void Utils::setupOutputLogDirectories(const std::string& base_path) {
+  std::string output_dir = base_path + "/loop_candidates/";
+  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
+    boost::filesystem::create_directories(output_dir);
+  }
+  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
+    boost::filesystem::remove_all(entry.path());
+  }
+
+  output_dir = base_path + "/descriptor_matched/";
+  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
+    boost::filesystem::create_directories(output_dir);
+  }
+  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
+    boost::filesystem::remove_all(entry.path());
+  }
+
+  output_dir = base_path + "/pnp_verified/";
+  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
+    boost::filesystem::create_directories(output_dir);
+  }
+  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
+    boost::filesystem::remove_all(entry.path());
+  }
+
+  output_dir = base_path + "/loop_closure/";
+  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
+    boost::filesystem::create_directories(output_dir);
+  }
+  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
+    boost::filesystem::remove_all(entry.path());
+  }
+
+  output_dir = base_path + "/geometric_verification/";
+  if (!boost::filesystem::is_directory(output_dir) || !boost::filesystem::exists(output_dir)) {
+    boost::filesystem::create_directories(output_dir);
+  }
+  for (const auto& entry : boost::filesystem::directory_iterator(output_dir)) {
+    boost::filesystem::remove_all(entry.path());
+  }
+
+  std::string loop_closure_file = base_path + "/loop_closure.txt";
+  if (boost::filesystem::exists(loop_closure_file)) {
+    boost::filesystem::remove(loop_closure_file);
+  }
+  std::ofstream loop_path_file(loop_closure_file, std::ios::out);
+  loop_path_file << "cur_kf_id"
+                 << " "
+                 << "cur_kf_ts"
+                 << " "
+                 << "matched_kf_id"
+                 << " "
+                 << "matched_kf_ts"
+                 << " "
+                 << "relative_tx"
+                 << " "
+                 << "relative_ty"
+                 << " "
+                 << "relative_tz"
+                 << " "
+                 << "relative_yaw"
+                 << " "
+                 << "relative_pitch"
+                 << " "
+                 << "relative_roll" << std::endl;
+  loop_path_file.close();
+
+  std::string switch_info_file = base_path + "/switch_info.txt";
+  if (boost::filesystem::exists(switch_info_file)) {
+    boost::filesystem::remove(switch_info_file);
+  }
+  std::ofstream switch_info_file_stream(switch_info_file, std::ios::out);
+  switch_info_file_stream << "type"
+                          << " "
+                          << "vio_stamp"
+                          << " "
+                          << "prim_stamp"
+                          << " "
+                          << "uber_stamp" << std::endl;
+  switch_info_file_stream.close();
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "utils/ChunkedVector.h"
+
+namespace {
+
+struct DummyKeyframe {
+  explicit DummyKeyframe(int index) : index(index) {}
+  int index;
+};
+
+// the lookup PoseGraph::getKFPtr did on the std::list, as reference
+DummyKeyframe* findInList(const std::list<DummyKeyframe*>& keyframes, int index) {
+  for (DummyKeyframe* kf : keyframes) {
+    if (kf->index == index) return kf;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(ChunkedVector, stablePointersAndIteration) {
+  utils::ChunkedVector<int, 2> vector;  // chunks of 4
+  for (int i = 0; i < 3; ++i) vector.push_back(i);
+  const int* first = &vector[0];
+  for (int i = 3; i < 100; ++i) vector.push_back(i);
+  EXPECT_EQ(first, &vector[0]);
+  EXPECT_EQ(vector.size(), 100u);
+  EXPECT_EQ(vector.back(), 99);
+
+  int expected = 10;
+  for (auto it = vector.begin() + 10; it != vector.end(); ++it) EXPECT_EQ(*it, expected++);
+  EXPECT_EQ(vector.end() - vector.begin(), 100);
+}
+
+// Per-keyframe insertion and lookup cost while a mission grows to 50k keyframes.
+TEST(ChunkedVector, benchmarkKeyframeLookup) {
+  const int num_keyframes = 50000;
+  const int block_size = 10000;
+  const int lookups_per_keyframe = 4;  // addKFToPoseGraph, updatePath and the optimization look up loop partners
+
+  std::vector<std::unique_ptr<DummyKeyframe>> storage;
+  utils::ChunkedVector<DummyKeyframe*> keyframes;
+  std::list<DummyKeyframe*> keyframe_list;
+
+  typedef std::chrono::steady_clock clock;
+  std::cout << "Per keyframe insertion + " << lookups_per_keyframe << " lookups:" << std::endl;
+  unsigned int seed = 1;
+  for (int block = 0; block < num_keyframes / block_size; ++block) {
+    clock::duration chunked_time = clock::duration::zero();
+    clock::duration list_time = clock::duration::zero();
+    for (int i = block * block_size; i < (block + 1) * block_size; ++i) {
+      storage.emplace_back(new DummyKeyframe(i));
+      int lookups[lookups_per_keyframe];
+      for (int& lookup : lookups) lookup = rand_r(&seed) % (i + 1);
+
+      clock::time_point start = clock::now();
+      keyframes.push_back(storage.back().get());
+      for (int lookup : lookups) ASSERT_EQ(keyframes[lookup]->index, lookup);
+      chunked_time += clock::now() - start;
+
+      // the list scan is too slow to run for every keyframe
+      if (i % 100 != 0) {
+        keyframe_list.push_back(storage.back().get());
+        continue;
+      }
+      start = clock::now();
+      keyframe_list.push_back(storage.back().get());
+      for (int lookup : lookups) ASSERT_EQ(findInList(keyframe_list, lookup)->index, lookup);
+      list_time += (clock::now() - start) * 100;
+    }
+    std::cout << "  keyframes " << block * block_size << " - " << (block + 1) * block_size << ": ChunkedVector "
+              << std::chrono::duration<double, std::nano>(chunked_time).count() / block_size << " ns, std::list "
+              << std::chrono::duration<double, std::nano>(list_time).count() / block_size << " ns" << std::endl;
+  }
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "pose_graph/GlobalMapping.h"
+
+namespace {
+
+struct SyntheticObservation {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  int keyframe;
+  Eigen::Vector3d local_pos;
+  double quality;
+};
+
+struct SyntheticMap {
+  std::vector<KeyframePose> keyframes;
+  // per landmark, in the order they are added: the landmark id is the slot in the snapshots
+  std::vector<std::vector<SyntheticObservation, Eigen::aligned_allocator<SyntheticObservation>>> observations;
+};
+
+KeyframePose keyframePose(int index, const Eigen::Vector3d& translation, double yaw) {
+  KeyframePose pose;
+  pose.index = index;
+  pose.translation = translation;
+  pose.rotation = Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  return pose;
+}
+
+// Keyframes along a straight line, each landmark seen by 1 to 3 consecutive keyframes.
+SyntheticMap createMap(int num_keyframes, int landmarks_per_keyframe, std::mt19937& rng) {
+  SyntheticMap map;
+  std::uniform_real_distribution<double> local(-2.0, 2.0);
+  std::uniform_real_distribution<double> quality(0.1, 1.0);
+  std::uniform_int_distribution<int> num_observations(1, 3);
+  for (int k = 0; k < num_keyframes; ++k) {
+    map.keyframes.push_back(keyframePose(k, Eigen::Vector3d(0.5 * k, 0.0, 0.0), 0.01 * k));
+    for (int i = 0; i < landmarks_per_keyframe; ++i) {
+      map.observations.emplace_back();
+      const int last = std::min(num_keyframes - 1, k + num_observations(rng) - 1);
+      for (int j = k; j <= last; ++j) {
+        map.observations.back().push_back(
+            SyntheticObservation{j, Eigen::Vector3d(local(rng), local(rng), local(rng) + 4.0), quality(rng)});
+      }
+    }
+  }
+  return map;
+}
+
+void fillGlobalMap(const SyntheticMap& map, GlobalMap& global_map) {  // NOLINT
+  for (const KeyframePose& pose : map.keyframes) global_map.addKeyframe(pose);
+  for (size_t id = 0; id < map.observations.size(); ++id) {
+    for (const SyntheticObservation& obs : map.observations[id]) {
+      const KeyframePose& pose = map.keyframes[obs.keyframe];
+      global_map.addLandmark(pose.rotation * obs.local_pos + pose.translation,
+                             id,
+                             obs.quality,
+                             obs.keyframe,
+                             obs.local_pos,
+                             Eigen::Vector3d(100.0, 150.0, 200.0));
+    }
+  }
+}
+
+// What LoopClosure::updateGlobalMap computed for every landmark after each optimization, as reference.
+Eigen::Vector3d fullRecompute(const SyntheticMap& map, size_t id) {
+  Eigen::Vector3d point = Eigen::Vector3d::Zero();
+  double quality = 0.0;
+  for (const SyntheticObservation& obs : map.observations[id]) {
+    const KeyframePose& pose = map.keyframes[obs.keyframe];
+    point += (pose.rotation * obs.local_pos + pose.translation) * obs.quality;
+    quality += obs.quality;
+  }
+  return point / quality;
+}
+
+// The pose graph correction of a loop: the keyframes from first_index on are rotated about first_index.
+std::vector<KeyframePose> correct(SyntheticMap& map, int first_index, double yaw) {  // NOLINT
+  std::vector<KeyframePose> changed;
+  const Eigen::Matrix3d rotation = Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  const Eigen::Vector3d pivot = map.keyframes[first_index].translation;
+  for (size_t k = first_index; k < map.keyframes.size(); ++k) {
+    KeyframePose& pose = map.keyframes[k];
+    pose.translation = rotation * (pose.translation - pivot) + pivot + Eigen::Vector3d(0.0, 0.01, 0.0);
+    pose.rotation = rotation * pose.rotation;
+    changed.push_back(pose);
+  }
+  return changed;
+}
+
+}  // namespace
+
+TEST(GlobalMap, incrementalUpdateMatchesFullRecompute) {
+  std::mt19937 rng(7);
+  SyntheticMap map = createMap(100, 50, rng);
+  GlobalMap global_map;
+  fillGlobalMap(map, global_map);
+  ASSERT_EQ(global_map.size(), map.observations.size());
+
+  std::shared_ptr<const GlobalMapSnapshot> before = global_map.snapshot();
+  EXPECT_EQ(before.get(), global_map.snapshot().get());  // nothing changed, nothing copied
+  for (size_t id = 0; id < map.observations.size(); ++id) {
+    const MapPoint& point = (*before)[id];
+    EXPECT_LT((Eigen::Vector3d(point.x, point.y, point.z) - fullRecompute(map, id)).norm(), 1e-4) << id;
+  }
+
+  // unchanged poses re-anchor nothing
+  EXPECT_EQ(global_map.updateKeyframePoses(map.keyframes), 0u);
+
+  std::vector<KeyframePose> changed = correct(map, 90, 0.05);
+  std::vector<bool> moved(map.observations.size(), false);
+  size_t expected_reanchored = 0;
+  for (size_t id = 0; id < map.observations.size(); ++id) {
+    for (const SyntheticObservation& obs : map.observations[id]) moved[id] = moved[id] || obs.keyframe >= 90;
+    if (moved[id]) ++expected_reanchored;
+  }
+  EXPECT_EQ(global_map.updateKeyframePoses(changed, 4), expected_reanchored);
+
+  // every landmark as the full recompute gives it, the ones not re-anchored untouched
+  std::shared_ptr<const GlobalMapSnapshot> after = global_map.snapshot();
+  ASSERT_EQ(after->size(), map.observations.size());
+  for (size_t id = 0; id < map.observations.size(); ++id) {
+    const MapPoint& point = (*after)[id];
+    const Eigen::Vector3d position(point.x, point.y, point.z);
+    EXPECT_LT((position - fullRecompute(map, id)).norm(), 1e-4) << id;
+    if (!moved[id]) {
+      const MapPoint& old_point = (*before)[id];
+      EXPECT_EQ(position, Eigen::Vector3d(old_point.x, old_point.y, old_point.z)) << id;
+    }
+  }
+
+  // the landmarks of the first keyframes did not move: their chunk is shared with the old snapshot
+  EXPECT_EQ(before->chunk(0).get(), after->chunk(0).get());
+  EXPECT_NE(before->chunk(after->numChunks() - 1).get(), after->chunk(after->numChunks() - 1).get());
+  // and the old snapshot is untouched
+  const MapPoint& old_point = (*before)[map.observations.size() - 1];
+  const MapPoint& new_point = (*after)[map.observations.size() - 1];
+  EXPECT_NE(old_point.y, new_point.y);
+}
+
+TEST(GlobalMap, voxelDownsampling) {
+  GlobalMap global_map;
+  global_map.addKeyframe(keyframePose(0, Eigen::Vector3d::Zero(), 0.0));
+  const Eigen::Vector3d color(10.0, 20.0, 30.0);
+  // two points in the voxel [0, 1)^3, one in [1, 2) x [0, 1)^2, one below the quality threshold
+  global_map.addLandmark(Eigen::Vector3d(0.2, 0.5, 0.5), 1, 0.5, 0, Eigen::Vector3d(0.2, 0.5, 0.5), color);
+  global_map.addLandmark(Eigen::Vector3d(0.6, 0.5, 0.5), 2, 0.5, 0, Eigen::Vector3d(0.6, 0.5, 0.5), color);
+  global_map.addLandmark(Eigen::Vector3d(1.5, 0.5, 0.5), 3, 0.5, 0, Eigen::Vector3d(1.5, 0.5, 0.5), color);
+  global_map.addLandmark(Eigen::Vector3d(1.6, 0.5, 0.5), 4, 0.01, 0, Eigen::Vector3d(1.6, 0.5, 0.5), color);
+
+  std::vector<MapPoint> points;
+  global_map.snapshot()->downsample(1.0, 0.1, points);
+  ASSERT_EQ(points.size(), 2u);
+  EXPECT_FLOAT_EQ(points[0].x, 0.4f);
+  EXPECT_FLOAT_EQ(points[1].x, 1.5f);
+  EXPECT_EQ(points[0].g, 20);
+  EXPECT_FLOAT_EQ(points[0].quality, 0.5f);
+}
+
+// Map update after a loop that corrects the last 2% of the keyframes, for a growing map.
+TEST(GlobalMap, benchmarkLocalCorrection) {
+  std::cout << "Global map update after a correction of the last 2% of the keyframes:" << std::endl;
+  for (int num_keyframes : {100, 1000, 5000}) {
+    std::mt19937 rng(1);
+    SyntheticMap map = createMap(num_keyframes, 100, rng);
+    GlobalMap global_map;
+    fillGlobalMap(map, global_map);
+    global_map.snapshot();
+
+    typedef std::chrono::steady_clock clock;
+    std::vector<KeyframePose> changed = correct(map, num_keyframes - num_keyframes / 50, 0.02);
+    clock::time_point start = clock::now();
+    const size_t reanchored = global_map.updateKeyframePoses(changed);
+    std::shared_ptr<const GlobalMapSnapshot> snapshot = global_map.snapshot();
+    const double incremental_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    // recomputing and copying every landmark, as before
+    start = clock::now();
+    std::vector<Eigen::Vector3d> all;
+    all.reserve(map.observations.size());
+    for (size_t id = 0; id < map.observations.size(); ++id) all.push_back(fullRecompute(map, id));
+    const double full_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    std::cout << "  " << map.observations.size() << " landmarks: " << reanchored << " re-anchored in "
+              << incremental_ms << " ms, full recompute " << full_ms << " ms" << std::endl;
+    EXPECT_EQ(snapshot->size(), map.observations.size());
+  }
+}
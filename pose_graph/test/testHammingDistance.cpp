@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "utils/HammingDistance.h"
+
+namespace {
+
+typedef std::bitset<256> Bitset;  // DVision::BRIEF256::bitset
+
+// Window and FAST descriptors of a loop candidate: every other window descriptor has a noisy copy among the
+// old descriptors, the rest are random.
+void createDescriptors(size_t num_window, size_t num_old, std::vector<Bitset>& window, std::vector<Bitset>& old) {
+  std::mt19937 rng(42);
+  std::bernoulli_distribution bit(0.5), flip(0.1);
+  auto random_descriptor = [&]() {
+    Bitset d;
+    for (size_t b = 0; b < 256; ++b) d[b] = bit(rng);
+    return d;
+  };
+  old.clear();
+  window.clear();
+  for (size_t i = 0; i < num_old; ++i) old.push_back(random_descriptor());
+  std::uniform_int_distribution<size_t> old_index(0, num_old - 1);
+  for (size_t i = 0; i < num_window; ++i) {
+    if (i % 2) {
+      window.push_back(random_descriptor());
+      continue;
+    }
+    Bitset d = old[old_index(rng)];
+    for (size_t b = 0; b < 256; ++b)
+      if (flip(rng)) d.flip(b);
+    window.push_back(d);
+  }
+}
+
+// The matching Keyframe::searchInAera did on the bitsets, as reference.
+void matchBitsets(const std::vector<Bitset>& window, const std::vector<Bitset>& old, std::vector<int>& best) {
+  best.assign(window.size(), -1);
+  for (size_t i = 0; i < window.size(); ++i) {
+    int best_distance = 128;
+    for (size_t j = 0; j < old.size(); ++j) {
+      int distance = (window[i] ^ old[j]).count();
+      if (distance < best_distance) {
+        best_distance = distance;
+        best[i] = static_cast<int>(j);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(HammingDistance, matchesAgreeWithBitsets) {
+  std::vector<Bitset> window, old;
+  createDescriptors(301, 503, window, old);
+  std::vector<utils::Descriptor256> window_packed, old_packed;
+  utils::packDescriptors(window, window_packed);
+  utils::packDescriptors(old, old_packed);
+
+  for (size_t j = 0; j < old.size(); j += 37) {
+    EXPECT_EQ(utils::hammingDistance(window_packed[0], old_packed[j]), static_cast<int>((window[0] ^ old[j]).count()));
+  }
+
+  std::vector<int> reference;
+  matchBitsets(window, old, reference);
+  for (size_t i = 0; i < window.size(); ++i) {
+    if (reference[i] != -1) {
+      EXPECT_EQ(utils::nearestHamming(window_packed[i], old_packed.data(), old.size()), reference[i]);
+    }
+  }
+  EXPECT_EQ(utils::nearestHamming(window_packed[0], old_packed.data(), 0), -1);
+  std::vector<utils::HammingMatch> matches;
+  utils::matchHamming(window_packed, old_packed, matches);
+  ASSERT_EQ(matches.size(), window.size());
+  for (size_t i = 0; i < window.size(); ++i) {
+    const utils::HammingMatch& match = matches[i];
+    int second_best = 256;
+    for (size_t j = 0; j < old.size(); ++j) {
+      if (static_cast<int>(j) != match.best_index) {
+        second_best = std::min(second_best, static_cast<int>((window[i] ^ old[j]).count()));
+      }
+    }
+    ASSERT_EQ(match.best_distance, static_cast<int>((window[i] ^ old[match.best_index]).count()));
+    ASSERT_EQ(match.second_best_distance, second_best);
+    if (reference[i] != -1) {
+      ASSERT_EQ(match.best_index, reference[i]);
+    }
+  }
+}
+
+TEST(HammingDistance, emptyTrainSet) {
+  std::vector<utils::Descriptor256> queries(3), train;
+  std::vector<utils::HammingMatch> matches;
+  utils::matchHamming(queries, train, matches);
+  ASSERT_EQ(matches.size(), 3u);
+  for (const utils::HammingMatch& match : matches) {
+    EXPECT_EQ(match.best_index, -1);
+    EXPECT_EQ(match.second_best_index, -1);
+  }
+}
+
+// Descriptor search of one loop candidate, ~300 window points against ~500 FAST points.
+TEST(HammingDistance, benchmarkLoopCandidateSearch) {
+  const size_t num_window = 300;
+  const size_t num_old = 500;
+  const int repetitions = 20;
+  std::vector<Bitset> window, old;
+  createDescriptors(num_window, num_old, window, old);
+  std::vector<utils::Descriptor256> window_packed, old_packed;
+  utils::packDescriptors(window, window_packed);
+  utils::packDescriptors(old, old_packed);
+
+  typedef std::chrono::steady_clock clock;
+  std::vector<int> reference;
+  clock::time_point start = clock::now();
+  for (int r = 0; r < repetitions; ++r) matchBitsets(window, old, reference);
+  const double bitset_us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+  std::cout << "Loop candidate search " << num_window << " x " << num_old << ":" << std::endl;
+  std::cout << "  std::bitset: " << bitset_us << " us" << std::endl;
+
+  std::vector<utils::HammingMatch> matches;
+  start = clock::now();
+  for (int r = 0; r < repetitions; ++r) utils::matchHamming(window_packed, old_packed, matches);
+  const double packed_us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+  std::cout << "  packed: " << packed_us << " us (" << bitset_us / packed_us << "x)" << std::endl;
+}
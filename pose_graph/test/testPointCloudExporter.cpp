@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "pose_graph/PointCloudExporter.h"
+
+namespace {
+
+struct PlyVertex {
+  float x, y, z;
+  uint8_t r, g, b;
+  float quality;
+};
+
+// Header and vertices of a binary PLY file as PointCloudExporter writes it.
+bool readPly(const std::string& filename, std::vector<PlyVertex>& vertices) {  // NOLINT
+  std::ifstream file(filename, std::ios::binary);
+  std::string line;
+  size_t num_vertices = 0;
+  while (std::getline(file, line) && line != "end_header") {
+    if (line.compare(0, 15, "element vertex ") == 0) num_vertices = std::stoul(line.substr(15));
+  }
+  if (!file) return false;
+  const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (data.size() != num_vertices * 19) return false;
+  vertices.resize(num_vertices);
+  for (size_t i = 0; i < num_vertices; ++i) {
+    const char* in = data.data() + i * 19;
+    std::memcpy(&vertices[i].x, in, 4);
+    std::memcpy(&vertices[i].y, in + 4, 4);
+    std::memcpy(&vertices[i].z, in + 8, 4);
+    vertices[i].r = static_cast<uint8_t>(in[12]);
+    vertices[i].g = static_cast<uint8_t>(in[13]);
+    vertices[i].b = static_cast<uint8_t>(in[14]);
+    std::memcpy(&vertices[i].quality, in + 15, 4);
+  }
+  return true;
+}
+
+// Landmarks first_id to last_id, one per meter along x, every tenth below the export quality.
+void addLandmarks(GlobalMap& global_map, uint64_t first_id, uint64_t last_id) {  // NOLINT
+  for (uint64_t id = first_id; id <= last_id; ++id) {
+    const Eigen::Vector3d position(static_cast<double>(id), 1.0, 2.0);
+    const double quality = id % 10 == 0 ? 0.001 : 0.5;
+    global_map.addLandmark(position, id, quality, 0, position, Eigen::Vector3d(10.0, 20.0, id % 256));
+  }
+}
+
+}  // namespace
+
+TEST(PointCloudExporter, saveAndAppend) {
+  const std::string filename = ::testing::TempDir() + "pointcloud_exporter_test.ply";
+  GlobalMap global_map;
+  KeyframePose keyframe;
+  keyframe.index = 0;
+  keyframe.translation.setZero();
+  keyframe.rotation.setIdentity();
+  global_map.addKeyframe(keyframe);
+  // more than one chunk, the last one partial
+  addLandmarks(global_map, 1, 5000);
+
+  PointCloudExporter exporter(0.01);
+  ASSERT_TRUE(exporter.save(global_map.snapshot(), filename, false));
+  exporter.waitUntilIdle();
+  EXPECT_FALSE(exporter.busy());
+  EXPECT_EQ(exporter.progress(), 1.0);
+
+  std::vector<PlyVertex> vertices;
+  ASSERT_TRUE(readPly(filename, vertices));
+  ASSERT_EQ(vertices.size(), 4500u);
+  EXPECT_EQ(vertices[0].x, 1.0f);
+  EXPECT_EQ(vertices[0].z, 2.0f);
+  EXPECT_EQ(vertices[0].g, 20);
+  EXPECT_EQ(vertices[0].b, 1);
+  EXPECT_EQ(vertices[9].x, 11.0f);  // 10 is below the quality
+  EXPECT_FLOAT_EQ(vertices[9].quality, 0.5f);
+
+  // the new landmarks only, the first ones keep their saved position
+  global_map.updateLandmark(1, Eigen::Vector3d(-1.0, -1.0, -1.0), 0.5, Eigen::Vector3d::Zero());
+  addLandmarks(global_map, 5001, 9000);
+  ASSERT_TRUE(exporter.save(global_map.snapshot(), filename, true));
+  exporter.waitUntilIdle();
+  ASSERT_TRUE(readPly(filename, vertices));
+  ASSERT_EQ(vertices.size(), 8100u);
+  EXPECT_EQ(vertices[0].x, 1.0f);
+  EXPECT_EQ(vertices[4500].x, 5001.0f);
+  EXPECT_EQ(vertices.back().x, 8999.0f);
+
+  // nothing new
+  ASSERT_TRUE(exporter.save(global_map.snapshot(), filename, true));
+  exporter.waitUntilIdle();
+  ASSERT_TRUE(readPly(filename, vertices));
+  EXPECT_EQ(vertices.size(), 8100u);
+
+  // a full save writes the current positions
+  ASSERT_TRUE(exporter.save(global_map.snapshot(), filename, false));
+  exporter.waitUntilIdle();
+  ASSERT_TRUE(readPly(filename, vertices));
+  ASSERT_EQ(vertices.size(), 8100u);
+  EXPECT_EQ(vertices[0].x, -1.0f);
+
+  // a file changed by someone else is written again
+  std::ofstream(filename, std::ios::app) << "garbage";
+  addLandmarks(global_map, 9001, 9010);
+  ASSERT_TRUE(exporter.save(global_map.snapshot(), filename, true));
+  exporter.waitUntilIdle();
+  ASSERT_TRUE(readPly(filename, vertices));
+  EXPECT_EQ(vertices.size(), 8109u);
+  std::remove(filename.c_str());
+}
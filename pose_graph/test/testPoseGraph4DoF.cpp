@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <Eigen/Core>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "pose_graph/PoseGraph4DoF.h"
+#include "utils/Utils.h"
+
+namespace {
+
+struct SyntheticKeyframe {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  Eigen::Vector3d true_t, svin_t;
+  Eigen::Matrix3d true_r, svin_r;
+  int loop_index = -1;
+  Eigen::Vector3d loop_relative_t;
+  double loop_relative_yaw = 0.0;
+};
+
+// Circles of constant radius, one keyframe every 0.5 m. The odometry slowly drifts in yaw and position,
+// and every loop_spacing keyframes one closes a loop to the same spot on the previous lap.
+std::vector<SyntheticKeyframe, Eigen::aligned_allocator<SyntheticKeyframe>> createTrajectory(int num_keyframes,
+                                                                                            int keyframes_per_lap,
+                                                                                            int loop_spacing) {
+  std::vector<SyntheticKeyframe, Eigen::aligned_allocator<SyntheticKeyframe>> keyframes(num_keyframes);
+  const double radius = 0.5 * keyframes_per_lap / (2.0 * M_PI);
+  for (int i = 0; i < num_keyframes; ++i) {
+    const double angle = 2.0 * M_PI * i / keyframes_per_lap;
+    const double yaw = angle * 180.0 / M_PI + 90.0;
+    SyntheticKeyframe& kf = keyframes[i];
+    kf.true_t = Eigen::Vector3d(radius * std::cos(angle), radius * std::sin(angle), 0.001 * i);
+    kf.true_r = Utils::ypr2R(Eigen::Vector3d(yaw, 2.0, -1.0));
+    kf.svin_t = kf.true_t + Eigen::Vector3d(0.0005 * i, -0.0003 * i, 0.0001 * i);
+    kf.svin_r = Utils::ypr2R(Eigen::Vector3d(yaw + 0.002 * i, 2.0, -1.0));
+    if (i >= keyframes_per_lap && i % loop_spacing == 0) {
+      const SyntheticKeyframe& old_kf = keyframes[i - keyframes_per_lap];
+      kf.loop_index = i - keyframes_per_lap;
+      kf.loop_relative_t = old_kf.true_r.transpose() * (kf.true_t - old_kf.true_t);
+      kf.loop_relative_yaw = Utils::R2ypr(kf.true_r).x() - Utils::R2ypr(old_kf.true_r).x();
+    }
+  }
+  return keyframes;
+}
+
+// Persistent vs. rebuild loop latency the benchmark accepts, generous since the sparse solve dominates both.
+const double kMaxLatencyRatio = 1.0;
+
+}  // namespace
+
+// Loop latency on a 10k keyframe mission: rebuilding the whole graph per loop vs. the persistent graph.
+TEST(PoseGraph4DoF, benchmarkIncrementalVsRebuild) {
+  const int num_keyframes = 10000;
+  const int keyframes_per_lap = 400;
+  const int loop_spacing = 200;
+  const auto keyframes = createTrajectory(num_keyframes, keyframes_per_lap, loop_spacing);
+  const int first_looped_index = 0;  // the first loop closes to the very first keyframe
+
+  typedef std::chrono::steady_clock clock;
+  PoseGraph4DoF incremental;
+  incremental.reset(first_looped_index);
+  std::vector<double> incremental_ms, rebuild_ms;
+
+  for (int cur_index = keyframes_per_lap; cur_index < num_keyframes; cur_index += loop_spacing) {
+    // persistent graph: only add the keyframes since the last loop
+    clock::time_point start = clock::now();
+    for (int i = incremental.lastIndex() + 1; i <= cur_index; ++i) {
+      Eigen::Vector3d init_t = keyframes[i].svin_t;
+      Eigen::Matrix3d init_r = keyframes[i].svin_r;
+      if (i > first_looped_index) {
+        // warm start: new keyframes continue from the drift-corrected pose of their predecessor
+        Eigen::Vector3d prev_t;
+        Eigen::Matrix3d prev_r;
+        incremental.getPose(i - 1, prev_t, prev_r);
+        const Eigen::Matrix3d prev_r_svin = prev_r * keyframes[i - 1].svin_r.transpose();
+        init_t = prev_t + prev_r_svin * (keyframes[i].svin_t - keyframes[i - 1].svin_t);
+        init_r = prev_r_svin * keyframes[i].svin_r;
+      }
+      incremental.addKeyframe(i, 0, keyframes[i].svin_t, keyframes[i].svin_r, init_t, init_r);
+      const SyntheticKeyframe& kf = keyframes[i];
+      if (kf.loop_index >= 0) incremental.addLoopEdge(i, kf.loop_index, kf.loop_relative_t, kf.loop_relative_yaw);
+    }
+    incremental.solve(5);
+    incremental_ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+    // previous behaviour: a new problem from the earliest loop to the current keyframe, started from odometry
+    start = clock::now();
+    PoseGraph4DoF rebuild;
+    rebuild.reset(first_looped_index);
+    for (int i = first_looped_index; i <= cur_index; ++i) {
+      const SyntheticKeyframe& kf = keyframes[i];
+      rebuild.addKeyframe(i, 0, kf.svin_t, kf.svin_r, kf.svin_t, kf.svin_r);
+      if (kf.loop_index >= 0) rebuild.addLoopEdge(i, kf.loop_index, kf.loop_relative_t, kf.loop_relative_yaw);
+    }
+    rebuild.solve(5);
+    rebuild_ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+  }
+
+  // the warm started graph has to be at least as close to the ground truth as the odometry
+  double odometry_error = 0.0, incremental_error = 0.0;
+  for (int i = first_looped_index; i <= incremental.lastIndex(); ++i) {
+    Eigen::Vector3d t;
+    Eigen::Matrix3d r;
+    incremental.getPose(i, t, r);
+    incremental_error += (t - keyframes[i].true_t).norm();
+    odometry_error += (keyframes[i].svin_t - keyframes[i].true_t).norm();
+  }
+  EXPECT_LT(incremental_error, odometry_error);
+
+  const size_t n = incremental_ms.size();
+  std::cout << "4-DoF loop latency over " << n << " loops, " << incremental.lastIndex() + 1 << " keyframes"
+            << std::endl;
+  for (size_t k : {size_t(0), n / 4, n / 2, 3 * n / 4, n - 1}) {
+    std::cout << "  loop " << k << ": persistent " << incremental_ms[k] << " ms, rebuild " << rebuild_ms[k] << " ms"
+              << std::endl;
+  }
+
+  // the persistent graph has to beat the rebuild where it matters, on the large graphs of the second half of the
+  // mission. Summed over those loops against timing noise, and only asked to be faster, not by how much
+  double incremental_late_ms = 0.0, rebuild_late_ms = 0.0;
+  for (size_t k = n / 2; k < n; ++k) {
+    incremental_late_ms += incremental_ms[k];
+    rebuild_late_ms += rebuild_ms[k];
+  }
+  std::cout << "  second half: persistent " << incremental_late_ms << " ms, rebuild " << rebuild_late_ms << " ms ("
+            << rebuild_late_ms / incremental_late_ms << "x)" << std::endl;
+  EXPECT_LT(incremental_late_ms, kMaxLatencyRatio * rebuild_late_ms);
+}
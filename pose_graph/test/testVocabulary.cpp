@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DBoW/DBoW2.h"
+
+namespace {
+
+// Vocabulary tree with random node descriptors and weights, in place of the trained brief_k10L6 vocabulary.
+class SyntheticVocabulary : public BriefVocabulary {
+ public:
+  using BriefVocabulary::transform;  // the single feature transform with weight and node id
+
+  SyntheticVocabulary(int k, int L) : BriefVocabulary(k, L, DBoW2::TF_IDF, DBoW2::L1_NORM) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> weight(0.5, 5.0);
+    m_nodes.push_back(Node(0));
+    std::vector<DBoW2::NodeId> level(1, 0);
+    for (int l = 0; l < L; ++l) {
+      std::vector<DBoW2::NodeId> next_level;
+      for (DBoW2::NodeId parent : level) {
+        for (int c = 0; c < k; ++c) {
+          const DBoW2::NodeId id = m_nodes.size();
+          m_nodes.push_back(Node(id));
+          for (int b = 0; b < DBoW2::FBrief::L; ++b) m_nodes.back().descriptor[b] = rng() & 1;
+          m_nodes.back().parent = parent;
+          m_nodes.back().weight = weight(rng);
+          m_nodes[parent].children.push_back(id);
+          next_level.push_back(id);
+        }
+      }
+      level.swap(next_level);
+    }
+    createWords();
+    createFlatTree();
+  }
+
+  // Back to the pointer based tree the vocabulary used before the flat layout, as reference.
+  void dropFlatTree() { m_flat.reset(); }
+  const SVINLoop::FlatVocabulary& flatTree() const { return *m_flat; }
+};
+
+std::vector<DBoW2::FBrief::TDescriptor> randomDescriptors(size_t n) {
+  std::mt19937 rng(3);
+  std::vector<DBoW2::FBrief::TDescriptor> descriptors(n);
+  for (auto& d : descriptors) {
+    for (int b = 0; b < DBoW2::FBrief::L; ++b) d[b] = rng() & 1;
+  }
+  return descriptors;
+}
+
+}  // namespace
+
+// Node start-up cost of the vocabulary (LoopClosure::setup loads it and copies it into the database) for the
+// text, binary stream and memory mapped formats. All three have to produce the same BoW vectors.
+TEST(Vocabulary, benchmarkLoading) {
+  const SyntheticVocabulary synthetic(10, 5);
+  const boost::filesystem::path directory =
+      boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("vocabulary_%%%%");
+  boost::filesystem::create_directories(directory);
+  const std::string text_file = (directory / "voc.yml.gz").string();
+  const std::string binary_file = (directory / "voc.bin").string();
+  const std::string mapped_file = (directory / "voc.mmap").string();
+  synthetic.save(text_file);
+  synthetic.saveBin(binary_file);
+  synthetic.saveMapped(mapped_file);
+
+  const auto descriptors = randomDescriptors(500);
+  DBoW2::BowVector expected;
+  synthetic.transform(descriptors, expected);
+
+  typedef std::chrono::steady_clock clock;
+  std::cout << "Loading a " << synthetic.size() << " word vocabulary:" << std::endl;
+  for (const std::string& file : {text_file, binary_file, mapped_file}) {
+    const clock::time_point start = clock::now();
+    std::unique_ptr<BriefVocabulary> voc(file == text_file ? new BriefVocabulary() : new BriefVocabulary(file));
+    if (file == text_file) voc->load(file);
+    const double load_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    BriefDatabase db;
+    db.setVocabulary(*voc, false, 0);
+    const double total_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    std::cout << "  " << boost::filesystem::path(file).extension().string() << ": load " << load_ms
+              << " ms, load + database " << total_ms << " ms" << std::endl;
+
+    EXPECT_EQ(voc->isMapped(), file == mapped_file);
+    EXPECT_EQ(voc->size(), synthetic.size());
+    DBoW2::BowVector bow;
+    voc->transform(descriptors, bow);
+    EXPECT_EQ(bow, expected) << file;
+    EXPECT_EQ(voc->getParentNode(123, 2), synthetic.getParentNode(123, 2));
+    EXPECT_EQ(voc->getWord(77), synthetic.getWord(77));
+    EXPECT_EQ(voc->getWordWeight(77), synthetic.getWordWeight(77));
+  }
+  boost::filesystem::remove_all(directory);
+}
+
+// A corrupted or truncated memory mapped vocabulary has to be rejected when it is loaded, not read out of bounds
+// by the first transform, so that LoopClosure can fall back to the binary one.
+TEST(Vocabulary, rejectsCorruptedMappedFile) {
+  const SyntheticVocabulary synthetic(10, 3);
+  const boost::filesystem::path directory =
+      boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("vocabulary_%%%%");
+  boost::filesystem::create_directories(directory);
+  const std::string mapped_file = (directory / "voc.mmap").string();
+  synthetic.saveMapped(mapped_file);
+  std::string contents;
+  {
+    std::ifstream stream(mapped_file, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  }
+  const size_t n_nodes = synthetic.flatTree().nNodes();
+  const size_t nodes_offset = sizeof(SVINLoop::MappedHeader) + sizeof(utils::Descriptor256) * n_nodes;
+  auto write_and_load = [&](const std::string& data) {
+    std::ofstream(mapped_file, std::ios::binary | std::ios::trunc) << data;
+    BriefVocabulary voc(mapped_file);
+  };
+
+  EXPECT_NO_THROW(write_and_load(contents));
+  EXPECT_THROW(write_and_load(contents.substr(0, contents.size() - 100)), std::string);
+  const std::vector<size_t> fields = {offsetof(SVINLoop::FlatNode, firstChild),
+                                      offsetof(SVINLoop::FlatNode, nChildren),
+                                      offsetof(SVINLoop::FlatNode, parent),
+                                      offsetof(SVINLoop::FlatNode, wordId)};
+  const int32_t bad_index = 1 << 30;
+  for (size_t field : fields) {
+    std::string corrupted = contents;
+    // the last node is a leaf with a parent and a word, the root has the children
+    const size_t node = field == offsetof(SVINLoop::FlatNode, firstChild) ? 0 : n_nodes - 1;
+    std::memcpy(&corrupted[nodes_offset + sizeof(SVINLoop::FlatNode) * node + field], &bad_index, sizeof(bad_index));
+    EXPECT_THROW(write_and_load(corrupted), std::string) << "field at offset " << field;
+  }
+  boost::filesystem::remove_all(directory);
+}
+
+// BoW conversion of a keyframe (LoopClosure::detectLoop) on the k10L6 vocabulary: the pointer based tree, the flat
+// tree one feature at a time and the batched flat tree have to agree on words, weights and feature vector nodes.
+TEST(Vocabulary, benchmarkTransform) {
+  SyntheticVocabulary flat(10, 6);
+  SyntheticVocabulary tree(10, 6);
+  tree.dropFlatTree();
+  const auto descriptors = randomDescriptors(500);
+  const int repetitions = 20;
+  const int levelsup = 4;
+
+  DBoW2::BowVector expected_bow, bow;
+  DBoW2::FeatureVector expected_fv, fv;
+  tree.transform(descriptors, expected_bow, expected_fv, levelsup);
+  flat.transform(descriptors, bow, fv, levelsup);
+  EXPECT_EQ(bow, expected_bow);
+  EXPECT_EQ(fv, expected_fv);
+
+  std::vector<DBoW2::WordId> word_ids;
+  std::vector<DBoW2::WordValue> weights;
+  std::vector<DBoW2::NodeId> nids;
+  flat.transformBatch(descriptors, word_ids, weights, &nids, 2);
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    DBoW2::WordId word_id;
+    DBoW2::WordValue weight;
+    DBoW2::NodeId nid;
+    tree.transform(descriptors[i], word_id, weight, &nid, 2);
+    ASSERT_EQ(word_ids[i], word_id);
+    ASSERT_EQ(weights[i], weight);
+    ASSERT_EQ(nids[i], nid);
+  }
+
+  typedef std::chrono::steady_clock clock;
+  auto time_us = [&](const std::function<void()>& transform) {
+    const clock::time_point start = clock::now();
+    for (int r = 0; r < repetitions; ++r) transform();
+    return std::chrono::duration<double, std::micro>(clock::now() - start).count() / repetitions;
+  };
+  const double tree_us = time_us([&]() { tree.transform(descriptors, bow, fv, levelsup); });
+  const double single_us = time_us([&]() {
+    for (size_t i = 0; i < descriptors.size(); ++i) flat.transform(descriptors[i], word_ids[i], weights[i], &nids[i]);
+  });
+  const double batch_us = time_us([&]() { flat.transform(descriptors, bow, fv, levelsup); });
+  std::cout << "BoW conversion of " << descriptors.size() << " descriptors, " << flat.size() << " words:" << std::endl
+            << "  pointer tree: " << tree_us << " us" << std::endl
+            << "  flat tree, per feature: " << single_us << " us (" << tree_us / single_us << "x)" << std::endl
+            << "  flat tree, batched: " << batch_us << " us (" << tree_us / batch_us << "x)" << std::endl;
+}